@@ -7,7 +7,9 @@
 
 namespace berrydb {}  // namespace berrydb
 
+#include "berrydb/bulk_loader.h"
 #include "berrydb/catalog.h"
+#include "berrydb/cursor.h"
 #include "berrydb/options.h"
 #include "berrydb/pool.h"
 #include "berrydb/space.h"
@@ -16,7 +18,10 @@ namespace berrydb {}  // namespace berrydb
 #include "berrydb/string_view.h"
 #include "berrydb/transaction.h"
 #include "berrydb/types.h"
+#include "berrydb/value_handle.h"
+#include "berrydb/value_reader.h"
 #include "berrydb/version.h"
 #include "berrydb/vfs.h"
+#include "berrydb/write_batch.h"
 
 #endif  // BERRYDB_INCLUDE_BERRYDB_H_
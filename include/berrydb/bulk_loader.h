@@ -0,0 +1,63 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_INCLUDE_BERRYDB_BULK_LOADER_H_
+#define BERRYDB_INCLUDE_BERRYDB_BULK_LOADER_H_
+
+#include "berrydb/string_view.h"
+
+namespace berrydb {
+
+enum class Status : int;
+
+/**
+ * Fills an empty (key/value name)space with pre-sorted key-value pairs.
+ *
+ * A bulk loader builds the space's B+tree pages directly, without going through
+ * the path used by Put(). Leaves are packed according to the loader's fill
+ * factor, and are written to the store using large sequential writes. The inner
+ * nodes are built bottom-up after all the keys have been added.
+ *
+ * The space's content is only replaced when Finish() is called, and only
+ * becomes durable when the loader's transaction is committed. The transaction
+ * must not be used to access the space while the loader is alive.
+ */
+class BulkLoader {
+ public:
+  /** Adds a key-value pair to the space.
+   *
+   * @param  key   must sort strictly after all the keys previously added
+   * @param  value the key's value
+   * @return       kInvalidArgument if the key is out of order; kEntryTooLarge
+   *               if the key does not fit in a store page; otherwise, most
+   *               likely kSuccess or kIoError
+   */
+  Status Add(string_view key, string_view value);
+
+  /** Builds the tree's inner nodes and links the tree into the space.
+   *
+   * No keys can be added after this method is called. If the call fails, the
+   * transaction must be rolled back.
+   *
+   * @return most likely kSuccess or kIoError
+   */
+  Status Finish();
+
+  /** Releases the loader's resources.
+   *
+   * The keys added by a loader that was not finished are discarded. */
+  void Release();
+
+ private:
+  friend class BulkLoaderImpl;
+
+  /** Use Transaction::CreateBulkLoader() to create BulkLoader instances. */
+  constexpr BulkLoader() noexcept = default;
+  /** Use Release() to destroy BulkLoader instances. */
+  ~BulkLoader() noexcept = default;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_INCLUDE_BERRYDB_BULK_LOADER_H_
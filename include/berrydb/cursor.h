@@ -0,0 +1,94 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_INCLUDE_BERRYDB_CURSOR_H_
+#define BERRYDB_INCLUDE_BERRYDB_CURSOR_H_
+
+#include "berrydb/string_view.h"
+
+namespace berrydb {
+
+enum class Status : int;
+
+/**
+ * Iterates over the key-value pairs in a (key/value name)space, in key order.
+ *
+ * A cursor is created by a transaction, and sees the Put()s and Delete()s made
+ * by the transaction before the cursor was positioned. A Put() or Delete() on
+ * the cursor's space invalidates the cursor's position, so the cursor must be
+ * re-positioned with a Seek call before it is used again.
+ *
+ * Cursors hold on to the database page that contains their current key-value
+ * pair, so cursors must be released before their transaction is committed or
+ * rolled back.
+ */
+class Cursor {
+ public:
+  /** Moves the cursor to the first key greater than or equal to a given key.
+   *
+   * @param  key the key to search for
+   * @return     kNotFound if all the keys in the space are smaller than the
+   *             given key; otherwise, most likely kSuccess or kIoError
+   */
+  Status Seek(string_view key);
+
+  /** Moves the cursor to the last key in the space.
+   *
+   * @return kNotFound if the space is empty; otherwise, most likely kSuccess
+   *         or kIoError
+   */
+  Status SeekToLast();
+
+  /** Moves the cursor to the next key in the space.
+   *
+   * The cursor must be valid.
+   *
+   * @return kNotFound if the cursor was positioned on the space's last key;
+   *         otherwise, most likely kSuccess or kIoError
+   */
+  Status Next();
+
+  /** Moves the cursor to the previous key in the space.
+   *
+   * The cursor must be valid.
+   *
+   * @return kNotFound if the cursor was positioned on the space's first key;
+   *         otherwise, most likely kSuccess or kIoError
+   */
+  Status Prev();
+
+  /** True if the cursor is positioned on a key-value pair.
+   *
+   * Cursors become valid after a successful Seek call, and become invalid when
+   * a call fails, including when a call moves past either end of the space. */
+  bool IsValid();
+
+  /** The key at the cursor's position. The cursor must be valid.
+   *
+   * The key's data remains valid until the cursor is moved or released. */
+  string_view key();
+
+  /** The value at the cursor's position. The cursor must be valid.
+   *
+   * The value's data remains valid until the cursor is moved or released.
+   * Values stored in overflow pages are copied into a buffer owned by the
+   * cursor. If the copy fails, the cursor becomes invalid, and an empty value
+   * is returned. Transaction::CreateValueReader() can stream large values. */
+  string_view value();
+
+  /** Releases the cursor's resources. */
+  void Release();
+
+ private:
+  friend class CursorImpl;
+
+  /** Use Transaction::CreateCursor() to create Cursor instances. */
+  constexpr Cursor() noexcept = default;
+  /** Use Release() to destroy Cursor instances. */
+  ~Cursor() noexcept = default;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_INCLUDE_BERRYDB_CURSOR_H_
@@ -6,10 +6,35 @@
 #define BERRYDB_INCLUDE_BERRYDB_OPTIONS_H_
 
 #include "berrydb/types.h"
+#include "berrydb/vfs.h"
 
 namespace berrydb {
 
-class Vfs;
+/** Algorithms that a page pool can use to choose the pages it evicts. */
+enum class PageEvictionPolicy {
+  /** Evicts the least recently used page.
+   *
+   * Every page fetch and release moves the page in a linked list.
+   */
+  kLru = 0,
+
+  /** Evicts a page that was not used since the clock hand last passed it.
+   *
+   * This is the CLOCK approximation of LRU. Page fetches only set a reference
+   * bit on the page, so they are cheaper than LRU bookkeeping.
+   */
+  kClock = 1,
+
+  /** Admits pages into a main LRU queue only after they are used twice.
+   *
+   * This is the 2Q algorithm. Newly fetched pages enter a small FIFO probation
+   * queue. The IDs of the pages evicted from the probation queue are
+   * remembered for a while, and pages that are fetched again during that time
+   * enter the main queue. So, pages that are only used once, such as the pages
+   * read by a large scan, do not push frequently used pages out of the pool.
+   */
+  kTwoQueue = 2,
+};
 
 /** Options used to create a resource pool. */
 struct PoolOptions {
@@ -28,6 +53,74 @@ struct PoolOptions {
    */
   size_t page_pool_size;
 
+  /** If true, the pool's page cache can be used by many threads at once.
+   *
+   * Multi-threaded page pools are split into shards, which are latched
+   * independently. Single-threaded page pools skip all latching.
+   */
+  bool multi_threaded;
+
+  /** Number of shards in a multi-threaded page pool.
+   *
+   * This is rounded up to a power of two. 0 requests one shard per hardware
+   * thread. Ignored by single-threaded pools.
+   */
+  size_t page_pool_shards;
+
+  /** The algorithm used to choose the cached pages that get evicted. */
+  PageEvictionPolicy page_eviction_policy;
+
+  /** If true, the page pool's entries are carved out of large memory blocks.
+   *
+   * By default, each page pool entry is allocated separately. Slabs cut down
+   * the allocator overhead, and place each page's data at an address that is
+   * aligned to the page size, as required by direct I/O.
+   */
+  bool page_pool_slabs;
+
+  /** If true, the page pool's slabs are backed by huge pages, if possible.
+   *
+   * Huge pages reduce TLB misses when accessing large page pools. Each slab
+   * holds at least one huge page (2 MiB), so small pools may use more memory.
+   * Ignored if page_pool_slabs is false.
+   */
+  bool page_pool_huge_pages;
+
+  /** If true, the page pool's entries are kept in a single frame table.
+   *
+   * The frame table stores the bookkeeping data of all the pool's entries in
+   * one array, and the entries' page data in a separate block. Page data is
+   * aligned to the page size. CLOCK pools scan the array linearly to find the
+   * pages to evict, which is friendlier to CPU caches than following list
+   * pointers. The memory for the whole pool is reserved when the pool is
+   * created, so Pool::SetPagePoolSize() cannot grow the pool beyond
+   * page_pool_size, and shrinking the pool does not return any memory. Takes
+   * precedence over page_pool_slabs.
+   */
+  bool page_pool_frame_table;
+
+  /** If true, store data files are accessed via direct I/O, if possible.
+   *
+   * The page pool caches the stores' pages, so caching the data files in the
+   * operating system's page cache as well wastes memory. Direct I/O skips the
+   * OS cache, so page_pool_size becomes the real memory budget for store
+   * pages, and I/O latency does not depend on the OS cache's state. Direct I/O
+   * needs page data that is aligned to the page size, so this implies
+   * page_pool_slabs, unless page_pool_frame_table is set. Buffered I/O is used
+   * if the VFS or the filesystem does not support direct I/O.
+   */
+  bool page_pool_direct_io;
+
+  /** Fraction of the page pool's eviction candidates kept clean ahead of time.
+   *
+   * If positive, a multi-threaded page pool runs a background thread that
+   * writes the dirty pages that are closest to being evicted, so cache misses
+   * rarely wait for a dirty page to be written. For example, 0.1 keeps the
+   * 10% of the pages that would be evicted next clean. 0 disables the
+   * background cleaner. Ignored by single-threaded pools.
+   */
+  double page_pool_clean_fraction;
+
   /** The platform services implementation used by the resource pool.
    *
    * All the stores that use the resource pool must perform their operations via
@@ -42,6 +135,35 @@ struct PoolOptions {
   PoolOptions();
 };
 
+/** Options used to create a cursor. */
+struct CursorOptions {
+  /** If true, the cursor will not visit the same keys again.
+   *
+   * One-shot cursors tell the page pool to evict the pages that they are done
+   * with before other cached pages. This keeps long scans from pushing more
+   * useful pages out of the cache.
+   */
+  bool one_shot;
+
+  /** Defaults. */
+  CursorOptions();
+};
+
+/** Options used to create a bulk loader. */
+struct BulkLoaderOptions {
+  /** The fraction of each tree page that is filled with loaded data.
+   *
+   * Values close to 1 produce the smallest and fastest trees, for data that
+   * will only be read. Lower values leave room for future Put()s, which would
+   * otherwise split almost every page they touch. The value is clamped to
+   * [0.5, 1].
+   */
+  double fill_factor;
+
+  /** Defaults. */
+  BulkLoaderOptions();
+};
+
 /** Options used to create a store. */
 struct StoreOptions {
   /** If false, opening a non-existent store will fail. */
@@ -52,6 +174,30 @@ struct StoreOptions {
    * If this option is true, create_if_missing must also be true. */
   bool error_if_exists;
 
+  /** If true, the store is opened read-only, and its data file is mapped.
+   *
+   * The pages of memory-mapped stores are read straight from the mapping, so
+   * they bypass the page pool, and lookups do not copy page data. The data
+   * file is cached by the operating system, which can share the cache between
+   * processes that open the same store. The store cannot be modified, so
+   * create_if_missing and error_if_exists are ignored, and write operations
+   * fail with kReadOnly. Opening the store fails if the VFS cannot map files.
+   *
+   * Memory-mapped stores take a shared lock on the data file, so any number of
+   * them can be open at the same time, but opening the store fails with
+   * kAlreadyLocked while it is open for writing, and vice versa.
+   */
+  bool memory_mapped;
+
+  /** The access pattern hint for the data files of memory-mapped stores.
+   *
+   * The hint is applied to the entire data file when the store is opened.
+   * kRandom suits point lookups on stores that are larger than the memory,
+   * kSequential suits scans, and kWillNeed reads the whole store into memory
+   * right away. Ignored if memory_mapped is false.
+   */
+  MappingAdvice mapping_advice;
+
   /** Defaults. */
   StoreOptions();
 };
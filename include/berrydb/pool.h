@@ -43,6 +43,23 @@ class Pool {
   /** The maximum number of store pages cached by the page pool. */
   size_t page_pool_size() const;
 
+  /** Changes the maximum number of store pages cached by the page pool.
+   *
+   * This can be called while stores are open, for example to give memory back
+   * to the system under memory pressure. Shrinking the page pool evicts cached
+   * pages right away, writing back the modified pages. Pages used by running
+   * transactions are evicted when they are no longer used.
+   *
+   * Pools that use a frame table cannot grow beyond the page_pool_size they
+   * were created with, and keep all their memory when they are shrunk. See
+   * PoolOptions::page_pool_frame_table.
+   *
+   * @param  page_pool_size the new maximum number of cached store pages
+   * @return                kInvalidArgument if the size is 0 or too large for
+   *                        the pool's frame table; otherwise, kSuccess
+   */
+  Status SetPagePoolSize(size_t page_pool_size);
+
  private:
   friend class PoolImpl;
 
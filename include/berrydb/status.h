@@ -38,6 +38,15 @@ enum class Status : int {
   // a 32-bit CPU.
   kDatabaseTooLarge = 8,
 
+  // A key or value exceeds the size limits imposed by the store's page size.
+  kEntryTooLarge = 9,
+
+  // The arguments passed to a method do not meet the method's requirements.
+  kInvalidArgument = 10,
+
+  // The store was opened in read-only mode, so it cannot be modified.
+  kReadOnly = 11,
+
   // Valid values are in [kSuccess, kFirstInvalidValue).
   kFirstInvalidValue,  // This must remain at the end of the enum's block.
 };
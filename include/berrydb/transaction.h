@@ -9,9 +9,16 @@
 
 namespace berrydb {
 
+class BulkLoader;
+struct BulkLoaderOptions;
 class Catalog;
+class Cursor;
+struct CursorOptions;
 class Space;
 enum class Status : int;
+class ValueHandle;
+class ValueReader;
+class WriteBatch;
 
 /**
  * An atomic and durable (once committed) unit of database operations.
@@ -24,15 +31,139 @@ enum class Status : int;
  */
 class Transaction {
  public:
-  /** Reads a store key. Sees Put()s and Delete()s made by this transaction. */
+  /** Reads a store key. Sees Put()s and Delete()s made by this transaction.
+   *
+   * The value's data is owned by the transaction, and remains valid until the
+   * next Get() call on the same transaction, or until the transaction is
+   * released. */
   Status Get(Space* space, string_view key, string_view* value);
 
+  /** Reads a store key without copying its value.
+   *
+   * The value's data is kept in the resource pool's page cache until the handle
+   * is released. See ValueHandle for the restrictions that apply until then.
+   * Values stored in overflow pages are copied into the handle; use
+   * CreateValueReader() to read them without copying.
+   *
+   * @param  space the (key/value name)space holding the key
+   * @param  key   the key to be read
+   * @param  value must be empty; if the call succeeds, holds the key's value
+   * @return       kNotFound if the space does not contain the key; otherwise,
+   *               most likely kSuccess or kIoError
+   */
+  Status Get(Space* space, string_view key, ValueHandle* value);
+
+  /** Reads many store keys without copying their values.
+   *
+   * This is equivalent to calling Get() for each key, but the lookups share
+   * the work of descending the space's B+tree, and the store pages that are not
+   * cached are read together. Keys do not need to be sorted.
+   *
+   * @param  space    the (key/value name)space holding the keys
+   * @param  count    the number of keys to be read
+   * @param  keys     the keys to be read
+   * @param  values   must all be empty; if the call succeeds, values[i] holds
+   *                  the value of keys[i], if the space contains the key
+   * @param  statuses if the call succeeds, statuses[i] is kSuccess if values[i]
+   *                  holds a value, kNotFound if the space does not contain
+   *                  keys[i], or the error that occurred while reading the
+   *                  overflow pages of keys[i]'s value
+   * @return          most likely kSuccess or kIoError; if the call fails, all
+   *                  the handles in values are left empty
+   */
+  Status MultiGet(Space* space, size_t count, const string_view* keys,
+                  ValueHandle* values, Status* statuses);
+
+  /** Hints that store keys will be read soon.
+   *
+   * Reads of the store pages needed to read the keys' values are started in
+   * the background, so later Get() and MultiGet() calls on the keys can find
+   * the pages in the resource pool's page cache. The store's B+tree is walked
+   * using the pages that are already cached, and the walk stops at the first
+   * missing page on each key's path, which is prefetched. So, this call only
+   * waits for reads that were already in progress, and a cold tree is loaded
+   * one level per call. The keys whose tree leaves are cached also get their
+   * large values prefetched.
+   *
+   * Keys that the space does not contain are ignored. Large values may only be
+   * partially loaded, if the page cache is too small to hold them.
+   *
+   * @param  space the (key/value name)space holding the keys
+   * @param  count the number of keys that will be read
+   * @param  keys  the keys that will be read; do not need to be sorted
+   * @return       kAlreadyClosed if the transaction was committed or rolled
+   *               back; kDataCorrupted if a cached tree page is corrupted;
+   *               otherwise, kSuccess
+   */
+  Status Prefetch(Space* space, size_t count, const string_view* keys);
+
+  /** Creates a reader that streams a store key's value in chunks.
+   *
+   * This is the preferred way of reading very large values, because the value
+   * is not copied, and only one of its pages is cached at a time. The reader
+   * must be released before the transaction is committed or rolled back.
+   *
+   * @param  space  the (key/value name)space holding the key
+   * @param  key    the key whose value will be read
+   * @param  result if the call succeeds, receives a pointer to the newly
+   *                created reader
+   * @return        kNotFound if the space does not contain the key;
+   *                kAlreadyClosed if the transaction was committed or rolled
+   *                back; otherwise, most likely kSuccess or kIoError
+   */
+  Status CreateValueReader(Space* space, string_view key,
+                           ValueReader** result);
+
   /** Creates / updates a store key. Seen by Gets() made by this transaction. */
   Status Put(Space* space, string_view key, string_view value);
 
   /** Deletes a store key. Seen by Gets() made by this transaction. */
   Status Delete(Space* space, string_view key);
 
+  /** Applies all the mutations in a batch.
+   *
+   * The batch is not modified, so it can be applied to other transactions. If
+   * the call fails, the transaction must be rolled back.
+   *
+   * @param  batch the mutations to be applied
+   * @return       kEntryTooLarge if a key does not fit in a store page, in
+   *               which case none of the batch's mutations are applied;
+   *               otherwise, most likely kSuccess or kIoError
+   */
+  Status Write(WriteBatch* batch);
+
+  /** Creates a cursor that iterates over a space's keys.
+   *
+   * The cursor is not positioned on any key when it is created. The cursor must
+   * be released before the transaction is committed or rolled back.
+   *
+   * @param space   the (key/value name)space that the cursor iterates over
+   * @param options the cursor's configuration
+   * @param result  if the operation succeeds, receives a pointer to the newly
+   *                created cursor
+   * @return        most likely kSuccess; kAlreadyClosed if the transaction was
+   *                committed or rolled back
+   */
+  Status CreateCursor(Space* space, const CursorOptions& options,
+                      Cursor** result);
+
+  /** Creates a bulk loader that fills an empty space with sorted keys.
+   *
+   * The loader must be released before the transaction is committed or rolled
+   * back.
+   *
+   * @param space   the (key/value name)space that will be filled; must not
+   *                contain any keys
+   * @param options the loader's configuration
+   * @param result  if the operation succeeds, receives a pointer to the newly
+   *                created loader
+   * @return        kInvalidArgument if the space is not empty; kAlreadyClosed
+   *                if the transaction was committed or rolled back; otherwise,
+   *                most likely kSuccess or kIoError
+   */
+  Status CreateBulkLoader(Space* space, const BulkLoaderOptions& options,
+                          BulkLoader** result);
+
   /**
    * Writes Put()s and Deletes() in this transaction to durable storage.
    *
@@ -0,0 +1,93 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_INCLUDE_BERRYDB_VALUE_HANDLE_H_
+#define BERRYDB_INCLUDE_BERRYDB_VALUE_HANDLE_H_
+
+#include "berrydb/string_view.h"
+
+namespace berrydb {
+
+class Page;
+
+/**
+ * A value read from a store, without copying it out of the store's cache.
+ *
+ * A handle that holds a value keeps the database page containing the value in
+ * the resource pool's page cache. Handles are cheap to create, and are intended
+ * to be allocated on the stack and released as soon as the value is consumed.
+ *
+ * Large values are stored across many pages, so they are copied into a buffer
+ * owned by the handle. Transaction::CreateValueReader() can read these values
+ * without copying them.
+ *
+ * While a handle holds a value, the transaction that produced it must not
+ * modify the value's (key/value name)space, and must not be committed or rolled
+ * back.
+ */
+class ValueHandle {
+ public:
+  /** Creates an empty handle. */
+  ValueHandle() noexcept = default;
+
+  /** Releases the value held by this handle, if there is one. */
+  inline ~ValueHandle() noexcept {
+    if (!IsEmpty())
+      Release();
+  }
+
+  /** Moves the value held by a handle into a new handle. */
+  inline ValueHandle(ValueHandle&& other) noexcept
+      : page_(other.page_), buffer_(other.buffer_), value_(other.value_) {
+    other.page_ = nullptr;
+    other.buffer_ = nullptr;
+    other.value_ = string_view();
+  }
+
+  /** Moves the value held by a handle into this handle. */
+  inline ValueHandle& operator=(ValueHandle&& other) noexcept {
+    if (!IsEmpty())
+      Release();
+    page_ = other.page_;
+    buffer_ = other.buffer_;
+    value_ = other.value_;
+    other.page_ = nullptr;
+    other.buffer_ = nullptr;
+    other.value_ = string_view();
+    return *this;
+  }
+
+  /** The value held by this handle. Empty if the handle does not hold a value.
+   *
+   * The value's data remains valid until the handle is released. */
+  inline string_view value() const noexcept { return value_; }
+
+  /** True if this handle holds a value. */
+  inline bool IsEmpty() const noexcept {
+    return page_ == nullptr && buffer_ == nullptr;
+  }
+
+  /** Releases the value held by this handle.
+   *
+   * The handle becomes empty, and can be used to read another value. */
+  void Release() noexcept;
+
+ private:
+  friend class TransactionImpl;
+
+  // Handles cannot be copied, because each handle holds a page pool pin.
+  ValueHandle(const ValueHandle& other) = delete;
+  ValueHandle& operator=(const ValueHandle& other) = delete;
+
+  /** The pinned page pool entry holding the value. nullptr if empty. */
+  Page* page_ = nullptr;
+  /** Holds a copy of a large value. The buffer's size is the value's size. */
+  void* buffer_ = nullptr;
+  /** Points into the pinned page's data, or into the buffer. */
+  string_view value_;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_INCLUDE_BERRYDB_VALUE_HANDLE_H_
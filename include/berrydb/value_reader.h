@@ -0,0 +1,55 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_INCLUDE_BERRYDB_VALUE_READER_H_
+#define BERRYDB_INCLUDE_BERRYDB_VALUE_READER_H_
+
+#include <cstddef>
+
+#include "berrydb/string_view.h"
+
+namespace berrydb {
+
+enum class Status : int;
+
+/**
+ * Reads a value from a store in chunks, without copying it.
+ *
+ * Large values are stored across many database pages. A reader only holds on
+ * to the page that contains the chunk it returned most recently, so values of
+ * any size can be read without filling up the resource pool's page cache.
+ *
+ * While a reader is alive, the transaction that produced it must not modify the
+ * value's (key/value name)space, and must not be committed or rolled back.
+ */
+class ValueReader {
+ public:
+  /** The size of the whole value, in bytes. */
+  size_t size();
+
+  /** Reads the value's next chunk.
+   *
+   * @param  chunk if the call succeeds, receives the chunk's bytes, which
+   *               remain valid until the next call or until the reader is
+   *               released
+   * @return       kNotFound if the whole value was read; otherwise, most
+   *               likely kSuccess or kIoError
+   */
+  Status Next(string_view* chunk);
+
+  /** Releases the reader's resources. */
+  void Release();
+
+ private:
+  friend class ValueReaderImpl;
+
+  /** Use Transaction::CreateValueReader() to create ValueReader instances. */
+  constexpr ValueReader() noexcept = default;
+  /** Use Release() to destroy ValueReader instances. */
+  ~ValueReader() noexcept = default;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_INCLUDE_BERRYDB_VALUE_READER_H_
@@ -12,6 +12,7 @@
 namespace berrydb {
 
 class BlockAccessFile;
+class BlockIoQueue;
 class RandomAccessFile;
 enum class Status : int;
 
@@ -60,6 +61,12 @@ class Vfs {
    * @param  error_if_exists   if true, the call will not succeed if a file
    *                           already exists; create_if_missing must be also
    *                           true if this is true
+   * @param  direct_io         if true, the file's data should bypass the
+   *                           operating system's cache; the caller guarantees
+   *                           that all the buffers passed to Read() and Write()
+   *                           are aligned to the block size; implementations
+   *                           that cannot do direct I/O on the file should use
+   *                           buffered I/O instead of failing
    * @param  file              if the call succeeds, populated with a
    *                           RandomAccessFile* that can be used to access the
    *                           file
@@ -74,9 +81,32 @@ class Vfs {
                                     size_t block_shift,
                                     bool create_if_missing,
                                     bool error_if_exists,
+                                    bool direct_io,
                                     BlockAccessFile** result,
                                     size_t* file_size) = 0;
 
+  /** Opens an existing file for block reads.
+   *
+   * This method is used for the data files of memory-mapped stores, which are
+   * read-only. The file does not need to be writable. Writes to the returned
+   * file fail.
+   *
+   * @param  file_path   the file to be opened
+   * @param  block_shift log2(block size); the block size can be computed as
+   *                     1 << block_shift
+   * @param  file        if the call succeeds, populated with a
+   *                     BlockAccessFile* that can be used to read the file
+   * @param  file_size   the number of bytes contained by the file when it is
+   *                     opened
+   * @return             attempting to open a non-existing file may result in
+   *                     kIoError or kNotFound; all other errors will result in
+   *                     kIoError
+   */
+  virtual Status OpenForBlockReads(const std::string& file_path,
+                                   size_t block_shift,
+                                   BlockAccessFile** result,
+                                   size_t* file_size) = 0;
+
   /** Deletes a file from the filesystem.
    *
    * The natural name for this method would have been DeleteFile. However,
@@ -181,6 +211,32 @@ class RandomAccessFile {
   RandomAccessFile& operator=(RandomAccessFile&& other) noexcept;
 };
 
+/** Hints about how the memory mapping of a file will be accessed.
+ *
+ * The values mirror the advice accepted by posix_madvise().
+ */
+enum class MappingAdvice : int {
+  /** No particular access pattern. The OS uses its default readahead. */
+  kNormal = 0,
+
+  /** The data will be accessed in random order, so readahead is wasted. */
+  kRandom = 1,
+
+  /** The data will be accessed in increasing order, so readahead pays off. */
+  kSequential = 2,
+
+  /** The data will be accessed soon, so the OS should start reading it now. */
+  kWillNeed = 3,
+};
+
+/** A memory buffer used by scatter / gather block I/O. */
+struct BlockIoBuffer {
+  /** The buffer's first byte. */
+  uint8_t* data;
+  /** The buffer's size. Must be a multiple of the file's block size. */
+  size_t byte_count;
+};
+
 /** Interface for accessing files via block-based I/O.
  *
  * This interface is used for accessing store files. The block size is the store
@@ -217,6 +273,37 @@ class BlockAccessFile {
    */
   virtual Status Write(uint8_t* buffer, size_t offset, size_t byte_count) = 0;
 
+  /** Reads a sequence of blocks from the file into multiple buffers.
+   *
+   * The buffers are filled in order, so this behaves like reading the blocks
+   * into a large buffer and splitting it. The default implementation calls
+   * Read() for each buffer. Implementations are encouraged to override this
+   * with a vectored read, such as preadv(), which transfers all the data in a
+   * single system call.
+   *
+   * @param  offset       0-based file position of the first byte to be read;
+   *                      must be a multiple of the block size
+   * @param  buffers      receive the bytes from the file
+   * @param  buffer_count the number of elements in the buffers array
+   * @return              most likely kSuccess or kIoError
+   */
+  virtual Status ReadV(size_t offset, const BlockIoBuffer* buffers,
+                       size_t buffer_count);
+
+  /** Writes a sequence of blocks from multiple buffers to the file.
+   *
+   * This is the counterpart of ReadV(). The default implementation calls
+   * Write() for each buffer.
+   *
+   * @param  buffers      store the bytes to be written to the file
+   * @param  buffer_count the number of elements in the buffers array
+   * @param  offset       0-based file position of the first byte to be
+   *                      written; must be a multiple of the block size
+   * @return              most likely kSuccess or kIoError
+   */
+  virtual Status WriteV(const BlockIoBuffer* buffers, size_t buffer_count,
+                        size_t offset);
+
   /** Evicts any cached data for the file into persistent storage.
    *
    * After this method returns successfully, the written data should survive a
@@ -238,6 +325,67 @@ class BlockAccessFile {
    */
   virtual Status Lock() = 0;
 
+  /** Attempts to acquire a shared lock on the file.
+   *
+   * Any number of users can hold shared locks on a file at the same time, but
+   * shared locks cannot coexist with the exclusive lock taken by Lock(). Files
+   * that are only read, such as memory-mapped stores, take shared locks, so
+   * they cannot change while they are used.
+   *
+   * The file remains locked until it is closed.
+   *
+   * @return kAlreadyLocked if another user holds an exclusive lock on the
+   *         file, otherwise kSuccess or kIoError
+   */
+  virtual Status LockShared() = 0;
+
+  /** Creates a queue for issuing asynchronous reads and writes to this file.
+   *
+   * The default implementation performs the queued operations on a background
+   * thread, using Read() and Write(). This is correct for files that do not
+   * support concurrent I/O. Implementations are encouraged to override this
+   * with the platform's asynchronous I/O facilities.
+   *
+   * The queue must be released before the file is closed.
+   *
+   * @param  queue_depth the maximum number of operations that can be queued or
+   *                     in progress at a time; must be positive
+   * @param  result      if the call succeeds, populated with a BlockIoQueue*
+   *                     that can be used to access the file
+   * @return             most likely kSuccess or kIoError
+   */
+  virtual Status CreateIoQueue(size_t queue_depth, BlockIoQueue** result);
+
+  /** Maps the beginning of the file into memory, for reading.
+   *
+   * The mapped memory must not be written to. The mapping remains valid until
+   * the file is closed. A file can be mapped at most once.
+   *
+   * The default implementation fails, so VFSes that cannot map files do not
+   * need to override this.
+   *
+   * @param  byte_count the number of bytes to be mapped; must be a positive
+   *                    multiple of the block size, and must not exceed the
+   *                    file's size
+   * @param  result     if the call succeeds, receives the address where the
+   *                    file's first byte is mapped
+   * @return            most likely kSuccess or kIoError
+   */
+  virtual Status MapForReading(size_t byte_count, uint8_t** result);
+
+  /** Tells the OS how a part of the file's mapping will be accessed.
+   *
+   * This is a hint, so errors are ignored. The default implementation does
+   * nothing.
+   *
+   * @param offset     0-based file position of the first byte in the range;
+   *                   must be a multiple of the block size
+   * @param byte_count the size of the range; the range must be mapped
+   * @param advice     the expected access pattern
+   */
+  virtual void AdviseMapping(size_t offset, size_t byte_count,
+                             MappingAdvice advice);
+
   /** Closes the file and releases its underlying resources.
    *
    * This call deallocates the memory used for the BlockAccessFile, invalidating
@@ -264,15 +412,129 @@ class BlockAccessFile {
   BlockAccessFile& operator=(BlockAccessFile&& other) noexcept;
 };
 
+/** The outcome of an operation issued via a BlockIoQueue. */
+struct BlockIoCompletion {
+  /** The tag passed to BlockIoQueue::SubmitRead() or SubmitWrite(). */
+  void* tag;
+  /** Most likely kSuccess or kIoError. */
+  Status status;
+};
+
+/** Issues asynchronous I/O to a BlockAccessFile.
+ *
+ * Submitted operations are batched, and are only guaranteed to start when
+ * Poll() is called. Operations may complete in any order.
+ *
+ * Queues are not thread-safe. Each queue should be used by a single thread at a
+ * time.
+ */
+class BlockIoQueue {
+ public:
+  /** Queues a read of a sequence of blocks from the file.
+   *
+   * The offset and byte count follow the rules of BlockAccessFile::Read(). The
+   * buffer must remain valid until the read's completion is returned by
+   * Poll().
+   *
+   * @param  offset     0-based file position of the first byte to be read
+   * @param  byte_count number of bytes that will be read into the buffer
+   * @param  buffer     receives the bytes from the file
+   * @param  tag        identifies the read's completion
+   * @return            kInvalidArgument if the queue already holds queue_depth
+   *                    operations that were not returned by Poll(); otherwise,
+   *                    kSuccess
+   */
+  virtual Status SubmitRead(
+      size_t offset, size_t byte_count, uint8_t* buffer, void* tag) = 0;
+
+  /** Queues a write of a sequence of blocks to the file.
+   *
+   * The offset and byte count follow the rules of BlockAccessFile::Write().
+   * The buffer must remain valid until the write's completion is returned by
+   * Poll().
+   *
+   * @param  buffer     stores the bytes to be written to the file
+   * @param  offset     0-based file position of the first byte to be written
+   * @param  byte_count number of buffer bytes that will be written to the file
+   * @param  tag        identifies the write's completion
+   * @return            kInvalidArgument if the queue already holds queue_depth
+   *                    operations that were not returned by Poll(); otherwise,
+   *                    kSuccess
+   */
+  virtual Status SubmitWrite(
+      uint8_t* buffer, size_t offset, size_t byte_count, void* tag) = 0;
+
+  /** Starts the queued operations, and collects completed operations.
+   *
+   * @param  min_count        the call blocks until at least this many
+   *                          operations have completed; must not exceed the
+   *                          number of operations that were submitted and not
+   *                          returned by Poll()
+   * @param  max_count        the maximum number of completions returned
+   * @param  completions      receives up to max_count completions
+   * @param  completion_count populated with the number of completions returned
+   * @return                  kIoError if the platform's asynchronous I/O
+   *                          facility failed; the queue should be released in
+   *                          that case; otherwise, kSuccess
+   */
+  virtual Status Poll(size_t min_count, size_t max_count,
+                      BlockIoCompletion* completions,
+                      size_t* completion_count) = 0;
+
+  /** Waits for all the operations in progress and releases the queue.
+   *
+   * Operations that were submitted after the last Poll() call are dropped
+   * without being started. */
+  virtual void Release() = 0;
+
+ protected:
+  /** Instances must be created using BlockAccessFile::CreateIoQueue(). */
+  BlockIoQueue() noexcept;
+  /** Instances must be destroyed using Release(). */
+  virtual ~BlockIoQueue();
+
+  // Copy and move assignment + construction are protected so that subclasses
+  // can enable them, if they wish to do so.
+  BlockIoQueue(const BlockIoQueue& other) noexcept;
+  BlockIoQueue(BlockIoQueue&& other) noexcept;
+  BlockIoQueue& operator=(const BlockIoQueue& other) noexcept;
+  BlockIoQueue& operator=(BlockIoQueue&& other) noexcept;
+};
+
 /**
  * The VFS associated with resource pools by default.
  *
  * If the vfs/ directory is included, BerryDB will provide a default VFS
- * implementation. Embedders that wish to replace the default should not include
- * vfs/ in their BerryDB build, and should implement berrydb::DefaultVfs().
+ * implementation, which is BuiltinPosixVfs() on POSIX systems, and
+ * BuiltinLibcVfs() everywhere else. Embedders that wish to replace the
+ * default should not include vfs/ in their BerryDB build, and should implement
+ * berrydb::DefaultVfs().
  */
 Vfs* DefaultVfs();
 
+/**
+ * The built-in VFS implemented on top of the C standard library.
+ *
+ * This VFS works on all platforms, but it serializes I/O on each file, because
+ * stdio's reads and writes go through the file's current position.
+ *
+ * Only available if the vfs/ directory is included in the BerryDB build.
+ */
+Vfs* BuiltinLibcVfs();
+
+/**
+ * The built-in VFS implemented on top of POSIX file descriptors.
+ *
+ * Files are accessed via pread() and pwrite(), which do not depend on a file
+ * position, so concurrent I/O on the same file does not need to be serialized.
+ * This is the default VFS on POSIX systems.
+ *
+ * Only available if the vfs/ directory is included in the BerryDB build.
+ *
+ * @return nullptr on platforms that do not support POSIX file I/O
+ */
+Vfs* BuiltinPosixVfs();
+
 }  // namespace berrydb
 
 #endif  // BERRYDB_INCLUDE_BERRYDB_VFS_H_
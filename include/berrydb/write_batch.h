@@ -0,0 +1,65 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_INCLUDE_BERRYDB_WRITE_BATCH_H_
+#define BERRYDB_INCLUDE_BERRYDB_WRITE_BATCH_H_
+
+#include "berrydb/string_view.h"
+
+namespace berrydb {
+
+class Space;
+
+/**
+ * A list of Put()s and Delete()s that are applied together to a transaction.
+ *
+ * The batch copies the keys and values given to it, so the caller's buffers
+ * can be reused right away. Transaction::Write() sorts the batch's mutations
+ * by space and key, which lets it apply all the mutations that land on the same
+ * database page while it holds on to the page. This is much faster than
+ * issuing one Put() per key when ingesting large amounts of data.
+ *
+ * A batch can be applied to many transactions, and can be reused after calling
+ * Clear().
+ */
+class WriteBatch {
+ public:
+  /** Creates an empty batch. */
+  static WriteBatch* Create();
+
+  /** Records the creation / update of a key.
+   *
+   * If the batch has many mutations for the same key, they are applied in the
+   * order in which they were recorded. */
+  void Put(Space* space, string_view key, string_view value);
+
+  /** Records the deletion of a key.
+   *
+   * Deleting a key that does not exist is not considered an error when the
+   * batch is applied. */
+  void Delete(Space* space, string_view key);
+
+  /** Removes all the mutations in this batch.
+   *
+   * The batch's memory is kept around, so it can be reused by new mutations. */
+  void Clear();
+
+  /** The number of mutations recorded in this batch. */
+  size_t size() const;
+
+  /** Releases the batch's resources. */
+  void Release();
+
+ private:
+  friend class WriteBatchImpl;
+
+  /** Use WriteBatch::Create() to create WriteBatch instances. */
+  constexpr WriteBatch() noexcept = default;
+  /** Use Release() to destroy WriteBatch instances. */
+  ~WriteBatch() noexcept = default;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_INCLUDE_BERRYDB_WRITE_BATCH_H_
@@ -18,6 +18,17 @@
 #include <cstring>
 #endif  // DCHECK_IS_ON()
 
+#if defined(_WIN32)
+#include <malloc.h>
+#else  // defined(_WIN32)
+#include <stdlib.h>
+#endif  // defined(_WIN32)
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // defined(__linux__)
+
 namespace berrydb {
 
 /**
@@ -73,6 +84,105 @@ inline void Deallocate(void* data, std::size_t size_in_bytes) {
   UNUSED(size_in_bytes);
 }
 
+/**
+ * Dynamically allocates a large memory block with a custom alignment.
+ *
+ * This is used for blocks that hold many page pool entries.
+ *
+ * @param bytes          guaranteed to be positive, and a multiple of alignment
+ * @param alignment      guaranteed to be a power of two, and a multiple of
+ *                       sizeof(void*)
+ * @param use_huge_pages hint that the memory block should be backed by huge
+ *                       pages, if the platform supports them; when set,
+ *                       alignment is a multiple of the huge page size
+ * @return a pointer aligned to the given alignment
+ */
+inline void* AllocateAligned(std::size_t size_in_bytes, std::size_t alignment,
+                             bool use_huge_pages) {
+  DCHECK(size_in_bytes > 0);
+  DCHECK_EQ(alignment & (alignment - 1), 0U);
+  DCHECK_EQ(size_in_bytes & (alignment - 1), 0U);
+
+#if defined(_WIN32)
+  void* data = _aligned_malloc(size_in_bytes, alignment);
+#else  // defined(_WIN32)
+  void* data;
+  if (posix_memalign(&data, alignment, size_in_bytes) != 0)
+    data = nullptr;
+#endif  // defined(_WIN32)
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // Transparent huge pages are used without any system configuration, unlike
+  // MAP_HUGETLB. The advice is best-effort, so errors are ignored.
+  if (use_huge_pages && data != nullptr)
+    madvise(data, size_in_bytes, MADV_HUGEPAGE);
+#else  // defined(__linux__) && defined(MADV_HUGEPAGE)
+  UNUSED(use_huge_pages);
+#endif  // defined(__linux__) && defined(MADV_HUGEPAGE)
+
+#if DCHECK_IS_ON()
+  // Fill the block with a recognizable pattern, so it is easier to detect
+  // use-before-initialize bugs.
+  std::memset(data, 0xCC, size_in_bytes);
+#endif  // DCHECK_IS_ON()
+
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(data) & (alignment - 1), 0U);
+  return data;
+}
+
+/**
+ * Returns the memory backing a range of a block to the OS, if possible.
+ *
+ * The block stays allocated, and the range's contents become undefined. This is
+ * used for page pool entries that are set aside when the pool shrinks.
+ *
+ * @param data  points inside a block allocated with AllocateAligned()
+ * @param bytes the size of the range; only the OS pages that are completely
+ *              inside the range are returned
+ */
+inline void DiscardAligned(void* data, std::size_t size_in_bytes) {
+  DCHECK(data != nullptr);
+
+#if defined(__linux__) && defined(MADV_DONTNEED)
+  static const std::size_t os_page_size =
+      static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  uintptr_t start = reinterpret_cast<uintptr_t>(data);
+  uintptr_t end = start + size_in_bytes;
+  start = (start + os_page_size - 1) & ~(os_page_size - 1);
+  end &= ~(os_page_size - 1);
+  // The advice is best-effort, so errors are ignored.
+  if (start < end)
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+#else  // defined(__linux__) && defined(MADV_DONTNEED)
+  UNUSED(data);
+  UNUSED(size_in_bytes);
+#endif  // defined(__linux__) && defined(MADV_DONTNEED)
+}
+
+/**
+ * Releases memory that was previously allocated with AllocateAligned().
+ *
+ * @param data  result of a previous call to AllocateAligned(bytes, ...)
+ * @param bytes must match the value passed to the AllocateAligned() call
+ */
+inline void DeallocateAligned(void* data, std::size_t size_in_bytes) {
+  DCHECK(size_in_bytes > 0);
+  DCHECK(data != nullptr);
+
+#if DCHECK_IS_ON()
+  // Fill the block with a recognizable pattern, so it is easier to detect
+  // use-after-free bugs.
+  std::memset(data, 0xDD, size_in_bytes);
+#endif  // DCHECK_IS_ON()
+
+#if defined(_WIN32)
+  _aligned_free(data);
+#else  // defined(_WIN32)
+  free(data);
+#endif  // defined(_WIN32)
+  UNUSED(size_in_bytes);
+}
+
 }  // namespace berrydb
 
 #endif  // BERRYDB_PLATFORM_ALLOC_H_
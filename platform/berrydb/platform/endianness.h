@@ -14,6 +14,34 @@
 
 namespace berrydb {
 
+/** Reads a 32-bit unsigned integer from an aligned buffer.
+ *
+ * Consumers should assume that the integer is stored in a cross-platform
+ * manner, but not depend on that in testing. This lets the embedder choose
+ * portability or extra speed on big-endian platforms.
+ *
+ * @param  from memory holding the integer; must be 4-byte-aligned
+ * @return      the integer stored at the given location
+ */
+inline uint32_t LoadUint32(const uint8_t* from) noexcept {
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(from) & 3, 0U);
+  return *(reinterpret_cast<const uint32_t*>(from));
+}
+
+/** Stores a 32-bit unsigned integer to an aligned buffer.
+ *
+ * Consumers should assume that the integer is stored in a cross-platform
+ * manner, but not depend on that in testing. This lets the embedder choose
+ * portability or extra speed on big-endian platforms.
+ *
+ * @param value the integer to be stored
+ * @param to    memory that will hold the integer; must be 4-byte-aligned
+ */
+inline void StoreUint32(uint32_t value, uint8_t* to) noexcept {
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(to) & 3, 0U);
+  *(reinterpret_cast<uint32_t*>(to)) = value;
+}
+
 /** Reads a 64-bit unsigned integer from an aligned buffer.
  *
  * Consumers should assume that the integer is stored in a cross-platform
@@ -34,8 +62,8 @@ inline uint64_t LoadUint64(const uint8_t* from) noexcept {
  * manner, but not depend on that in testing. This lets the embedder choose
  * portability or extra speed on big-endian platforms.
  *
- * @param  from memory holding the integer; must be 8-byte-aligned
- * @return      the integer stored at the given location
+ * @param value the integer to be stored
+ * @param to    memory that will hold the integer; must be 8-byte-aligned
  */
 inline void StoreUint64(uint64_t value, uint8_t* to) noexcept {
   DCHECK_EQ(reinterpret_cast<uintptr_t>(to) & 7, 0U);
@@ -0,0 +1,23 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "berrydb/bulk_loader.h"
+
+#include "../bulk_loader_impl.h"
+
+namespace berrydb {
+
+Status BulkLoader::Add(string_view key, string_view value) {
+  return BulkLoaderImpl::FromApi(this)->Add(key, value);
+}
+
+Status BulkLoader::Finish() {
+  return BulkLoaderImpl::FromApi(this)->Finish();
+}
+
+void BulkLoader::Release() {
+  BulkLoaderImpl::FromApi(this)->Release();
+}
+
+}  // namespace berrydb
@@ -0,0 +1,43 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "berrydb/cursor.h"
+
+#include "../cursor_impl.h"
+
+namespace berrydb {
+
+Status Cursor::Seek(string_view key) {
+  return CursorImpl::FromApi(this)->Seek(key);
+}
+
+Status Cursor::SeekToLast() {
+  return CursorImpl::FromApi(this)->SeekToLast();
+}
+
+Status Cursor::Next() {
+  return CursorImpl::FromApi(this)->Next();
+}
+
+Status Cursor::Prev() {
+  return CursorImpl::FromApi(this)->Prev();
+}
+
+bool Cursor::IsValid() {
+  return CursorImpl::FromApi(this)->IsValid();
+}
+
+string_view Cursor::key() {
+  return CursorImpl::FromApi(this)->key();
+}
+
+string_view Cursor::value() {
+  return CursorImpl::FromApi(this)->value();
+}
+
+void Cursor::Release() {
+  CursorImpl::FromApi(this)->Release();
+}
+
+}  // namespace berrydb
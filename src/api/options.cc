@@ -7,9 +7,19 @@
 namespace berrydb {
 
 PoolOptions::PoolOptions()
-    : page_shift(15), page_pool_size(256), vfs(nullptr) { }
+    : page_shift(15), page_pool_size(256), multi_threaded(false),
+      page_pool_shards(0), page_eviction_policy(PageEvictionPolicy::kLru),
+      page_pool_slabs(false), page_pool_huge_pages(false),
+      page_pool_frame_table(false), page_pool_direct_io(false),
+      page_pool_clean_fraction(0),
+      vfs(nullptr) { }
+
+CursorOptions::CursorOptions() : one_shot(false) { }
+
+BulkLoaderOptions::BulkLoaderOptions() : fill_factor(0.9) { }
 
 StoreOptions::StoreOptions()
-    : create_if_missing(true), error_if_exists(false) { }
+    : create_if_missing(true), error_if_exists(false), memory_mapped(false),
+      mapping_advice(MappingAdvice::kNormal) { }
 
 }  // namespace berrydb
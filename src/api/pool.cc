@@ -34,4 +34,8 @@ size_t Pool::page_pool_size() const {
   return PoolImpl::FromApi(this)->page_pool_size();
 }
 
+Status Pool::SetPagePoolSize(size_t page_pool_size) {
+  return PoolImpl::FromApi(this)->SetPagePoolSize(page_pool_size);
+}
+
 }  // namespace berrydb
@@ -40,6 +40,20 @@ TEST_F(PoolTest, CreateOptions) {
   EXPECT_EQ(42U, pool->page_pool_size());
 }
 
+TEST_F(PoolTest, SetPagePoolSize) {
+  PoolOptions options;
+  options.page_shift = 12;
+  options.page_pool_size = 42;
+
+  UniquePtr<Pool> pool(Pool::Create(options));
+  EXPECT_EQ(Status::kSuccess, pool->SetPagePoolSize(16));
+  EXPECT_EQ(16U, pool->page_pool_size());
+  EXPECT_EQ(Status::kSuccess, pool->SetPagePoolSize(100));
+  EXPECT_EQ(100U, pool->page_pool_size());
+  EXPECT_EQ(Status::kInvalidArgument, pool->SetPagePoolSize(0));
+  EXPECT_EQ(100U, pool->page_pool_size());
+}
+
 TEST_F(PoolTest, ReleaseClosesStore) {
   PoolOptions pool_options;
   pool_options.page_shift = 12;
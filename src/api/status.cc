@@ -28,6 +28,12 @@ const char* StatusToCString(Status status) noexcept {
     return "Data Corrupted";
   case Status::kDatabaseTooLarge:
     return "Database Too Large";
+  case Status::kEntryTooLarge:
+    return "Entry Too Large";
+  case Status::kInvalidArgument:
+    return "Invalid Argument";
+  case Status::kReadOnly:
+    return "Read Only";
   case Status::kFirstInvalidValue:
     // Needed to avoid a (very useful otherwise) compiler warning.
     break;
@@ -5,9 +5,12 @@
 #include "berrydb/transaction.h"
 
 #include "berrydb/status.h"
+#include "../bulk_loader_impl.h"
 #include "../catalog_impl.h"
+#include "../cursor_impl.h"
 #include "../space_impl.h"
 #include "../transaction_impl.h"
+#include "../value_reader_impl.h"
 
 namespace berrydb {
 
@@ -15,6 +18,32 @@ Status Transaction::Get(Space* space, string_view key, string_view* value) {
   return TransactionImpl::FromApi(this)->Get(space, key, value);
 }
 
+Status Transaction::Get(Space* space, string_view key, ValueHandle* value) {
+  return TransactionImpl::FromApi(this)->Get(space, key, value);
+}
+
+Status Transaction::MultiGet(Space* space, size_t count,
+                             const string_view* keys, ValueHandle* values,
+                             Status* statuses) {
+  return TransactionImpl::FromApi(this)->MultiGet(
+      space, count, keys, values, statuses);
+}
+
+Status Transaction::Prefetch(Space* space, size_t count,
+                             const string_view* keys) {
+  return TransactionImpl::FromApi(this)->Prefetch(space, count, keys);
+}
+
+Status Transaction::CreateValueReader(
+    Space* space, string_view key, ValueReader** result) {
+  ValueReaderImpl* reader;
+  Status status = TransactionImpl::FromApi(this)->CreateValueReader(
+      space, key, &reader);
+  if (status == Status::kSuccess)
+    *result = reader->ToApi();
+  return status;
+}
+
 Status Transaction::Put(Space* space, string_view key, string_view value) {
   return TransactionImpl::FromApi(this)->Put(space, key, value);
 }
@@ -23,6 +52,30 @@ Status Transaction::Delete(Space* space, string_view key) {
   return TransactionImpl::FromApi(this)->Delete(space, key);
 }
 
+Status Transaction::Write(WriteBatch* batch) {
+  return TransactionImpl::FromApi(this)->Write(batch);
+}
+
+Status Transaction::CreateCursor(
+    Space* space, const CursorOptions& options, Cursor** result) {
+  CursorImpl* cursor;
+  Status status = TransactionImpl::FromApi(this)->CreateCursor(
+      space, options, &cursor);
+  if (status == Status::kSuccess)
+    *result = cursor->ToApi();
+  return status;
+}
+
+Status Transaction::CreateBulkLoader(
+    Space* space, const BulkLoaderOptions& options, BulkLoader** result) {
+  BulkLoaderImpl* loader;
+  Status status = TransactionImpl::FromApi(this)->CreateBulkLoader(
+      space, options, &loader);
+  if (status == Status::kSuccess)
+    *result = loader->ToApi();
+  return status;
+}
+
 Status Transaction::Commit() {
   return TransactionImpl::FromApi(this)->Commit();
 }
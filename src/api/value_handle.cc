@@ -0,0 +1,26 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "berrydb/value_handle.h"
+
+#include "../page.h"
+#include "../page_pool.h"
+#include "../store_impl.h"
+#include "../transaction_impl.h"
+
+namespace berrydb {
+
+void ValueHandle::Release() noexcept {
+  if (page_ != nullptr) {
+    page_->transaction()->store()->page_pool()->UnpinStorePage(page_);
+    page_ = nullptr;
+  }
+  if (buffer_ != nullptr) {
+    Deallocate(buffer_, value_.size());
+    buffer_ = nullptr;
+  }
+  value_ = string_view();
+}
+
+}  // namespace berrydb
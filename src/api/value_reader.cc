@@ -0,0 +1,23 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "berrydb/value_reader.h"
+
+#include "../value_reader_impl.h"
+
+namespace berrydb {
+
+size_t ValueReader::size() {
+  return ValueReaderImpl::FromApi(this)->size();
+}
+
+Status ValueReader::Next(string_view* chunk) {
+  return ValueReaderImpl::FromApi(this)->Next(chunk);
+}
+
+void ValueReader::Release() {
+  ValueReaderImpl::FromApi(this)->Release();
+}
+
+}  // namespace berrydb
@@ -4,6 +4,10 @@
 
 #include "berrydb/vfs.h"
 
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "../thread_pool_block_io_queue.h"
+
 namespace berrydb {
 
 Vfs::Vfs() noexcept = default;
@@ -23,6 +27,58 @@ BlockAccessFile& BlockAccessFile::operator =(
 BlockAccessFile& BlockAccessFile::operator =(
     BlockAccessFile&& other) noexcept = default;
 
+Status BlockAccessFile::ReadV(size_t offset, const BlockIoBuffer* buffers,
+                              size_t buffer_count) {
+  for (size_t i = 0; i < buffer_count; ++i) {
+    Status status = Read(offset, buffers[i].byte_count, buffers[i].data);
+    if (status != Status::kSuccess)
+      return status;
+    offset += buffers[i].byte_count;
+  }
+  return Status::kSuccess;
+}
+
+Status BlockAccessFile::WriteV(const BlockIoBuffer* buffers,
+                               size_t buffer_count, size_t offset) {
+  for (size_t i = 0; i < buffer_count; ++i) {
+    Status status = Write(buffers[i].data, offset, buffers[i].byte_count);
+    if (status != Status::kSuccess)
+      return status;
+    offset += buffers[i].byte_count;
+  }
+  return Status::kSuccess;
+}
+
+Status BlockAccessFile::CreateIoQueue(size_t queue_depth,
+                                      BlockIoQueue** result) {
+  // The file may not support concurrent I/O, so operations are performed one
+  // at a time.
+  *result = ThreadPoolBlockIoQueue::Create(this, queue_depth, 1);
+  return Status::kSuccess;
+}
+
+Status BlockAccessFile::MapForReading(size_t byte_count, uint8_t** result) {
+  UNUSED(byte_count);
+  UNUSED(result);
+  return Status::kIoError;
+}
+
+void BlockAccessFile::AdviseMapping(size_t offset, size_t byte_count,
+                                    MappingAdvice advice) {
+  UNUSED(offset);
+  UNUSED(byte_count);
+  UNUSED(advice);
+}
+
+BlockIoQueue::BlockIoQueue() noexcept = default;
+BlockIoQueue::~BlockIoQueue() = default;
+BlockIoQueue::BlockIoQueue(const BlockIoQueue& other) noexcept = default;
+BlockIoQueue::BlockIoQueue(BlockIoQueue&& other) noexcept = default;
+BlockIoQueue& BlockIoQueue::operator =(
+    const BlockIoQueue& other) noexcept = default;
+BlockIoQueue& BlockIoQueue::operator =(
+    BlockIoQueue&& other) noexcept = default;
+
 RandomAccessFile::RandomAccessFile() noexcept = default;
 RandomAccessFile::~RandomAccessFile() = default;
 RandomAccessFile::RandomAccessFile(
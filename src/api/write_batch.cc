@@ -0,0 +1,35 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "berrydb/write_batch.h"
+
+#include "../write_batch_impl.h"
+
+namespace berrydb {
+
+WriteBatch* WriteBatch::Create() {
+  return WriteBatchImpl::Create()->ToApi();
+}
+
+void WriteBatch::Put(Space* space, string_view key, string_view value) {
+  WriteBatchImpl::FromApi(this)->Put(space, key, value);
+}
+
+void WriteBatch::Delete(Space* space, string_view key) {
+  WriteBatchImpl::FromApi(this)->Delete(space, key);
+}
+
+void WriteBatch::Clear() {
+  WriteBatchImpl::FromApi(this)->Clear();
+}
+
+size_t WriteBatch::size() const {
+  return WriteBatchImpl::FromApi(this)->size();
+}
+
+void WriteBatch::Release() {
+  WriteBatchImpl::FromApi(this)->Release();
+}
+
+}  // namespace berrydb
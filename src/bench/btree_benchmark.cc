@@ -0,0 +1,458 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "berrydb/options.h"
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/value_handle.h"
+#include "berrydb/vfs.h"
+#include "berrydb/write_batch.h"
+#include "../cursor_impl.h"
+#include "../pool_impl.h"
+#include "../space_impl.h"
+#include "../store_impl.h"
+#include "../test/file_deleter.h"
+#include "../transaction_impl.h"
+#include "../write_batch_impl.h"
+
+namespace berrydb {
+
+class BTreeBenchmark : public benchmark::Fixture {
+ public:
+  BTreeBenchmark()
+      : vfs_(DefaultVfs()), data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) {}
+
+  void SetUp(const benchmark::State& state) override {
+    key_count_ = state.range(0);
+    long_keys_ = state.range(1) != 0;
+
+    PoolOptions options;
+    options.page_shift = kPageShift;
+    options.page_pool_size = kPagePoolSize;
+    pool_ = PoolImpl::Create(options);
+
+    Status status = pool_->OpenStore(
+        data_file_deleter_.path(), StoreOptions(), &store_);
+    DCHECK_EQ(Status::kSuccess, status);
+
+    // The keys are inserted in random order, so the tree's pages are not
+    // perfectly packed, as they would be in a long-lived store.
+    std::vector<size_t> key_indexes(key_count_);
+    for (size_t i = 0; i < key_count_; ++i)
+      key_indexes[i] = i;
+    std::shuffle(key_indexes.begin(), key_indexes.end(), rnd_);
+
+    TransactionImpl* transaction = store_->CreateTransaction();
+    status = transaction->CreateSpace(nullptr, "btree", &space_);
+    DCHECK_EQ(Status::kSuccess, status);
+    string_view value(value_.data(), value_.size());
+    for (size_t key_index : key_indexes) {
+      std::string key = Key(key_index);
+      status = transaction->Put(
+          space_->ToApi(), string_view(key.data(), key.size()), value);
+      DCHECK_EQ(Status::kSuccess, status);
+    }
+    status = transaction->Commit();
+    DCHECK_EQ(Status::kSuccess, status);
+    transaction->Release();
+    UNUSED(status);
+  }
+
+  void TearDown(const benchmark::State& state) override {
+    space_->Release();
+    store_->Release();
+    pool_->Release();
+
+    // The store files are reused by the next benchmark run.
+    vfs_->RemoveFile(data_file_deleter_.path());
+    vfs_->RemoveFile(log_file_deleter_.path());
+    UNUSED(state);
+  }
+
+ protected:
+  /** The key with the given index. Keys sort in the same order as indexes.
+   *
+   * Long keys mimic the hierarchical keys produced by applications that map
+   * documents onto a key-value store. Neighboring keys share most of their
+   * bytes, which is the case that key prefix compression targets. */
+  std::string Key(size_t index) {
+    char key[128];
+    if (long_keys_) {
+      std::snprintf(key, sizeof(key),
+                    "tenant%04zu/collection/entity%012zu/attribute%04zu",
+                    index >> 16, index >> 3, index);
+    } else {
+      std::snprintf(key, sizeof(key), "key%016zu", index);
+    }
+    return std::string(key);
+  }
+
+  /** Random keys for lookup benchmarks.
+   *
+   * @param count       the number of keys to generate
+   * @param hit_percent the percentage of keys that are in the store; the other
+   *                    keys sort between the store's keys
+   */
+  std::vector<std::string> LookupKeys(size_t count, size_t hit_percent) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < count; ++i) {
+      std::string key = Key(rnd_() % key_count_);
+      if (rnd_() % 100 >= hit_percent)
+        key.push_back('+');
+      keys.push_back(key);
+    }
+    return keys;
+  }
+
+  /** New keys for write benchmarks.
+   *
+   * @param count      the number of keys to generate
+   * @param sequential if true, the keys follow each other, as they would in a
+   *                   bulk ingestion job; otherwise, the keys are random
+   */
+  std::vector<std::string> NewKeys(size_t count, bool sequential) {
+    std::vector<std::string> keys;
+    size_t first_index = rnd_() % key_count_;
+    for (size_t i = 0; i < count; ++i) {
+      size_t index = sequential ? (first_index + i) % key_count_ :
+                                  rnd_() % key_count_;
+      // The suffix makes the key sort right after an existing key.
+      std::string key = Key(index);
+      key.push_back('+');
+      keys.push_back(key);
+    }
+    return keys;
+  }
+
+  /** Looks up random keys that are in the store, one Get() at a time. */
+  void RunPointLookups(benchmark::State& state) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 1024; ++i)
+      keys.push_back(Key(rnd_() % key_count_));
+
+    TransactionImpl* transaction = store_->CreateTransaction();
+    size_t key_index = 0;
+    for (auto _ : state) {
+      string_view value;
+      const std::string& key = keys[key_index];
+      Status status = transaction->Get(
+          space_->ToApi(), string_view(key.data(), key.size()), &value);
+      if (status != Status::kSuccess) {
+        state.SkipWithError("Transaction::Get failed.");
+        break;
+      }
+      benchmark::DoNotOptimize(value.data());
+      key_index = (key_index + 1) & 1023;
+    }
+    transaction->Rollback();
+    transaction->Release();
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(KeyLabel());
+  }
+
+  /** Describes the key layout used by a benchmark. */
+  const char* KeyLabel() const noexcept {
+    return long_keys_ ? "long keys" : "short keys";
+  }
+
+  const std::string kStoreFileName = "bench_btree.berry";
+  static constexpr size_t kPageShift = 12;
+  // Large enough to cache all the stores used in the benchmarks below.
+  static constexpr size_t kPagePoolSize = 16384;
+
+  Vfs* vfs_;
+  // Must precede the store, because on Windows all file handles must be closed
+  // before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  PoolImpl* pool_;
+  StoreImpl* store_;
+  SpaceImpl* space_;
+  size_t key_count_;
+  bool long_keys_;
+  const std::string value_ = std::string(100, 'v');
+  std::mt19937 rnd_;
+};
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, PointLookups)(benchmark::State& state) {
+  RunPointLookups(state);
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, PointLookups)->RangeMultiplier(8)->Ranges({
+    {1 << 10, 1 << 19},  // Number of keys in the store.
+    {0, 1}});  // 1 for long keys with shared prefixes.
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, MappedPointLookups)(
+    benchmark::State& state) {
+  // The store is reopened in memory-mapped mode, so the lookups read its pages
+  // from the OS page cache instead of the page pool.
+  store_->Release();
+  StoreOptions options;
+  options.memory_mapped = true;
+  options.mapping_advice = MappingAdvice::kRandom;
+  Status status = pool_->OpenStore(
+      data_file_deleter_.path(), options, &store_);
+  DCHECK_EQ(Status::kSuccess, status);
+  UNUSED(status);
+
+  RunPointLookups(state);
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, MappedPointLookups)->RangeMultiplier(8)
+    ->Ranges({
+        {1 << 10, 1 << 19},  // Number of keys in the store.
+        {0, 1}});  // 1 for long keys with shared prefixes.
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, PointLookupHandles)(
+    benchmark::State& state) {
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < 1024; ++i)
+    keys.push_back(Key(rnd_() % key_count_));
+
+  TransactionImpl* transaction = store_->CreateTransaction();
+  size_t key_index = 0;
+  for (auto _ : state) {
+    ValueHandle value;
+    const std::string& key = keys[key_index];
+    Status status = transaction->Get(
+        space_->ToApi(), string_view(key.data(), key.size()), &value);
+    if (status != Status::kSuccess) {
+      state.SkipWithError("Transaction::Get failed.");
+      break;
+    }
+    benchmark::DoNotOptimize(value.value().data());
+    key_index = (key_index + 1) & 1023;
+  }
+  transaction->Rollback();
+  transaction->Release();
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(KeyLabel());
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, PointLookupHandles)->RangeMultiplier(8)
+    ->Ranges({
+        {1 << 10, 1 << 19},  // Number of keys in the store.
+        {0, 1}});  // 1 for long keys with shared prefixes.
+
+// Batched and independent lookups are measured on the same key sets, so their
+// results can be compared directly.
+constexpr size_t kLookupBatchSize = 64;
+
+void LookupBatchArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int key_count : {1 << 10, 1 << 16, 1 << 19}) {
+    for (int long_keys : {0, 1}) {
+      for (int hit_percent : {0, 50, 100})
+        benchmark->Args({key_count, long_keys, hit_percent});
+    }
+  }
+}
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, IndependentGets)(benchmark::State& state) {
+  std::vector<std::string> keys = LookupKeys(
+      kLookupBatchSize * 16, state.range(2));
+  std::vector<string_view> key_views;
+  for (const std::string& key : keys)
+    key_views.push_back(string_view(key.data(), key.size()));
+
+  TransactionImpl* transaction = store_->CreateTransaction();
+  size_t batch_start = 0;
+  for (auto _ : state) {
+    for (size_t i = 0; i < kLookupBatchSize; ++i) {
+      ValueHandle value;
+      Status status = transaction->Get(
+          space_->ToApi(), key_views[batch_start + i], &value);
+      if (status != Status::kSuccess && status != Status::kNotFound) {
+        state.SkipWithError("Transaction::Get failed.");
+        break;
+      }
+      benchmark::DoNotOptimize(value.value().data());
+    }
+    batch_start = (batch_start + kLookupBatchSize) % key_views.size();
+  }
+  transaction->Rollback();
+  transaction->Release();
+
+  state.SetItemsProcessed(state.iterations() * kLookupBatchSize);
+  state.SetLabel(KeyLabel());
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, IndependentGets)->Apply(
+    LookupBatchArguments);
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, MultiGets)(benchmark::State& state) {
+  std::vector<std::string> keys = LookupKeys(
+      kLookupBatchSize * 16, state.range(2));
+  std::vector<string_view> key_views;
+  for (const std::string& key : keys)
+    key_views.push_back(string_view(key.data(), key.size()));
+
+  TransactionImpl* transaction = store_->CreateTransaction();
+  size_t batch_start = 0;
+  for (auto _ : state) {
+    ValueHandle values[kLookupBatchSize];
+    Status statuses[kLookupBatchSize];
+    Status status = transaction->MultiGet(
+        space_->ToApi(), kLookupBatchSize, &key_views[batch_start], values,
+        statuses);
+    if (status != Status::kSuccess) {
+      state.SkipWithError("Transaction::MultiGet failed.");
+      break;
+    }
+    for (const ValueHandle& value : values)
+      benchmark::DoNotOptimize(value.value().data());
+    batch_start = (batch_start + kLookupBatchSize) % key_views.size();
+  }
+  transaction->Rollback();
+  transaction->Release();
+
+  state.SetItemsProcessed(state.iterations() * kLookupBatchSize);
+  state.SetLabel(KeyLabel());
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, MultiGets)->Apply(LookupBatchArguments);
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, Inserts)(benchmark::State& state) {
+  TransactionImpl* transaction = store_->CreateTransaction();
+  for (auto _ : state) {
+    // Keys above key_count_ are not in the store, and are spread across the
+    // existing keys by the formatting in Key().
+    std::string key = Key(rnd_() % key_count_);
+    key.push_back('+');
+    Status status = transaction->Put(
+        space_->ToApi(), string_view(key.data(), key.size()),
+        string_view(value_.data(), value_.size()));
+    if (status != Status::kSuccess) {
+      state.SkipWithError("Transaction::Put failed.");
+      break;
+    }
+  }
+  transaction->Commit();
+  transaction->Release();
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(KeyLabel());
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, Inserts)->RangeMultiplier(8)->Ranges({
+    {1 << 10, 1 << 19},  // Number of keys in the store.
+    {0, 1}});  // 1 for long keys with shared prefixes.
+
+// Per-key Puts and batched writes are measured on the same key sets, so their
+// results can be compared directly.
+constexpr size_t kWriteBatchSize = 256;
+
+void WriteBatchArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int key_count : {1 << 10, 1 << 16, 1 << 19}) {
+    for (int long_keys : {0, 1}) {
+      for (int sequential : {0, 1})
+        benchmark->Args({key_count, long_keys, sequential});
+    }
+  }
+}
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, PutBatches)(benchmark::State& state) {
+  TransactionImpl* transaction = store_->CreateTransaction();
+  string_view value(value_.data(), value_.size());
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<std::string> keys = NewKeys(kWriteBatchSize,
+                                            state.range(2) != 0);
+    state.ResumeTiming();
+
+    for (const std::string& key : keys) {
+      Status status = transaction->Put(
+          space_->ToApi(), string_view(key.data(), key.size()), value);
+      if (status != Status::kSuccess) {
+        state.SkipWithError("Transaction::Put failed.");
+        break;
+      }
+    }
+  }
+  transaction->Commit();
+  transaction->Release();
+
+  state.SetItemsProcessed(state.iterations() * kWriteBatchSize);
+  state.SetLabel(state.range(2) ? "sequential" : "random");
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, PutBatches)->Apply(WriteBatchArguments);
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, WriteBatches)(benchmark::State& state) {
+  TransactionImpl* transaction = store_->CreateTransaction();
+  WriteBatchImpl* batch = WriteBatchImpl::Create();
+  string_view value(value_.data(), value_.size());
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<std::string> keys = NewKeys(kWriteBatchSize,
+                                            state.range(2) != 0);
+    state.ResumeTiming();
+
+    batch->Clear();
+    for (const std::string& key : keys) {
+      batch->Put(space_->ToApi(), string_view(key.data(), key.size()),
+                 value);
+    }
+    Status status = transaction->Write(batch->ToApi());
+    if (status != Status::kSuccess) {
+      state.SkipWithError("Transaction::Write failed.");
+      break;
+    }
+  }
+  batch->Release();
+  transaction->Commit();
+  transaction->Release();
+
+  state.SetItemsProcessed(state.iterations() * kWriteBatchSize);
+  state.SetLabel(state.range(2) ? "sequential" : "random");
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, WriteBatches)->Apply(
+    WriteBatchArguments);
+
+BENCHMARK_DEFINE_F(BTreeBenchmark, RangeScans)(benchmark::State& state) {
+  constexpr size_t kScanSize = 100;
+  TransactionImpl* transaction = store_->CreateTransaction();
+  CursorOptions options;
+  options.one_shot = true;
+  CursorImpl* cursor;
+  Status status = transaction->CreateCursor(space_->ToApi(), options, &cursor);
+  DCHECK_EQ(Status::kSuccess, status);
+
+  for (auto _ : state) {
+    std::string key = Key(rnd_() % key_count_);
+    status = cursor->Seek(string_view(key.data(), key.size()));
+    for (size_t i = 0; i < kScanSize && status == Status::kSuccess; ++i) {
+      benchmark::DoNotOptimize(cursor->key().data());
+      benchmark::DoNotOptimize(cursor->value().data());
+      status = cursor->Next();
+    }
+    if (status != Status::kSuccess && status != Status::kNotFound) {
+      state.SkipWithError("Cursor iteration failed.");
+      break;
+    }
+  }
+  cursor->Release();
+  transaction->Rollback();
+  transaction->Release();
+
+  state.SetItemsProcessed(state.iterations() * kScanSize);
+  state.SetLabel(KeyLabel());
+}
+
+BENCHMARK_REGISTER_F(BTreeBenchmark, RangeScans)->RangeMultiplier(8)->Ranges({
+    {1 << 10, 1 << 19},  // Number of keys in the store.
+    {0, 1}});  // 1 for long keys with shared prefixes.
+
+}  // namespace berrydb
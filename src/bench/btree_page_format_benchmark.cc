@@ -0,0 +1,146 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "berrydb/platform.h"
+#include "../format/btree_page_format.h"
+#include "../format/key_prefix_format.h"
+
+namespace berrydb {
+
+class BTreePageFormatBenchmark : public benchmark::Fixture {
+ public:
+  void SetUp(const benchmark::State& state) override {
+    page_size_ = state.range(0);
+    page_data_ = reinterpret_cast<uint8_t*>(Allocate(page_size_));
+    DCHECK(page_data_ != nullptr);
+
+    // Fill a leaf page with random 16-byte keys and 8-byte values, which is
+    // the densest layout expected in practice.
+    BTreePageFormat::InitLeaf(page_data_, page_size_);
+    std::uniform_int_distribution<int> byte_distribution(0, 255);
+    std::string value(8, 'v');
+    string_view value_view(value.data(), value.size());
+    while (true) {
+      std::string key(16, '\0');
+      for (char& c : key)
+        c = static_cast<char>(byte_distribution(rnd_));
+      string_view key_view(key.data(), key.size());
+
+      bool found;
+      size_t slot = BTreePageFormat::LowerBound(page_data_, key_view, &found);
+      if (!BTreePageFormat::InsertLeafCell(page_data_, slot, key_view,
+                                           value_view)) {
+        break;
+      }
+      keys_.push_back(std::move(key));
+    }
+    std::shuffle(keys_.begin(), keys_.end(), rnd_);
+  }
+
+  void TearDown(const benchmark::State& state) override {
+    Deallocate(page_data_, page_size_);
+    keys_.clear();
+    UNUSED(state);
+  }
+
+ protected:
+  /** Binary search over the full keys, which ignores the key prefix array. */
+  size_t ScalarLowerBound(string_view key) {
+    size_t low = 0, high = BTreePageFormat::CellCount(page_data_);
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (BTreePageFormat::KeySuffix(page_data_, middle) < key)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return low;
+  }
+
+  std::mt19937 rnd_;
+  size_t page_size_;
+  uint8_t* page_data_;
+  std::vector<std::string> keys_;
+};
+
+BENCHMARK_DEFINE_F(BTreePageFormatBenchmark, PrefixSearch)(
+    benchmark::State& state) {
+  size_t key_index = 0;
+  for (auto _ : state) {
+    const std::string& key = keys_[key_index];
+    bool found;
+    size_t slot = BTreePageFormat::LowerBound(
+        page_data_, string_view(key.data(), key.size()), &found);
+    benchmark::DoNotOptimize(slot);
+    key_index = (key_index + 1 == keys_.size()) ? 0 : key_index + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(KeyPrefixFormat::IsVectorized() ? "vectorized" : "scalar");
+}
+
+BENCHMARK_REGISTER_F(BTreePageFormatBenchmark, PrefixSearch)
+    ->RangeMultiplier(2)->Range(1 << 9, 1 << 16);  // Page size.
+
+BENCHMARK_DEFINE_F(BTreePageFormatBenchmark, ScalarSearch)(
+    benchmark::State& state) {
+  size_t key_index = 0;
+  for (auto _ : state) {
+    const std::string& key = keys_[key_index];
+    size_t slot = ScalarLowerBound(string_view(key.data(), key.size()));
+    benchmark::DoNotOptimize(slot);
+    key_index = (key_index + 1 == keys_.size()) ? 0 : key_index + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BTreePageFormatBenchmark, ScalarSearch)
+    ->RangeMultiplier(2)->Range(1 << 9, 1 << 16);  // Page size.
+
+BENCHMARK_DEFINE_F(BTreePageFormatBenchmark, PrefixArrayOnly)(
+    benchmark::State& state) {
+  const uint8_t* prefixes = BTreePageFormat::KeyPrefixes(page_data_);
+  size_t cell_count = BTreePageFormat::CellCount(page_data_);
+  size_t key_index = 0;
+  for (auto _ : state) {
+    const std::string& key = keys_[key_index];
+    size_t slot = KeyPrefixFormat::LowerBound(
+        prefixes, cell_count,
+        KeyPrefixFormat::Prefix(string_view(key.data(), key.size())));
+    benchmark::DoNotOptimize(slot);
+    key_index = (key_index + 1 == keys_.size()) ? 0 : key_index + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(KeyPrefixFormat::IsVectorized() ? "vectorized" : "scalar");
+}
+
+BENCHMARK_REGISTER_F(BTreePageFormatBenchmark, PrefixArrayOnly)
+    ->RangeMultiplier(2)->Range(1 << 9, 1 << 16);  // Page size.
+
+BENCHMARK_DEFINE_F(BTreePageFormatBenchmark, ScalarPrefixArrayOnly)(
+    benchmark::State& state) {
+  const uint8_t* prefixes = BTreePageFormat::KeyPrefixes(page_data_);
+  size_t cell_count = BTreePageFormat::CellCount(page_data_);
+  size_t key_index = 0;
+  for (auto _ : state) {
+    const std::string& key = keys_[key_index];
+    size_t slot = KeyPrefixFormat::ScalarLowerBound(
+        prefixes, cell_count,
+        KeyPrefixFormat::Prefix(string_view(key.data(), key.size())));
+    benchmark::DoNotOptimize(slot);
+    key_index = (key_index + 1 == keys_.size()) ? 0 : key_index + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BTreePageFormatBenchmark, ScalarPrefixArrayOnly)
+    ->RangeMultiplier(2)->Range(1 << 9, 1 << 16);  // Page size.
+
+}  // namespace berrydb
@@ -0,0 +1,171 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "berrydb/options.h"
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/vfs.h"
+#include "../bulk_loader_impl.h"
+#include "../pool_impl.h"
+#include "../space_impl.h"
+#include "../store_impl.h"
+#include "../test/file_deleter.h"
+#include "../transaction_impl.h"
+
+namespace berrydb {
+
+class BulkLoaderBenchmark : public benchmark::Fixture {
+ public:
+  BulkLoaderBenchmark()
+      : vfs_(DefaultVfs()), data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) {}
+
+  void SetUp(const benchmark::State& state) override {
+    size_t key_count = state.range(0);
+    bool long_keys = state.range(1) != 0;
+
+    keys_.clear();
+    data_bytes_ = 0;
+    for (size_t i = 0; i < key_count; ++i) {
+      char key[128];
+      if (long_keys) {
+        std::snprintf(key, sizeof(key),
+                      "tenant%04zu/collection/entity%012zu/attribute%04zu",
+                      i >> 16, i >> 3, i);
+      } else {
+        std::snprintf(key, sizeof(key), "key%016zu", i);
+      }
+      keys_.push_back(key);
+      data_bytes_ += keys_.back().size() + value_.size();
+    }
+
+    PoolOptions options;
+    options.page_shift = kPageShift;
+    options.page_pool_size = kPagePoolSize;
+    pool_ = PoolImpl::Create(options);
+
+    Status status = pool_->OpenStore(
+        data_file_deleter_.path(), StoreOptions(), &store_);
+    DCHECK_EQ(Status::kSuccess, status);
+    UNUSED(status);
+  }
+
+  void TearDown(const benchmark::State& state) override {
+    store_->Release();
+    pool_->Release();
+
+    // The store files are reused by the next benchmark run.
+    vfs_->RemoveFile(data_file_deleter_.path());
+    vfs_->RemoveFile(log_file_deleter_.path());
+    UNUSED(state);
+  }
+
+ protected:
+  /** Creates a new space that receives one benchmark iteration's keys. */
+  SpaceImpl* CreateSpace(TransactionImpl* transaction, size_t iteration) {
+    std::string name = "space" + std::to_string(iteration);
+    SpaceImpl* space;
+    Status status = transaction->CreateSpace(
+        nullptr, string_view(name.data(), name.size()), &space);
+    DCHECK_EQ(Status::kSuccess, status);
+    UNUSED(status);
+    return space;
+  }
+
+  const std::string kStoreFileName = "bench_bulk_loader.berry";
+  static constexpr size_t kPageShift = 12;
+  static constexpr size_t kPagePoolSize = 16384;
+
+  Vfs* vfs_;
+  // Must precede the store, because on Windows all file handles must be closed
+  // before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  PoolImpl* pool_;
+  StoreImpl* store_;
+  std::vector<std::string> keys_;
+  /** The total size of the keys and values loaded by each iteration. */
+  size_t data_bytes_;
+  const std::string value_ = std::string(100, 'v');
+};
+
+// The bytes processed by these benchmarks can be compared with the sequential
+// write bandwidth reported by VfsBenchmark.
+BENCHMARK_DEFINE_F(BulkLoaderBenchmark, BulkLoads)(benchmark::State& state) {
+  size_t iteration = 0;
+  for (auto _ : state) {
+    TransactionImpl* transaction = store_->CreateTransaction();
+    SpaceImpl* space = CreateSpace(transaction, iteration++);
+
+    BulkLoaderImpl* loader;
+    Status status = transaction->CreateBulkLoader(
+        space->ToApi(), BulkLoaderOptions(), &loader);
+    for (const std::string& key : keys_) {
+      if (status != Status::kSuccess)
+        break;
+      status = loader->Add(string_view(key.data(), key.size()),
+                           string_view(value_.data(), value_.size()));
+    }
+    if (status == Status::kSuccess)
+      status = loader->Finish();
+    loader->Release();
+    if (status == Status::kSuccess)
+      status = transaction->Commit();
+    space->Release();
+    transaction->Release();
+    if (status != Status::kSuccess) {
+      state.SkipWithError("Bulk load failed.");
+      break;
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() * data_bytes_);
+  state.SetItemsProcessed(state.iterations() * keys_.size());
+}
+
+BENCHMARK_REGISTER_F(BulkLoaderBenchmark, BulkLoads)->RangeMultiplier(8)
+    ->Ranges({
+        {1 << 10, 1 << 16},  // Number of keys loaded by each iteration.
+        {0, 1}});  // 1 for long keys with shared prefixes.
+
+BENCHMARK_DEFINE_F(BulkLoaderBenchmark, SortedPuts)(benchmark::State& state) {
+  size_t iteration = 0;
+  for (auto _ : state) {
+    TransactionImpl* transaction = store_->CreateTransaction();
+    SpaceImpl* space = CreateSpace(transaction, iteration++);
+
+    Status status = Status::kSuccess;
+    for (const std::string& key : keys_) {
+      status = transaction->Put(
+          space->ToApi(), string_view(key.data(), key.size()),
+          string_view(value_.data(), value_.size()));
+      if (status != Status::kSuccess)
+        break;
+    }
+    if (status == Status::kSuccess)
+      status = transaction->Commit();
+    space->Release();
+    transaction->Release();
+    if (status != Status::kSuccess) {
+      state.SkipWithError("Transaction::Put failed.");
+      break;
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() * data_bytes_);
+  state.SetItemsProcessed(state.iterations() * keys_.size());
+}
+
+BENCHMARK_REGISTER_F(BulkLoaderBenchmark, SortedPuts)->RangeMultiplier(8)
+    ->Ranges({
+        {1 << 10, 1 << 16},  // Number of keys loaded by each iteration.
+        {0, 1}});  // 1 for long keys with shared prefixes.
+
+}  // namespace berrydb
@@ -0,0 +1,133 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "berrydb/options.h"
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/vfs.h"
+#include "../page_pool.h"
+#include "../pool_impl.h"
+#include "../space_impl.h"
+#include "../store_impl.h"
+#include "../test/file_deleter.h"
+#include "../transaction_impl.h"
+#include "../value_reader_impl.h"
+
+namespace berrydb {
+
+class OverflowChainBenchmark : public benchmark::Fixture {
+ public:
+  OverflowChainBenchmark()
+      : vfs_(DefaultVfs()), data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) {}
+
+  void SetUp(const benchmark::State& state) override {
+    value_.assign(static_cast<size_t>(state.range(0)), 'v');
+
+    // The pool is much smaller than the values, so reads go to the store file.
+    PoolOptions options;
+    options.page_shift = kPageShift;
+    options.page_pool_size = kPagePoolSize;
+    pool_ = PoolImpl::Create(options);
+
+    Status status = pool_->OpenStore(
+        data_file_deleter_.path(), StoreOptions(), &store_);
+    DCHECK_EQ(Status::kSuccess, status);
+
+    TransactionImpl* transaction = store_->CreateTransaction();
+    status = transaction->CreateSpace(nullptr, "space", &space_);
+    DCHECK_EQ(Status::kSuccess, status);
+    status = transaction->Put(space_->ToApi(), "key",
+                              string_view(value_.data(), value_.size()));
+    DCHECK_EQ(Status::kSuccess, status);
+    status = transaction->Commit();
+    DCHECK_EQ(Status::kSuccess, status);
+    UNUSED(status);
+    transaction->Release();
+  }
+
+  void TearDown(const benchmark::State& state) override {
+    space_->Release();
+    store_->Release();
+    pool_->Release();
+
+    // The store files are reused by the next benchmark run.
+    vfs_->RemoveFile(data_file_deleter_.path());
+    vfs_->RemoveFile(log_file_deleter_.path());
+    UNUSED(state);
+  }
+
+ protected:
+  const std::string kStoreFileName = "bench_overflow_chain.berry";
+  static constexpr size_t kPageShift = 12;
+  static constexpr size_t kPagePoolSize = 64;
+
+  Vfs* vfs_;
+  // Must precede the store, because on Windows all file handles must be closed
+  // before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  PoolImpl* pool_;
+  StoreImpl* store_;
+  SpaceImpl* space_;
+  std::string value_;
+};
+
+BENCHMARK_DEFINE_F(OverflowChainBenchmark, StreamValue)(
+    benchmark::State& state) {
+  TransactionImpl* transaction = store_->CreateTransaction();
+  size_t max_pinned_pages = 0;
+  for (auto _ : state) {
+    ValueReaderImpl* reader;
+    Status status = transaction->CreateValueReader(
+        space_->ToApi(), "key", &reader);
+    size_t read_bytes = 0;
+    while (status == Status::kSuccess) {
+      string_view chunk;
+      status = reader->Next(&chunk);
+      read_bytes += chunk.size();
+      benchmark::DoNotOptimize(chunk.data());
+      max_pinned_pages = std::max(max_pinned_pages,
+                                  store_->page_pool()->pinned_pages());
+    }
+    reader->Release();
+    if (status != Status::kNotFound || read_bytes != value_.size()) {
+      state.SkipWithError("ValueReader::Next failed.");
+      break;
+    }
+  }
+  transaction->Release();
+
+  state.SetBytesProcessed(state.iterations() * value_.size());
+  state.counters["pinned_pages"] = static_cast<double>(max_pinned_pages);
+}
+
+BENCHMARK_REGISTER_F(OverflowChainBenchmark, StreamValue)
+    ->Range(1 << 16, 1 << 24);  // Value size.
+
+BENCHMARK_DEFINE_F(OverflowChainBenchmark, GetValue)(benchmark::State& state) {
+  TransactionImpl* transaction = store_->CreateTransaction();
+  for (auto _ : state) {
+    string_view value;
+    Status status = transaction->Get(space_->ToApi(), "key", &value);
+    benchmark::DoNotOptimize(value.data());
+    if (status != Status::kSuccess || value.size() != value_.size()) {
+      state.SkipWithError("Transaction::Get failed.");
+      break;
+    }
+  }
+  transaction->Release();
+
+  state.SetBytesProcessed(state.iterations() * value_.size());
+}
+
+BENCHMARK_REGISTER_F(OverflowChainBenchmark, GetValue)
+    ->Range(1 << 16, 1 << 24);  // Value size.
+
+}  // namespace berrydb
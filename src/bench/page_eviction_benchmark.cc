@@ -0,0 +1,336 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "berrydb/options.h"
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/vfs.h"
+#include "../page_pool.h"
+#include "../pool_impl.h"
+#include "../store_impl.h"
+#include "../test/file_deleter.h"
+#include "../transaction_impl.h"
+
+namespace berrydb {
+
+namespace {
+
+/** Page IDs drawn from a Zipfian distribution over a store's pages.
+ *
+ * The page with popularity rank k is drawn with probability proportional to
+ * 1 / k^exponent. Ranks are assigned to pages at random, so popular pages are
+ * spread across the store.
+ */
+std::vector<size_t> ZipfTrace(size_t page_count, double exponent,
+                              size_t trace_size, std::mt19937* rnd) {
+  std::vector<double> cumulative_weights(page_count);
+  double total_weight = 0;
+  for (size_t i = 0; i < page_count; ++i) {
+    total_weight += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+    cumulative_weights[i] = total_weight;
+  }
+
+  std::vector<size_t> rank_pages(page_count);
+  for (size_t i = 0; i < page_count; ++i)
+    rank_pages[i] = i;
+  std::shuffle(rank_pages.begin(), rank_pages.end(), *rnd);
+
+  std::uniform_real_distribution<double> distribution(0, total_weight);
+  std::vector<size_t> trace(trace_size);
+  for (size_t i = 0; i < trace_size; ++i) {
+    size_t rank = std::lower_bound(
+        cumulative_weights.begin(), cumulative_weights.end(),
+        distribution(*rnd)) - cumulative_weights.begin();
+    trace[i] = rank_pages[std::min(rank, page_count - 1)];
+  }
+  return trace;
+}
+
+/** Repeated sequential scans over a store's pages. */
+std::vector<size_t> ScanTrace(size_t page_count, size_t trace_size) {
+  std::vector<size_t> trace(trace_size);
+  for (size_t i = 0; i < trace_size; ++i)
+    trace[i] = i % page_count;
+  return trace;
+}
+
+/** A Zipfian trace interleaved with a large sequential scan.
+ *
+ * This models an application that serves frequent point lookups while an
+ * analytics job reads a large range. The scan reads pages that are not
+ * accessed by the point lookups.
+ *
+ * @param page_count      the number of pages accessed by the point lookups
+ * @param scan_page_count the number of pages read by the scan; these pages
+ *                        follow the point lookup pages in the store
+ * @param scan_burst_size the number of consecutive scan pages read between
+ *                        bursts of point lookups
+ */
+std::vector<size_t> ScanZipfTrace(size_t page_count, double exponent,
+                                  size_t scan_page_count,
+                                  size_t scan_burst_size, size_t trace_size,
+                                  std::mt19937* rnd) {
+  std::vector<size_t> lookups = ZipfTrace(page_count, exponent, trace_size,
+                                          rnd);
+  std::vector<size_t> trace;
+  trace.reserve(trace_size);
+  size_t lookup_index = 0, scan_index = 0;
+  while (trace.size() < trace_size) {
+    // Each burst of point lookups is twice as large as a burst of scan reads.
+    for (size_t i = 0; i < 2 * scan_burst_size; ++i)
+      trace.push_back(lookups[lookup_index++]);
+    for (size_t i = 0; i < scan_burst_size; ++i) {
+      trace.push_back(page_count + scan_index);
+      scan_index = (scan_index + 1) % scan_page_count;
+    }
+  }
+  trace.resize(trace_size);
+  return trace;
+}
+
+}  // namespace
+
+class PageEvictionBenchmark : public benchmark::Fixture {
+ public:
+  PageEvictionBenchmark()
+      : vfs_(DefaultVfs()), data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) {}
+
+  void SetUp(const benchmark::State& state) override {
+    PoolOptions options;
+    options.page_shift = kPageShift;
+    options.page_pool_size = kPagePoolSize;
+    options.page_eviction_policy =
+        static_cast<PageEvictionPolicy>(state.range(0));
+    options.page_pool_frame_table = state.range(1) != 0;
+    // The background cleaner only runs in multi-threaded pools.
+    options.page_pool_clean_fraction =
+        static_cast<double>(state.range(2)) / 100;
+    options.multi_threaded = state.range(2) != 0;
+    pool_ = PoolImpl::Create(options);
+
+    Status status = pool_->OpenStore(
+        data_file_deleter_.path(), StoreOptions(), &store_);
+    DCHECK_EQ(Status::kSuccess, status);
+
+    // Pages modified by a transaction stay pinned until it commits, so the
+    // store is written in batches that fit in the pool.
+    PagePool* page_pool = pool_->page_pool();
+    for (size_t batch = 0; batch < kStorePageCount + kScanPageCount;
+         batch += kBatchSize) {
+      TransactionImpl* transaction = store_->CreateTransaction();
+      for (size_t i = batch; i < batch + kBatchSize; ++i) {
+        Page* page;
+        status = page_pool->StorePage(store_, kFirstPageId + i,
+                                      PagePool::kIgnorePageData, &page);
+        DCHECK_EQ(Status::kSuccess, status);
+        transaction->WillModifyPage(page);
+        std::memset(page->data(), static_cast<int>(i), page_pool->page_size());
+        page_pool->UnpinStorePage(page);
+      }
+      status = transaction->Commit();
+      DCHECK_EQ(Status::kSuccess, status);
+      transaction->Release();
+    }
+    UNUSED(status);
+  }
+
+  void TearDown(const benchmark::State& state) override {
+    store_->Release();
+    pool_->Release();
+
+    // The store files are reused by the next benchmark run.
+    vfs_->RemoveFile(data_file_deleter_.path());
+    vfs_->RemoveFile(log_file_deleter_.path());
+    UNUSED(state);
+  }
+
+  /** Fetches and unpins the pages in the trace, in order.
+   *
+   * @param modify_pages if true, each fetched page is modified, and the
+   *                     modifications are committed every kCommitInterval
+   *                     pages */
+  void ReplayTrace(benchmark::State& state, bool modify_pages = false) {
+    PagePool* page_pool = pool_->page_pool();
+    transaction_ = modify_pages ? store_->CreateTransaction() : nullptr;
+
+    // Warm up the pool, so the hit ratio reflects the steady state.
+    size_t trace_index = 0;
+    for (; trace_index < kTraceSize / 4; ++trace_index) {
+      if (!FetchPage(page_pool, trace_[trace_index], trace_index)) {
+        state.SkipWithError("PagePool::StorePage failed.");
+        return;
+      }
+    }
+    size_t hit_count = page_pool->hit_count();
+    size_t miss_count = page_pool->miss_count();
+    size_t foreground_writes = page_pool->foreground_write_count();
+    size_t background_writes = page_pool->background_write_count();
+
+    for (auto _ : state) {
+      if (!FetchPage(page_pool, trace_[trace_index], trace_index)) {
+        state.SkipWithError("PagePool::StorePage failed.");
+        break;
+      }
+      if (++trace_index == kTraceSize)
+        trace_index = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (transaction_ != nullptr) {
+      transaction_->Commit();
+      transaction_->Release();
+    }
+
+    hit_count = page_pool->hit_count() - hit_count;
+    miss_count = page_pool->miss_count() - miss_count;
+    state.counters["hit_ratio"] = static_cast<double>(hit_count) /
+        static_cast<double>(hit_count + miss_count);
+    if (modify_pages) {
+      // Writes per miss. Foreground writes stall the misses that cause them.
+      foreground_writes =
+          page_pool->foreground_write_count() - foreground_writes;
+      background_writes =
+          page_pool->background_write_count() - background_writes;
+      state.counters["foreground_writes"] =
+          static_cast<double>(foreground_writes) /
+          static_cast<double>(miss_count);
+      state.counters["background_writes"] =
+          static_cast<double>(background_writes) /
+          static_cast<double>(miss_count);
+    }
+  }
+
+ protected:
+  /** Fetches a store page and unpins it right away.
+   *
+   * If a transaction is running, the page is modified by the transaction, and
+   * the transaction is committed and replaced every kCommitInterval accesses.
+   */
+  inline bool FetchPage(PagePool* page_pool, size_t page_index,
+                        size_t trace_index) {
+    Page* page;
+    Status status = page_pool->StorePage(
+        store_, kFirstPageId + page_index, PagePool::kFetchPageData, &page);
+    if (status != Status::kSuccess)
+      return false;
+    if (transaction_ == nullptr) {
+      benchmark::DoNotOptimize(page->data()[0]);
+      page_pool->UnpinStorePage(page);
+      return true;
+    }
+
+    transaction_->WillModifyPage(page);
+    ++page->data()[0];
+    page_pool->UnpinStorePage(page);
+    if ((trace_index + 1) % kCommitInterval == 0) {
+      if (transaction_->Commit() != Status::kSuccess)
+        return false;
+      transaction_->Release();
+      transaction_ = store_->CreateTransaction();
+    }
+    return true;
+  }
+
+  const std::string kStoreFileName = "bench_page_eviction.berry";
+  // Small pages keep the store file in the OS page cache.
+  static constexpr size_t kPageShift = 9;
+  // Page 0 is the store header, and page 1 is the root catalog.
+  static constexpr size_t kFirstPageId = 2;
+  /** Number of pages accessed by the Zipfian part of the traces. */
+  static constexpr size_t kStorePageCount = 4096;
+  /** Number of pages accessed by the scans in the traces. */
+  static constexpr size_t kScanPageCount = 8192;
+  /** Number of consecutive pages read by a scan between point lookups. */
+  static constexpr size_t kScanBurstSize = 1024;
+  /** The pool caches 1/8th of the pages in the Zipfian traces. */
+  static constexpr size_t kPagePoolSize = 512;
+  /** Number of pages written by each transaction while setting up the store.
+   */
+  static constexpr size_t kBatchSize = 256;
+  /** Number of pages modified by each transaction while replaying a trace.
+   *
+   * Transactions are much larger than the pool, so many dirty pages are
+   * evicted before they are committed. */
+  static constexpr size_t kCommitInterval = 4096;
+  static constexpr size_t kTraceSize = 1 << 18;
+  static constexpr double kZipfExponent = 0.99;
+
+  Vfs* vfs_;
+  // Must precede the store, because on Windows all file handles must be closed
+  // before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  PoolImpl* pool_;
+  StoreImpl* store_;
+  /** The transaction that modifies pages, if the trace modifies pages. */
+  TransactionImpl* transaction_;
+  /** Page indexes, relative to kFirstPageId. */
+  std::vector<size_t> trace_;
+};
+
+constexpr double PageEvictionBenchmark::kZipfExponent;
+
+// The arguments are the eviction policy, whether the pool uses a frame table,
+// and the percentage of the pool kept clean by the background cleaner. Pools
+// with a background cleaner are multi-threaded.
+BENCHMARK_DEFINE_F(PageEvictionBenchmark, ZipfTrace)(benchmark::State& state) {
+  std::mt19937 rnd(42);
+  trace_ = ZipfTrace(kStorePageCount, kZipfExponent, kTraceSize, &rnd);
+  ReplayTrace(state);
+}
+
+BENCHMARK_REGISTER_F(PageEvictionBenchmark, ZipfTrace)
+    ->Args({static_cast<int>(PageEvictionPolicy::kLru), 0, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kClock), 0, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kClock), 1, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kTwoQueue), 0, 0});
+
+BENCHMARK_DEFINE_F(PageEvictionBenchmark, ScanZipfTrace)(
+    benchmark::State& state) {
+  std::mt19937 rnd(42);
+  trace_ = ScanZipfTrace(kStorePageCount, kZipfExponent, kScanPageCount,
+                         kScanBurstSize, kTraceSize, &rnd);
+  ReplayTrace(state);
+}
+
+BENCHMARK_REGISTER_F(PageEvictionBenchmark, ScanZipfTrace)
+    ->Args({static_cast<int>(PageEvictionPolicy::kLru), 0, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kClock), 0, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kClock), 1, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kTwoQueue), 0, 0});
+
+// Most pages in the scans are read ahead by earlier misses.
+BENCHMARK_DEFINE_F(PageEvictionBenchmark, ScanTrace)(benchmark::State& state) {
+  trace_ = ScanTrace(kStorePageCount + kScanPageCount, kTraceSize);
+  ReplayTrace(state);
+}
+
+BENCHMARK_REGISTER_F(PageEvictionBenchmark, ScanTrace)
+    ->Args({static_cast<int>(PageEvictionPolicy::kLru), 0, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kTwoQueue), 0, 0});
+
+BENCHMARK_DEFINE_F(PageEvictionBenchmark, ModifyZipfTrace)(
+    benchmark::State& state) {
+  std::mt19937 rnd(42);
+  trace_ = ZipfTrace(kStorePageCount, kZipfExponent, kTraceSize, &rnd);
+  ReplayTrace(state, true);
+}
+
+BENCHMARK_REGISTER_F(PageEvictionBenchmark, ModifyZipfTrace)
+    ->Args({static_cast<int>(PageEvictionPolicy::kLru), 0, 0})
+    ->Args({static_cast<int>(PageEvictionPolicy::kLru), 0, 10})
+    ->Args({static_cast<int>(PageEvictionPolicy::kLru), 0, 25})
+    ->Args({static_cast<int>(PageEvictionPolicy::kClock), 1, 25})
+    ->Args({static_cast<int>(PageEvictionPolicy::kTwoQueue), 0, 25});
+
+}  // namespace berrydb
@@ -0,0 +1,162 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "berrydb/options.h"
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/vfs.h"
+#include "../page_pool.h"
+#include "../pool_impl.h"
+#include "../store_impl.h"
+#include "../test/file_deleter.h"
+#include "../transaction_impl.h"
+
+namespace berrydb {
+
+class PagePoolBenchmark : public benchmark::Fixture {
+ public:
+  PagePoolBenchmark()
+      : vfs_(DefaultVfs()), data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) {}
+
+  void SetUp(const benchmark::State& state) override {
+    // The threads share the pool and the store set up by the first thread.
+    if (state.thread_index() != 0)
+      return;
+
+    page_count_ = static_cast<size_t>(state.range(1));
+
+    // The pool has room for the store's catalog pages, in addition to the
+    // pages read by the benchmark.
+    PoolOptions options;
+    options.page_shift = kPageShift;
+    options.page_pool_size = page_count_ + 16;
+    options.multi_threaded = state.range(0) != 0;
+    options.page_pool_slabs = state.range(2) != 0;
+    options.page_pool_huge_pages = state.range(2) == 2;
+    pool_ = PoolImpl::Create(options);
+
+    Status status = pool_->OpenStore(
+        data_file_deleter_.path(), StoreOptions(), &store_);
+    DCHECK_EQ(Status::kSuccess, status);
+
+    // The pages written here stay cached, so the hit benchmarks only see hits.
+    page_pool_ = pool_->page_pool();
+    TransactionImpl* transaction = store_->CreateTransaction();
+    for (size_t i = 0; i < page_count_; ++i) {
+      Page* page;
+      status = page_pool_->StorePage(store_, kFirstPageId + i,
+                                     PagePool::kIgnorePageData, &page);
+      DCHECK_EQ(Status::kSuccess, status);
+      transaction->WillModifyPage(page);
+      std::memset(page->data(), static_cast<int>(i), page_pool_->page_size());
+      page_pool_->UnpinStorePage(page);
+    }
+    status = transaction->Commit();
+    DCHECK_EQ(Status::kSuccess, status);
+    UNUSED(status);
+    transaction->Release();
+  }
+
+  void TearDown(const benchmark::State& state) override {
+    if (state.thread_index() != 0)
+      return;
+
+    store_->Release();
+    pool_->Release();
+
+    // The store files are reused by the next benchmark run.
+    vfs_->RemoveFile(data_file_deleter_.path());
+    vfs_->RemoveFile(log_file_deleter_.path());
+  }
+
+  /** Fetches and unpins random pages. */
+  void FetchRandomPages(benchmark::State& state) {
+    std::mt19937 rnd(static_cast<uint32_t>(state.thread_index()));
+    for (auto _ : state) {
+      // The first thread's SetUp() is only guaranteed to be done once the
+      // other threads enter the loop.
+      PagePool* page_pool = page_pool_;
+      size_t page_id = kFirstPageId + rnd() % page_count_;
+      Page* page;
+      Status status = page_pool->StorePage(
+          store_, page_id, PagePool::kFetchPageData, &page);
+      if (status != Status::kSuccess) {
+        state.SkipWithError("PagePool::StorePage failed.");
+        break;
+      }
+      benchmark::DoNotOptimize(page->data()[0]);
+      page_pool->UnpinStorePage(page);
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+ protected:
+  const std::string kStoreFileName = "bench_page_pool.berry";
+  // Small pages keep large pools in memory.
+  static constexpr size_t kPageShift = 9;
+  // Page 0 is the store header, and page 1 is the root catalog.
+  static constexpr size_t kFirstPageId = 2;
+
+  Vfs* vfs_;
+  // Must precede the store, because on Windows all file handles must be closed
+  // before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  PoolImpl* pool_;
+  PagePool* page_pool_;
+  StoreImpl* store_;
+  /** Number of pages read by the benchmark. */
+  size_t page_count_;
+};
+
+BENCHMARK_DEFINE_F(PagePoolBenchmark, StorePageHit)(benchmark::State& state) {
+  FetchRandomPages(state);
+}
+
+// The last argument selects the entry allocation: 0 allocates each entry
+// separately, 1 uses slabs, and 2 uses slabs backed by huge pages.
+//
+// Single-threaded pools cannot be shared by threads.
+BENCHMARK_REGISTER_F(PagePoolBenchmark, StorePageHit)
+    ->Args({0, 64, 0})  // Single-threaded pool, cached pages, allocation.
+    ->Args({0, 1024, 0})
+    ->Args({0, 16384, 0})
+    ->Args({0, 16384, 1})
+    ->Args({0, 16384, 2})
+    ->Args({0, 262144, 0})
+    ->Args({0, 262144, 1})
+    ->Args({0, 262144, 2});
+
+BENCHMARK_DEFINE_F(PagePoolBenchmark, ConcurrentStorePageHit)(
+    benchmark::State& state) {
+  FetchRandomPages(state);
+}
+
+BENCHMARK_REGISTER_F(PagePoolBenchmark, ConcurrentStorePageHit)
+    ->Args({1, 1024, 0})  // Multi-threaded pool, cached pages, allocation.
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(PagePoolBenchmark, ConcurrentStorePageMiss)(
+    benchmark::State& state) {
+  // The pool only caches a quarter of the pages, so most fetches miss. The
+  // other threads wait for the first thread before their loops start.
+  if (state.thread_index() == 0)
+    page_pool_->SetPageCapacity(page_count_ / 4);
+  FetchRandomPages(state);
+}
+
+BENCHMARK_REGISTER_F(PagePoolBenchmark, ConcurrentStorePageMiss)
+    ->Args({1, 16384, 0})  // Multi-threaded pool, store pages, allocation.
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+}  // namespace berrydb
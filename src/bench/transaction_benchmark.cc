@@ -0,0 +1,120 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "berrydb/options.h"
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/vfs.h"
+#include "../page_pool.h"
+#include "../pool_impl.h"
+#include "../store_impl.h"
+#include "../test/file_deleter.h"
+#include "../transaction_impl.h"
+
+namespace berrydb {
+
+class TransactionBenchmark : public benchmark::Fixture {
+ public:
+  TransactionBenchmark()
+      : vfs_(DefaultVfs()), data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) {}
+
+  void SetUp(const benchmark::State& state) override {
+    page_count_ = static_cast<size_t>(state.range(0));
+
+    // The pool caches all the pages that can be modified, in addition to the
+    // store's catalog pages.
+    PoolOptions options;
+    options.page_shift = kPageShift;
+    options.page_pool_size = page_count_ * kPageSpread + 16;
+    pool_ = PoolImpl::Create(options);
+
+    Status status = pool_->OpenStore(
+        data_file_deleter_.path(), StoreOptions(), &store_);
+    DCHECK_EQ(Status::kSuccess, status);
+    UNUSED(status);
+  }
+
+  void TearDown(const benchmark::State& state) override {
+    store_->Release();
+    pool_->Release();
+
+    // The store files are reused by the next benchmark run.
+    vfs_->RemoveFile(data_file_deleter_.path());
+    vfs_->RemoveFile(log_file_deleter_.path());
+    UNUSED(state);
+  }
+
+ protected:
+  const std::string kStoreFileName = "bench_transaction.berry";
+  static constexpr size_t kPageShift = 12;
+  // Page 0 is the store header, and page 1 is the root catalog.
+  static constexpr size_t kFirstPageId = 2;
+  /** Each transaction modifies 1 out of kPageSpread consecutive pages, on
+   * average. So, some of the modified pages are adjacent. */
+  static constexpr size_t kPageSpread = 2;
+
+  Vfs* vfs_;
+  // Must precede the store, because on Windows all file handles must be closed
+  // before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  PoolImpl* pool_;
+  StoreImpl* store_;
+  /** Number of pages modified by each transaction. */
+  size_t page_count_;
+};
+
+BENCHMARK_DEFINE_F(TransactionBenchmark, Commit)(benchmark::State& state) {
+  std::mt19937 rnd(42);
+  std::vector<size_t> page_ids(page_count_ * kPageSpread);
+  for (size_t i = 0; i < page_ids.size(); ++i)
+    page_ids[i] = kFirstPageId + i;
+
+  PagePool* page_pool = pool_->page_pool();
+  for (auto _ : state) {
+    // The pages are modified in random order.
+    std::shuffle(page_ids.begin(), page_ids.end(), rnd);
+    TransactionImpl* transaction = store_->CreateTransaction();
+    for (size_t i = 0; i < page_count_; ++i) {
+      Page* page;
+      Status status = page_pool->StorePage(
+          store_, page_ids[i], PagePool::kIgnorePageData, &page);
+      DCHECK_EQ(Status::kSuccess, status);
+      UNUSED(status);
+      transaction->WillModifyPage(page);
+      std::memset(page->data(), static_cast<int>(i), page_pool->page_size());
+      page_pool->UnpinStorePage(page);
+    }
+
+    // Only the commit is timed.
+    auto start = std::chrono::steady_clock::now();
+    Status status = transaction->Commit();
+    auto end = std::chrono::steady_clock::now();
+    transaction->Release();
+    if (status != Status::kSuccess) {
+      state.SkipWithError("TransactionImpl::Commit failed.");
+      break;
+    }
+    state.SetIterationTime(
+        std::chrono::duration_cast<std::chrono::duration<double>>(
+            end - start).count());
+  }
+  state.SetItemsProcessed(state.iterations() * page_count_);
+}
+
+// The argument is the number of pages modified by each transaction.
+BENCHMARK_REGISTER_F(TransactionBenchmark, Commit)
+    ->RangeMultiplier(10)->Range(10, 10000)->UseManualTime();
+
+}  // namespace berrydb
@@ -3,7 +3,9 @@
 // found in the LICENSE file.
 
 #include <cmath>
+#include <cstring>
 #include <random>
+#include <vector>
 
 #include "benchmark/benchmark.h"
 
@@ -17,9 +19,13 @@ namespace berrydb {
 
 class VfsBenchmark : public benchmark::Fixture {
  public:
-  VfsBenchmark() : vfs_(DefaultVfs()), deleter_(kFileName) {}
+  VfsBenchmark() : deleter_(kFileName) {}
 
   void SetUp(const benchmark::State& state) override {
+    // The last argument selects the VFS: 0 is the libc VFS and 1 is the POSIX
+    // VFS. vfs_ is null if the selected VFS is not available.
+    vfs_ = (state.range(kVfsArgument) == 0) ? BuiltinLibcVfs()
+                                             : BuiltinPosixVfs();
     block_size_ = state.range(0);
     block_shift_ = static_cast<size_t>(std::log2(block_size_));
     DCHECK_EQ(block_size_, static_cast<size_t>(1) << block_shift_);
@@ -35,6 +41,8 @@ class VfsBenchmark : public benchmark::Fixture {
 
  protected:
   const std::string kFileName = "bench_vfs.file";
+  /** Index of the benchmark argument that selects the VFS. */
+  static constexpr int kVfsArgument = 2;
 
   Vfs* vfs_;
   // Must precede UniquePtr members, because on Windows all file handles must be
@@ -49,11 +57,17 @@ class VfsBenchmark : public benchmark::Fixture {
 
 
 BENCHMARK_DEFINE_F(VfsBenchmark, RandomBlockWrites)(benchmark::State& state) {
+  if (vfs_ == nullptr) {
+    state.SkipWithError("VFS not available on this platform.");
+    return;
+  }
+
   UniquePtr<BlockAccessFile> file;
   BlockAccessFile* raw_file;
   size_t raw_file_size;
   Status status = vfs_->OpenForBlockAccess(
-      deleter_.path(), block_shift_, true, false, &raw_file, &raw_file_size);
+      deleter_.path(), block_shift_, true, false, false, &raw_file,
+      &raw_file_size);
   if (status != Status::kSuccess) {
     state.SkipWithError("Vfs::OpenForBlockAccess failed.");
     return;
@@ -94,9 +108,152 @@ BENCHMARK_DEFINE_F(VfsBenchmark, RandomBlockWrites)(benchmark::State& state) {
 BENCHMARK_REGISTER_F(
     VfsBenchmark, RandomBlockWrites)->RangeMultiplier(2)->Ranges(
     {{4096, 65536},  // Block size.
-    {1024, 1024}});  // Total number of blocks in the file.
+    {1024, 1024},  // Total number of blocks in the file.
+    {0, 1}});  // VFS.
+
+BENCHMARK_DEFINE_F(VfsBenchmark, RandomBlockReads)(benchmark::State& state) {
+  if (vfs_ == nullptr) {
+    state.SkipWithError("VFS not available on this platform.");
+    return;
+  }
+
+  UniquePtr<BlockAccessFile> file;
+  BlockAccessFile* raw_file;
+  size_t raw_file_size;
+  Status status = vfs_->OpenForBlockAccess(
+      deleter_.path(), block_shift_, true, false, false, &raw_file,
+      &raw_file_size);
+  if (status != Status::kSuccess) {
+    state.SkipWithError("Vfs::OpenForBlockAccess failed.");
+    return;
+  }
+  file.reset(raw_file);
+
+  size_t block_count = state.range(1);
+  for (size_t i = 0; i < block_count; ++i) {
+    status = file->Write(block_data_, i << block_shift_, block_size_);
+    if (status != Status::kSuccess) {
+      state.SkipWithError("BlockAccessFile::Write failed. (initial fill)");
+      return;
+    }
+  }
+
+  // The file is small enough to stay in the OS page cache, so this measures
+  // the VFS' per-call overhead.
+  for (auto _ : state) {
+    size_t block_number = rnd_() % block_count;
+
+    if (file->Read(block_number << block_shift_, block_size_, block_data_) !=
+        Status::kSuccess) {
+      state.SkipWithError("BlockAccessFile::Read failed.");
+      return;
+    }
+  }
+
+  state.SetBytesProcessed(state.iterations() << block_shift_);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(
+    VfsBenchmark, RandomBlockReads)->RangeMultiplier(2)->Ranges(
+    {{4096, 65536},  // Block size.
+    {1024, 1024},  // Total number of blocks in the file.
+    {0, 1}});  // VFS.
+
+BENCHMARK_DEFINE_F(VfsBenchmark, AsyncRandomBlockReads)(
+    benchmark::State& state) {
+  if (vfs_ == nullptr) {
+    state.SkipWithError("VFS not available on this platform.");
+    return;
+  }
+
+  // Direct I/O keeps the reads from being served by the OS page cache, so this
+  // measures how well the queue overlaps device accesses.
+  UniquePtr<BlockAccessFile> file;
+  BlockAccessFile* raw_file;
+  size_t raw_file_size;
+  Status status = vfs_->OpenForBlockAccess(
+      deleter_.path(), block_shift_, true, false, true, &raw_file,
+      &raw_file_size);
+  if (status != Status::kSuccess) {
+    state.SkipWithError("Vfs::OpenForBlockAccess failed.");
+    return;
+  }
+  file.reset(raw_file);
+
+  constexpr size_t kBlockCount = 1024;
+  size_t queue_depth = state.range(1);
+  size_t buffers_size = queue_depth << block_shift_;
+  uint8_t* buffers = reinterpret_cast<uint8_t*>(
+      AllocateAligned(buffers_size, block_size_, false));
+  std::memset(buffers, 0, buffers_size);
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    status = file->Write(buffers, i << block_shift_, block_size_);
+    if (status != Status::kSuccess) {
+      DeallocateAligned(buffers, buffers_size);
+      state.SkipWithError("BlockAccessFile::Write failed. (initial fill)");
+      return;
+    }
+  }
+
+  BlockIoQueue* queue;
+  if (file->CreateIoQueue(queue_depth, &queue) != Status::kSuccess) {
+    DeallocateAligned(buffers, buffers_size);
+    state.SkipWithError("BlockAccessFile::CreateIoQueue failed.");
+    return;
+  }
+
+  // Each buffer slot always has a read in progress. The slot index is the tag.
+  for (size_t i = 0; i < queue_depth; ++i) {
+    size_t block_number = rnd_() % kBlockCount;
+    queue->SubmitRead(
+        block_number << block_shift_, block_size_,
+        buffers + (i << block_shift_), reinterpret_cast<void*>(i));
+  }
+
+  std::vector<BlockIoCompletion> completions(queue_depth);
+  size_t read_count = 0;
+  for (auto _ : state) {
+    size_t completion_count;
+    if (queue->Poll(1, queue_depth, completions.data(), &completion_count) !=
+        Status::kSuccess) {
+      state.SkipWithError("BlockIoQueue::Poll failed.");
+      break;
+    }
+    read_count += completion_count;
+
+    for (size_t i = 0; i < completion_count; ++i) {
+      if (completions[i].status != Status::kSuccess) {
+        state.SkipWithError("BlockIoQueue read failed.");
+        break;
+      }
+      size_t slot = reinterpret_cast<size_t>(completions[i].tag);
+      size_t block_number = rnd_() % kBlockCount;
+      queue->SubmitRead(block_number << block_shift_, block_size_,
+                        buffers + (slot << block_shift_), completions[i].tag);
+    }
+  }
+
+  // Release() waits for the reads in progress, so the buffers can be freed.
+  queue->Release();
+  DeallocateAligned(buffers, buffers_size);
+
+  state.SetBytesProcessed(read_count << block_shift_);
+  state.SetItemsProcessed(read_count);
+}
+
+BENCHMARK_REGISTER_F(
+    VfsBenchmark, AsyncRandomBlockReads)->RangeMultiplier(4)->Ranges(
+    {{4096, 4096},  // Block size.
+    {1, 64},  // Queue depth.
+    {0, 1}});  // VFS.
 
 BENCHMARK_DEFINE_F(VfsBenchmark, LogWrites)(benchmark::State& state) {
+  if (vfs_ == nullptr) {
+    state.SkipWithError("VFS not available on this platform.");
+    return;
+  }
+
   UniquePtr<RandomAccessFile> file;
   RandomAccessFile* raw_file;
   size_t raw_file_size;
@@ -129,7 +286,10 @@ BENCHMARK_DEFINE_F(VfsBenchmark, LogWrites)(benchmark::State& state) {
   state.SetItemsProcessed(state.iterations());
 }
 
-BENCHMARK_REGISTER_F(VfsBenchmark, LogWrites)->RangeMultiplier(2)->Range(
-    4096, 65536);  // Log record size.
+// The unused argument keeps the VFS argument's index consistent.
+BENCHMARK_REGISTER_F(VfsBenchmark, LogWrites)->RangeMultiplier(2)->Ranges(
+    {{4096, 65536},  // Log record size.
+    {0, 0},  // Unused.
+    {0, 1}});  // VFS.
 
 }  // namespace berrydb
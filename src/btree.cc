@@ -0,0 +1,1076 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./btree.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "berrydb/status.h"
+#include "./format/btree_page_format.h"
+#include "./format/overflow_page_format.h"
+#include "./free_page_manager.h"
+#include "./overflow_chain.h"
+#include "./page.h"
+#include "./page_pool.h"
+#include "./store_impl.h"
+#include "./transaction_impl.h"
+
+namespace berrydb {
+
+constexpr size_t BTree::kMaxDepth;
+constexpr size_t BTree::kInvalidPageId;
+constexpr size_t BTree::kMaxBatchPages;
+
+static_assert(
+    BTree::kInvalidPageId == FreePageManager::kInvalidPageId,
+    "kInvalidPageId must be the same in BTree and FreePageManager");
+
+namespace {
+
+/** A key whose bytes are stored in two separate buffers.
+ *
+ * This is the natural representation of a key stored in a B+tree page, which
+ * consists of the page's common prefix followed by the cell's key suffix. */
+struct KeyPieces {
+  string_view head;
+  string_view tail;
+
+  inline size_t size() const noexcept { return head.size() + tail.size(); }
+
+  inline char operator[](size_t index) const noexcept {
+    DCHECK_LT(index, size());
+    return (index < head.size()) ? head[index] : tail[index - head.size()];
+  }
+
+  /** The key's first bytes. */
+  KeyPieces Prefix(size_t prefix_size) const noexcept {
+    DCHECK_LE(prefix_size, size());
+    KeyPieces prefix;
+    if (prefix_size <= head.size()) {
+      prefix.head = head.substr(0, prefix_size);
+    } else {
+      prefix.head = head;
+      prefix.tail = tail.substr(0, prefix_size - head.size());
+    }
+    return prefix;
+  }
+
+  /** Copies the key's bytes into a buffer.
+   *
+   * The buffer may overlap the key's tail, but not its head. */
+  void CopyTo(uint8_t* buffer) const noexcept {
+    if (tail.size() != 0)
+      std::memmove(buffer + head.size(), tail.data(), tail.size());
+    if (head.size() != 0)
+      std::memmove(buffer, head.data(), head.size());
+  }
+};
+
+/** The number of bytes at the beginning of two keys that are equal. */
+size_t CommonPrefixSize(const KeyPieces& key1, const KeyPieces& key2) noexcept {
+  size_t max_size = std::min(key1.size(), key2.size());
+  size_t size = 0;
+  while (size < max_size && key1[size] == key2[size])
+    ++size;
+  return size;
+}
+
+}  // namespace
+
+class BTree::NodeCells {
+ public:
+  /** Sets up the cells of a node for rebuilding.
+   *
+   * @param page_copy    a copy of the node's page, so the page itself can be
+   *                     rebuilt
+   * @param pending_slot the pending cell's position among the node's cells
+   * @param pending      the cell that must be added to the node
+   */
+  NodeCells(const uint8_t* page_copy, size_t pending_slot,
+            const PendingCell& pending) noexcept
+      : page_copy_(page_copy),
+        page_prefix_(BTreePageFormat::CommonPrefix(page_copy)),
+        page_count_(BTreePageFormat::CellCount(page_copy)),
+        pending_slot_(pending_slot), pending_(pending),
+        is_leaf_(BTreePageFormat::IsLeaf(page_copy)),
+        pending_has_page_prefix_(
+            BTreePageFormat::HasCommonPrefix(page_copy, pending.key)) {
+    DCHECK_LE(pending_slot, page_count_);
+  }
+
+  /** The number of cells, including the pending cell. */
+  inline size_t count() const noexcept { return page_count_ + 1; }
+
+  /** The full key of a cell. */
+  inline KeyPieces Key(size_t index) const noexcept {
+    KeyPieces key;
+    if (index == pending_slot_) {
+      key.head = pending_.key;
+    } else {
+      key.head = page_prefix_;
+      key.tail = BTreePageFormat::KeySuffix(page_copy_, PageSlot(index));
+    }
+    return key;
+  }
+
+  /** The child page ID stored in an inner node cell. */
+  inline uint64_t ChildId64(size_t index) const noexcept {
+    DCHECK(!is_leaf_);
+    if (index == pending_slot_)
+      return pending_.child_id64;
+    return BTreePageFormat::ChildId64(page_copy_, PageSlot(index));
+  }
+
+  /** Page bytes used by a range of cells, including their slots.
+   *
+   * @param  begin       the first cell in the range
+   * @param  end         the cell right after the range
+   * @param  prefix_size the size of the common prefix removed from the keys
+   * @return             the number of bytes needed after the page header
+   */
+  size_t PageBytes(size_t begin, size_t end,
+                   size_t prefix_size) const noexcept {
+    size_t bytes = BTreePageFormat::AlignCellSize(prefix_size);
+    for (size_t index = begin; index < end; ++index)
+      bytes += CellSize(index, prefix_size) + BTreePageFormat::kSlotSize;
+    return bytes;
+  }
+
+  /** The common prefix size that minimizes the bytes used by a cell range.
+   *
+   * Longer prefixes make cells smaller, but cells are aligned, so prefixes
+   * that are barely longer than the page's current prefix can use more bytes
+   * in pages with few cells. The current prefix, and no prefix at all, are
+   * always considered, so the result is never worse than either.
+   */
+  size_t BestPrefixSize(size_t begin, size_t end) const noexcept {
+    DCHECK_LT(begin, end);
+
+    // The keys are sorted, so the first and last keys have the shortest common
+    // prefix of any key pair in the range.
+    size_t shared_size = CommonPrefixSize(Key(begin), Key(end - 1));
+    size_t best_size = shared_size;
+    size_t best_bytes = PageBytes(begin, end, shared_size);
+    for (size_t prefix_size : {std::min(shared_size, page_prefix_.size()),
+                               static_cast<size_t>(0)}) {
+      if (prefix_size == best_size)
+        continue;
+      size_t bytes = PageBytes(begin, end, prefix_size);
+      if (bytes < best_bytes) {
+        best_size = prefix_size;
+        best_bytes = bytes;
+      }
+    }
+    return best_size;
+  }
+
+  /** The page bytes used by a range of cells, with the best common prefix. */
+  size_t BestPageBytes(size_t begin, size_t end) const noexcept {
+    return PageBytes(begin, end, BestPrefixSize(begin, end));
+  }
+
+  /** Writes a range of cells into an empty page.
+   *
+   * The caller must ensure that the cells fit, by calling BestPageBytes(). */
+  void Build(size_t begin, size_t end, uint8_t* page_data) const noexcept {
+    DCHECK_EQ(0U, BTreePageFormat::CellCount(page_data));
+
+    KeyPieces prefix = Key(begin).Prefix(BestPrefixSize(begin, end));
+    BTreePageFormat::SetCommonPrefix(page_data, prefix.head, prefix.tail);
+    for (size_t index = begin; index < end; ++index) {
+      bool appended;
+      if (index == pending_slot_) {
+        size_t slot = BTreePageFormat::CellCount(page_data);
+        if (is_leaf_) {
+          appended = BTreePageFormat::InsertLeafCell(
+              page_data, slot, pending_.key, pending_.value,
+              pending_.is_overflow);
+        } else {
+          appended = BTreePageFormat::InsertInnerCell(
+              page_data, slot, pending_.key, pending_.child_id64);
+        }
+      } else {
+        appended = BTreePageFormat::AppendCell(
+            page_copy_, PageSlot(index), page_data);
+      }
+      DCHECK(appended);
+      UNUSED(appended);
+    }
+  }
+
+  /** Picks the position where the cells are split between two nodes.
+   *
+   * Leaf cells before the returned index go into the left node, and the other
+   * cells go into the right node. The inner node cell at the returned index is
+   * not stored in either node. Its key becomes the separator, and its child
+   * becomes the right node's leftmost child.
+   */
+  size_t SplitIndex() const noexcept {
+    size_t count = this->count();
+
+    // When the pending key doesn't have the page's common prefix, it sorts
+    // before or after all the page's keys. It is placed in a node by itself,
+    // so the other node keeps the page's prefix, and is guaranteed to fit. This
+    // also makes sequential inserts fill up nodes.
+    if (!pending_has_page_prefix_) {
+      DCHECK(pending_slot_ == 0 || pending_slot_ == page_count_);
+      if (pending_slot_ == 0)
+        return 1;
+      return is_leaf_ ? count - 1 : count - 2;
+    }
+
+    // All the keys have the page's common prefix, so cell sizes are computed
+    // using that prefix. The nodes' prefixes will be at least as good.
+    size_t prefix_size = page_prefix_.size();
+    size_t total_bytes = PageBytes(0, count, prefix_size);
+    size_t best_index = 1;
+    size_t best_bytes = total_bytes;
+    size_t left_bytes = BTreePageFormat::AlignCellSize(prefix_size);
+    size_t last_index = is_leaf_ ? count - 1 : count - 2;
+    for (size_t index = 1; index <= last_index; ++index) {
+      left_bytes += CellSize(index - 1, prefix_size) +
+          BTreePageFormat::kSlotSize;
+      // Both nodes store a common prefix, but total_bytes only counts it once.
+      size_t right_bytes = total_bytes - left_bytes +
+          BTreePageFormat::AlignCellSize(prefix_size);
+      if (!is_leaf_) {
+        right_bytes -= CellSize(index, prefix_size) +
+            BTreePageFormat::kSlotSize;
+      }
+      size_t max_bytes = std::max(left_bytes, right_bytes);
+      if (max_bytes < best_bytes) {
+        best_index = index;
+        best_bytes = max_bytes;
+      }
+    }
+    return best_index;
+  }
+
+ private:
+  /** The heap bytes used by a cell, if its key loses a common prefix. */
+  size_t CellSize(size_t index, size_t prefix_size) const noexcept {
+    size_t key_size = Key(index).size() - prefix_size;
+    if (!is_leaf_)
+      return BTreePageFormat::InnerCellSize(key_size);
+
+    size_t value_size = (index == pending_slot_) ? pending_.value.size() :
+        BTreePageFormat::Value(page_copy_, PageSlot(index)).size();
+    return BTreePageFormat::LeafCellSize(key_size, value_size);
+  }
+
+  /** The slot in the page copy that holds a cell. */
+  inline size_t PageSlot(size_t index) const noexcept {
+    DCHECK_NE(index, pending_slot_);
+    return (index < pending_slot_) ? index : index - 1;
+  }
+
+  const uint8_t* const page_copy_;
+  const string_view page_prefix_;
+  const size_t page_count_;
+  const size_t pending_slot_;
+  const PendingCell& pending_;
+  const bool is_leaf_;
+  const bool pending_has_page_prefix_;
+};
+
+Status BTree::Create(TransactionImpl* transaction, size_t* root_page_id) {
+  DCHECK(transaction != nullptr);
+  DCHECK(root_page_id != nullptr);
+
+  BTree tree(transaction, kInvalidPageId);
+  Page* root;
+  Status status = tree.AllocNodePage(&root);
+  if (status != Status::kSuccess)
+    return status;
+
+  BTreePageFormat::InitLeaf(root->data(), tree.page_pool_->page_size());
+  *root_page_id = root->page_id();
+  tree.page_pool_->UnpinStorePage(root);
+  return Status::kSuccess;
+}
+
+BTree::BTree(TransactionImpl* transaction, size_t root_page_id) noexcept
+    : transaction_(transaction), store_(transaction->store()),
+      page_pool_(transaction->store()->page_pool()),
+      root_page_id_(root_page_id) {
+  DCHECK(transaction != nullptr);
+}
+
+Status BTree::Find(string_view key, Page** leaf, size_t* slot) {
+  DCHECK(leaf != nullptr);
+  DCHECK(slot != nullptr);
+
+  Path path;
+  Page* page;
+  Status status = FindLeaf(key, &path, &page, nullptr);
+  if (status != Status::kSuccess)
+    return status;
+
+  bool found;
+  size_t key_slot = BTreePageFormat::LowerBound(page->data(), key, &found);
+  if (!found) {
+    page_pool_->UnpinStorePage(page);
+    return Status::kNotFound;
+  }
+
+  *leaf = page;
+  *slot = key_slot;
+  return Status::kSuccess;
+}
+
+Status BTree::IsEmpty(bool* is_empty) {
+  DCHECK(is_empty != nullptr);
+
+  Page* root;
+  Status status = FetchNode(root_page_id_, &root);
+  if (status != Status::kSuccess)
+    return status;
+
+  const uint8_t* root_data = root->data();
+  *is_empty = BTreePageFormat::IsLeaf(root_data) &&
+      BTreePageFormat::CellCount(root_data) == 0;
+  page_pool_->UnpinStorePage(root);
+  return Status::kSuccess;
+}
+
+Status BTree::Put(string_view key, string_view value) {
+  if (!EntryFits(key, value))
+    return Status::kEntryTooLarge;
+
+  alignas(8) uint8_t reference[OverflowPageFormat::kReferenceSize];
+  bool is_overflow;
+  Status status = StoreLargeValue(key, &value, reference, &is_overflow);
+  if (status != Status::kSuccess)
+    return status;
+
+  Path path;
+  Page* leaf;
+  status = FindLeaf(key, &path, &leaf, nullptr);
+  if (status != Status::kSuccess)
+    return status;
+
+  uint8_t* leaf_data = leaf->data();
+  bool found;
+  size_t slot = BTreePageFormat::LowerBound(leaf_data, key, &found);
+  transaction_->WillModifyPage(leaf);
+  if (found) {
+    status = RemoveLeafCell(leaf_data, slot);
+    if (status != Status::kSuccess) {
+      page_pool_->UnpinStorePage(leaf);
+      return status;
+    }
+  }
+
+  PendingCell cell;
+  cell.key = key;
+  cell.value = value;
+  cell.is_overflow = is_overflow;
+  cell.child_id64 = kInvalidPageId;
+  return InsertCell(path, path.depth, leaf, slot, cell);
+}
+
+Status BTree::Delete(string_view key) {
+  Path path;
+  Page* leaf;
+  Status status = FindLeaf(key, &path, &leaf, nullptr);
+  if (status != Status::kSuccess)
+    return status;
+
+  uint8_t* leaf_data = leaf->data();
+  bool found;
+  size_t slot = BTreePageFormat::LowerBound(leaf_data, key, &found);
+  if (!found) {
+    page_pool_->UnpinStorePage(leaf);
+    return Status::kNotFound;
+  }
+
+  transaction_->WillModifyPage(leaf);
+  status = RemoveLeafCell(leaf_data, slot);
+  page_pool_->UnpinStorePage(leaf);
+  return status;
+}
+
+Status BTree::Apply(const Mutation* mutations, size_t count) {
+  DCHECK(mutations != nullptr || count == 0);
+
+  // The size checks are done upfront, so oversized entries are reported before
+  // the tree is modified.
+  for (size_t i = 0; i < count; ++i) {
+    DCHECK(i == 0 || mutations[i - 1].key <= mutations[i].key);
+    if (!mutations[i].is_delete &&
+        !EntryFits(mutations[i].key, mutations[i].value)) {
+      return Status::kEntryTooLarge;
+    }
+  }
+
+  Fence fence;
+  size_t next = 0;
+  while (next < count) {
+    Path path;
+    Page* leaf;
+    Status status = FindLeaf(mutations[next].key, &path, &leaf, &fence);
+    if (status != Status::kSuccess)
+      return status;
+
+    // All the mutations whose keys sort below the fence land on this leaf.
+    string_view fence_key(fence.key.data(), fence.key.size());
+    uint8_t* leaf_data = leaf->data();
+    bool will_modify_called = false;
+    bool leaf_consumed = false;
+    for (; next < count; ++next) {
+      const Mutation& mutation = mutations[next];
+      if (fence.is_set && !(mutation.key < fence_key))
+        break;
+
+      bool found;
+      size_t slot = BTreePageFormat::LowerBound(leaf_data, mutation.key,
+                                                &found);
+      if (!found && mutation.is_delete)
+        continue;
+      if (!will_modify_called) {
+        transaction_->WillModifyPage(leaf);
+        will_modify_called = true;
+      }
+      if (found) {
+        status = RemoveLeafCell(leaf_data, slot);
+        if (status != Status::kSuccess) {
+          page_pool_->UnpinStorePage(leaf);
+          return status;
+        }
+      }
+      if (mutation.is_delete)
+        continue;
+
+      PendingCell cell;
+      cell.key = mutation.key;
+      cell.value = mutation.value;
+      alignas(8) uint8_t reference[OverflowPageFormat::kReferenceSize];
+      status = StoreLargeValue(cell.key, &cell.value, reference,
+                               &cell.is_overflow);
+      if (status != Status::kSuccess) {
+        page_pool_->UnpinStorePage(leaf);
+        return status;
+      }
+      cell.child_id64 = kInvalidPageId;
+      if (BTreePageFormat::HasCommonPrefix(leaf_data, cell.key)) {
+        bool inserted;
+        status = InsertCellIfFits(leaf_data, slot, cell, &inserted);
+        if (status != Status::kSuccess) {
+          page_pool_->UnpinStorePage(leaf);
+          return status;
+        }
+        if (inserted)
+          continue;
+      }
+
+      // The leaf must be rebuilt or split. This changes the leaves' key
+      // ranges, so the next mutation starts a new descent.
+      ++next;
+      leaf_consumed = true;
+      status = RebuildNode(path, path.depth, leaf, slot, cell);
+      if (status != Status::kSuccess)
+        return status;
+      break;
+    }
+    if (!leaf_consumed)
+      page_pool_->UnpinStorePage(leaf);
+  }
+  return Status::kSuccess;
+}
+
+Status BTree::FindMany(Lookup* lookups, size_t count) {
+  DCHECK(lookups != nullptr || count == 0);
+
+  for (size_t i = 0; i < count; ++i) {
+    DCHECK(i == 0 || lookups[i - 1].key <= lookups[i].key);
+    lookups[i].leaf = nullptr;
+    lookups[i].status = Status::kNotFound;
+  }
+  if (count == 0)
+    return Status::kSuccess;
+
+  // The lookups are routed through the tree one level at a time. Sorted keys
+  // that fall in the same node form a contiguous run, so each node on a level
+  // is fetched exactly once.
+  LookupRunVector runs, child_runs;
+  LookupRun root_run;
+  root_run.page_id64 = root_page_id_;
+  root_run.begin = 0;
+  root_run.end = count;
+  runs.push_back(root_run);
+
+  Status status = Status::kSuccess;
+  for (size_t level = 0; level < kMaxDepth; ++level) {
+    child_runs.clear();
+    for (size_t batch_start = 0; batch_start < runs.size();
+         batch_start += kMaxBatchPages) {
+      size_t batch_size = std::min(kMaxBatchPages, runs.size() - batch_start);
+      size_t page_ids[kMaxBatchPages];
+      for (size_t i = 0; i < batch_size; ++i) {
+        uint64_t page_id64 = runs[batch_start + i].page_id64;
+        page_ids[i] = static_cast<size_t>(page_id64);
+        // This check should be optimized out on 64-bit architectures.
+        if (page_ids[i] != page_id64) {
+          status = Status::kDatabaseTooLarge;
+          break;
+        }
+        if (page_ids[i] == kInvalidPageId) {
+          status = Status::kDataCorrupted;
+          break;
+        }
+      }
+      if (status != Status::kSuccess)
+        break;
+
+      Page* pages[kMaxBatchPages];
+      status = page_pool_->StorePages(store_, page_ids, batch_size, pages);
+      if (status != Status::kSuccess)
+        break;
+
+      for (size_t i = 0; i < batch_size; ++i) {
+        if (status == Status::kSuccess &&
+            BTreePageFormat::IsCorruptPage(pages[i]->data(),
+                                           page_pool_->page_size())) {
+          status = Status::kDataCorrupted;
+        }
+        if (status == Status::kSuccess) {
+          RouteLookups(lookups, runs[batch_start + i], pages[i],
+                       &child_runs);
+        }
+        page_pool_->UnpinStorePage(pages[i]);
+      }
+      if (status != Status::kSuccess)
+        break;
+    }
+
+    if (status != Status::kSuccess)
+      break;
+    if (child_runs.empty())
+      return Status::kSuccess;
+    runs.swap(child_runs);
+  }
+
+  // Either a page could not be fetched, or the tree is deeper than any tree
+  // that could have been built by this code.
+  if (status == Status::kSuccess)
+    status = Status::kDataCorrupted;
+  for (size_t i = 0; i < count; ++i) {
+    if (lookups[i].leaf != nullptr) {
+      page_pool_->UnpinStorePage(lookups[i].leaf);
+      lookups[i].leaf = nullptr;
+    }
+  }
+  return status;
+}
+
+Status BTree::FindManyCached(Lookup* lookups, size_t count,
+                             PageIdVector* uncached_page_ids) {
+  DCHECK(lookups != nullptr || count == 0);
+  DCHECK(uncached_page_ids != nullptr);
+
+  for (size_t i = 0; i < count; ++i) {
+    DCHECK(i == 0 || lookups[i - 1].key <= lookups[i].key);
+    lookups[i].leaf = nullptr;
+    lookups[i].status = Status::kNotFound;
+  }
+  if (count == 0)
+    return Status::kSuccess;
+
+  // The lookups are routed one level at a time, like in FindMany(). Runs that
+  // reach a node which is not cached stop there.
+  LookupRunVector runs, child_runs;
+  LookupRun root_run;
+  root_run.page_id64 = root_page_id_;
+  root_run.begin = 0;
+  root_run.end = count;
+  runs.push_back(root_run);
+
+  Status status = Status::kSuccess;
+  for (size_t level = 0; level < kMaxDepth && !runs.empty(); ++level) {
+    child_runs.clear();
+    for (const LookupRun& run : runs) {
+      size_t page_id = static_cast<size_t>(run.page_id64);
+      // This check should be optimized out on 64-bit architectures.
+      if (page_id != run.page_id64 || page_id == kInvalidPageId) {
+        status = Status::kDataCorrupted;
+        break;
+      }
+
+      Page* page = page_pool_->PinCachedStorePage(store_, page_id);
+      if (page == nullptr) {
+        uncached_page_ids->push_back(page_id);
+        continue;
+      }
+      if (BTreePageFormat::IsCorruptPage(page->data(),
+                                         page_pool_->page_size())) {
+        status = Status::kDataCorrupted;
+      } else {
+        RouteLookups(lookups, run, page, &child_runs);
+      }
+      page_pool_->UnpinStorePage(page);
+      if (status != Status::kSuccess)
+        break;
+    }
+    if (status != Status::kSuccess)
+      break;
+    runs.swap(child_runs);
+  }
+  if (status == Status::kSuccess && runs.empty())
+    return Status::kSuccess;
+
+  // Either a node is corrupted, or the tree is deeper than any tree that could
+  // have been built by this code.
+  for (size_t i = 0; i < count; ++i) {
+    if (lookups[i].leaf != nullptr) {
+      page_pool_->UnpinStorePage(lookups[i].leaf);
+      lookups[i].leaf = nullptr;
+    }
+  }
+  return Status::kDataCorrupted;
+}
+
+void BTree::RouteLookups(Lookup* lookups, const LookupRun& run, Page* page,
+                         LookupRunVector* child_runs) {
+  const uint8_t* page_data = page->data();
+  if (BTreePageFormat::IsLeaf(page_data)) {
+    for (size_t i = run.begin; i < run.end; ++i) {
+      bool found;
+      size_t slot = BTreePageFormat::LowerBound(page_data, lookups[i].key,
+                                                &found);
+      if (!found)
+        continue;
+      // Each lookup that found its key owns a pin on the leaf.
+      page_pool_->PinStorePage(page);
+      lookups[i].leaf = page;
+      lookups[i].slot = slot;
+      lookups[i].status = Status::kSuccess;
+    }
+    return;
+  }
+
+  size_t run_child_slot = 0;
+  for (size_t i = run.begin; i < run.end; ++i) {
+    size_t child_slot = BTreePageFormat::UpperBound(page_data, lookups[i].key);
+    if (i != run.begin && child_slot == run_child_slot) {
+      child_runs->back().end = i + 1;
+      continue;
+    }
+
+    LookupRun child_run;
+    child_run.page_id64 = (child_slot == 0) ?
+        BTreePageFormat::LeftmostChildId64(page_data) :
+        BTreePageFormat::ChildId64(page_data, child_slot - 1);
+    child_run.begin = i;
+    child_run.end = i + 1;
+    child_runs->push_back(child_run);
+    run_child_slot = child_slot;
+  }
+}
+
+Status BTree::FindLowerBound(string_view key, Page** leaf, size_t* slot) {
+  DCHECK(leaf != nullptr);
+  DCHECK(slot != nullptr);
+
+  Path path;
+  Status status = FindLeaf(key, &path, leaf, nullptr);
+  if (status != Status::kSuccess)
+    return status;
+
+  bool found;
+  *slot = BTreePageFormat::LowerBound((*leaf)->data(), key, &found);
+  return Status::kSuccess;
+}
+
+Status BTree::FindLastLeaf(Page** leaf) {
+  DCHECK(leaf != nullptr);
+
+  uint64_t page_id64 = root_page_id_;
+  for (size_t level = 0; level < kMaxDepth; ++level) {
+    Page* page;
+    Status status = FetchNode(page_id64, &page);
+    if (status != Status::kSuccess)
+      return status;
+
+    const uint8_t* page_data = page->data();
+    if (BTreePageFormat::IsLeaf(page_data)) {
+      *leaf = page;
+      return Status::kSuccess;
+    }
+
+    size_t cell_count = BTreePageFormat::CellCount(page_data);
+    page_id64 = (cell_count == 0) ?
+        BTreePageFormat::LeftmostChildId64(page_data) :
+        BTreePageFormat::ChildId64(page_data, cell_count - 1);
+    page_pool_->UnpinStorePage(page);
+  }
+
+  // The tree is deeper than any tree that could have been built by this code.
+  return Status::kDataCorrupted;
+}
+
+Status BTree::FetchLeaf(uint64_t page_id64, Page** leaf) {
+  DCHECK(leaf != nullptr);
+
+  Status status = FetchNode(page_id64, leaf);
+  if (status != Status::kSuccess)
+    return status;
+
+  if (!BTreePageFormat::IsLeaf((*leaf)->data())) {
+    page_pool_->UnpinStorePage(*leaf);
+    return Status::kDataCorrupted;
+  }
+  return Status::kSuccess;
+}
+
+Status BTree::FindLeaf(string_view key, Path* path, Page** leaf,
+                       Fence* fence) {
+  DCHECK(path != nullptr);
+  DCHECK(leaf != nullptr);
+
+  if (fence != nullptr)
+    fence->is_set = false;
+
+  uint64_t page_id64 = root_page_id_;
+  for (size_t level = 0; level < kMaxDepth; ++level) {
+    Page* page;
+    Status status = FetchNode(page_id64, &page);
+    if (status != Status::kSuccess)
+      return status;
+
+    const uint8_t* page_data = page->data();
+    path->page_ids[level] = page->page_id();
+    if (BTreePageFormat::IsLeaf(page_data)) {
+      path->depth = level;
+      *leaf = page;
+      return Status::kSuccess;
+    }
+
+    size_t child_slot = BTreePageFormat::UpperBound(page_data, key);
+    page_id64 = (child_slot == 0) ?
+        BTreePageFormat::LeftmostChildId64(page_data) :
+        BTreePageFormat::ChildId64(page_data, child_slot - 1);
+    // Deeper separators are tighter bounds, so they replace the ones found
+    // higher up in the tree.
+    if (fence != nullptr &&
+        child_slot < BTreePageFormat::CellCount(page_data)) {
+      string_view prefix = BTreePageFormat::CommonPrefix(page_data);
+      string_view suffix = BTreePageFormat::KeySuffix(page_data, child_slot);
+      fence->is_set = true;
+      fence->key.assign(prefix.begin(), prefix.end());
+      fence->key.insert(fence->key.end(), suffix.begin(), suffix.end());
+    }
+    page_pool_->UnpinStorePage(page);
+  }
+
+  // The tree is deeper than any tree that could have been built by this code.
+  return Status::kDataCorrupted;
+}
+
+bool BTree::EntryFits(string_view key, string_view value) const noexcept {
+  // Values of any size can be moved to overflow pages, so only the key's size
+  // is limited.
+  UNUSED(value);
+  size_t max_cell_size = BTreePageFormat::MaxCellSize(page_pool_->page_size());
+  return BTreePageFormat::LeafCellSize(
+             key.size(), OverflowPageFormat::kReferenceSize) <=
+             max_cell_size &&
+         BTreePageFormat::InnerCellSize(key.size()) <= max_cell_size;
+}
+
+bool BTree::ValueFitsInLeaf(string_view key,
+                            string_view value) const noexcept {
+  size_t max_cell_size = BTreePageFormat::MaxCellSize(page_pool_->page_size());
+  return BTreePageFormat::LeafCellSize(key.size(), value.size()) <=
+      max_cell_size;
+}
+
+Status BTree::StoreLargeValue(string_view key, string_view* value,
+                              uint8_t* reference, bool* is_overflow) {
+  DCHECK(value != nullptr);
+  DCHECK(reference != nullptr);
+  DCHECK(is_overflow != nullptr);
+
+  *is_overflow = !ValueFitsInLeaf(key, *value);
+  if (!*is_overflow)
+    return Status::kSuccess;
+
+  Status status = OverflowChain::Write(transaction_, *value, reference);
+  if (status != Status::kSuccess)
+    return status;
+  *value = string_view(reinterpret_cast<const char*>(reference),
+                       OverflowPageFormat::kReferenceSize);
+  return Status::kSuccess;
+}
+
+Status BTree::RemoveLeafCell(uint8_t* leaf_data, size_t slot) {
+  DCHECK(leaf_data != nullptr);
+
+  if (BTreePageFormat::IsOverflowValue(leaf_data, slot)) {
+    // The reference is read from the cell, so the chain is freed first.
+    Status status = OverflowChain::Free(
+        transaction_, BTreePageFormat::Value(leaf_data, slot));
+    if (status != Status::kSuccess)
+      return status;
+  }
+  BTreePageFormat::RemoveCell(leaf_data, slot);
+  return Status::kSuccess;
+}
+
+Status BTree::FetchNode(uint64_t page_id64, Page** page) {
+  DCHECK(page != nullptr);
+
+  size_t page_id = static_cast<size_t>(page_id64);
+  // This check should be optimized out on 64-bit architectures.
+  if (page_id != page_id64)
+    return Status::kDatabaseTooLarge;
+  if (page_id == kInvalidPageId)
+    return Status::kDataCorrupted;
+
+  Status status = page_pool_->StorePage(
+      store_, page_id, PagePool::kFetchPageData, page);
+  if (status != Status::kSuccess)
+    return status;
+
+  if (BTreePageFormat::IsCorruptPage((*page)->data(),
+                                     page_pool_->page_size())) {
+    page_pool_->UnpinStorePage(*page);
+    return Status::kDataCorrupted;
+  }
+  return Status::kSuccess;
+}
+
+Status BTree::InsertCell(const Path& path, size_t level, Page* page,
+                         size_t slot, const PendingCell& cell) {
+  DCHECK_LE(level, path.depth);
+  DCHECK_EQ(path.page_ids[level], page->page_id());
+
+  uint8_t* page_data = page->data();
+  if (BTreePageFormat::HasCommonPrefix(page_data, cell.key)) {
+    bool inserted;
+    Status status = InsertCellIfFits(page_data, slot, cell, &inserted);
+    if (status != Status::kSuccess || inserted) {
+      page_pool_->UnpinStorePage(page);
+      return status;
+    }
+  }
+  return RebuildNode(path, level, page, slot, cell);
+}
+
+Status BTree::RebuildNode(const Path& path, size_t level, Page* page,
+                          size_t slot, const PendingCell& cell) {
+  Page* scratch = page_pool_->AllocPage();
+  if (scratch == nullptr) {
+    page_pool_->UnpinStorePage(page);
+    return Status::kPoolFull;
+  }
+
+  size_t page_size = page_pool_->page_size();
+  size_t capacity = page_size - BTreePageFormat::kFirstSlotOffset;
+  uint8_t* page_data = page->data();
+  uint8_t* scratch_data = scratch->data();
+  std::memcpy(scratch_data, page_data, page_size);
+
+  NodeCells cells(scratch_data, slot, cell);
+  size_t count = cells.count();
+  bool is_leaf = BTreePageFormat::IsLeaf(scratch_data);
+
+  // Rebuilding the node with a different common prefix may free up enough
+  // space for the new cell.
+  if (cells.BestPageBytes(0, count) <= capacity) {
+    if (is_leaf) {
+      BTreePageFormat::InitLeaf(page_data, page_size);
+      BTreePageFormat::SetNextLeafId64(
+          BTreePageFormat::NextLeafId64(scratch_data), page_data);
+      BTreePageFormat::SetPrevLeafId64(
+          BTreePageFormat::PrevLeafId64(scratch_data), page_data);
+    } else {
+      BTreePageFormat::InitInner(
+          page_data, page_size,
+          BTreePageFormat::LeftmostChildId64(scratch_data));
+    }
+    cells.Build(0, count, page_data);
+    page_pool_->UnpinUnassignedPage(scratch);
+    page_pool_->UnpinStorePage(page);
+    return Status::kSuccess;
+  }
+
+  size_t split_index = cells.SplitIndex();
+  size_t right_begin = is_leaf ? split_index : split_index + 1;
+  DCHECK_LE(cells.BestPageBytes(0, split_index), capacity);
+  DCHECK_LE(cells.BestPageBytes(right_begin, count), capacity);
+
+  // The root page ID must not change, so the root's cells are moved into two
+  // new pages, and the root becomes their parent. Other nodes keep their left
+  // half, so their parent's pointer remains valid.
+  Page* left = page;
+  Page* right;
+  Status status = AllocNodePage(&right);
+  if (status == Status::kSuccess && level == 0) {
+    status = AllocNodePage(&left);
+    if (status != Status::kSuccess)
+      page_pool_->UnpinStorePage(right);
+  }
+  if (status != Status::kSuccess) {
+    page_pool_->UnpinUnassignedPage(scratch);
+    page_pool_->UnpinStorePage(page);
+    return status;
+  }
+
+  uint8_t* left_data = left->data();
+  uint8_t* right_data = right->data();
+  if (is_leaf) {
+    uint64_t next_id64 = BTreePageFormat::NextLeafId64(scratch_data);
+    BTreePageFormat::InitLeaf(left_data, page_size);
+    BTreePageFormat::SetPrevLeafId64(
+        BTreePageFormat::PrevLeafId64(scratch_data), left_data);
+    BTreePageFormat::SetNextLeafId64(right->page_id(), left_data);
+    BTreePageFormat::InitLeaf(right_data, page_size);
+    BTreePageFormat::SetPrevLeafId64(left->page_id(), right_data);
+    BTreePageFormat::SetNextLeafId64(next_id64, right_data);
+
+    if (next_id64 != kInvalidPageId) {
+      size_t next_id = static_cast<size_t>(next_id64);
+      Page* next;
+      // This check should be optimized out on 64-bit architectures.
+      if (next_id != next_id64) {
+        status = Status::kDatabaseTooLarge;
+      } else {
+        status = page_pool_->StorePage(
+            store_, next_id, PagePool::kFetchPageData, &next);
+      }
+      if (status != Status::kSuccess) {
+        page_pool_->UnpinStorePage(right);
+        if (left != page)
+          page_pool_->UnpinStorePage(left);
+        page_pool_->UnpinUnassignedPage(scratch);
+        page_pool_->UnpinStorePage(page);
+        return status;
+      }
+      transaction_->WillModifyPage(next);
+      BTreePageFormat::SetPrevLeafId64(right->page_id(), next->data());
+      page_pool_->UnpinStorePage(next);
+    }
+  } else {
+    BTreePageFormat::InitInner(
+        left_data, page_size, BTreePageFormat::LeftmostChildId64(scratch_data));
+    BTreePageFormat::InitInner(
+        right_data, page_size, cells.ChildId64(split_index));
+  }
+  cells.Build(0, split_index, left_data);
+  cells.Build(right_begin, count, right_data);
+
+  // Leaf separators only need to tell the two halves apart, so they are
+  // truncated right after the first byte where the halves' boundary keys
+  // differ. Inner node separators must be kept intact, because they also
+  // separate the keys in the nodes below.
+  KeyPieces separator_key = cells.Key(split_index);
+  if (is_leaf) {
+    separator_key = separator_key.Prefix(
+        CommonPrefixSize(cells.Key(split_index - 1), separator_key) + 1);
+  }
+  // The page copy is no longer needed, so it holds the separator. The copy's
+  // common prefix is stored at the end of the page, so it doesn't overlap the
+  // separator, which is at most a quarter of a page.
+  separator_key.CopyTo(scratch_data);
+  string_view separator(reinterpret_cast<const char*>(scratch_data),
+                        separator_key.size());
+
+  size_t right_id = right->page_id();
+  page_pool_->UnpinStorePage(right);
+
+  if (level == 0) {
+    BTreePageFormat::InitInner(page_data, page_size, left->page_id());
+    page_pool_->UnpinStorePage(left);
+
+    // The new root is empty, so the separator is guaranteed to fit.
+    bool inserted = BTreePageFormat::InsertInnerCell(
+        page_data, 0, separator, right_id);
+    DCHECK(inserted);
+    UNUSED(inserted);
+    page_pool_->UnpinUnassignedPage(scratch);
+    page_pool_->UnpinStorePage(page);
+    return Status::kSuccess;
+  }
+  page_pool_->UnpinStorePage(page);
+
+  Page* parent;
+  status = page_pool_->StorePage(
+      store_, path.page_ids[level - 1], PagePool::kFetchPageData, &parent);
+  if (status != Status::kSuccess) {
+    page_pool_->UnpinUnassignedPage(scratch);
+    return status;
+  }
+  transaction_->WillModifyPage(parent);
+
+  PendingCell parent_cell;
+  parent_cell.key = separator;
+  parent_cell.is_overflow = false;
+  parent_cell.child_id64 = right_id;
+  size_t parent_slot = BTreePageFormat::UpperBound(parent->data(), separator);
+  status = InsertCell(path, level - 1, parent, parent_slot, parent_cell);
+  page_pool_->UnpinUnassignedPage(scratch);
+  return status;
+}
+
+Status BTree::AllocNodePage(Page** page) {
+  size_t page_id;
+  Status status = store_->free_page_manager()->AllocPage(
+      transaction_, &page_id);
+  if (status != Status::kSuccess)
+    return status;
+
+  status = page_pool_->StorePage(
+      store_, page_id, PagePool::kIgnorePageData, page);
+  if (status != Status::kSuccess)
+    return status;
+
+  transaction_->WillModifyPage(*page);
+  return Status::kSuccess;
+}
+
+Status BTree::InsertCellIfFits(uint8_t* page_data, size_t slot,
+                               const PendingCell& cell, bool* inserted) {
+  DCHECK(inserted != nullptr);
+
+  bool is_leaf = BTreePageFormat::IsLeaf(page_data);
+  if (is_leaf) {
+    *inserted = BTreePageFormat::InsertLeafCell(
+        page_data, slot, cell.key, cell.value, cell.is_overflow);
+  } else {
+    *inserted = BTreePageFormat::InsertInnerCell(
+        page_data, slot, cell.key, cell.child_id64);
+  }
+  if (*inserted)
+    return Status::kSuccess;
+
+  size_t key_size = cell.key.size() -
+      BTreePageFormat::CommonPrefixSize(page_data);
+  size_t cell_size = is_leaf ?
+      BTreePageFormat::LeafCellSize(key_size, cell.value.size()) :
+      BTreePageFormat::InnerCellSize(key_size);
+  if (BTreePageFormat::FreeBytes(page_data) +
+      BTreePageFormat::FragmentedBytes(page_data) <
+      cell_size + BTreePageFormat::kSlotSize) {
+    return Status::kSuccess;
+  }
+
+  Page* scratch = page_pool_->AllocPage();
+  if (scratch == nullptr)
+    return Status::kPoolFull;
+  BTreePageFormat::Compact(page_data, page_pool_->page_size(), scratch->data());
+  page_pool_->UnpinUnassignedPage(scratch);
+
+  if (is_leaf) {
+    *inserted = BTreePageFormat::InsertLeafCell(
+        page_data, slot, cell.key, cell.value, cell.is_overflow);
+  } else {
+    *inserted = BTreePageFormat::InsertInnerCell(
+        page_data, slot, cell.key, cell.child_id64);
+  }
+  DCHECK(*inserted);
+  return Status::kSuccess;
+}
+
+}  // namespace berrydb
@@ -0,0 +1,394 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_BTREE_H_
+#define BERRYDB_BTREE_H_
+
+#include <vector>
+
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/string_view.h"
+#include "./util/platform_allocator.h"
+
+namespace berrydb {
+
+class Page;
+class PagePool;
+class StoreImpl;
+class TransactionImpl;
+
+/** B+tree that stores the key-value pairs in a Space.
+ *
+ * Values are stored in leaf pages, next to their keys. Values that are too
+ * large for a leaf are stored in chains of overflow pages, and their leaf cells
+ * hold references to the chains. Inner node pages only hold separator keys and
+ * child page IDs. Leaves are chained in a doubly linked
+ * list, so they can be visited in key order without going through the inner
+ * nodes. The page layout is described in BTreePageFormat.
+ *
+ * A tree is identified by its root page, whose ID never changes, so it can be
+ * recorded once in the Space's catalog entry. When the root overflows, its
+ * content is split into two newly allocated pages. The root page becomes an
+ * inner node whose children are the two split halves.
+ *
+ * Keys are compressed in two ways, to increase the tree's fanout. Each page
+ * stores its keys' common prefix once, so the cells only hold key suffixes.
+ * When a leaf is split, the separator key that goes into the parent node is
+ * truncated to the shortest prefix of the right half's first key that sorts
+ * after the left half's last key.
+ *
+ * Nodes are not merged or rebalanced when their keys are deleted. Leaves that
+ * become empty remain in the tree until their key range is reused.
+ *
+ * BTree instances are lightweight, and are intended to be created on the stack
+ * for each operation. Operations that modify the tree leave it in an undefined
+ * state if they fail, so the transaction must be rolled back in that case.
+ */
+class BTree {
+ public:
+  /** Trees deeper than this are considered corrupted.
+   *
+   * Each node holds at least 4 cells, so this bound is never reached in
+   * practice. It protects against cycles in corrupted trees. */
+  static constexpr size_t kMaxDepth = 32;
+
+  /** Page ID that's guaranteed to be invalid for tree pages.
+   *
+   * The first page in a store file holds the store's header, so it can never
+   * be allocated to a tree. This value is used to terminate the leaf chain. */
+  static constexpr size_t kInvalidPageId = 0;
+
+  /** Maximum number of pages fetched together by FindMany().
+   *
+   * All the pages in a batch are pinned at the same time, so the batch must be
+   * much smaller than the page pool. */
+  static constexpr size_t kMaxBatchPages = 16;
+
+  /** A key looked up by FindMany(), together with the lookup's result. */
+  struct Lookup {
+    /** The key to look up. Set by the caller. */
+    string_view key;
+    /** The leaf page holding the key. nullptr if the key was not found. */
+    Page* leaf;
+    /** The key's slot in the leaf. Only meaningful if the key was found. */
+    size_t slot;
+    /** kSuccess if the key was found, kNotFound otherwise. */
+    Status status;
+  };
+
+  /** Sets up the pages of an empty tree.
+   *
+   * @param  transaction  the transaction that allocates the tree's pages
+   * @param  root_page_id receives the ID of the new tree's root page
+   * @return              most likely kSuccess or kIoError
+   */
+  static Status Create(TransactionImpl* transaction, size_t* root_page_id);
+
+  /** Sets up operations on an existing tree.
+   *
+   * @param transaction  the transaction used to read and modify the tree
+   * @param root_page_id the ID of the tree's root page
+   */
+  BTree(TransactionImpl* transaction, size_t root_page_id) noexcept;
+
+  /** Finds the leaf cell that holds a key.
+   *
+   * If the call succeeds, the caller owns a pin on the leaf page, and must
+   * remove it by calling PagePool::UnpinStorePage() after reading the cell.
+   *
+   * @param  key  the key to look up
+   * @param  leaf if the call succeeds, receives the leaf page holding the key
+   * @param  slot if the call succeeds, receives the key's slot in the leaf
+   * @return      kNotFound if the tree does not contain the key; otherwise,
+   *              most likely kSuccess or kIoError
+   */
+  Status Find(string_view key, Page** leaf, size_t* slot);
+
+  /** A key-value pair creation, update or removal applied by Apply(). */
+  struct Mutation {
+    string_view key;
+    /** Ignored for deletions. */
+    string_view value;
+    bool is_delete;
+  };
+
+  /** Applies many mutations to the tree.
+   *
+   * Consecutive mutations that land on the same leaf are applied while the
+   * leaf is pinned, and the leaf is only set up for modification once, so a
+   * sorted batch costs roughly one descent per modified leaf. Mutations that
+   * require splitting a leaf fall back to the path taken by Put().
+   *
+   * @param  mutations the mutations to apply; must be sorted by key; mutations
+   *                   of the same key are applied in the given order
+   * @param  count     the number of mutations
+   * @return           kEntryTooLarge if a key does not fit in a page, in
+   *                   which case the tree is not modified; otherwise,
+   *                   most likely kSuccess or kIoError; deleting a missing key
+   *                   does not fail the call
+   */
+  Status Apply(const Mutation* mutations, size_t count);
+
+  /** Finds the leaf cells that hold many keys.
+   *
+   * The lookups share the tree descents. Each tree node is fetched at most
+   * once, and the nodes on each tree level are fetched in batches, so the reads
+   * of the pages that are not cached can be coalesced.
+   *
+   * If the call succeeds, the caller owns a pin on the leaf page of every
+   * lookup that found its key. If the call fails, the caller does not own any
+   * pin, and the lookup results are undefined.
+   *
+   * @param  lookups the keys to look up; must be sorted by key
+   * @param  count   the number of lookups
+   * @return         most likely kSuccess or kIoError; a missing key is reported
+   *                 in its lookup's status, and does not fail the call
+   */
+  Status FindMany(Lookup* lookups, size_t count);
+
+  using PageIdVector = std::vector<size_t, PlatformAllocator<size_t>>;
+
+  /** Finds the leaf cells that hold many keys, without reading tree nodes.
+   *
+   * This is FindMany() for hints, which should not issue reads. Only the tree
+   * nodes that are already in the page pool are used. The IDs of the other
+   * nodes on the lookups' paths are collected, and the lookups routed through
+   * them are reported as not found. Prefetching the collected nodes lets later
+   * calls descend further.
+   *
+   * The caller owns pins like it would after a FindMany() call.
+   *
+   * @param  lookups           the keys to look up; must be sorted by key
+   * @param  count             the number of lookups
+   * @param  uncached_page_ids receives the IDs of the tree nodes that are on
+   *                           the lookups' paths, and are not in the pool
+   * @return                   kDataCorrupted if a node fails sanity checks;
+   *                           otherwise, kSuccess */
+  Status FindManyCached(Lookup* lookups, size_t count,
+                        PageIdVector* uncached_page_ids);
+
+  /** Finds the position of the first key that is greater than or equal to a
+   * given key.
+   *
+   * The returned slot may be past the leaf's last cell, which means that the
+   * position's key is in the next leaf, if one exists. If the call succeeds,
+   * the caller owns a pin on the leaf page.
+   *
+   * @param  key  the key to look up
+   * @param  leaf if the call succeeds, receives the leaf page for the key
+   * @param  slot if the call succeeds, receives a slot in [0, CellCount()]
+   * @return      most likely kSuccess or kIoError
+   */
+  Status FindLowerBound(string_view key, Page** leaf, size_t* slot);
+
+  /** Finds the leaf at the end of the leaf chain.
+   *
+   * If the call succeeds, the caller owns a pin on the leaf page. */
+  Status FindLastLeaf(Page** leaf);
+
+  /** Fetches a leaf page whose ID was read from another tree page.
+   *
+   * This is intended for walking the leaf chain. If the call succeeds, the
+   * caller owns a pin on the leaf page.
+   *
+   * @param  page_id64 a page ID read from a leaf's sibling link
+   * @param  leaf      if the call succeeds, receives the leaf page
+   * @return           kDataCorrupted if the page is not a valid leaf;
+   *                   otherwise, most likely kSuccess or kIoError
+   */
+  Status FetchLeaf(uint64_t page_id64, Page** leaf);
+
+  /** Checks whether the tree has never held more keys than its root can fit.
+   *
+   * @param  is_empty if the call succeeds, set to true if the tree's root is a
+   *                  leaf without any cells; trees whose keys were all deleted
+   *                  after the root was split are not considered empty
+   * @return          most likely kSuccess or kIoError
+   */
+  Status IsEmpty(bool* is_empty);
+
+  /** Checks that a key-value pair is small enough to be stored in the tree.
+   *
+   * Large values are stored in overflow pages, so only the key's size matters.
+   */
+  bool EntryFits(string_view key, string_view value) const noexcept;
+
+  /** Checks that a key-value pair can be stored in a leaf cell.
+   *
+   * The values of the pairs that don't pass this check are stored in overflow
+   * pages. */
+  bool ValueFitsInLeaf(string_view key, string_view value) const noexcept;
+
+  /** Creates or updates a key-value pair.
+   *
+   * @return kEntryTooLarge if the key does not fit in a page; otherwise, most
+   *         likely kSuccess or kIoError
+   */
+  Status Put(string_view key, string_view value);
+
+  /** Removes a key-value pair.
+   *
+   * @return kNotFound if the tree does not contain the key; otherwise, most
+   *         likely kSuccess or kIoError
+   */
+  Status Delete(string_view key);
+
+ private:
+  /** The page IDs of the nodes visited while looking up a key.
+   *
+   * page_ids[0] is the root, and page_ids[depth] is the leaf. */
+  struct Path {
+    size_t depth;
+    size_t page_ids[kMaxDepth];
+  };
+
+  /** The smallest key that sorts after all the keys in a leaf's key range.
+   *
+   * The leaf's parent nodes store the key as a separator. The key is copied
+   * out, because the nodes are unpinned while the leaf is being used. */
+  struct Fence {
+    /** False for the last leaf, whose key range is unbounded. */
+    bool is_set;
+    std::vector<char, PlatformAllocator<char>> key;
+  };
+
+  /** Lookups that are routed through the same tree node by FindMany().
+   *
+   * lookups[begin] to lookups[end - 1] all belong to the node's key range. */
+  struct LookupRun {
+    uint64_t page_id64;
+    size_t begin;
+    size_t end;
+  };
+  using LookupRunVector =
+      std::vector<LookupRun, PlatformAllocator<LookupRun>>;
+
+  /** A cell that is waiting to be inserted into a node.
+   *
+   * Leaf cells use key, value and is_overflow, inner node cells use key and
+   * child_id64. */
+  struct PendingCell {
+    string_view key;
+    string_view value;
+    /** True if the value is a reference to overflow pages. */
+    bool is_overflow;
+    uint64_t child_id64;
+  };
+
+  /** The cells of a node that is being rebuilt, including a pending cell. */
+  class NodeCells;
+
+  /** Descends from the root to the leaf that should hold a key.
+   *
+   * If the call succeeds, the caller owns a pin on the returned leaf.
+   *
+   * @param  key   the key to look up
+   * @param  path  receives the nodes visited during the descent
+   * @param  leaf  if the call succeeds, receives the leaf for the key
+   * @param  fence if not nullptr, receives the upper bound of the leaf's key
+   *               range
+   * @return       most likely kSuccess or kIoError
+   */
+  Status FindLeaf(string_view key, Path* path, Page** leaf, Fence* fence);
+
+
+  /** Routes the lookups in a run through one fetched tree node.
+   *
+   * Leaves resolve the run's lookups. Inner nodes append the runs for the next
+   * tree level to child_runs. This method does not consume the caller's pin on
+   * the node's page.
+   */
+  void RouteLookups(Lookup* lookups, const LookupRun& run, Page* page,
+                    LookupRunVector* child_runs);
+
+  /** Fetches a tree node page whose ID was read from another tree page.
+   *
+   * If the call succeeds, the caller owns a pin on the returned page.
+   *
+   * @return kDataCorrupted if the page ID is invalid or if the page fails
+   *         sanity checks; otherwise, most likely kSuccess or kIoError
+   */
+  Status FetchNode(uint64_t page_id64, Page** page);
+
+  /** Inserts a cell into a node, rebuilding or splitting the node if needed.
+   *
+   * The caller must have called WillModifyPage() on the node's page. This
+   * method consumes the caller's pin on the page.
+   *
+   * @param  path  the nodes visited while looking up the cell's key
+   * @param  level the node's position in the path
+   * @param  page  the page holding the node
+   * @param  slot  the cell's position in the node
+   * @param  cell  the cell to be inserted
+   * @return       most likely kSuccess or kIoError
+   */
+  Status InsertCell(const Path& path, size_t level, Page* page, size_t slot,
+                    const PendingCell& cell);
+
+  /** Rebuilds a node that cannot hold a new cell as it is.
+   *
+   * The node's cells and the new cell are written into the node's page, with a
+   * shorter common prefix, if they fit. Otherwise, the node is split, and a
+   * separator key is inserted into its parent node.
+   *
+   * The arguments match InsertCell(), and this method also consumes the
+   * caller's pin on the page.
+   */
+  Status RebuildNode(const Path& path, size_t level, Page* page, size_t slot,
+                     const PendingCell& cell);
+
+  /** Moves a value that does not fit in a leaf cell to overflow pages.
+   *
+   * @param  key         the value's key
+   * @param  value       the value to be stored; if the value is moved, this is
+   *                     replaced by the reference to its overflow pages
+   * @param  reference   buffer of OverflowPageFormat::kReferenceSize bytes that
+   *                     holds the reference, if the value is moved
+   * @param  is_overflow set to true if the value was moved
+   * @return             most likely kSuccess or kIoError
+   */
+  Status StoreLargeValue(string_view key, string_view* value,
+                         uint8_t* reference, bool* is_overflow);
+
+  /** Removes a leaf cell, freeing the overflow pages of its value.
+   *
+   * @param  leaf_data the leaf's page data; the caller must have called
+   *                   WillModifyPage() on the leaf's page
+   * @param  slot      the cell's position in the leaf
+   * @return           most likely kSuccess or kIoError; if the call fails, the
+   *                   cell is not removed
+   */
+  Status RemoveLeafCell(uint8_t* leaf_data, size_t slot);
+
+  /** Allocates a page for a new tree node.
+   *
+   * If the call succeeds, the caller owns a pin on the page, which is set up
+   * for modification by this tree's transaction. */
+  Status AllocNodePage(Page** page);
+
+  /** Inserts a cell into a node, compacting the node's page if necessary.
+   *
+   * @param  page_data the node's page data; must be set up for modification
+   * @param  slot      the cell's position in the node
+   * @param  cell      the cell to be inserted
+   * @param  inserted  set to false if the node does not have enough space
+   * @return           most likely kSuccess; kPoolFull if compaction failed
+   */
+  Status InsertCellIfFits(uint8_t* page_data, size_t slot,
+                          const PendingCell& cell, bool* inserted);
+
+  /** The transaction used for all the tree's page accesses. */
+  TransactionImpl* const transaction_;
+  /** The store that holds this tree's pages. */
+  StoreImpl* const store_;
+  /** The page pool used by the tree's store. */
+  PagePool* const page_pool_;
+  /** The tree's root page. */
+  const size_t root_page_id_;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_BTREE_H_
@@ -0,0 +1,430 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./btree.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/options.h"
+#include "berrydb/status.h"
+#include "./format/btree_page_format.h"
+#include "./overflow_chain.h"
+#include "./page_pool.h"
+#include "./pool_impl.h"
+#include "./store_impl.h"
+#include "./test/file_deleter.h"
+#include "./transaction_impl.h"
+#include "./util/unique_ptr.h"
+
+// TODO(pwnall): Remove this once we don't need to print a Status value.
+#include "berrydb/ostream_ops.h"
+
+namespace berrydb {
+
+namespace {
+
+string_view ToStringView(const std::string& string) {
+  return string_view(string.data(), string.size());
+}
+
+}  // namespace
+
+class BTreeTest : public ::testing::Test {
+ protected:
+  BTreeTest()
+      : data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) { }
+
+  void SetUp() override {
+    PoolOptions options;
+    options.page_shift = kStorePageShift;
+    options.page_pool_size = 64;
+    pool_.reset(PoolImpl::Create(options));
+
+    StoreImpl* raw_store;
+    ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+        kStoreFileName, StoreOptions(), &raw_store));
+    store_.reset(raw_store);
+  }
+
+  /** Reads a key's value into a string. */
+  Status Get(BTree* tree, const std::string& key, std::string* value) {
+    Page* leaf;
+    size_t slot;
+    Status status = tree->Find(ToStringView(key), &leaf, &slot);
+    if (status != Status::kSuccess)
+      return status;
+
+    string_view leaf_value = BTreePageFormat::Value(leaf->data(), slot);
+    if (!BTreePageFormat::IsOverflowValue(leaf->data(), slot)) {
+      value->assign(leaf_value.data(), leaf_value.size());
+      store_->page_pool()->UnpinStorePage(leaf);
+      return Status::kSuccess;
+    }
+
+    // Reading a chain does not modify any page, so any transaction works.
+    OverflowChain chain(store_->init_transaction(), leaf_value);
+    store_->page_pool()->UnpinStorePage(leaf);
+    value->resize(chain.value_size64());
+    return chain.ReadAll(reinterpret_cast<uint8_t*>(&(*value)[0]));
+  }
+
+  /** Collects the keys in a tree by walking the leaf chain.
+   *
+   * Also checks that the leaves' previous page IDs match the chain. */
+  void ReadLeafChain(size_t root_page_id, std::vector<std::string>* keys) {
+    PagePool* page_pool = store_->page_pool();
+
+    size_t page_id = root_page_id;
+    while (true) {
+      Page* page;
+      ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+          store_.get(), page_id, PagePool::kFetchPageData, &page));
+      bool is_leaf = BTreePageFormat::IsLeaf(page->data());
+      if (!is_leaf) {
+        page_id = static_cast<size_t>(
+            BTreePageFormat::LeftmostChildId64(page->data()));
+      }
+      page_pool->UnpinStorePage(page);
+      if (is_leaf)
+        break;
+    }
+
+    size_t prev_page_id = BTree::kInvalidPageId;
+    while (page_id != BTree::kInvalidPageId) {
+      Page* page;
+      ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+          store_.get(), page_id, PagePool::kFetchPageData, &page));
+      const uint8_t* page_data = page->data();
+      ASSERT_TRUE(BTreePageFormat::IsLeaf(page_data));
+      EXPECT_EQ(prev_page_id, BTreePageFormat::PrevLeafId64(page_data));
+
+      size_t cell_count = BTreePageFormat::CellCount(page_data);
+      for (size_t slot = 0; slot < cell_count; ++slot)
+        keys->push_back(PageKey(page_data, slot));
+
+      prev_page_id = page_id;
+      page_id = static_cast<size_t>(BTreePageFormat::NextLeafId64(page_data));
+      page_pool->UnpinStorePage(page);
+    }
+  }
+
+  /** The full key stored in a page cell. */
+  std::string PageKey(const uint8_t* page_data, size_t slot) {
+    string_view prefix = BTreePageFormat::CommonPrefix(page_data);
+    string_view suffix = BTreePageFormat::KeySuffix(page_data, slot);
+    std::string key(prefix.data(), prefix.size());
+    key.append(suffix.data(), suffix.size());
+    return key;
+  }
+
+  std::string RandomString(size_t min_size, size_t max_size) {
+    std::uniform_int_distribution<size_t> size_distribution(
+        min_size, max_size);
+    std::uniform_int_distribution<int> byte_distribution(0, 255);
+    std::string result(size_distribution(rnd_), '\0');
+    for (char& c : result)
+      c = static_cast<char>(byte_distribution(rnd_));
+    return result;
+  }
+
+  const std::string kStoreFileName = "test_btree.berry";
+  static constexpr size_t kStorePageShift = 9;  // 512-byte pages
+
+  // Must precede UniquePtr members, because on Windows all file handles must be
+  // closed before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  UniquePtr<PoolImpl> pool_;
+  UniquePtr<StoreImpl> store_;
+  std::mt19937 rnd_;
+};
+
+constexpr size_t BTreeTest::kStorePageShift;
+
+TEST_F(BTreeTest, EmptyTree) {
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  size_t root_page_id;
+  ASSERT_EQ(Status::kSuccess, BTree::Create(transaction.get(), &root_page_id));
+  EXPECT_NE(BTree::kInvalidPageId, root_page_id);
+
+  BTree tree(transaction.get(), root_page_id);
+  std::string value;
+  EXPECT_EQ(Status::kNotFound, Get(&tree, "key", &value));
+  EXPECT_EQ(Status::kNotFound, tree.Delete("key"));
+
+  std::vector<std::string> keys;
+  ReadLeafChain(root_page_id, &keys);
+  EXPECT_TRUE(keys.empty());
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(BTreeTest, PutGetDelete) {
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  size_t root_page_id;
+  ASSERT_EQ(Status::kSuccess, BTree::Create(transaction.get(), &root_page_id));
+  BTree tree(transaction.get(), root_page_id);
+
+  ASSERT_EQ(Status::kSuccess, tree.Put("key", "value"));
+  std::string value;
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "key", &value));
+  EXPECT_EQ("value", value);
+  EXPECT_EQ(Status::kNotFound, Get(&tree, "ke", &value));
+  EXPECT_EQ(Status::kNotFound, Get(&tree, "key2", &value));
+
+  ASSERT_EQ(Status::kSuccess, tree.Put("key", "longer value"));
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "key", &value));
+  EXPECT_EQ("longer value", value);
+
+  ASSERT_EQ(Status::kSuccess, tree.Put("", ""));
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "", &value));
+  EXPECT_EQ("", value);
+
+  ASSERT_EQ(Status::kSuccess, tree.Delete("key"));
+  EXPECT_EQ(Status::kNotFound, Get(&tree, "key", &value));
+  EXPECT_EQ(Status::kNotFound, tree.Delete("key"));
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "", &value));
+
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(BTreeTest, EntryTooLarge) {
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  size_t root_page_id;
+  ASSERT_EQ(Status::kSuccess, BTree::Create(transaction.get(), &root_page_id));
+  BTree tree(transaction.get(), root_page_id);
+
+  size_t max_cell_size = BTreePageFormat::MaxCellSize(1 << kStorePageShift);
+  size_t max_entry_size = max_cell_size - BTreePageFormat::kCellKeyOffset;
+  std::string key(8, 'k');
+  std::string value(max_entry_size - key.size(), 'v');
+  EXPECT_TRUE(tree.ValueFitsInLeaf(ToStringView(key), ToStringView(value)));
+  EXPECT_EQ(Status::kSuccess,
+            tree.Put(ToStringView(key), ToStringView(value)));
+
+  // Keys must also fit in inner node cells.
+  std::string large_key(max_entry_size, 'k');
+  EXPECT_EQ(Status::kEntryTooLarge, tree.Put(ToStringView(large_key), ""));
+
+  std::string stored_value;
+  ASSERT_EQ(Status::kSuccess, Get(&tree, key, &stored_value));
+  EXPECT_EQ(max_entry_size - key.size(), stored_value.size());
+}
+
+TEST_F(BTreeTest, LargeValues) {
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  size_t root_page_id;
+  ASSERT_EQ(Status::kSuccess, BTree::Create(transaction.get(), &root_page_id));
+  BTree tree(transaction.get(), root_page_id);
+
+  size_t max_cell_size = BTreePageFormat::MaxCellSize(1 << kStorePageShift);
+  size_t max_entry_size = max_cell_size - BTreePageFormat::kCellKeyOffset;
+  std::string key(8, 'k');
+  std::string value(max_entry_size - key.size() + 1, 'v');
+  EXPECT_FALSE(tree.ValueFitsInLeaf(ToStringView(key), ToStringView(value)));
+  EXPECT_TRUE(tree.EntryFits(ToStringView(key), ToStringView(value)));
+
+  // Values larger than the pool span many overflow pages.
+  std::string huge_value;
+  for (size_t i = 0; i < (200U << kStorePageShift); ++i)
+    huge_value.push_back(static_cast<char>('a' + i % 26));
+
+  ASSERT_EQ(Status::kSuccess,
+            tree.Put(ToStringView(key), ToStringView(value)));
+  ASSERT_EQ(Status::kSuccess, tree.Put("huge", ToStringView(huge_value)));
+  ASSERT_EQ(Status::kSuccess, tree.Put("small", "value"));
+
+  Page* leaf;
+  size_t slot;
+  ASSERT_EQ(Status::kSuccess, tree.Find(ToStringView(key), &leaf, &slot));
+  EXPECT_TRUE(BTreePageFormat::IsOverflowValue(leaf->data(), slot));
+  store_->page_pool()->UnpinStorePage(leaf);
+
+  std::string stored_value;
+  ASSERT_EQ(Status::kSuccess, Get(&tree, key, &stored_value));
+  EXPECT_EQ(value, stored_value);
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "huge", &stored_value));
+  EXPECT_EQ(huge_value, stored_value);
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "small", &stored_value));
+  EXPECT_EQ("value", stored_value);
+
+  // Large values can replace small values, and the other way around.
+  ASSERT_EQ(Status::kSuccess, tree.Put("small", ToStringView(value)));
+  ASSERT_EQ(Status::kSuccess, tree.Put("huge", "tiny"));
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "small", &stored_value));
+  EXPECT_EQ(value, stored_value);
+  ASSERT_EQ(Status::kSuccess, Get(&tree, "huge", &stored_value));
+  EXPECT_EQ("tiny", stored_value);
+
+  ASSERT_EQ(Status::kSuccess, tree.Delete(ToStringView(key)));
+  EXPECT_EQ(Status::kNotFound, Get(&tree, key, &stored_value));
+}
+
+TEST_F(BTreeTest, SequentialInserts) {
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  size_t ascending_root_id, descending_root_id;
+  ASSERT_EQ(Status::kSuccess, BTree::Create(
+      transaction.get(), &ascending_root_id));
+  ASSERT_EQ(Status::kSuccess, BTree::Create(
+      transaction.get(), &descending_root_id));
+  BTree ascending(transaction.get(), ascending_root_id);
+  BTree descending(transaction.get(), descending_root_id);
+
+  constexpr int kKeyCount = 2000;
+  std::vector<std::string> expected_keys;
+  for (int i = 0; i < kKeyCount; ++i) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "key%06d", i);
+    expected_keys.push_back(key);
+  }
+  for (int i = 0; i < kKeyCount; ++i) {
+    string_view ascending_key = ToStringView(expected_keys[i]);
+    ASSERT_EQ(Status::kSuccess, ascending.Put(ascending_key, ascending_key));
+    string_view descending_key = ToStringView(expected_keys[kKeyCount - 1 - i]);
+    ASSERT_EQ(Status::kSuccess, descending.Put(descending_key, descending_key));
+  }
+
+  for (const std::string& key : expected_keys) {
+    std::string value;
+    ASSERT_EQ(Status::kSuccess, Get(&ascending, key, &value));
+    EXPECT_EQ(key, value);
+    ASSERT_EQ(Status::kSuccess, Get(&descending, key, &value));
+    EXPECT_EQ(key, value);
+  }
+
+  std::vector<std::string> keys;
+  ReadLeafChain(ascending_root_id, &keys);
+  EXPECT_EQ(expected_keys, keys);
+  keys.clear();
+  ReadLeafChain(descending_root_id, &keys);
+  EXPECT_EQ(expected_keys, keys);
+
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+}
+
+TEST_F(BTreeTest, LongSharedPrefixes) {
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  size_t root_page_id;
+  ASSERT_EQ(Status::kSuccess, BTree::Create(transaction.get(), &root_page_id));
+  BTree tree(transaction.get(), root_page_id);
+
+  constexpr int kKeyCount = 1500;
+  std::vector<std::string> expected_keys;
+  for (int i = 0; i < kKeyCount; ++i) {
+    char key[64];
+    std::snprintf(key, sizeof(key), "tenant%04d/entity%08d/attribute%04d",
+                  i / 500, i / 10, i);
+    expected_keys.push_back(key);
+  }
+  std::vector<std::string> shuffled_keys = expected_keys;
+  std::shuffle(shuffled_keys.begin(), shuffled_keys.end(), rnd_);
+  for (const std::string& key : shuffled_keys)
+    ASSERT_EQ(Status::kSuccess, tree.Put(ToStringView(key), "v"));
+
+  for (const std::string& key : expected_keys) {
+    std::string value;
+    ASSERT_EQ(Status::kSuccess, Get(&tree, key, &value));
+    EXPECT_EQ("v", value);
+  }
+  std::vector<std::string> keys;
+  ReadLeafChain(root_page_id, &keys);
+  EXPECT_EQ(expected_keys, keys);
+
+  // The keys differ in their last bytes, so the separators copied from the
+  // leaves are much shorter than the keys, and the leaves elide the keys'
+  // shared bytes.
+  PagePool* page_pool = store_->page_pool();
+  Page* root;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store_.get(), root_page_id, PagePool::kFetchPageData, &root));
+  const uint8_t* root_data = root->data();
+  ASSERT_FALSE(BTreePageFormat::IsLeaf(root_data));
+  size_t root_cell_count = BTreePageFormat::CellCount(root_data);
+  ASSERT_LT(0U, root_cell_count);
+  for (size_t slot = 0; slot < root_cell_count; ++slot)
+    EXPECT_GT(expected_keys[0].size(), PageKey(root_data, slot).size());
+
+  size_t leaf_id = static_cast<size_t>(
+      BTreePageFormat::LeftmostChildId64(root_data));
+  page_pool->UnpinStorePage(root);
+  while (true) {
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store_.get(), leaf_id, PagePool::kFetchPageData, &page));
+    const uint8_t* page_data = page->data();
+    bool is_leaf = BTreePageFormat::IsLeaf(page_data);
+    if (is_leaf) {
+      EXPECT_LE(string_view("tenant0000/entity0000").size(),
+                BTreePageFormat::CommonPrefixSize(page_data));
+    } else {
+      leaf_id = static_cast<size_t>(
+          BTreePageFormat::LeftmostChildId64(page_data));
+    }
+    page_pool->UnpinStorePage(page);
+    if (is_leaf)
+      break;
+  }
+
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+}
+
+TEST_F(BTreeTest, RandomOperations) {
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  size_t root_page_id;
+  ASSERT_EQ(Status::kSuccess, BTree::Create(transaction.get(), &root_page_id));
+  BTree tree(transaction.get(), root_page_id);
+
+  std::map<std::string, std::string> expected;
+  for (int i = 0; i < 3000; ++i) {
+    std::string key = RandomString(0, 24);
+    std::string value = RandomString(0, 60);
+    ASSERT_EQ(Status::kSuccess,
+              tree.Put(ToStringView(key), ToStringView(value)));
+    expected[key] = value;
+
+    if (i % 3 == 0) {
+      auto it = expected.lower_bound(RandomString(1, 1));
+      if (it != expected.end()) {
+        ASSERT_EQ(Status::kSuccess, tree.Delete(ToStringView(it->first)));
+        expected.erase(it);
+      }
+    }
+  }
+
+  for (const auto& it : expected) {
+    std::string value;
+    ASSERT_EQ(Status::kSuccess, Get(&tree, it.first, &value));
+    EXPECT_EQ(it.second, value);
+  }
+
+  std::vector<std::string> keys;
+  ReadLeafChain(root_page_id, &keys);
+  std::vector<std::string> expected_keys;
+  for (const auto& it : expected)
+    expected_keys.push_back(it.first);
+  EXPECT_EQ(expected_keys, keys);
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+
+  // The data must survive the commit, and eviction from the page pool.
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+  UniquePtr<TransactionImpl> transaction2(store_->CreateTransaction());
+  BTree tree2(transaction2.get(), root_page_id);
+  for (const auto& it : expected) {
+    std::string value;
+    ASSERT_EQ(Status::kSuccess, Get(&tree2, it.first, &value));
+    EXPECT_EQ(it.second, value);
+  }
+  ASSERT_EQ(Status::kSuccess, transaction2->Commit());
+}
+
+}  // namespace berrydb
@@ -0,0 +1,408 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./bulk_loader_impl.h"
+
+#include <algorithm>
+
+#include "berrydb/options.h"
+#include "berrydb/status.h"
+#include "./btree.h"
+#include "./format/btree_page_format.h"
+#include "./format/overflow_page_format.h"
+#include "./free_page_manager.h"
+#include "./overflow_chain.h"
+#include "./page.h"
+#include "./page_pool.h"
+#include "./store_impl.h"
+#include "./transaction_impl.h"
+
+namespace berrydb {
+
+static_assert(std::is_standard_layout<BulkLoaderImpl>::value,
+    "BulkLoaderImpl must be a standard layout type so its public API can be "
+    "exposed cheaply");
+
+namespace {
+
+/** The number of bytes written to the store by each run buffer flush. */
+constexpr size_t kRunBytes = 1 << 20;
+
+/** The number of bytes at the beginning of two keys that are equal. */
+size_t CommonPrefixSize(string_view key1, string_view key2) noexcept {
+  size_t max_size = std::min(key1.size(), key2.size());
+  size_t size = 0;
+  while (size < max_size && key1[size] == key2[size])
+    ++size;
+  return size;
+}
+
+/** The fill factor, restricted to values that produce valid trees. */
+double ClampFillFactor(double fill_factor) noexcept {
+  return std::min(std::max(fill_factor, 0.5), 1.0);
+}
+
+}  // namespace
+
+BulkLoaderImpl* BulkLoaderImpl::Create(TransactionImpl* transaction,
+                                       size_t root_page_id,
+                                       const BulkLoaderOptions& options) {
+  void* heap_block = Allocate(sizeof(BulkLoaderImpl));
+  BulkLoaderImpl* loader = new (heap_block) BulkLoaderImpl(
+      transaction, root_page_id, options);
+  DCHECK_EQ(heap_block, static_cast<void*>(loader));
+  return loader;
+}
+
+BulkLoaderImpl::BulkLoaderImpl(TransactionImpl* transaction,
+                               size_t root_page_id,
+                               const BulkLoaderOptions& options)
+    : api_(), transaction_(transaction), store_(transaction->store()),
+      page_pool_(transaction->store()->page_pool()),
+      root_page_id_(root_page_id),
+      page_size_(page_pool_->page_size()),
+      page_capacity_(page_size_ - BTreePageFormat::kFirstSlotOffset),
+      fill_bytes_(static_cast<size_t>(
+          page_capacity_ * ClampFillFactor(options.fill_factor))),
+      run_page_count_(std::max(
+          kRunBytes >> page_pool_->page_shift(), static_cast<size_t>(1))),
+      // The run is written straight from this buffer, so it is aligned for
+      // direct I/O.
+      run_buffer_(reinterpret_cast<uint8_t*>(AllocateAligned(
+          run_page_count_ * page_size_, page_size_, false))) {
+  DCHECK(transaction != nullptr);
+}
+
+BulkLoaderImpl::~BulkLoaderImpl() {
+  DeallocateAligned(run_buffer_, run_page_count_ * page_size_);
+}
+
+void BulkLoaderImpl::Release() {
+  this->~BulkLoaderImpl();
+  void* heap_block = static_cast<void*>(this);
+  Deallocate(heap_block, sizeof(BulkLoaderImpl));
+}
+
+Status BulkLoaderImpl::Add(string_view key, string_view value) {
+  DCHECK(!is_finished_);
+  if (transaction_->IsClosed())
+    return Status::kAlreadyClosed;
+
+  BTree tree(transaction_, root_page_id_);
+  if (!tree.EntryFits(key, value))
+    return Status::kEntryTooLarge;
+
+  if (!leaf_entries_.empty()) {
+    if (!(LeafKey(leaf_entries_.back()) < key))
+      return Status::kInvalidArgument;
+  } else if (leaf_count_ != 0) {
+    string_view last_key(last_leaf_key_.data(), last_leaf_key_.size());
+    if (!(last_key < key))
+      return Status::kInvalidArgument;
+  }
+
+  // Values that do not fit in a leaf are written out right away. The leaf only
+  // stores the reference to their overflow pages.
+  alignas(8) uint8_t reference[OverflowPageFormat::kReferenceSize];
+  bool is_overflow = !tree.ValueFitsInLeaf(key, value);
+  if (is_overflow) {
+    Status status = OverflowChain::Write(transaction_, value, reference);
+    if (status != Status::kSuccess)
+      return status;
+    value = string_view(reinterpret_cast<char*>(reference), sizeof(reference));
+  }
+
+  if (!leaf_entries_.empty()) {
+    // The keys are sorted, so the first key and the new key have the shortest
+    // common prefix of any key pair in the leaf.
+    size_t prefix_size = std::min(
+        leaf_prefix_size_, CommonPrefixSize(LeafKey(leaf_entries_[0]), key));
+    size_t bytes = (prefix_size == leaf_prefix_size_) ?
+        leaf_bytes_ : LeafBytes(prefix_size);
+    bytes += BTreePageFormat::LeafCellSize(key.size() - prefix_size,
+                                           value.size()) +
+        BTreePageFormat::kSlotSize;
+    if (bytes <= fill_bytes_) {
+      leaf_prefix_size_ = prefix_size;
+      leaf_bytes_ = bytes;
+    } else {
+      Status status = FlushLeaf();
+      if (status != Status::kSuccess)
+        return status;
+    }
+  }
+
+  if (leaf_entries_.empty()) {
+    // A leaf's only key is also the leaf's common prefix.
+    leaf_prefix_size_ = key.size();
+    leaf_bytes_ = BTreePageFormat::AlignCellSize(key.size()) +
+        BTreePageFormat::LeafCellSize(0, value.size()) +
+        BTreePageFormat::kSlotSize;
+  }
+
+  LeafEntry entry;
+  entry.offset = leaf_data_.size();
+  entry.key_size = key.size();
+  entry.value_size = value.size();
+  entry.is_overflow = is_overflow;
+  leaf_data_.insert(leaf_data_.end(), key.begin(), key.end());
+  leaf_data_.insert(leaf_data_.end(), value.begin(), value.end());
+  leaf_entries_.push_back(entry);
+  return Status::kSuccess;
+}
+
+Status BulkLoaderImpl::Finish() {
+  DCHECK(!is_finished_);
+  if (transaction_->IsClosed())
+    return Status::kAlreadyClosed;
+  is_finished_ = true;
+
+  // Small loads fit in the root page, so no other pages are needed.
+  if (leaf_count_ == 0)
+    return WriteRoot(nullptr);
+
+  Status status = FlushLeaf();
+  if (status != Status::kSuccess)
+    return status;
+  // The last leaf does not have a next sibling.
+  last_leaf_data_ = nullptr;
+
+  ChildVector children, parents;
+  children.swap(leaves_);
+  while (InnerNodeEnd(children, 0, page_capacity_) != children.size()) {
+    parents.clear();
+    status = BuildInnerLevel(children, &parents);
+    if (status != Status::kSuccess)
+      return status;
+    children.swap(parents);
+  }
+
+  status = FlushRun();
+  if (status != Status::kSuccess)
+    return status;
+  status = store_->free_page_manager()->TrimPageRun(
+      transaction_, run_first_page_id_, run_page_count_,
+      run_used_page_count_);
+  if (status != Status::kSuccess)
+    return status;
+  return WriteRoot(&children);
+}
+
+size_t BulkLoaderImpl::LeafBytes(size_t prefix_size) const noexcept {
+  size_t bytes = BTreePageFormat::AlignCellSize(prefix_size);
+  for (const LeafEntry& entry : leaf_entries_) {
+    bytes += BTreePageFormat::LeafCellSize(entry.key_size - prefix_size,
+                                           entry.value_size) +
+        BTreePageFormat::kSlotSize;
+  }
+  return bytes;
+}
+
+void BulkLoaderImpl::BuildLeaf(uint8_t* page_data) const noexcept {
+  BTreePageFormat::InitLeaf(page_data, page_size_);
+  if (leaf_entries_.empty())
+    return;
+
+  string_view first_key = LeafKey(leaf_entries_[0]);
+  BTreePageFormat::SetCommonPrefix(
+      page_data, first_key.substr(0, leaf_prefix_size_), string_view());
+  for (size_t i = 0; i < leaf_entries_.size(); ++i) {
+    const LeafEntry& entry = leaf_entries_[i];
+    string_view value(leaf_data_.data() + entry.offset + entry.key_size,
+                      entry.value_size);
+    bool inserted = BTreePageFormat::InsertLeafCell(
+        page_data, i, LeafKey(entry), value, entry.is_overflow);
+    DCHECK(inserted);
+    UNUSED(inserted);
+  }
+}
+
+Status BulkLoaderImpl::FlushLeaf() {
+  DCHECK(!leaf_entries_.empty());
+
+  size_t page_id;
+  uint8_t* page_data;
+  Status status = ReservePage(&page_id, &page_data);
+  if (status != Status::kSuccess)
+    return status;
+
+  BuildLeaf(page_data);
+  BTreePageFormat::SetPrevLeafId64(last_leaf_id_, page_data);
+
+  Child leaf;
+  leaf.page_id64 = page_id;
+  leaf.separator_offset = separators_.size();
+  leaf.separator_size = 0;
+  string_view first_key = LeafKey(leaf_entries_[0]);
+  if (leaf_count_ != 0) {
+    // Same as in leaf splits, the separator is the shortest prefix of the
+    // leaf's first key that sorts after the previous leaf's last key.
+    string_view last_key(last_leaf_key_.data(), last_leaf_key_.size());
+    leaf.separator_size = CommonPrefixSize(last_key, first_key) + 1;
+    DCHECK_LE(leaf.separator_size, first_key.size());
+    separators_.insert(separators_.end(), first_key.begin(),
+                       first_key.begin() + leaf.separator_size);
+  }
+  leaves_.push_back(leaf);
+
+  string_view last_key = LeafKey(leaf_entries_.back());
+  last_leaf_key_.assign(last_key.begin(), last_key.end());
+  last_leaf_id_ = page_id;
+  last_leaf_data_ = page_data;
+  ++leaf_count_;
+
+  leaf_data_.clear();
+  leaf_entries_.clear();
+  return Status::kSuccess;
+}
+
+size_t BulkLoaderImpl::InnerNodeEnd(const ChildVector& children, size_t begin,
+                                    size_t max_bytes) const noexcept {
+  DCHECK_LT(begin, children.size());
+
+  // The node's leftmost child does not need a cell, so the node's cells start
+  // with the second child.
+  size_t end = begin + 1;
+  size_t prefix_size = 0;
+  size_t bytes = 0;
+  for (; end < children.size(); ++end) {
+    string_view key = Separator(children[end]);
+    size_t new_prefix_size, new_bytes;
+    if (end == begin + 1) {
+      new_prefix_size = key.size();
+      new_bytes = BTreePageFormat::AlignCellSize(new_prefix_size);
+    } else {
+      new_prefix_size = std::min(
+          prefix_size,
+          CommonPrefixSize(Separator(children[begin + 1]), key));
+      if (new_prefix_size == prefix_size) {
+        new_bytes = bytes;
+      } else {
+        new_bytes = BTreePageFormat::AlignCellSize(new_prefix_size);
+        for (size_t i = begin + 1; i < end; ++i) {
+          new_bytes += BTreePageFormat::InnerCellSize(
+              children[i].separator_size - new_prefix_size) +
+              BTreePageFormat::kSlotSize;
+        }
+      }
+    }
+    new_bytes += BTreePageFormat::InnerCellSize(key.size() - new_prefix_size) +
+        BTreePageFormat::kSlotSize;
+    if (new_bytes > max_bytes)
+      break;
+    prefix_size = new_prefix_size;
+    bytes = new_bytes;
+  }
+  return end;
+}
+
+void BulkLoaderImpl::BuildInnerNode(const ChildVector& children, size_t begin,
+                                    size_t end,
+                                    uint8_t* page_data) const noexcept {
+  DCHECK_LT(begin, end);
+
+  BTreePageFormat::InitInner(page_data, page_size_,
+                             children[begin].page_id64);
+  if (end == begin + 1)
+    return;
+
+  string_view first_key = Separator(children[begin + 1]);
+  size_t prefix_size = CommonPrefixSize(first_key,
+                                        Separator(children[end - 1]));
+  BTreePageFormat::SetCommonPrefix(
+      page_data, first_key.substr(0, prefix_size), string_view());
+  for (size_t i = begin + 1; i < end; ++i) {
+    bool inserted = BTreePageFormat::InsertInnerCell(
+        page_data, i - begin - 1, Separator(children[i]),
+        children[i].page_id64);
+    DCHECK(inserted);
+    UNUSED(inserted);
+  }
+}
+
+Status BulkLoaderImpl::BuildInnerLevel(const ChildVector& children,
+                                       ChildVector* parents) {
+  DCHECK(parents != nullptr);
+
+  size_t begin = 0;
+  while (begin < children.size()) {
+    size_t end = InnerNodeEnd(children, begin, fill_bytes_);
+    size_t page_id;
+    uint8_t* page_data;
+    Status status = ReservePage(&page_id, &page_data);
+    if (status != Status::kSuccess)
+      return status;
+    BuildInnerNode(children, begin, end, page_data);
+
+    // The node's keys are bounded by the separator of its leftmost child.
+    Child parent;
+    parent.page_id64 = page_id;
+    parent.separator_offset = children[begin].separator_offset;
+    parent.separator_size = children[begin].separator_size;
+    parents->push_back(parent);
+    begin = end;
+  }
+  return Status::kSuccess;
+}
+
+Status BulkLoaderImpl::ReservePage(size_t* page_id, uint8_t** page_data) {
+  DCHECK(page_id != nullptr);
+  DCHECK(page_data != nullptr);
+
+  bool needs_new_run = run_first_page_id_ == 0 ||
+      run_used_page_count_ == run_page_count_;
+  size_t new_page_id;
+  if (needs_new_run) {
+    Status status = store_->free_page_manager()->AllocPageRun(
+        transaction_, run_page_count_, &new_page_id);
+    if (status != Status::kSuccess)
+      return status;
+  } else {
+    new_page_id = run_first_page_id_ + run_used_page_count_;
+  }
+
+  // The previous leaf must be linked to the new page before it is written.
+  if (last_leaf_data_ != nullptr) {
+    BTreePageFormat::SetNextLeafId64(new_page_id, last_leaf_data_);
+    last_leaf_data_ = nullptr;
+  }
+
+  if (needs_new_run) {
+    Status status = FlushRun();
+    if (status != Status::kSuccess)
+      return status;
+    run_first_page_id_ = new_page_id;
+    run_used_page_count_ = 0;
+  }
+
+  *page_id = new_page_id;
+  *page_data = run_buffer_ + run_used_page_count_ * page_size_;
+  ++run_used_page_count_;
+  return Status::kSuccess;
+}
+
+Status BulkLoaderImpl::FlushRun() {
+  if (run_used_page_count_ == 0)
+    return Status::kSuccess;
+  return store_->WritePageRun(run_first_page_id_, run_used_page_count_,
+                              run_buffer_);
+}
+
+Status BulkLoaderImpl::WriteRoot(const ChildVector* children) {
+  Page* root;
+  Status status = page_pool_->StorePage(
+      store_, root_page_id_, PagePool::kIgnorePageData, &root);
+  if (status != Status::kSuccess)
+    return status;
+
+  transaction_->WillModifyPage(root);
+  if (children == nullptr)
+    BuildLeaf(root->data());
+  else
+    BuildInnerNode(*children, 0, children->size(), root->data());
+  page_pool_->UnpinStorePage(root);
+  return Status::kSuccess;
+}
+
+}  // namespace berrydb
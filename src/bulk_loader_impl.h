@@ -0,0 +1,226 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_BULK_LOADER_IMPL_H_
+#define BERRYDB_BULK_LOADER_IMPL_H_
+
+#include <vector>
+
+#include "berrydb/bulk_loader.h"
+#include "berrydb/platform.h"
+#include "./util/platform_allocator.h"
+
+namespace berrydb {
+
+struct BulkLoaderOptions;
+class PagePool;
+class StoreImpl;
+class TransactionImpl;
+
+/** Internal representation for the BulkLoader class in the public API.
+ *
+ * Tree pages are assembled in a run buffer that holds many consecutive pages.
+ * When the buffer fills up, it is written to the store using a single
+ * BlockAccessFile::Write() call, and reused for the next pages. The page IDs
+ * for each run are allocated at the end of the data file, so the pages in a
+ * run are consecutive on disk.
+ *
+ * Leaves are built while keys are added, so only one leaf's worth of keys is
+ * buffered. Each finished leaf contributes a child entry to the level above it,
+ * which is built by Finish(). The top level fits in a single node, which is
+ * written into the tree's root page, because the root's page ID never changes.
+ */
+class BulkLoaderImpl {
+ public:
+  /** Creates a BulkLoaderImpl instance.
+   *
+   * @param transaction  the transaction that receives the tree's pages
+   * @param root_page_id the root page of the tree that will be loaded; the
+   *                     tree must be empty
+   * @param options      the loader's configuration
+   */
+  static BulkLoaderImpl* Create(TransactionImpl* transaction,
+                                size_t root_page_id,
+                                const BulkLoaderOptions& options);
+
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline BulkLoaderImpl* FromApi(BulkLoader* api) noexcept {
+    BulkLoaderImpl* impl = reinterpret_cast<BulkLoaderImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline const BulkLoaderImpl* FromApi(const BulkLoader* api) noexcept {
+    const BulkLoaderImpl* impl = reinterpret_cast<const BulkLoaderImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+
+  /** Computes the public API representation for this loader. */
+  inline BulkLoader* ToApi() noexcept { return &api_; }
+
+  // See the public API documention for details.
+  Status Add(string_view key, string_view value);
+  Status Finish();
+  void Release();
+
+ private:
+  /** A key-value pair buffered for the leaf that is being assembled. */
+  struct LeafEntry {
+    /** The position of the key's bytes in leaf_data_. The value follows. */
+    size_t offset;
+    size_t key_size;
+    size_t value_size;
+    /** True if the value is a reference to overflow pages. */
+    bool is_overflow;
+  };
+
+  /** A finished tree node, which must be referenced by the level above it. */
+  struct Child {
+    uint64_t page_id64;
+    /** The position of the node's separator key in separators_.
+     *
+     * The separator is the smallest key that can be stored in the node. The
+     * leftmost node on each level does not need a separator. */
+    size_t separator_offset;
+    size_t separator_size;
+  };
+
+  using ChildVector = std::vector<Child, PlatformAllocator<Child>>;
+
+  /** Use BulkLoaderImpl::Create() to obtain BulkLoaderImpl instances. */
+  BulkLoaderImpl(TransactionImpl* transaction, size_t root_page_id,
+                 const BulkLoaderOptions& options);
+  /** Use Release() to destroy BulkLoaderImpl instances. */
+  ~BulkLoaderImpl();
+
+  // Loaders cannot be copied or moved.
+  BulkLoaderImpl(const BulkLoaderImpl& other) = delete;
+  BulkLoaderImpl(BulkLoaderImpl&& other) = delete;
+  BulkLoaderImpl& operator=(const BulkLoaderImpl& other) = delete;
+  BulkLoaderImpl& operator=(BulkLoaderImpl&& other) = delete;
+
+  /** The key of a buffered leaf entry. */
+  inline string_view LeafKey(const LeafEntry& entry) const noexcept {
+    return string_view(leaf_data_.data() + entry.offset, entry.key_size);
+  }
+
+  /** The separator key of a finished node. */
+  inline string_view Separator(const Child& child) const noexcept {
+    return string_view(separators_.data() + child.separator_offset,
+                       child.separator_size);
+  }
+
+  /** Page bytes used by the buffered leaf entries, with a common prefix. */
+  size_t LeafBytes(size_t prefix_size) const noexcept;
+
+  /** Writes the buffered leaf entries into an empty leaf page. */
+  void BuildLeaf(uint8_t* page_data) const noexcept;
+
+  /** Moves the buffered leaf entries into a new leaf in the run buffer. */
+  Status FlushLeaf();
+
+  /** Finds the children that go into an inner node.
+   *
+   * @param  begin     the node's leftmost child
+   * @param  max_bytes the page bytes that the node's cells may use
+   * @return           the child right after the node's last child
+   */
+  size_t InnerNodeEnd(const ChildVector& children, size_t begin,
+                      size_t max_bytes) const noexcept;
+
+  /** Writes a range of children into an empty inner node page. */
+  void BuildInnerNode(const ChildVector& children, size_t begin, size_t end,
+                      uint8_t* page_data) const noexcept;
+
+  /** Builds the inner nodes whose children are the given nodes.
+   *
+   * @param  children the nodes on a tree level
+   * @param  parents  receives the nodes on the level above
+   * @return          most likely kSuccess or kIoError
+   */
+  Status BuildInnerLevel(const ChildVector& children, ChildVector* parents);
+
+  /** Sets up the page that will hold the next tree node.
+   *
+   * This may write the run buffer to the store, and allocate the pages for a
+   * new run.
+   *
+   * @param  page_id   receives the page ID of the new node
+   * @param  page_data receives the new node's buffer
+   * @return           most likely kSuccess or kIoError
+   */
+  Status ReservePage(size_t* page_id, uint8_t** page_data);
+
+  /** Writes the pages in the run buffer to the store. */
+  Status FlushRun();
+
+  /** Replaces the content of the tree's root page.
+   *
+   * @param  children if not nullptr, the root becomes an inner node with these
+   *                  children; otherwise, the root becomes a leaf holding the
+   *                  buffered leaf entries
+   * @return          most likely kSuccess or kIoError
+   */
+  Status WriteRoot(const ChildVector* children);
+
+  /* The public API version of this class. */
+  BulkLoader api_;  // Must be the first class member.
+
+  /** The transaction that receives the tree's pages. */
+  TransactionImpl* const transaction_;
+  /** The store that holds the tree. */
+  StoreImpl* const store_;
+  /** The page pool used by the store. */
+  PagePool* const page_pool_;
+  /** The tree's root page. */
+  const size_t root_page_id_;
+  /** The store's page size. */
+  const size_t page_size_;
+  /** The page bytes available to a node's cells and common prefix. */
+  const size_t page_capacity_;
+  /** The page bytes filled by the loader, based on the fill factor. */
+  const size_t fill_bytes_;
+  /** The number of pages in the run buffer. */
+  const size_t run_page_count_;
+
+  /** Holds the pages that will be written by the next store write. */
+  uint8_t* const run_buffer_;
+  /** The ID of the first page in the current run. 0 if no run was allocated. */
+  size_t run_first_page_id_ = 0;
+  /** The number of pages in the current run that hold tree nodes. */
+  size_t run_used_page_count_ = 0;
+
+  /** The key and value bytes of the buffered leaf entries. */
+  std::vector<char, PlatformAllocator<char>> leaf_data_;
+  /** The key-value pairs that will go into the next leaf. */
+  std::vector<LeafEntry, PlatformAllocator<LeafEntry>> leaf_entries_;
+  /** The size of the common prefix of the buffered leaf entries' keys. */
+  size_t leaf_prefix_size_ = 0;
+  /** The page bytes used by the buffered leaf entries. */
+  size_t leaf_bytes_ = 0;
+
+  /** The last key in the most recently built leaf. */
+  std::vector<char, PlatformAllocator<char>> last_leaf_key_;
+  /** The page ID of the most recently built leaf. */
+  size_t last_leaf_id_ = 0;
+  /** The most recently built leaf, if it is still in the run buffer.
+   *
+   * The leaf's next sibling link is set when the next page is reserved. */
+  uint8_t* last_leaf_data_ = nullptr;
+  /** The number of leaves built so far. */
+  size_t leaf_count_ = 0;
+
+  /** The separator keys of the finished nodes. */
+  std::vector<char, PlatformAllocator<char>> separators_;
+  /** The finished leaves. */
+  ChildVector leaves_;
+
+  /** Set when Finish() is called. */
+  bool is_finished_ = false;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_BULK_LOADER_IMPL_H_
@@ -0,0 +1,331 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./bulk_loader_impl.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/options.h"
+#include "berrydb/space.h"
+#include "berrydb/status.h"
+#include "./cursor_impl.h"
+#include "./free_page_list.h"
+#include "./page_pool.h"
+#include "./pool_impl.h"
+#include "./space_impl.h"
+#include "./store_impl.h"
+#include "./test/file_deleter.h"
+#include "./transaction_impl.h"
+#include "./util/unique_ptr.h"
+
+// TODO(pwnall): Remove this once we don't need to print a Status value.
+#include "berrydb/ostream_ops.h"
+
+namespace berrydb {
+
+namespace {
+
+string_view ToStringView(const std::string& string) {
+  return string_view(string.data(), string.size());
+}
+
+std::string FromStringView(string_view view) {
+  return std::string(view.data(), view.size());
+}
+
+}  // namespace
+
+class BulkLoaderImplTest : public ::testing::Test {
+ protected:
+  BulkLoaderImplTest()
+      : data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) { }
+
+  void SetUp() override {
+    PoolOptions options;
+    options.page_shift = kStorePageShift;
+    options.page_pool_size = 64;
+    pool_.reset(PoolImpl::Create(options));
+
+    StoreImpl* raw_store;
+    ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+        kStoreFileName, StoreOptions(), &raw_store));
+    store_.reset(raw_store);
+
+    transaction_.reset(store_->CreateTransaction());
+    SpaceImpl* raw_space;
+    ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+        nullptr, "space", &raw_space));
+    space_.reset(raw_space->ToApi());
+  }
+
+  /** Builds sorted keys that share a long prefix. */
+  std::vector<std::string> SortedKeys(int key_count) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < key_count; ++i) {
+      char key[32];
+      std::snprintf(key, sizeof(key), "prefix/key%06d", i);
+      keys.push_back(key);
+    }
+    return keys;
+  }
+
+  /** Bulk-loads the given keys into the test space. */
+  void LoadKeys(const std::vector<std::string>& keys, double fill_factor) {
+    BulkLoaderOptions options;
+    options.fill_factor = fill_factor;
+    BulkLoaderImpl* raw_loader;
+    ASSERT_EQ(Status::kSuccess, transaction_->CreateBulkLoader(
+        space_.get(), options, &raw_loader));
+    UniquePtr<BulkLoaderImpl> loader(raw_loader);
+
+    for (const std::string& key : keys) {
+      std::string value = "value of " + key;
+      ASSERT_EQ(Status::kSuccess, loader->Add(
+          ToStringView(key), ToStringView(value)));
+    }
+    ASSERT_EQ(Status::kSuccess, loader->Finish());
+  }
+
+  /** Checks that a scan over the test space produces the given keys. */
+  void ExpectScannedKeys(const std::vector<std::string>& keys) {
+    CursorImpl* raw_cursor;
+    ASSERT_EQ(Status::kSuccess, transaction_->CreateCursor(
+        space_.get(), CursorOptions(), &raw_cursor));
+    UniquePtr<CursorImpl> cursor(raw_cursor);
+
+    std::vector<std::string> scanned_keys;
+    Status status = cursor->Seek("");
+    while (status == Status::kSuccess) {
+      std::string key = FromStringView(cursor->key());
+      EXPECT_EQ("value of " + key, FromStringView(cursor->value()));
+      scanned_keys.push_back(key);
+      status = cursor->Next();
+    }
+    EXPECT_EQ(Status::kNotFound, status);
+    EXPECT_EQ(keys, scanned_keys);
+
+    // The leaves' backward links must match the forward links.
+    scanned_keys.clear();
+    status = cursor->SeekToLast();
+    while (status == Status::kSuccess) {
+      scanned_keys.push_back(FromStringView(cursor->key()));
+      status = cursor->Prev();
+    }
+    std::reverse(scanned_keys.begin(), scanned_keys.end());
+    EXPECT_EQ(Status::kNotFound, status);
+    EXPECT_EQ(keys, scanned_keys);
+  }
+
+  const std::string kStoreFileName = "test_bulk_loader.berry";
+  static constexpr size_t kStorePageShift = 9;  // 512-byte pages
+
+  // Must precede UniquePtr members, because on Windows all file handles must be
+  // closed before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  UniquePtr<PoolImpl> pool_;
+  UniquePtr<StoreImpl> store_;
+  UniquePtr<TransactionImpl> transaction_;
+  UniquePtr<Space> space_;
+};
+
+constexpr size_t BulkLoaderImplTest::kStorePageShift;
+
+TEST_F(BulkLoaderImplTest, LoadsManyKeys) {
+  // 512-byte pages fit a few keys each, so the tree has many levels, and the
+  // pages span a few runs.
+  std::vector<std::string> keys = SortedKeys(25000);
+  LoadKeys(keys, 0.9);
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+
+  for (size_t i = 0; i < keys.size(); i += 7) {
+    string_view value;
+    ASSERT_EQ(Status::kSuccess, transaction_->Get(
+        space_.get(), ToStringView(keys[i]), &value));
+    EXPECT_EQ("value of " + keys[i], FromStringView(value));
+  }
+  string_view value;
+  EXPECT_EQ(Status::kNotFound, transaction_->Get(
+      space_.get(), "prefix/key", &value));
+  EXPECT_EQ(Status::kNotFound, transaction_->Get(
+      space_.get(), "prefix/key999999", &value));
+  ExpectScannedKeys(keys);
+
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  transaction_.reset(store_->CreateTransaction());
+  ExpectScannedKeys(keys);
+}
+
+TEST_F(BulkLoaderImplTest, LoadedTreeAcceptsWrites) {
+  std::vector<std::string> keys = SortedKeys(2000);
+  std::vector<std::string> loaded_keys;
+  for (size_t i = 0; i < keys.size(); i += 2)
+    loaded_keys.push_back(keys[i]);
+  LoadKeys(loaded_keys, 1.0);
+
+  // Full leaves must be split by the normal insertion path.
+  for (size_t i = 1; i < keys.size(); i += 2) {
+    std::string value = "value of " + keys[i];
+    ASSERT_EQ(Status::kSuccess, transaction_->Put(
+        space_.get(), ToStringView(keys[i]), ToStringView(value)));
+  }
+  ExpectScannedKeys(keys);
+
+  std::vector<std::string> remaining_keys;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i % 3 == 0) {
+      ASSERT_EQ(Status::kSuccess, transaction_->Delete(
+          space_.get(), ToStringView(keys[i])));
+    } else {
+      remaining_keys.push_back(keys[i]);
+    }
+  }
+  ExpectScannedKeys(remaining_keys);
+}
+
+TEST_F(BulkLoaderImplTest, SingleLeaf) {
+  std::vector<std::string> keys = SortedKeys(3);
+  LoadKeys(keys, 0.5);
+  ExpectScannedKeys(keys);
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(BulkLoaderImplTest, EmptyLoad) {
+  LoadKeys(std::vector<std::string>(), 0.9);
+  ExpectScannedKeys(std::vector<std::string>());
+
+  std::string value = "value of key";
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "key", ToStringView(value)));
+  ExpectScannedKeys({"key"});
+}
+
+TEST_F(BulkLoaderImplTest, LargeValues) {
+  BulkLoaderImpl* raw_loader;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateBulkLoader(
+      space_.get(), BulkLoaderOptions(), &raw_loader));
+  UniquePtr<BulkLoaderImpl> loader(raw_loader);
+
+  // Large values are interleaved with small values.
+  std::vector<std::string> keys = SortedKeys(200);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::string value = "value of " + keys[i];
+    if (i % 10 == 0)
+      value.append(i * 100, 'v');
+    ASSERT_EQ(Status::kSuccess, loader->Add(
+        ToStringView(keys[i]), ToStringView(value)));
+  }
+  ASSERT_EQ(Status::kSuccess, loader->Finish());
+  loader.reset();
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  transaction_.reset(store_->CreateTransaction());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::string expected_value = "value of " + keys[i];
+    if (i % 10 == 0)
+      expected_value.append(i * 100, 'v');
+    string_view value;
+    ASSERT_EQ(Status::kSuccess, transaction_->Get(
+        space_.get(), ToStringView(keys[i]), &value));
+    EXPECT_EQ(expected_value, FromStringView(value));
+  }
+}
+
+TEST_F(BulkLoaderImplTest, LargeValueAfterRunFreesUnusedPages) {
+  BulkLoaderImpl* raw_loader;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateBulkLoader(
+      space_.get(), BulkLoaderOptions(), &raw_loader));
+  UniquePtr<BulkLoaderImpl> loader(raw_loader);
+
+  // The last value's overflow pages are allocated after the leaves' run, so
+  // the run's unused pages cannot be trimmed off the end of the data file.
+  std::vector<std::string> keys = SortedKeys(100);
+  std::string large_value(10000, 'v');
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::string value = "value of " + keys[i];
+    if (i == keys.size() - 1)
+      value = large_value;
+    ASSERT_EQ(Status::kSuccess, loader->Add(
+        ToStringView(keys[i]), ToStringView(value)));
+  }
+  ASSERT_EQ(Status::kSuccess, loader->Finish());
+  loader.reset();
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_NE(FreePageList::kInvalidPageId,
+            store_->header()->free_list_head_page);
+
+  // The unused pages are reused by later single-page allocations.
+  size_t page_count = store_->header()->page_count;
+  transaction_.reset(store_->CreateTransaction());
+  SpaceImpl* raw_space;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      nullptr, "space2", &raw_space));
+  UniquePtr<Space> space2(raw_space->ToApi());
+  for (const std::string& key : keys) {
+    ASSERT_EQ(Status::kSuccess, transaction_->Put(
+        space2.get(), ToStringView(key), ToStringView(key)));
+  }
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_EQ(page_count, store_->header()->page_count);
+
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(
+      space_.get(), ToStringView(keys.back()), &value));
+  EXPECT_EQ(large_value, FromStringView(value));
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(
+      space_.get(), ToStringView(keys.front()), &value));
+  EXPECT_EQ("value of " + keys.front(), FromStringView(value));
+}
+
+TEST_F(BulkLoaderImplTest, RejectsNonEmptySpace) {
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+
+  BulkLoaderImpl* loader;
+  EXPECT_EQ(Status::kInvalidArgument, transaction_->CreateBulkLoader(
+      space_.get(), BulkLoaderOptions(), &loader));
+}
+
+TEST_F(BulkLoaderImplTest, RejectsUnsortedKeys) {
+  BulkLoaderImpl* raw_loader;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateBulkLoader(
+      space_.get(), BulkLoaderOptions(), &raw_loader));
+  UniquePtr<BulkLoaderImpl> loader(raw_loader);
+
+  ASSERT_EQ(Status::kSuccess, loader->Add("b", "value"));
+  EXPECT_EQ(Status::kInvalidArgument, loader->Add("b", "value"));
+  EXPECT_EQ(Status::kInvalidArgument, loader->Add("a", "value"));
+  EXPECT_EQ(Status::kSuccess, loader->Add("c", "value"));
+}
+
+TEST_F(BulkLoaderImplTest, RejectsLargeEntries) {
+  BulkLoaderImpl* raw_loader;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateBulkLoader(
+      space_.get(), BulkLoaderOptions(), &raw_loader));
+  UniquePtr<BulkLoaderImpl> loader(raw_loader);
+
+  std::string key(1 << kStorePageShift, 'k');
+  EXPECT_EQ(Status::kEntryTooLarge, loader->Add(ToStringView(key), "value"));
+}
+
+TEST_F(BulkLoaderImplTest, ClosedTransaction) {
+  BulkLoaderImpl* raw_loader;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateBulkLoader(
+      space_.get(), BulkLoaderOptions(), &raw_loader));
+  UniquePtr<BulkLoaderImpl> loader(raw_loader);
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  EXPECT_EQ(Status::kAlreadyClosed, loader->Add("key", "value"));
+  EXPECT_EQ(Status::kAlreadyClosed, transaction_->CreateBulkLoader(
+      space_.get(), BulkLoaderOptions(), &raw_loader));
+}
+
+}  // namespace berrydb
@@ -4,7 +4,16 @@
 
 #include "./catalog_impl.h"
 
+#include <cstring>
+
 #include "berrydb/platform.h"
+#include "./btree.h"
+#include "./format/btree_page_format.h"
+#include "./page.h"
+#include "./page_pool.h"
+#include "./space_impl.h"
+#include "./store_impl.h"
+#include "./transaction_impl.h"
 
 namespace berrydb {
 
@@ -12,15 +21,16 @@ static_assert(std::is_standard_layout<CatalogImpl>::value,
     "CatalogImpl must be a standard layout type so its public API can be "
     "exposed cheaply");
 
-CatalogImpl* CatalogImpl::Create() {
+CatalogImpl* CatalogImpl::Create(StoreImpl* store, size_t root_page_id) {
   void* heap_block = Allocate(sizeof(CatalogImpl));
-  CatalogImpl* catalog = new (heap_block) CatalogImpl();
+  CatalogImpl* catalog = new (heap_block) CatalogImpl(store, root_page_id);
   DCHECK_EQ(heap_block, static_cast<void*>(catalog));
   return catalog;
 }
 
-CatalogImpl::CatalogImpl()
-    : api_() {
+CatalogImpl::CatalogImpl(StoreImpl* store, size_t root_page_id)
+    : api_(), store_(store), root_page_id_(root_page_id) {
+  DCHECK(store != nullptr);
 }
 
 CatalogImpl::~CatalogImpl() { }
@@ -31,4 +41,105 @@ void CatalogImpl::Release() {
   Deallocate(heap_block, sizeof(CatalogImpl));
 }
 
+Status CatalogImpl::FindEntry(TransactionImpl* transaction, string_view name,
+                              EntryType* type, size_t* root_page_id) {
+  DCHECK(transaction != nullptr);
+  DCHECK_EQ(store_, transaction->store());
+  DCHECK(type != nullptr);
+  DCHECK(root_page_id != nullptr);
+
+  BTree tree(transaction, root_page_id_);
+  Page* leaf;
+  size_t slot;
+  Status status = tree.Find(name, &leaf, &slot);
+  if (status != Status::kSuccess)
+    return status;
+
+  // Entries are copied out of the leaf cell, because they may be unaligned.
+  alignas(8) uint8_t entry[CatalogEntryFormat::kEntrySize];
+  string_view value = BTreePageFormat::Value(leaf->data(), slot);
+  bool is_valid = !BTreePageFormat::IsOverflowValue(leaf->data(), slot) &&
+                  value.size() == CatalogEntryFormat::kEntrySize;
+  if (is_valid)
+    std::memcpy(entry, value.data(), CatalogEntryFormat::kEntrySize);
+  store_->page_pool()->UnpinStorePage(leaf);
+  if (!is_valid || CatalogEntryFormat::IsCorruptEntry(entry))
+    return Status::kDataCorrupted;
+
+  uint64_t root_page_id64 = CatalogEntryFormat::RootPageId64(entry);
+  if (root_page_id64 == BTree::kInvalidPageId)
+    return Status::kDataCorrupted;
+  *root_page_id = static_cast<size_t>(root_page_id64);
+  // This check should be optimized out on 64-bit architectures.
+  if (*root_page_id != root_page_id64)
+    return Status::kDatabaseTooLarge;
+
+  *type = CatalogEntryFormat::Type(entry);
+  return Status::kSuccess;
+}
+
+Status CatalogImpl::AddEntry(TransactionImpl* transaction, string_view name,
+                             EntryType type, size_t root_page_id) {
+  DCHECK(transaction != nullptr);
+  DCHECK_EQ(store_, transaction->store());
+  DCHECK_NE(root_page_id, BTree::kInvalidPageId);
+
+  BTree tree(transaction, root_page_id_);
+  Page* leaf;
+  size_t slot;
+  Status status = tree.Find(name, &leaf, &slot);
+  if (status == Status::kSuccess) {
+    store_->page_pool()->UnpinStorePage(leaf);
+    return Status::kAlreadyExists;
+  }
+  if (status != Status::kNotFound)
+    return status;
+
+  alignas(8) uint8_t entry[CatalogEntryFormat::kEntrySize];
+  CatalogEntryFormat::SetEntry(type, root_page_id, entry);
+  return tree.Put(name, string_view(reinterpret_cast<char*>(entry),
+                                    CatalogEntryFormat::kEntrySize));
+}
+
+Status CatalogImpl::OpenEntry(string_view name, EntryType type,
+                              size_t* root_page_id) {
+  // Catalog operations run in their own transactions. See the public API.
+  TransactionImpl* transaction = store_->CreateTransaction();
+  EntryType entry_type;
+  Status status = FindEntry(transaction, name, &entry_type, root_page_id);
+  transaction->Rollback();
+  transaction->Release();
+  if (status != Status::kSuccess)
+    return status;
+
+  // An entry of a different type does not satisfy the lookup.
+  if (entry_type != type)
+    return Status::kNotFound;
+  return Status::kSuccess;
+}
+
+Status CatalogImpl::OpenCatalog(string_view name, CatalogImpl** result) {
+  DCHECK(result != nullptr);
+
+  size_t root_page_id;
+  Status status = OpenEntry(name, EntryType::kCatalog, &root_page_id);
+  if (status != Status::kSuccess)
+    return status;
+
+  *result = CatalogImpl::Create(store_, root_page_id);
+  return Status::kSuccess;
+}
+
+Status CatalogImpl::OpenSpace(string_view name, SpaceImpl** result) {
+  DCHECK(result != nullptr);
+
+  size_t root_page_id;
+  Status status = OpenEntry(name, EntryType::kSpace, &root_page_id);
+  if (status != Status::kSuccess)
+    return status;
+
+  *result = SpaceImpl::Create(root_page_id);
+  return Status::kSuccess;
+}
+
 }  // namespace berrydb
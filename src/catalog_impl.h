@@ -7,15 +7,31 @@
 
 #include "berrydb/catalog.h"
 #include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/string_view.h"
+#include "./format/catalog_entry_format.h"
 
 namespace berrydb {
 
 class SpaceImpl;
+class StoreImpl;
+class TransactionImpl;
 
-/** Internal representation for the Catalog class in the public API. */
+/** Internal representation for the Catalog class in the public API.
+ *
+ * A catalog's entries are stored in a B+tree, keyed by the entries' names. The
+ * entry format is described in CatalogEntryFormat.
+ */
 class CatalogImpl {
  public:
-  static CatalogImpl* Create();
+  using EntryType = CatalogEntryFormat::EntryType;
+
+  /** Creates a CatalogImpl instance.
+   *
+   * @param store        the store that holds the catalog
+   * @param root_page_id the ID of the root page of the catalog's B+tree
+   */
+  static CatalogImpl* Create(StoreImpl* store, size_t root_page_id);
 
   /** Computes the internal representation for a pointer from the public API. */
   static inline CatalogImpl* FromApi(Catalog* api) noexcept {
@@ -33,19 +49,62 @@ class CatalogImpl {
   /** Computes the public API representation for this store. */
   inline Catalog* ToApi() noexcept { return &api_; }
 
+  /** The store that holds this catalog. */
+  inline StoreImpl* store() const noexcept { return store_; }
+
+  /** The ID of the root page of the B+tree holding the catalog's entries. */
+  inline size_t root_page_id() const noexcept { return root_page_id_; }
+
+  /** Looks up an entry in this catalog.
+   *
+   * @param  transaction  the transaction used to read the catalog
+   * @param  name         the entry's name
+   * @param  type         if the call succeeds, receives the entry's type
+   * @param  root_page_id if the call succeeds, receives the ID of the root page
+   *                      of the B+tree of the space or catalog described by
+   *                      the entry
+   * @return              kNotFound if the catalog does not contain an entry
+   *                      with the given name; otherwise, most likely kSuccess,
+   *                      kIoError or kDataCorrupted
+   */
+  Status FindEntry(TransactionImpl* transaction, string_view name,
+                   EntryType* type, size_t* root_page_id);
+
+  /** Adds an entry to this catalog.
+   *
+   * @param  transaction  the transaction used to modify the catalog
+   * @param  name         the new entry's name
+   * @param  type         the type of the object described by the entry
+   * @param  root_page_id the ID of the root page of the object's B+tree
+   * @return              kAlreadyExists if the catalog already contains an
+   *                      entry with the given name; otherwise, most likely
+   *                      kSuccess or kIoError
+   */
+  Status AddEntry(TransactionImpl* transaction, string_view name,
+                  EntryType type, size_t root_page_id);
+
   // See the public API documention for details.
   void Release();
   Status OpenCatalog(string_view name, CatalogImpl** result);
   Status OpenSpace(string_view name, SpaceImpl** result);
 
  private:
-  /** Use CatalogImpl::Create() to obtain SpaceImpl instances. */
-  CatalogImpl();
-  /** Use Release() to destroy StoreImpl instances. */
+  /** Use CatalogImpl::Create() to obtain CatalogImpl instances. */
+  CatalogImpl(StoreImpl* store, size_t root_page_id);
+  /** Use Release() to destroy CatalogImpl instances. */
   ~CatalogImpl();
 
+  /** Looks up an entry of the given type, in its own transaction. */
+  Status OpenEntry(string_view name, EntryType type, size_t* root_page_id);
+
   /* The public API version of this class. */
   Catalog api_;  // Must be the first class member.
+
+  /** The store that holds this catalog. */
+  StoreImpl* const store_;
+
+  /** The ID of the root page of the B+tree holding the catalog's entries. */
+  const size_t root_page_id_;
 };
 
 }  // namespace berrydb
@@ -0,0 +1,230 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./cursor_impl.h"
+
+#include <cstring>
+
+#include "berrydb/options.h"
+#include "berrydb/status.h"
+#include "./btree.h"
+#include "./format/btree_page_format.h"
+#include "./overflow_chain.h"
+#include "./page.h"
+#include "./store_impl.h"
+#include "./transaction_impl.h"
+
+namespace berrydb {
+
+static_assert(std::is_standard_layout<CursorImpl>::value,
+    "CursorImpl must be a standard layout type so its public API can be "
+    "exposed cheaply");
+
+CursorImpl* CursorImpl::Create(TransactionImpl* transaction,
+                               size_t root_page_id,
+                               const CursorOptions& options) {
+  void* heap_block = Allocate(sizeof(CursorImpl));
+  CursorImpl* cursor = new (heap_block) CursorImpl(
+      transaction, root_page_id, options);
+  DCHECK_EQ(heap_block, static_cast<void*>(cursor));
+  return cursor;
+}
+
+CursorImpl::CursorImpl(TransactionImpl* transaction, size_t root_page_id,
+                       const CursorOptions& options)
+    : api_(), transaction_(transaction),
+      page_pool_(transaction->store()->page_pool()),
+      root_page_id_(root_page_id),
+      unpin_mode_(options.one_shot ? PagePool::kDiscardPage :
+                                     PagePool::kCachePage) {
+  DCHECK(transaction != nullptr);
+}
+
+CursorImpl::~CursorImpl() {
+  Invalidate();
+  if (key_buffer_ != nullptr)
+    Deallocate(key_buffer_, key_buffer_size_);
+  if (value_buffer_ != nullptr)
+    Deallocate(value_buffer_, value_buffer_size_);
+}
+
+void CursorImpl::Release() {
+  this->~CursorImpl();
+  void* heap_block = static_cast<void*>(this);
+  Deallocate(heap_block, sizeof(CursorImpl));
+}
+
+Status CursorImpl::Seek(string_view key) {
+  if (transaction_->IsClosed())
+    return Status::kAlreadyClosed;
+
+  Invalidate();
+  BTree tree(transaction_, root_page_id_);
+  Status status = tree.FindLowerBound(key, &leaf_, &slot_);
+  if (status != Status::kSuccess) {
+    leaf_ = nullptr;
+    return status;
+  }
+  return SkipForward();
+}
+
+Status CursorImpl::SeekToLast() {
+  if (transaction_->IsClosed())
+    return Status::kAlreadyClosed;
+
+  Invalidate();
+  BTree tree(transaction_, root_page_id_);
+  Status status = tree.FindLastLeaf(&leaf_);
+  if (status != Status::kSuccess) {
+    leaf_ = nullptr;
+    return status;
+  }
+  return SkipBackward();
+}
+
+Status CursorImpl::Next() {
+  DCHECK(IsValid());
+  if (transaction_->IsClosed())
+    return Status::kAlreadyClosed;
+
+  ++slot_;
+  return SkipForward();
+}
+
+Status CursorImpl::Prev() {
+  DCHECK(IsValid());
+  if (transaction_->IsClosed())
+    return Status::kAlreadyClosed;
+
+  if (slot_ > 0) {
+    --slot_;
+    return Status::kSuccess;
+  }
+  Status status = MoveToLeaf(BTreePageFormat::PrevLeafId64(leaf_->data()));
+  if (status != Status::kSuccess)
+    return status;
+  return SkipBackward();
+}
+
+string_view CursorImpl::key() {
+  DCHECK(IsValid());
+
+  const uint8_t* leaf_data = leaf_->data();
+  string_view prefix = BTreePageFormat::CommonPrefix(leaf_data);
+  string_view suffix = BTreePageFormat::KeySuffix(leaf_data, slot_);
+  if (prefix.size() == 0)
+    return suffix;
+
+  size_t key_size = prefix.size() + suffix.size();
+  if (key_size > key_buffer_size_) {
+    if (key_buffer_ != nullptr)
+      Deallocate(key_buffer_, key_buffer_size_);
+    key_buffer_ = reinterpret_cast<uint8_t*>(Allocate(key_size));
+    key_buffer_size_ = key_size;
+  }
+  std::memcpy(key_buffer_, prefix.data(), prefix.size());
+  if (suffix.size() != 0)
+    std::memcpy(key_buffer_ + prefix.size(), suffix.data(), suffix.size());
+  return string_view(reinterpret_cast<char*>(key_buffer_), key_size);
+}
+
+string_view CursorImpl::value() {
+  DCHECK(IsValid());
+
+  string_view leaf_value = BTreePageFormat::Value(leaf_->data(), slot_);
+  if (!BTreePageFormat::IsOverflowValue(leaf_->data(), slot_))
+    return leaf_value;
+
+  OverflowChain chain(transaction_, leaf_value);
+  size_t value_size = static_cast<size_t>(chain.value_size64());
+  // This check should be optimized out on 64-bit architectures.
+  if (value_size != chain.value_size64()) {
+    Invalidate();
+    return string_view();
+  }
+
+  if (value_size > value_buffer_size_) {
+    if (value_buffer_ != nullptr)
+      Deallocate(value_buffer_, value_buffer_size_);
+    value_buffer_ = reinterpret_cast<uint8_t*>(Allocate(value_size));
+    value_buffer_size_ = value_size;
+  }
+  if (chain.ReadAll(value_buffer_) != Status::kSuccess) {
+    Invalidate();
+    return string_view();
+  }
+  return string_view(reinterpret_cast<char*>(value_buffer_), value_size);
+}
+
+Status CursorImpl::SkipForward() {
+  DCHECK(IsValid());
+
+  while (slot_ >= BTreePageFormat::CellCount(leaf_->data())) {
+    Status status = MoveToLeaf(BTreePageFormat::NextLeafId64(leaf_->data()));
+    if (status != Status::kSuccess)
+      return status;
+    // The leaf after the sibling is read while the sibling's cells are used.
+    PrefetchLeaf(BTreePageFormat::NextLeafId64(leaf_->data()));
+    slot_ = 0;
+  }
+  return Status::kSuccess;
+}
+
+Status CursorImpl::SkipBackward() {
+  DCHECK(IsValid());
+
+  while (true) {
+    size_t cell_count = BTreePageFormat::CellCount(leaf_->data());
+    if (cell_count != 0) {
+      slot_ = cell_count - 1;
+      return Status::kSuccess;
+    }
+
+    Status status = MoveToLeaf(BTreePageFormat::PrevLeafId64(leaf_->data()));
+    if (status != Status::kSuccess)
+      return status;
+    PrefetchLeaf(BTreePageFormat::PrevLeafId64(leaf_->data()));
+  }
+}
+
+Status CursorImpl::MoveToLeaf(uint64_t sibling_id64) {
+  DCHECK(IsValid());
+
+  if (sibling_id64 == BTree::kInvalidPageId) {
+    Invalidate();
+    return Status::kNotFound;
+  }
+
+  // The current leaf is released before the sibling is fetched, so one-shot
+  // scans can recycle the current leaf's page pool entry.
+  Invalidate();
+  BTree tree(transaction_, root_page_id_);
+  Page* sibling;
+  Status status = tree.FetchLeaf(sibling_id64, &sibling);
+  if (status != Status::kSuccess)
+    return status;
+  leaf_ = sibling;
+  return Status::kSuccess;
+}
+
+void CursorImpl::PrefetchLeaf(uint64_t leaf_id64) {
+  size_t leaf_id = static_cast<size_t>(leaf_id64);
+  // This check should be optimized out on 64-bit architectures.
+  if (leaf_id != leaf_id64 || leaf_id == BTree::kInvalidPageId)
+    return;
+  page_pool_->Prefetch(transaction_->store(), &leaf_id, 1);
+}
+
+void CursorImpl::Invalidate() noexcept {
+  if (leaf_ == nullptr)
+    return;
+
+  if (unpin_mode_ == PagePool::kDiscardPage)
+    page_pool_->UnpinStorePage(leaf_, PagePool::kDiscardPage);
+  else
+    page_pool_->UnpinStorePage(leaf_, PagePool::kCachePage);
+  leaf_ = nullptr;
+}
+
+}  // namespace berrydb
@@ -0,0 +1,143 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_CURSOR_IMPL_H_
+#define BERRYDB_CURSOR_IMPL_H_
+
+#include "berrydb/cursor.h"
+#include "berrydb/platform.h"
+#include "./page_pool.h"
+
+namespace berrydb {
+
+struct CursorOptions;
+class Page;
+class TransactionImpl;
+
+/** Internal representation for the Cursor class in the public API.
+ *
+ * A positioned cursor owns a pin on the B+tree leaf that holds its current
+ * key-value pair. Next() and Prev() follow the leaves' sibling links, so they
+ * only descend from the tree's root when a Seek call is issued.
+ */
+class CursorImpl {
+ public:
+  /** Creates a CursorImpl instance.
+   *
+   * @param transaction  the transaction used to read the tree's pages
+   * @param root_page_id the ID of the root page of the space's B+tree
+   * @param options      the cursor's configuration
+   */
+  static CursorImpl* Create(TransactionImpl* transaction, size_t root_page_id,
+                            const CursorOptions& options);
+
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline CursorImpl* FromApi(Cursor* api) noexcept {
+    CursorImpl* impl = reinterpret_cast<CursorImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline const CursorImpl* FromApi(const Cursor* api) noexcept {
+    const CursorImpl* impl = reinterpret_cast<const CursorImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+
+  /** Computes the public API representation for this cursor. */
+  inline Cursor* ToApi() noexcept { return &api_; }
+
+  // See the public API documention for details.
+  Status Seek(string_view key);
+  Status SeekToLast();
+  Status Next();
+  Status Prev();
+  inline bool IsValid() const noexcept { return leaf_ != nullptr; }
+  string_view key();
+  string_view value();
+  void Release();
+
+ private:
+  /** Use CursorImpl::Create() to obtain CursorImpl instances. */
+  CursorImpl(TransactionImpl* transaction, size_t root_page_id,
+             const CursorOptions& options);
+  /** Use Release() to destroy CursorImpl instances. */
+  ~CursorImpl();
+
+  // Cursors cannot be copied or moved.
+  CursorImpl(const CursorImpl& other) = delete;
+  CursorImpl(CursorImpl&& other) = delete;
+  CursorImpl& operator=(const CursorImpl& other) = delete;
+  CursorImpl& operator=(CursorImpl&& other) = delete;
+
+  /** Follows next leaf links until the cursor's slot points to a cell.
+   *
+   * Leaves can be empty, because they are not merged when keys are deleted.
+   * Invalidates the cursor if it moves past the last leaf. */
+  Status SkipForward();
+
+  /** Follows previous leaf links until the cursor's slot points to a cell.
+   *
+   * The cursor's slot is ignored, and the cursor is positioned on the last cell
+   * of the first non-empty leaf. Invalidates the cursor if it moves past the
+   * first leaf. */
+  Status SkipBackward();
+
+  /** Replaces the cursor's leaf with one of its siblings.
+   *
+   * @param  sibling_id64 the ID of the leaf that the cursor is moving to; may
+   *                      be kInvalidPageId at the ends of the leaf chain
+   * @return              kNotFound at the ends of the leaf chain; otherwise,
+   *                      most likely kSuccess or kIoError; the cursor is
+   *                      invalidated if the call fails
+   */
+  Status MoveToLeaf(uint64_t sibling_id64);
+
+  /** Starts reading a leaf that the cursor is likely to move to next.
+   *
+   * @param leaf_id64 the ID of the leaf; may be kInvalidPageId at the ends of
+   *                  the leaf chain
+   */
+  void PrefetchLeaf(uint64_t leaf_id64);
+
+  /** Removes the cursor's pin on its current leaf, invalidating the cursor. */
+  void Invalidate() noexcept;
+
+  /* The public API version of this class. */
+  Cursor api_;  // Must be the first class member.
+
+  /** The transaction used to read the tree's pages. */
+  TransactionImpl* const transaction_;
+  /** The page pool that caches the tree's pages. */
+  PagePool* const page_pool_;
+  /** The ID of the root page of the space's B+tree. */
+  const size_t root_page_id_;
+  /** Used when the cursor stops using a leaf page. */
+  const PagePool::PageUnpinMode unpin_mode_;
+
+  /** The leaf holding the cursor's current position. nullptr if invalid. */
+  Page* leaf_ = nullptr;
+  /** The position of the cursor's cell in the current leaf. */
+  size_t slot_ = 0;
+
+  /** Holds the key returned by key(), when the key must be assembled.
+   *
+   * Keys are stored in leaves as a common prefix and a per-cell suffix. The
+   * buffer is reused across calls, and is only grown when a larger key is
+   * read. */
+  uint8_t* key_buffer_ = nullptr;
+  size_t key_buffer_size_ = 0;
+
+  /** Holds the value returned by value(), when the value is stored in overflow
+   * pages.
+   *
+   * The buffer is reused across calls, and is only grown when a larger value
+   * is read. */
+  uint8_t* value_buffer_ = nullptr;
+  size_t value_buffer_size_ = 0;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_CURSOR_IMPL_H_
@@ -0,0 +1,266 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./cursor_impl.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/options.h"
+#include "berrydb/space.h"
+#include "berrydb/status.h"
+#include "./page_pool.h"
+#include "./pool_impl.h"
+#include "./space_impl.h"
+#include "./store_impl.h"
+#include "./test/file_deleter.h"
+#include "./transaction_impl.h"
+#include "./util/unique_ptr.h"
+
+// TODO(pwnall): Remove this once we don't need to print a Status value.
+#include "berrydb/ostream_ops.h"
+
+namespace berrydb {
+
+namespace {
+
+string_view ToStringView(const std::string& string) {
+  return string_view(string.data(), string.size());
+}
+
+std::string FromStringView(string_view view) {
+  return std::string(view.data(), view.size());
+}
+
+}  // namespace
+
+class CursorImplTest : public ::testing::Test {
+ protected:
+  CursorImplTest()
+      : data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) { }
+
+  void SetUp() override {
+    PoolOptions options;
+    options.page_shift = kStorePageShift;
+    options.page_pool_size = 64;
+    pool_.reset(PoolImpl::Create(options));
+
+    StoreImpl* raw_store;
+    ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+        kStoreFileName, StoreOptions(), &raw_store));
+    store_.reset(raw_store);
+
+    transaction_.reset(store_->CreateTransaction());
+    SpaceImpl* raw_space;
+    ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+        nullptr, "space", &raw_space));
+    space_.reset(raw_space->ToApi());
+  }
+
+  /** Adds keys that span many leaves, and returns them in sorted order. */
+  std::vector<std::string> PutKeys(int key_count) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < key_count; ++i) {
+      char key[32];
+      std::snprintf(key, sizeof(key), "prefix/key%06d", i);
+      keys.push_back(key);
+    }
+    for (const std::string& key : keys) {
+      std::string value = "value of " + key;
+      EXPECT_EQ(Status::kSuccess, transaction_->Put(
+          space_.get(), ToStringView(key), ToStringView(value)));
+    }
+    return keys;
+  }
+
+  /** Creates a cursor over the test space. */
+  CursorImpl* CreateCursor(bool one_shot) {
+    CursorOptions options;
+    options.one_shot = one_shot;
+    CursorImpl* cursor;
+    EXPECT_EQ(Status::kSuccess, transaction_->CreateCursor(
+        space_.get(), options, &cursor));
+    return cursor;
+  }
+
+  const std::string kStoreFileName = "test_cursor.berry";
+  static constexpr size_t kStorePageShift = 9;  // 512-byte pages
+
+  // Must precede UniquePtr members, because on Windows all file handles must be
+  // closed before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  UniquePtr<PoolImpl> pool_;
+  UniquePtr<StoreImpl> store_;
+  UniquePtr<TransactionImpl> transaction_;
+  UniquePtr<Space> space_;
+};
+
+constexpr size_t CursorImplTest::kStorePageShift;
+
+TEST_F(CursorImplTest, EmptySpace) {
+  UniquePtr<CursorImpl> cursor(CreateCursor(false));
+  EXPECT_FALSE(cursor->IsValid());
+  EXPECT_EQ(Status::kNotFound, cursor->Seek(""));
+  EXPECT_FALSE(cursor->IsValid());
+  EXPECT_EQ(Status::kNotFound, cursor->SeekToLast());
+  EXPECT_FALSE(cursor->IsValid());
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(CursorImplTest, ForwardScan) {
+  std::vector<std::string> keys = PutKeys(500);
+  UniquePtr<CursorImpl> cursor(CreateCursor(false));
+
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(""));
+  std::vector<std::string> scanned_keys;
+  while (true) {
+    ASSERT_TRUE(cursor->IsValid());
+    std::string key = FromStringView(cursor->key());
+    EXPECT_EQ("value of " + key, FromStringView(cursor->value()));
+    scanned_keys.push_back(key);
+    EXPECT_EQ(1U, store_->page_pool()->pinned_pages());
+
+    Status status = cursor->Next();
+    if (status == Status::kNotFound)
+      break;
+    ASSERT_EQ(Status::kSuccess, status);
+  }
+  EXPECT_FALSE(cursor->IsValid());
+  EXPECT_EQ(keys, scanned_keys);
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(CursorImplTest, BackwardScan) {
+  std::vector<std::string> keys = PutKeys(500);
+  UniquePtr<CursorImpl> cursor(CreateCursor(false));
+
+  ASSERT_EQ(Status::kSuccess, cursor->SeekToLast());
+  std::vector<std::string> scanned_keys;
+  while (true) {
+    ASSERT_TRUE(cursor->IsValid());
+    scanned_keys.insert(scanned_keys.begin(), FromStringView(cursor->key()));
+
+    Status status = cursor->Prev();
+    if (status == Status::kNotFound)
+      break;
+    ASSERT_EQ(Status::kSuccess, status);
+  }
+  EXPECT_FALSE(cursor->IsValid());
+  EXPECT_EQ(keys, scanned_keys);
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(CursorImplTest, SeekAndStep) {
+  std::vector<std::string> keys = PutKeys(500);
+  UniquePtr<CursorImpl> cursor(CreateCursor(false));
+
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(ToStringView(keys[250])));
+  EXPECT_EQ(keys[250], FromStringView(cursor->key()));
+
+  // Seeking a missing key finds the next key.
+  std::string missing_key = keys[100] + "+";
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(ToStringView(missing_key)));
+  EXPECT_EQ(keys[101], FromStringView(cursor->key()));
+  ASSERT_EQ(Status::kSuccess, cursor->Prev());
+  EXPECT_EQ(keys[100], FromStringView(cursor->key()));
+  ASSERT_EQ(Status::kSuccess, cursor->Next());
+  ASSERT_EQ(Status::kSuccess, cursor->Next());
+  EXPECT_EQ(keys[102], FromStringView(cursor->key()));
+
+  EXPECT_EQ(Status::kNotFound, cursor->Seek("z"));
+  EXPECT_FALSE(cursor->IsValid());
+
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(""));
+  EXPECT_EQ(keys[0], FromStringView(cursor->key()));
+  EXPECT_EQ(Status::kNotFound, cursor->Prev());
+  EXPECT_FALSE(cursor->IsValid());
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(CursorImplTest, SkipsEmptyLeaves) {
+  std::vector<std::string> keys = PutKeys(500);
+
+  // Deleting a long run of keys empties the leaves in the middle of the tree.
+  std::vector<std::string> expected_keys;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i >= 10 && i < 490) {
+      ASSERT_EQ(Status::kSuccess, transaction_->Delete(
+          space_.get(), ToStringView(keys[i])));
+    } else {
+      expected_keys.push_back(keys[i]);
+    }
+  }
+
+  UniquePtr<CursorImpl> cursor(CreateCursor(false));
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(ToStringView(keys[100])));
+  EXPECT_EQ(keys[490], FromStringView(cursor->key()));
+  ASSERT_EQ(Status::kSuccess, cursor->Prev());
+  EXPECT_EQ(keys[9], FromStringView(cursor->key()));
+
+  std::vector<std::string> scanned_keys;
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(""));
+  do {
+    scanned_keys.push_back(FromStringView(cursor->key()));
+  } while (cursor->Next() == Status::kSuccess);
+  EXPECT_EQ(expected_keys, scanned_keys);
+}
+
+TEST_F(CursorImplTest, OneShotScan) {
+  std::vector<std::string> keys = PutKeys(500);
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  transaction_.reset(store_->CreateTransaction());
+
+  UniquePtr<CursorImpl> cursor(CreateCursor(true));
+  std::vector<std::string> scanned_keys;
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(""));
+  do {
+    scanned_keys.push_back(FromStringView(cursor->key()));
+    EXPECT_EQ(1U, store_->page_pool()->pinned_pages());
+  } while (cursor->Next() == Status::kSuccess);
+  EXPECT_EQ(keys, scanned_keys);
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(CursorImplTest, LargeValues) {
+  std::vector<std::string> keys = PutKeys(50);
+  std::string large_value(5000, 'v');
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), ToStringView(keys[10]), ToStringView(large_value)));
+  large_value.append(3000, 'w');
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), ToStringView(keys[20]), ToStringView(large_value)));
+
+  UniquePtr<CursorImpl> cursor(CreateCursor(false));
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(ToStringView(keys[10])));
+  EXPECT_EQ(std::string(5000, 'v'), FromStringView(cursor->value()));
+  // The overflow pages are not pinned after the value is copied.
+  EXPECT_EQ(1U, store_->page_pool()->pinned_pages());
+  ASSERT_EQ(Status::kSuccess, cursor->Next());
+  EXPECT_EQ("value of " + keys[11], FromStringView(cursor->value()));
+
+  ASSERT_EQ(Status::kSuccess, cursor->Seek(ToStringView(keys[20])));
+  EXPECT_EQ(large_value, FromStringView(cursor->value()));
+  EXPECT_EQ(keys[20], FromStringView(cursor->key()));
+  EXPECT_EQ(1U, store_->page_pool()->pinned_pages());
+}
+
+TEST_F(CursorImplTest, ClosedTransaction) {
+  PutKeys(10);
+  UniquePtr<CursorImpl> cursor(CreateCursor(false));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  EXPECT_EQ(Status::kAlreadyClosed, cursor->Seek(""));
+  EXPECT_EQ(Status::kAlreadyClosed, cursor->SeekToLast());
+
+  CursorImpl* raw_cursor;
+  EXPECT_EQ(Status::kAlreadyClosed, transaction_->CreateCursor(
+      space_.get(), CursorOptions(), &raw_cursor));
+}
+
+}  // namespace berrydb
@@ -19,4 +19,21 @@ TEST(AllocTest, DoesNotCrash) {
   Deallocate(buffer, 64);
 }
 
+TEST(AllocTest, AlignedDoesNotCrash) {
+  for (size_t alignment : {64, 4096, 2 << 20}) {
+    void* buffer = AllocateAligned(alignment * 2, alignment, false);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(buffer) & (alignment - 1));
+    std::memset(buffer, '\0', alignment * 2);
+    DeallocateAligned(buffer, alignment * 2);
+  }
+}
+
+TEST(AllocTest, HugePagesDoesNotCrash) {
+  constexpr size_t kHugePageSize = 2 << 20;
+  void* buffer = AllocateAligned(kHugePageSize, kHugePageSize, true);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(buffer) & (kHugePageSize - 1));
+  std::memset(buffer, '\0', kHugePageSize);
+  DeallocateAligned(buffer, kHugePageSize);
+}
+
 }  // namespace berrydb
@@ -36,4 +36,30 @@ TEST(EndiannessTest, LoadMatchesStore) {
   EXPECT_EQ(0xCDCDCDCDCDCDCDCDU, LoadUint64(buffer + 24));
 }
 
+TEST(EndiannessTest, LoadMatchesStore32) {
+  alignas(8) uint8_t buffer[16];
+  std::memset(buffer, 0xCD, sizeof(buffer));
+
+  uint32_t magic1 = 0x42657272;
+  uint32_t magic2 = 0x44425374;
+
+  StoreUint32(magic1, buffer + 4);
+  for (size_t i = 0; i < 4; ++i)
+    EXPECT_EQ(0xCD, buffer[i]);
+  for (size_t i = 8; i < 16; ++i)
+    EXPECT_EQ(0xCD, buffer[i]);
+
+  EXPECT_EQ(magic1, LoadUint32(buffer + 4));
+
+  StoreUint32(magic2, buffer + 4);
+  EXPECT_EQ(magic2, LoadUint32(buffer + 4));
+
+  StoreUint32(magic1, buffer + 8);
+  EXPECT_EQ(magic2, LoadUint32(buffer + 4));
+  EXPECT_EQ(magic1, LoadUint32(buffer + 8));
+
+  EXPECT_EQ(0xCDCDCDCDU, LoadUint32(buffer));
+  EXPECT_EQ(0xCDCDCDCDU, LoadUint32(buffer + 12));
+}
+
 }  // namespace berrydb
@@ -10,6 +10,7 @@
 
 #include "gtest/gtest.h"
 
+#include "berrydb/platform.h"
 #include "berrydb/status.h"
 #include "../test/file_deleter.h"
 
@@ -33,14 +34,14 @@ TEST_F(VfsTest, OpenForBlockAccessOptions) {
 
   // Setup guarantees that the file does not exist.
   ASSERT_NE(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, false, false, &file, &file_size));
+      kFileName, kBlockShift, false, false, false, &file, &file_size));
   EXPECT_EQ(nullptr, file);
   EXPECT_EQ(kInvalidSize, file_size);
 
   file = nullptr;
   file_size = kInvalidSize;
   ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, true, true, &file, &file_size));
+      kFileName, kBlockShift, true, true, false, &file, &file_size));
   ASSERT_NE(nullptr, file);
   EXPECT_EQ(0U, file_size);
   EXPECT_EQ(Status::kSuccess, file->Close());
@@ -49,14 +50,14 @@ TEST_F(VfsTest, OpenForBlockAccessOptions) {
   file = nullptr;
   file_size = kInvalidSize;
   ASSERT_NE(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, true, true, &file, &file_size));
+      kFileName, kBlockShift, true, true, false, &file, &file_size));
   EXPECT_EQ(nullptr, file);
   EXPECT_EQ(kInvalidSize, file_size);
 
   file = nullptr;
   file_size = kInvalidSize;
   ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, true, false, &file, &file_size));
+      kFileName, kBlockShift, true, false, false, &file, &file_size));
   ASSERT_NE(nullptr, file);
   EXPECT_EQ(0U, file_size);
   EXPECT_EQ(Status::kSuccess, file->Close());
@@ -64,12 +65,43 @@ TEST_F(VfsTest, OpenForBlockAccessOptions) {
   file = nullptr;
   file_size = kInvalidSize;
   ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, false, false, &file, &file_size));
+      kFileName, kBlockShift, false, false, false, &file, &file_size));
   ASSERT_NE(nullptr, file);
   EXPECT_EQ(0U, file_size);
   EXPECT_EQ(Status::kSuccess, file->Close());
 }
 
+TEST_F(VfsTest, OpenForBlockReads) {
+  uint8_t buffer[1 << kBlockShift], read_buffer[1 << kBlockShift];
+  BlockAccessFile* file = nullptr;
+  const size_t kInvalidSize = 0x0badc0de;
+  size_t file_size = kInvalidSize;
+
+  // Setup guarantees that the file does not exist.
+  ASSERT_NE(Status::kSuccess, vfs_->OpenForBlockReads(
+      kFileName, kBlockShift, &file, &file_size));
+  EXPECT_EQ(nullptr, file);
+  EXPECT_EQ(kInvalidSize, file_size);
+
+  for (size_t i = 0; i < 1 << kBlockShift; ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, true, false, &file, &file_size));
+  EXPECT_EQ(Status::kSuccess, file->Write(buffer, 0, 1 << kBlockShift));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+
+  file = nullptr;
+  file_size = kInvalidSize;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockReads(
+      kFileName, kBlockShift, &file, &file_size));
+  ASSERT_NE(nullptr, file);
+  EXPECT_EQ(1U << kBlockShift, file_size);
+  EXPECT_EQ(Status::kSuccess, file->Read(0, 1 << kBlockShift, read_buffer));
+  EXPECT_EQ(0, std::memcmp(buffer, read_buffer, 1 << kBlockShift));
+  EXPECT_EQ(Status::kIoError, file->Write(buffer, 0, 1 << kBlockShift));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
 TEST_F(VfsTest, BlockAccessFilePersistence) {
   uint8_t buffer[1 << kBlockShift], read_buffer[1 << kBlockShift];
   BlockAccessFile* file = nullptr;
@@ -80,7 +112,7 @@ TEST_F(VfsTest, BlockAccessFilePersistence) {
     buffer[i] = static_cast<uint8_t>(rnd_());
 
   ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, true, false, &file, &file_size));
+      kFileName, kBlockShift, true, false, false, &file, &file_size));
   ASSERT_NE(nullptr, file);
   EXPECT_EQ(0U, file_size);
   EXPECT_EQ(Status::kSuccess, file->Write(buffer, 0, 1 << kBlockShift));
@@ -88,7 +120,7 @@ TEST_F(VfsTest, BlockAccessFilePersistence) {
 
   file = nullptr;
   ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, false, false, &file, &file_size));
+      kFileName, kBlockShift, false, false, false, &file, &file_size));
   ASSERT_NE(nullptr, file);
   EXPECT_EQ(1U << kBlockShift, file_size);
   EXPECT_EQ(Status::kSuccess, file->Read(0, 1 << kBlockShift, read_buffer));
@@ -110,7 +142,7 @@ TEST_F(VfsTest, BlockAccessFileReadWriteOffsets) {
   }
 
   ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-      kFileName, kBlockShift, true, false, &file, &file_size));
+      kFileName, kBlockShift, true, false, false, &file, &file_size));
   ASSERT_NE(nullptr, file);
   EXPECT_EQ(0U, file_size);
 
@@ -170,6 +202,200 @@ TEST_F(VfsTest, BlockAccessFileReadWriteOffsets) {
   EXPECT_EQ(Status::kSuccess, vfs_->RemoveFile(kFileName));
 }
 
+TEST_F(VfsTest, BlockAccessFileVectoredIo) {
+  constexpr size_t kBlockSize = 1 << kBlockShift;
+  uint8_t buffer[4][kBlockSize], read_buffer[4][kBlockSize];
+  BlockAccessFile* file = nullptr;
+  size_t file_size;
+
+  for (size_t i = 0; i < 4; ++i) {
+    for (size_t j = 0; j < kBlockSize; ++j)
+      buffer[i][j] = static_cast<uint8_t>(rnd_());
+  }
+
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, false, false, &file, &file_size));
+  ASSERT_NE(nullptr, file);
+
+  // Write blocks [3, 1, 2] starting at block 1. Blocks 1 and 2 are adjacent in
+  // memory, so they are described by one buffer.
+  const BlockIoBuffer write_buffers[] = {
+      {buffer[3], kBlockSize}, {buffer[1], 2 * kBlockSize}};
+  EXPECT_EQ(Status::kSuccess, file->Write(buffer[0], 0, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->WriteV(write_buffers, 2, kBlockSize));
+
+  EXPECT_EQ(Status::kSuccess, file->Read(
+      2 * kBlockSize, kBlockSize, read_buffer[0]));
+  EXPECT_EQ(0, std::memcmp(buffer[1], read_buffer[0], kBlockSize));
+
+  // Read the whole file back, splitting it differently.
+  std::memset(read_buffer, 0, sizeof(read_buffer));
+  const BlockIoBuffer read_buffers[] = {
+      {read_buffer[0], 2 * kBlockSize}, {read_buffer[3], kBlockSize},
+      {read_buffer[2], kBlockSize}};
+  EXPECT_EQ(Status::kSuccess, file->ReadV(0, read_buffers, 3));
+  EXPECT_EQ(0, std::memcmp(buffer[0], read_buffer[0], kBlockSize));
+  EXPECT_EQ(0, std::memcmp(buffer[3], read_buffer[1], kBlockSize));
+  EXPECT_EQ(0, std::memcmp(buffer[1], read_buffer[3], kBlockSize));
+  EXPECT_EQ(0, std::memcmp(buffer[2], read_buffer[2], kBlockSize));
+
+  // The last buffer would extend past the end of the file.
+  EXPECT_NE(Status::kSuccess, file->ReadV(kBlockSize, read_buffers, 3));
+
+  EXPECT_EQ(Status::kSuccess, file->Close());
+  EXPECT_EQ(Status::kSuccess, vfs_->RemoveFile(kFileName));
+}
+
+TEST_F(VfsTest, BlockAccessFileDirectIo) {
+  constexpr size_t kBlockSize = 1 << kBlockShift;
+  constexpr size_t kBufferSize = 4 * kBlockSize;
+  // Direct I/O requires buffers that are aligned to the block size.
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(
+      AllocateAligned(kBufferSize, kBlockSize, false));
+  uint8_t* read_buffer = reinterpret_cast<uint8_t*>(
+      AllocateAligned(kBufferSize, kBlockSize, false));
+  for (size_t i = 0; i < kBufferSize; ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  BlockAccessFile* file = nullptr;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, true, true, &file, &file_size));
+  ASSERT_NE(nullptr, file);
+  EXPECT_EQ(0U, file_size);
+  EXPECT_EQ(Status::kSuccess, file->Write(buffer, 0, kBufferSize));
+  EXPECT_EQ(Status::kSuccess, file->Read(
+      kBlockSize, 2 * kBlockSize, read_buffer));
+  EXPECT_EQ(0, std::memcmp(buffer + kBlockSize, read_buffer, 2 * kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Sync());
+  EXPECT_EQ(Status::kSuccess, file->Close());
+
+  // The data is visible to buffered I/O, and vice versa.
+  file = nullptr;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, false, false, false, &file, &file_size));
+  ASSERT_NE(nullptr, file);
+  EXPECT_EQ(kBufferSize, file_size);
+  EXPECT_EQ(Status::kSuccess, file->Read(0, kBufferSize, read_buffer));
+  EXPECT_EQ(0, std::memcmp(buffer, read_buffer, kBufferSize));
+  EXPECT_EQ(Status::kSuccess, file->Write(buffer, kBufferSize, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+
+  file = nullptr;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, false, false, true, &file, &file_size));
+  ASSERT_NE(nullptr, file);
+  EXPECT_EQ(kBufferSize + kBlockSize, file_size);
+  EXPECT_EQ(Status::kSuccess, file->Read(kBufferSize, kBlockSize, read_buffer));
+  EXPECT_EQ(0, std::memcmp(buffer, read_buffer, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+
+  DeallocateAligned(read_buffer, kBufferSize);
+  DeallocateAligned(buffer, kBufferSize);
+  EXPECT_EQ(Status::kSuccess, vfs_->RemoveFile(kFileName));
+}
+
+TEST_F(VfsTest, BlockAccessFileIoQueue) {
+  constexpr size_t kBlockSize = 1 << kBlockShift;
+  constexpr size_t kBlockCount = 16;
+  constexpr size_t kQueueDepth = 4;
+  uint8_t buffer[kBlockCount][kBlockSize];
+  uint8_t read_buffer[kBlockCount][kBlockSize];
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    for (size_t j = 0; j < kBlockSize; ++j)
+      buffer[i][j] = static_cast<uint8_t>(rnd_());
+  }
+
+  BlockAccessFile* file = nullptr;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, true, false, &file, &file_size));
+  BlockIoQueue* queue = nullptr;
+  ASSERT_EQ(Status::kSuccess, file->CreateIoQueue(kQueueDepth, &queue));
+  ASSERT_NE(nullptr, queue);
+
+  // Blocks are written in reverse order, keeping the queue full. The tags are
+  // the block numbers.
+  BlockIoCompletion completions[kQueueDepth];
+  size_t completion_count;
+  bool written[kBlockCount] = {};
+  size_t next_block = kBlockCount;
+  size_t pending_count = 0;
+  while (next_block > 0 || pending_count > 0) {
+    while (next_block > 0 && pending_count < kQueueDepth) {
+      --next_block;
+      ASSERT_EQ(Status::kSuccess, queue->SubmitWrite(
+          buffer[next_block], next_block << kBlockShift, kBlockSize,
+          reinterpret_cast<void*>(next_block)));
+      ++pending_count;
+    }
+    if (next_block > 0) {
+      // The queue is full.
+      EXPECT_EQ(Status::kInvalidArgument, queue->SubmitWrite(
+          buffer[0], 0, kBlockSize, nullptr));
+    }
+
+    ASSERT_EQ(Status::kSuccess, queue->Poll(
+        1, kQueueDepth, completions, &completion_count));
+    ASSERT_LE(1U, completion_count);
+    ASSERT_GE(pending_count, completion_count);
+    for (size_t i = 0; i < completion_count; ++i) {
+      size_t block = reinterpret_cast<size_t>(completions[i].tag);
+      ASSERT_GT(kBlockCount, block);
+      EXPECT_FALSE(written[block]) << "block: " << block;
+      EXPECT_EQ(Status::kSuccess, completions[i].status) << "block: " << block;
+      written[block] = true;
+    }
+    pending_count -= completion_count;
+  }
+
+  // Read the blocks back two at a time, in batches that fill up the queue.
+  for (size_t batch = 0; batch < kBlockCount; batch += 2 * kQueueDepth) {
+    for (size_t i = batch; i < batch + 2 * kQueueDepth; i += 2) {
+      ASSERT_EQ(Status::kSuccess, queue->SubmitRead(
+          i << kBlockShift, 2 * kBlockSize, read_buffer[i],
+          reinterpret_cast<void*>(i)));
+    }
+    ASSERT_EQ(Status::kSuccess, queue->Poll(
+        kQueueDepth, kQueueDepth, completions, &completion_count));
+    ASSERT_EQ(kQueueDepth, completion_count);
+    for (size_t i = 0; i < completion_count; ++i)
+      EXPECT_EQ(Status::kSuccess, completions[i].status);
+  }
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    EXPECT_EQ(0, std::memcmp(buffer[i], read_buffer[i], kBlockSize))
+        << "block: " << i;
+  }
+
+  // Reads past the end of the file fail.
+  ASSERT_EQ(Status::kSuccess, queue->SubmitRead(
+      kBlockCount << kBlockShift, kBlockSize, read_buffer[0], nullptr));
+  ASSERT_EQ(Status::kSuccess, queue->Poll(
+      1, kQueueDepth, completions, &completion_count));
+  ASSERT_EQ(1U, completion_count);
+  EXPECT_EQ(nullptr, completions[0].tag);
+  EXPECT_NE(Status::kSuccess, completions[0].status);
+
+  // Reads that straddle the end of the file transfer the data that exists,
+  // and then fail.
+  ASSERT_EQ(Status::kSuccess, queue->SubmitRead(
+      (kBlockCount - 1) << kBlockShift, 2 * kBlockSize, read_buffer[0],
+      nullptr));
+  ASSERT_EQ(Status::kSuccess, queue->Poll(
+      1, kQueueDepth, completions, &completion_count));
+  ASSERT_EQ(1U, completion_count);
+  EXPECT_EQ(nullptr, completions[0].tag);
+  EXPECT_NE(Status::kSuccess, completions[0].status);
+
+  // Polling without outstanding operations does not block.
+  ASSERT_EQ(Status::kSuccess, queue->Poll(
+      0, kQueueDepth, completions, &completion_count));
+  EXPECT_EQ(0U, completion_count);
+
+  queue->Release();
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
 TEST_F(VfsTest, OpenForRandomAccessOptions) {
   RandomAccessFile* file = nullptr;
   const size_t kInvalidSize = 0x0badc0de;
@@ -0,0 +1,346 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./btree_page_format.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace berrydb {
+
+constexpr size_t BTreePageFormat::kFlagsOffset;
+constexpr size_t BTreePageFormat::kCellCountOffset;
+constexpr size_t BTreePageFormat::kHeapStartOffset;
+constexpr size_t BTreePageFormat::kFragmentedBytesOffset;
+constexpr size_t BTreePageFormat::kNextLeafIdOffset;
+constexpr size_t BTreePageFormat::kPrevLeafIdOffset;
+constexpr size_t BTreePageFormat::kLeftmostChildIdOffset;
+constexpr size_t BTreePageFormat::kCommonPrefixOffsetOffset;
+constexpr size_t BTreePageFormat::kCommonPrefixSizeOffset;
+constexpr size_t BTreePageFormat::kFirstSlotOffset;
+constexpr size_t BTreePageFormat::kKeyPrefixSize;
+constexpr size_t BTreePageFormat::kCellOffsetSize;
+constexpr size_t BTreePageFormat::kSlotSize;
+constexpr size_t BTreePageFormat::kCellValueSizeOffset;
+constexpr size_t BTreePageFormat::kCellKeyOffset;
+constexpr size_t BTreePageFormat::kCellAlignment;
+constexpr uint32_t BTreePageFormat::kLeafFlag;
+constexpr uint32_t BTreePageFormat::kOverflowValueFlag;
+
+namespace {
+
+/** Computes the KeyPrefixFormat prefix of a key given as two pieces. */
+uint32_t PiecewiseKeyPrefix(string_view head, string_view tail) noexcept {
+  if (head.size() >= KeyPrefixFormat::kPrefixSize || tail.size() == 0)
+    return KeyPrefixFormat::Prefix(head);
+
+  char bytes[KeyPrefixFormat::kPrefixSize];
+  size_t tail_size = std::min(KeyPrefixFormat::kPrefixSize - head.size(),
+                              tail.size());
+  if (head.size() != 0)
+    std::memcpy(bytes, head.data(), head.size());
+  std::memcpy(bytes + head.size(), tail.data(), tail_size);
+  return KeyPrefixFormat::Prefix(string_view(bytes, head.size() + tail_size));
+}
+
+/** Reserves heap space and a slot for a new cell.
+ *
+ * The cell's key suffix is given as two pieces that are logically
+ * concatenated, so cells can be moved between pages with different common
+ * prefixes without building the re-encoded key in a temporary buffer.
+ *
+ * @return the new cell's location, or nullptr if the cell does not fit */
+uint8_t* AllocateCell(uint8_t* page_data, size_t slot, string_view key_head,
+                      string_view key_tail, size_t cell_size) noexcept {
+  using Format = BTreePageFormat;
+
+  size_t cell_count = Format::CellCount(page_data);
+  DCHECK_LE(slot, cell_count);
+  if (Format::FreeBytes(page_data) < cell_size + Format::kSlotSize)
+    return nullptr;
+
+  size_t cell_offset = Format::HeapStart(page_data) - cell_size;
+  StoreUint32(static_cast<uint32_t>(cell_offset),
+              page_data + Format::kHeapStartOffset);
+  StoreUint32(static_cast<uint32_t>(cell_count + 1),
+              page_data + Format::kCellCountOffset);
+
+  // Growing the prefix array by one entry shifts the whole offset array. The
+  // moves below go from the highest addresses to the lowest, so they don't
+  // overwrite data that hasn't been moved yet.
+  uint8_t* offsets = page_data + Format::CellOffsetsOffset(cell_count);
+  uint8_t* new_offsets = page_data + Format::CellOffsetsOffset(cell_count + 1);
+  std::memmove(new_offsets + (slot + 1) * Format::kCellOffsetSize,
+               offsets + slot * Format::kCellOffsetSize,
+               (cell_count - slot) * Format::kCellOffsetSize);
+  std::memmove(new_offsets, offsets, slot * Format::kCellOffsetSize);
+  StoreUint32(static_cast<uint32_t>(cell_offset),
+              new_offsets + slot * Format::kCellOffsetSize);
+
+  uint8_t* prefix = page_data + Format::kFirstSlotOffset +
+      slot * Format::kKeyPrefixSize;
+  std::memmove(prefix + Format::kKeyPrefixSize, prefix,
+               (cell_count - slot) * Format::kKeyPrefixSize);
+  StoreUint32(PiecewiseKeyPrefix(key_head, key_tail), prefix);
+
+  return page_data + cell_offset;
+}
+
+/** Writes a cell's key suffix, given as two pieces. See AllocateCell(). */
+void WriteCellKey(uint8_t* cell, string_view key_head,
+                  string_view key_tail) noexcept {
+  StoreUint32(static_cast<uint32_t>(key_head.size() + key_tail.size()), cell);
+  uint8_t* key_data = cell + BTreePageFormat::kCellKeyOffset;
+  if (key_head.size() != 0)
+    std::memcpy(key_data, key_head.data(), key_head.size());
+  if (key_tail.size() != 0)
+    std::memcpy(key_data + key_head.size(), key_tail.data(), key_tail.size());
+}
+
+/** Adds a leaf cell whose key suffix is given as two pieces. */
+bool InsertLeafCellPieces(uint8_t* page_data, size_t slot, string_view key_head,
+                          string_view key_tail, string_view value,
+                          bool is_overflow) noexcept {
+  using Format = BTreePageFormat;
+  DCHECK(Format::IsLeaf(page_data));
+
+  size_t key_size = key_head.size() + key_tail.size();
+  uint8_t* cell = AllocateCell(page_data, slot, key_head, key_tail,
+                               Format::LeafCellSize(key_size, value.size()));
+  if (cell == nullptr)
+    return false;
+
+  WriteCellKey(cell, key_head, key_tail);
+  DCHECK_EQ(0U, value.size() & Format::kOverflowValueFlag);
+  uint32_t value_size = static_cast<uint32_t>(value.size());
+  if (is_overflow)
+    value_size |= Format::kOverflowValueFlag;
+  StoreUint32(value_size, cell + Format::kCellValueSizeOffset);
+  if (value.size() != 0) {
+    std::memcpy(cell + Format::kCellKeyOffset + key_size, value.data(),
+                value.size());
+  }
+  return true;
+}
+
+/** Adds an inner node cell whose key suffix is given as two pieces. */
+bool InsertInnerCellPieces(uint8_t* page_data, size_t slot,
+                           string_view key_head, string_view key_tail,
+                           uint64_t child_id64) noexcept {
+  using Format = BTreePageFormat;
+  DCHECK(!Format::IsLeaf(page_data));
+
+  size_t key_size = key_head.size() + key_tail.size();
+  uint8_t* cell = AllocateCell(page_data, slot, key_head, key_tail,
+                               Format::InnerCellSize(key_size));
+  if (cell == nullptr)
+    return false;
+
+  WriteCellKey(cell, key_head, key_tail);
+  StoreUint32(0, cell + Format::kCellValueSizeOffset);
+  StoreUint64(child_id64, cell + Format::kCellKeyOffset +
+                          Format::AlignCellSize(key_size));
+  return true;
+}
+
+}  // namespace
+
+void BTreePageFormat::InitLeaf(uint8_t* page_data, size_t page_size) noexcept {
+  DCHECK(page_data != nullptr);
+  std::memset(page_data, 0, kFirstSlotOffset);
+  StoreUint32(kLeafFlag, page_data + kFlagsOffset);
+  StoreUint32(static_cast<uint32_t>(page_size), page_data + kHeapStartOffset);
+  StoreUint32(static_cast<uint32_t>(page_size),
+              page_data + kCommonPrefixOffsetOffset);
+}
+
+void BTreePageFormat::InitInner(uint8_t* page_data, size_t page_size,
+                                uint64_t leftmost_child_id64) noexcept {
+  DCHECK(page_data != nullptr);
+  std::memset(page_data, 0, kFirstSlotOffset);
+  StoreUint32(static_cast<uint32_t>(page_size), page_data + kHeapStartOffset);
+  StoreUint32(static_cast<uint32_t>(page_size),
+              page_data + kCommonPrefixOffsetOffset);
+  StoreUint64(leftmost_child_id64, page_data + kLeftmostChildIdOffset);
+}
+
+void BTreePageFormat::SetCommonPrefix(
+    uint8_t* page_data, string_view prefix_head,
+    string_view prefix_tail) noexcept {
+  DCHECK_EQ(0U, CellCount(page_data));
+  DCHECK_EQ(0U, CommonPrefixSize(page_data));
+  DCHECK_EQ(0U, FragmentedBytes(page_data));
+  DCHECK_EQ(HeapStart(page_data), CommonPrefixOffset(page_data));
+
+  size_t prefix_size = prefix_head.size() + prefix_tail.size();
+  DCHECK_LE(kFirstSlotOffset + AlignCellSize(prefix_size),
+            HeapStart(page_data));
+  size_t prefix_offset = HeapStart(page_data) - AlignCellSize(prefix_size);
+  uint8_t* prefix_data = page_data + prefix_offset;
+  if (prefix_head.size() != 0)
+    std::memcpy(prefix_data, prefix_head.data(), prefix_head.size());
+  if (prefix_tail.size() != 0) {
+    std::memcpy(prefix_data + prefix_head.size(), prefix_tail.data(),
+                prefix_tail.size());
+  }
+
+  StoreUint32(static_cast<uint32_t>(prefix_offset),
+              page_data + kHeapStartOffset);
+  StoreUint32(static_cast<uint32_t>(prefix_offset),
+              page_data + kCommonPrefixOffsetOffset);
+  StoreUint32(static_cast<uint32_t>(prefix_size),
+              page_data + kCommonPrefixSizeOffset);
+}
+
+size_t BTreePageFormat::LowerBound(
+    const uint8_t* page_data, string_view key, bool* found) noexcept {
+  DCHECK(found != nullptr);
+
+  // All the keys in the page start with the common prefix, so keys that don't
+  // start with it sort either before or after all the keys in the page.
+  size_t cell_count = CellCount(page_data);
+  string_view common_prefix = CommonPrefix(page_data);
+  if (!HasCommonPrefix(page_data, key)) {
+    *found = false;
+    return (key < common_prefix) ? 0 : cell_count;
+  }
+  key = key.substr(common_prefix.size());
+
+  // The prefix array narrows the search down to the keys that share the
+  // searched key's prefix. Only their cells need to be read.
+  uint32_t prefix = KeyPrefixFormat::Prefix(key);
+  const uint8_t* prefixes = KeyPrefixes(page_data);
+  size_t low = KeyPrefixFormat::LowerBound(prefixes, cell_count, prefix);
+  size_t prefix_end = low + KeyPrefixFormat::UpperBound(
+      prefixes + low * kKeyPrefixSize, cell_count - low, prefix);
+  size_t high = prefix_end;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (KeySuffix(page_data, middle) < key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  *found = low < prefix_end && KeySuffix(page_data, low) == key;
+  return low;
+}
+
+size_t BTreePageFormat::UpperBound(
+    const uint8_t* page_data, string_view key) noexcept {
+  // See LowerBound() for an explanation of the search strategy.
+  size_t cell_count = CellCount(page_data);
+  string_view common_prefix = CommonPrefix(page_data);
+  if (!HasCommonPrefix(page_data, key))
+    return (key < common_prefix) ? 0 : cell_count;
+  key = key.substr(common_prefix.size());
+
+  uint32_t prefix = KeyPrefixFormat::Prefix(key);
+  const uint8_t* prefixes = KeyPrefixes(page_data);
+  size_t low = KeyPrefixFormat::LowerBound(prefixes, cell_count, prefix);
+  size_t high = low + KeyPrefixFormat::UpperBound(
+      prefixes + low * kKeyPrefixSize, cell_count - low, prefix);
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (KeySuffix(page_data, middle) <= key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+bool BTreePageFormat::InsertLeafCell(
+    uint8_t* page_data, size_t slot, string_view key,
+    string_view value, bool is_overflow) noexcept {
+  DCHECK(HasCommonPrefix(page_data, key));
+  return InsertLeafCellPieces(page_data, slot,
+                              key.substr(CommonPrefixSize(page_data)),
+                              string_view(), value, is_overflow);
+}
+
+bool BTreePageFormat::InsertInnerCell(
+    uint8_t* page_data, size_t slot, string_view key,
+    uint64_t child_id64) noexcept {
+  DCHECK(HasCommonPrefix(page_data, key));
+  return InsertInnerCellPieces(page_data, slot,
+                               key.substr(CommonPrefixSize(page_data)),
+                               string_view(), child_id64);
+}
+
+void BTreePageFormat::RemoveCell(uint8_t* page_data, size_t slot) noexcept {
+  size_t cell_count = CellCount(page_data);
+  DCHECK_LT(slot, cell_count);
+
+  size_t fragmented_bytes = FragmentedBytes(page_data) +
+      CellSize(page_data, slot);
+  StoreUint32(static_cast<uint32_t>(fragmented_bytes),
+              page_data + kFragmentedBytesOffset);
+  StoreUint32(static_cast<uint32_t>(cell_count - 1),
+              page_data + kCellCountOffset);
+
+  // Shrinking the prefix array by one entry shifts the whole offset array. The
+  // moves below go from the lowest addresses to the highest, so they don't
+  // overwrite data that hasn't been moved yet.
+  uint8_t* prefix = page_data + kFirstSlotOffset + slot * kKeyPrefixSize;
+  std::memmove(prefix, prefix + kKeyPrefixSize,
+               (cell_count - slot - 1) * kKeyPrefixSize);
+
+  uint8_t* offsets = page_data + CellOffsetsOffset(cell_count);
+  uint8_t* new_offsets = page_data + CellOffsetsOffset(cell_count - 1);
+  std::memmove(new_offsets, offsets, slot * kCellOffsetSize);
+  std::memmove(new_offsets + slot * kCellOffsetSize,
+               offsets + (slot + 1) * kCellOffsetSize,
+               (cell_count - slot - 1) * kCellOffsetSize);
+}
+
+bool BTreePageFormat::AppendCell(
+    const uint8_t* from, size_t from_slot, uint8_t* to) noexcept {
+  DCHECK_EQ(IsLeaf(from), IsLeaf(to));
+
+  // The cell's full key is the source page's common prefix followed by the
+  // cell's key suffix. The destination's common prefix is removed from the
+  // full key, which may leave a part of the source's common prefix.
+  string_view from_prefix = CommonPrefix(from);
+  string_view from_suffix = KeySuffix(from, from_slot);
+  size_t to_prefix_size = CommonPrefixSize(to);
+  string_view key_head, key_tail;
+  if (to_prefix_size <= from_prefix.size()) {
+    key_head = from_prefix.substr(to_prefix_size);
+    key_tail = from_suffix;
+  } else {
+    DCHECK_LE(to_prefix_size - from_prefix.size(), from_suffix.size());
+    key_head = from_suffix.substr(to_prefix_size - from_prefix.size());
+  }
+
+  size_t to_slot = CellCount(to);
+  if (IsLeaf(to)) {
+    return InsertLeafCellPieces(to, to_slot, key_head, key_tail,
+                                Value(from, from_slot),
+                                IsOverflowValue(from, from_slot));
+  }
+  return InsertInnerCellPieces(to, to_slot, key_head, key_tail,
+                               ChildId64(from, from_slot));
+}
+
+void BTreePageFormat::Compact(
+    uint8_t* page_data, size_t page_size, uint8_t* scratch) noexcept {
+  std::memcpy(scratch, page_data, page_size);
+
+  size_t cell_count = CellCount(page_data);
+  uint8_t* offsets = page_data + CellOffsetsOffset(cell_count);
+  size_t heap_start = CommonPrefixOffset(page_data);
+  for (size_t slot = 0; slot < cell_count; ++slot) {
+    size_t cell_size = CellSize(scratch, slot);
+    heap_start -= cell_size;
+    std::memcpy(page_data + heap_start, scratch + CellOffset(scratch, slot),
+                cell_size);
+    StoreUint32(static_cast<uint32_t>(heap_start),
+                offsets + slot * kCellOffsetSize);
+  }
+  StoreUint32(static_cast<uint32_t>(heap_start),
+              page_data + kHeapStartOffset);
+  StoreUint32(0, page_data + kFragmentedBytesOffset);
+}
+
+}  // namespace berrydb
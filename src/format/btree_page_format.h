@@ -0,0 +1,447 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_BTREE_PAGE_FORMAT_H_
+#define BERRYDB_BTREE_PAGE_FORMAT_H_
+
+#include "berrydb/platform.h"
+#include "berrydb/string_view.h"
+#include "./key_prefix_format.h"
+
+namespace berrydb {
+
+/** The on-disk layout of the pages that make up a Space's B+tree.
+ *
+ * This class should only be used by the BTree implementation and tests.
+ *
+ * Leaf and inner nodes are both slotted pages. A page starts with a fixed-size
+ * header, followed by the slot directory. Cells are allocated from the end of
+ * the page towards the beginning, so the page's free space is the gap between
+ * the slot directory and the lowest cell (the heap start). Removing a cell only
+ * removes its slot, so the cell's bytes become fragmented free space, which is
+ * reclaimed by Compact().
+ *
+ * The slot directory consists of two arrays with one entry per cell, both
+ * sorted by the cells' keys. The first array holds the keys' 4-byte prefixes,
+ * computed by KeyPrefixFormat. It is followed by an array of 4-byte cell
+ * offsets. Key lookups search the dense prefix array first, and only read the
+ * cells whose key prefixes match the searched key's prefix.
+ *
+ * All the keys in a page start with the page's common prefix, which is stored
+ * once, at the end of the page. Cells only store the remainder of their keys
+ * (the key suffixes), and the key prefix array is computed from the suffixes.
+ * Keys that share long prefixes, such as hierarchical names, use much less
+ * space this way, and their key prefix array entries remain distinct. The
+ * common prefix can only be changed while the page is empty, so pages are
+ * rebuilt with AppendCell() when their prefix changes.
+ *
+ * The page header format is as follows:
+ *
+ *  0: 4-byte flags; kLeafFlag is set for leaf nodes
+ *  4: 4-byte number of cells (slots) in the page
+ *  8: 4-byte heap start - the offset of the lowest cell in the page
+ * 12: 4-byte number of fragmented bytes in the heap
+ * 16: 8-byte page ID - the next leaf for leaves, leftmost child for inner nodes
+ * 24: 8-byte page ID - the previous leaf for leaves, must be 0 for inner nodes
+ * 32: 4-byte offset of the common key prefix; the page size if it is empty
+ * 36: 4-byte size of the common key prefix
+ *
+ * Cells are 8-byte aligned, and start with the same 8-byte header, so all keys
+ * can be read by the same code.
+ *
+ *  0: 4-byte key suffix size
+ *  4: 4-byte value size; must be 0 in inner nodes
+ *  8: the key suffix's bytes
+ *
+ * Leaf cells store the value's bytes right after the key. Values that are too
+ * large to fit in a leaf are stored in overflow pages, and their cells hold a
+ * reference in the format used by OverflowPageFormat. These cells have
+ * kOverflowValueFlag set in their value size. Inner cells store an
+ * 8-byte child page ID after the key, at the first 8-byte-aligned offset. All
+ * the keys in an inner cell's child are greater than or equal to the cell's
+ * key, and smaller than the next cell's key. The keys in the leftmost child
+ * are smaller than the first cell's key.
+ */
+class BTreePageFormat {
+ public:
+  /** True if the given page holds a leaf node. */
+  static inline bool IsLeaf(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return (LoadUint32(page_data + kFlagsOffset) & kLeafFlag) != 0;
+  }
+
+  /** Number of cells (slots) in a page. */
+  static inline size_t CellCount(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return static_cast<size_t>(LoadUint32(page_data + kCellCountOffset));
+  }
+
+  /** Offset of the lowest cell in a page. Equals the page size if empty. */
+  static inline size_t HeapStart(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return static_cast<size_t>(LoadUint32(page_data + kHeapStartOffset));
+  }
+
+  /** Heap bytes used by removed cells, which can be reclaimed by Compact(). */
+  static inline size_t FragmentedBytes(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return static_cast<size_t>(LoadUint32(page_data + kFragmentedBytesOffset));
+  }
+
+  /** Offset of the page's common key prefix. */
+  static inline size_t CommonPrefixOffset(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return static_cast<size_t>(
+        LoadUint32(page_data + kCommonPrefixOffsetOffset));
+  }
+
+  /** Size of the page's common key prefix. */
+  static inline size_t CommonPrefixSize(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return static_cast<size_t>(
+        LoadUint32(page_data + kCommonPrefixSizeOffset));
+  }
+
+  /** The prefix shared by all the keys in a page. */
+  static inline string_view CommonPrefix(const uint8_t* page_data) noexcept {
+    return string_view(
+        reinterpret_cast<const char*>(
+            page_data + CommonPrefixOffset(page_data)),
+        CommonPrefixSize(page_data));
+  }
+
+  /** True if a key starts with the page's common prefix.
+   *
+   * Only keys that pass this check can be inserted in the page. */
+  static inline bool HasCommonPrefix(const uint8_t* page_data,
+                                     string_view key) noexcept {
+    string_view prefix = CommonPrefix(page_data);
+    return key.size() >= prefix.size() &&
+        key.substr(0, prefix.size()) == prefix;
+  }
+
+  /** Bytes between the slot directory and the heap. */
+  static inline size_t FreeBytes(const uint8_t* page_data) noexcept {
+    return HeapStart(page_data) -
+        (kFirstSlotOffset + CellCount(page_data) * kSlotSize);
+  }
+
+  /** Reads the page ID of a leaf's right sibling.
+   *
+   * The return value is a 64-bit number (uint64_t), so the caller has to deal
+   * with the possibility that a 32-bit computer is used to open a large
+   * database created by a 64-bit computer.
+   *
+   * @param  page_data the data buffer of a leaf page
+   * @return           the page ID of the next leaf; kInvalidPageId for the
+   *                   tree's last leaf
+   */
+  static inline uint64_t NextLeafId64(const uint8_t* page_data) noexcept {
+    DCHECK(IsLeaf(page_data));
+    return LoadUint64(page_data + kNextLeafIdOffset);
+  }
+  static inline void SetNextLeafId64(uint64_t page_id64,
+                                     uint8_t* page_data) noexcept {
+    DCHECK(IsLeaf(page_data));
+    StoreUint64(page_id64, page_data + kNextLeafIdOffset);
+  }
+
+  /** Reads the page ID of a leaf's left sibling. See NextLeafId64(). */
+  static inline uint64_t PrevLeafId64(const uint8_t* page_data) noexcept {
+    DCHECK(IsLeaf(page_data));
+    return LoadUint64(page_data + kPrevLeafIdOffset);
+  }
+  static inline void SetPrevLeafId64(uint64_t page_id64,
+                                     uint8_t* page_data) noexcept {
+    DCHECK(IsLeaf(page_data));
+    StoreUint64(page_id64, page_data + kPrevLeafIdOffset);
+  }
+
+  /** Reads the page ID of an inner node's leftmost child. */
+  static inline uint64_t LeftmostChildId64(const uint8_t* page_data) noexcept {
+    DCHECK(!IsLeaf(page_data));
+    return LoadUint64(page_data + kLeftmostChildIdOffset);
+  }
+  static inline void SetLeftmostChildId64(uint64_t page_id64,
+                                          uint8_t* page_data) noexcept {
+    DCHECK(!IsLeaf(page_data));
+    StoreUint64(page_id64, page_data + kLeftmostChildIdOffset);
+  }
+
+  /** The array of key prefixes in a page's slot directory.
+   *
+   * The array has CellCount() entries, in the format used by KeyPrefixFormat.
+   */
+  static inline const uint8_t* KeyPrefixes(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return page_data + kFirstSlotOffset;
+  }
+
+  /** The offset of the cell referenced by a slot. */
+  static inline size_t CellOffset(const uint8_t* page_data,
+                                  size_t slot) noexcept {
+    size_t cell_count = CellCount(page_data);
+    DCHECK_LT(slot, cell_count);
+    return static_cast<size_t>(LoadUint32(
+        page_data + CellOffsetsOffset(cell_count) + slot * kCellOffsetSize));
+  }
+
+  /** The offset of the cell offsets array in a page's slot directory. */
+  static inline constexpr size_t CellOffsetsOffset(size_t cell_count) noexcept {
+    return kFirstSlotOffset + cell_count * kKeyPrefixSize;
+  }
+
+  /** The part of a cell's key that follows the page's common prefix. */
+  static inline string_view KeySuffix(const uint8_t* page_data,
+                                      size_t slot) noexcept {
+    const uint8_t* cell = page_data + CellOffset(page_data, slot);
+    return string_view(reinterpret_cast<const char*>(cell + kCellKeyOffset),
+                       static_cast<size_t>(LoadUint32(cell)));
+  }
+
+  /** The value stored in a leaf cell.
+   *
+   * For cells whose values are stored in overflow pages, this is the reference
+   * to the overflow page chain. */
+  static inline string_view Value(const uint8_t* page_data,
+                                  size_t slot) noexcept {
+    DCHECK(IsLeaf(page_data));
+    const uint8_t* cell = page_data + CellOffset(page_data, slot);
+    size_t key_size = static_cast<size_t>(LoadUint32(cell));
+    return string_view(
+        reinterpret_cast<const char*>(cell + kCellKeyOffset + key_size),
+        CellValueSize(cell));
+  }
+
+  /** True if a leaf cell's value is stored in overflow pages. */
+  static inline bool IsOverflowValue(const uint8_t* page_data,
+                                     size_t slot) noexcept {
+    DCHECK(IsLeaf(page_data));
+    const uint8_t* cell = page_data + CellOffset(page_data, slot);
+    return (LoadUint32(cell + kCellValueSizeOffset) & kOverflowValueFlag) != 0;
+  }
+
+  /** The child page ID stored in an inner cell. See NextLeafId64(). */
+  static inline uint64_t ChildId64(const uint8_t* page_data,
+                                   size_t slot) noexcept {
+    DCHECK(!IsLeaf(page_data));
+    const uint8_t* cell = page_data + CellOffset(page_data, slot);
+    size_t key_size = static_cast<size_t>(LoadUint32(cell));
+    return LoadUint64(cell + kCellKeyOffset + AlignCellSize(key_size));
+  }
+
+  /** The number of heap bytes used by a leaf cell.
+   *
+   * @param  key_size   the size of the cell's key suffix
+   * @param  value_size the size of the cell's value
+   */
+  static inline constexpr size_t LeafCellSize(size_t key_size,
+                                              size_t value_size) noexcept {
+    return AlignCellSize(kCellKeyOffset + key_size + value_size);
+  }
+
+  /** The number of heap bytes used by an inner node cell.
+   *
+   * @param  key_size the size of the cell's key suffix
+   */
+  static inline constexpr size_t InnerCellSize(size_t key_size) noexcept {
+    return kCellKeyOffset + AlignCellSize(key_size) + 8;
+  }
+
+  /** The number of heap bytes used by a page's cell. */
+  static inline size_t CellSize(const uint8_t* page_data,
+                                size_t slot) noexcept {
+    const uint8_t* cell = page_data + CellOffset(page_data, slot);
+    size_t key_size = static_cast<size_t>(LoadUint32(cell));
+    if (IsLeaf(page_data))
+      return LeafCellSize(key_size, CellValueSize(cell));
+    return InnerCellSize(key_size);
+  }
+
+  /** The largest cell that can be stored in a page.
+   *
+   * The limit applies to cells whose keys are not compressed. It guarantees
+   * that a full page can be split into two pages that each have room for any
+   * cell. Each page must hold at least 4 cells.
+   */
+  static inline constexpr size_t MaxCellSize(size_t page_size) noexcept {
+    return ((page_size - kFirstSlotOffset) / 4 - kSlotSize) &
+        ~(kCellAlignment - 1);
+  }
+
+  /** True if a page's header is guaranteed to be invalid.
+   *
+   * This method should be used before operating on a page that comes from an
+   * external source (disk). The checks below are the minimum needed to protect
+   * the slot directory and the heap boundaries. Individual cells are not
+   * checked, to keep the cost constant.
+   *
+   * @param  page_data the page's data buffer
+   * @param  page_size the page size of the store data file
+   * @return           true if the page is guaranteed to be corrupted
+   */
+  static inline bool IsCorruptPage(const uint8_t* page_data,
+                                   size_t page_size) noexcept {
+    size_t heap_start = HeapStart(page_data);
+    size_t cell_count = CellCount(page_data);
+    size_t prefix_offset = CommonPrefixOffset(page_data);
+    return prefix_offset > page_size ||
+        CommonPrefixSize(page_data) > page_size - prefix_offset ||
+        heap_start > prefix_offset ||
+        cell_count > (page_size - kFirstSlotOffset) / kSlotSize ||
+        kFirstSlotOffset + cell_count * kSlotSize > heap_start;
+  }
+
+  /** Sets up an empty leaf page with no siblings and no common prefix. */
+  static void InitLeaf(uint8_t* page_data, size_t page_size) noexcept;
+
+  /** Sets up an empty inner node page with no common prefix.
+   *
+   * @param leftmost_child_id64 the page ID of the node's only child
+   */
+  static void InitInner(uint8_t* page_data, size_t page_size,
+                        uint64_t leftmost_child_id64) noexcept;
+
+  /** Sets the common prefix of an empty page.
+   *
+   * The prefix is given as two pieces that are logically concatenated. This
+   * matches the way keys are stored in pages, as a common prefix followed by a
+   * key suffix, so a prefix of any key can be passed without being copied.
+   *
+   * @param page_data   the data buffer of a page without any cells, which was
+   *                    never compacted
+   * @param prefix_head the first part of the prefix of all the keys that will
+   *                    be stored in the page
+   * @param prefix_tail the rest of the prefix; the whole prefix must fit in the
+   *                    page
+   */
+  static void SetCommonPrefix(uint8_t* page_data, string_view prefix_head,
+                              string_view prefix_tail) noexcept;
+
+  /** Finds the first slot whose key is greater than or equal to a given key.
+   *
+   * @param  page_data the data buffer of a leaf or inner node page
+   * @param  key       the key to search for; does not need to start with the
+   *                   page's common prefix
+   * @param  found     set to true if the returned slot holds the given key
+   * @return           a slot in [0, CellCount()]; CellCount() means that all
+   *                   the keys in the page are smaller than the given key
+   */
+  static size_t LowerBound(const uint8_t* page_data, string_view key,
+                           bool* found) noexcept;
+
+  /** Finds the first slot whose key is strictly greater than a given key.
+   *
+   * In inner nodes, the result identifies the child that covers the given key.
+   * 0 means the leftmost child, and i > 0 means the child in slot i - 1.
+   */
+  static size_t UpperBound(const uint8_t* page_data, string_view key) noexcept;
+
+  /** Adds a cell to a leaf page, if the page has enough contiguous free space.
+   *
+   * @param  page_data   the data buffer of a leaf page
+   * @param  slot        the new cell's position; must preserve the key order
+   * @param  key         the cell's key; must start with the page's common
+   *                     prefix
+   * @param  value       the cell's value
+   * @param  is_overflow if true, the value is a reference to the overflow
+   *                     pages that hold the key's value
+   * @return             false if the cell doesn't fit; the caller should
+   *                     Compact() or split the page, and try again
+   */
+  static bool InsertLeafCell(uint8_t* page_data, size_t slot, string_view key,
+                             string_view value,
+                             bool is_overflow = false) noexcept;
+
+  /** Adds a cell to an inner node page. See InsertLeafCell(). */
+  static bool InsertInnerCell(uint8_t* page_data, size_t slot, string_view key,
+                              uint64_t child_id64) noexcept;
+
+  /** Removes a cell from a page.
+   *
+   * The cell's bytes are not touched until the page is compacted, so the views
+   * returned by KeySuffix() and Value() for the removed cell remain valid until
+   * then. */
+  static void RemoveCell(uint8_t* page_data, size_t slot) noexcept;
+
+  /** Copies a cell from a page to the end of another page.
+   *
+   * The cell's key is re-encoded if the pages have different common prefixes.
+   *
+   * @param  from      the page holding the cell; must be the same kind of node
+   *                   (leaf or inner) as the destination page
+   * @param  from_slot the cell's position in the source page
+   * @param  to        the page receiving the cell; the cell's key must start
+   *                   with this page's common prefix, and must sort after all
+   *                   the keys in the page
+   * @return           false if the destination page does not have enough
+   *                   contiguous free space
+   */
+  static bool AppendCell(const uint8_t* from, size_t from_slot,
+                         uint8_t* to) noexcept;
+
+  /** Rewrites a page's heap so that it has no fragmented bytes.
+   *
+   * @param  page_data the page to be compacted
+   * @param  page_size the page size of the store data file
+   * @param  scratch   buffer of page_size bytes, used for temporary storage
+   */
+  static void Compact(uint8_t* page_data, size_t page_size,
+                      uint8_t* scratch) noexcept;
+
+  /** The size of a leaf cell's value, without the overflow flag. */
+  static inline size_t CellValueSize(const uint8_t* cell) noexcept {
+    return static_cast<size_t>(
+        LoadUint32(cell + kCellValueSizeOffset) & ~kOverflowValueFlag);
+  }
+
+  /** Rounds up a size to the cell alignment. */
+  static inline constexpr size_t AlignCellSize(size_t size) noexcept {
+    return (size + kCellAlignment - 1) & ~(kCellAlignment - 1);
+  }
+
+  /** The offset of the node flags in a page. */
+  static constexpr size_t kFlagsOffset = 0;
+  /** The offset of the number of cells in a page. */
+  static constexpr size_t kCellCountOffset = 4;
+  /** The offset of the heap start in a page. */
+  static constexpr size_t kHeapStartOffset = 8;
+  /** The offset of the number of fragmented heap bytes in a page. */
+  static constexpr size_t kFragmentedBytesOffset = 12;
+  /** The offset of a leaf's right sibling page ID. */
+  static constexpr size_t kNextLeafIdOffset = 16;
+  /** The offset of a leaf's left sibling page ID. */
+  static constexpr size_t kPrevLeafIdOffset = 24;
+  /** The offset of an inner node's leftmost child page ID. */
+  static constexpr size_t kLeftmostChildIdOffset = 16;
+  /** The offset of the common key prefix's offset in a page. */
+  static constexpr size_t kCommonPrefixOffsetOffset = 32;
+  /** The offset of the common key prefix's size in a page. */
+  static constexpr size_t kCommonPrefixSizeOffset = 36;
+
+  /** The offset of the slot directory in a page. */
+  static constexpr size_t kFirstSlotOffset = 40;
+  /** The size of a key prefix array entry. */
+  static constexpr size_t kKeyPrefixSize = KeyPrefixFormat::kPrefixSize;
+  /** The size of a cell offset array entry. */
+  static constexpr size_t kCellOffsetSize = 4;
+  /** The slot directory bytes used by each cell. */
+  static constexpr size_t kSlotSize = kKeyPrefixSize + kCellOffsetSize;
+
+  /** The offset of the value size in a cell. */
+  static constexpr size_t kCellValueSizeOffset = 4;
+  /** The offset of the key bytes in a cell. */
+  static constexpr size_t kCellKeyOffset = 8;
+  /** All cells start at multiples of this offset. */
+  static constexpr size_t kCellAlignment = 8;
+
+  /** Set in the flags of leaf node pages. */
+  static constexpr uint32_t kLeafFlag = 1;
+  /** Set in the value size of leaf cells whose values are in overflow pages. */
+  static constexpr uint32_t kOverflowValueFlag = 0x80000000;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_BTREE_PAGE_FORMAT_H_
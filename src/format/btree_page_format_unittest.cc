@@ -0,0 +1,414 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./btree_page_format.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "./key_prefix_format.h"
+
+namespace berrydb {
+
+class BTreePageFormatTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kPageSize = 256;
+
+  /** Checks that a page's key prefix array matches its cells' key suffixes. */
+  void CheckKeyPrefixes(const uint8_t* page_data) {
+    const uint8_t* prefixes = BTreePageFormat::KeyPrefixes(page_data);
+    size_t cell_count = BTreePageFormat::CellCount(page_data);
+    for (size_t slot = 0; slot < cell_count; ++slot) {
+      EXPECT_EQ(
+          KeyPrefixFormat::Prefix(BTreePageFormat::KeySuffix(page_data, slot)),
+          LoadUint32(prefixes + slot * BTreePageFormat::kKeyPrefixSize))
+          << "slot: " << slot;
+    }
+  }
+
+  /** The full key stored in a page cell. */
+  std::string Key(const uint8_t* page_data, size_t slot) {
+    string_view prefix = BTreePageFormat::CommonPrefix(page_data);
+    string_view suffix = BTreePageFormat::KeySuffix(page_data, slot);
+    std::string key(prefix.data(), prefix.size());
+    key.append(suffix.data(), suffix.size());
+    return key;
+  }
+
+  alignas(8) uint8_t page_[kPageSize];
+  alignas(8) uint8_t page2_[kPageSize];
+  alignas(8) uint8_t scratch_[kPageSize];
+};
+
+constexpr size_t BTreePageFormatTest::kPageSize;
+
+TEST_F(BTreePageFormatTest, InitLeaf) {
+  std::memset(page_, 0xCD, kPageSize);
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+
+  EXPECT_TRUE(BTreePageFormat::IsLeaf(page_));
+  EXPECT_EQ(0U, BTreePageFormat::CellCount(page_));
+  EXPECT_EQ(kPageSize, BTreePageFormat::HeapStart(page_));
+  EXPECT_EQ(0U, BTreePageFormat::FragmentedBytes(page_));
+  EXPECT_EQ(kPageSize - BTreePageFormat::kFirstSlotOffset,
+            BTreePageFormat::FreeBytes(page_));
+  EXPECT_EQ(0U, BTreePageFormat::NextLeafId64(page_));
+  EXPECT_EQ(0U, BTreePageFormat::PrevLeafId64(page_));
+  EXPECT_FALSE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+}
+
+TEST_F(BTreePageFormatTest, InitInner) {
+  std::memset(page_, 0xCD, kPageSize);
+  BTreePageFormat::InitInner(page_, kPageSize, 0x1234567890);
+
+  EXPECT_FALSE(BTreePageFormat::IsLeaf(page_));
+  EXPECT_EQ(0U, BTreePageFormat::CellCount(page_));
+  EXPECT_EQ(kPageSize, BTreePageFormat::HeapStart(page_));
+  EXPECT_EQ(0x1234567890U, BTreePageFormat::LeftmostChildId64(page_));
+  EXPECT_FALSE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+}
+
+TEST_F(BTreePageFormatTest, LeafCells) {
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 0, "key2", "value2"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 0, "key1", "value1"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 2, "key3", ""));
+  ASSERT_EQ(3U, BTreePageFormat::CellCount(page_));
+
+  EXPECT_EQ("key1", BTreePageFormat::KeySuffix(page_, 0));
+  EXPECT_EQ("value1", BTreePageFormat::Value(page_, 0));
+  EXPECT_EQ("key2", BTreePageFormat::KeySuffix(page_, 1));
+  EXPECT_EQ("value2", BTreePageFormat::Value(page_, 1));
+  EXPECT_EQ("key3", BTreePageFormat::KeySuffix(page_, 2));
+  EXPECT_EQ("", BTreePageFormat::Value(page_, 2));
+  CheckKeyPrefixes(page_);
+
+  EXPECT_EQ(BTreePageFormat::LeafCellSize(4, 6),
+            BTreePageFormat::CellSize(page_, 0));
+  EXPECT_EQ(0U, BTreePageFormat::CellOffset(page_, 0) %
+                BTreePageFormat::kCellAlignment);
+  EXPECT_EQ(kPageSize - 2 * BTreePageFormat::LeafCellSize(4, 6) -
+            BTreePageFormat::LeafCellSize(4, 0),
+            BTreePageFormat::HeapStart(page_));
+
+  bool found;
+  EXPECT_EQ(1U, BTreePageFormat::LowerBound(page_, "key2", &found));
+  EXPECT_TRUE(found);
+  EXPECT_EQ(1U, BTreePageFormat::LowerBound(page_, "key15", &found));
+  EXPECT_FALSE(found);
+  EXPECT_EQ(0U, BTreePageFormat::LowerBound(page_, "", &found));
+  EXPECT_FALSE(found);
+  EXPECT_EQ(3U, BTreePageFormat::LowerBound(page_, "key4", &found));
+  EXPECT_FALSE(found);
+
+  EXPECT_EQ(2U, BTreePageFormat::UpperBound(page_, "key2"));
+  EXPECT_EQ(1U, BTreePageFormat::UpperBound(page_, "key15"));
+  EXPECT_EQ(0U, BTreePageFormat::UpperBound(page_, "key"));
+  EXPECT_EQ(3U, BTreePageFormat::UpperBound(page_, "key3"));
+}
+
+TEST_F(BTreePageFormatTest, InnerCells) {
+  BTreePageFormat::InitInner(page_, kPageSize, 1);
+
+  ASSERT_TRUE(BTreePageFormat::InsertInnerCell(page_, 0, "m", 3));
+  ASSERT_TRUE(BTreePageFormat::InsertInnerCell(page_, 0, "f", 2));
+  ASSERT_TRUE(BTreePageFormat::InsertInnerCell(page_, 2, "twelve bytes", 4));
+  ASSERT_EQ(3U, BTreePageFormat::CellCount(page_));
+
+  EXPECT_EQ("f", BTreePageFormat::KeySuffix(page_, 0));
+  EXPECT_EQ(2U, BTreePageFormat::ChildId64(page_, 0));
+  EXPECT_EQ("m", BTreePageFormat::KeySuffix(page_, 1));
+  EXPECT_EQ(3U, BTreePageFormat::ChildId64(page_, 1));
+  EXPECT_EQ("twelve bytes", BTreePageFormat::KeySuffix(page_, 2));
+  EXPECT_EQ(4U, BTreePageFormat::ChildId64(page_, 2));
+  EXPECT_EQ(BTreePageFormat::InnerCellSize(12),
+            BTreePageFormat::CellSize(page_, 2));
+  EXPECT_EQ(1U, BTreePageFormat::LeftmostChildId64(page_));
+  CheckKeyPrefixes(page_);
+
+  EXPECT_EQ(0U, BTreePageFormat::UpperBound(page_, "a"));
+  EXPECT_EQ(1U, BTreePageFormat::UpperBound(page_, "f"));
+  EXPECT_EQ(2U, BTreePageFormat::UpperBound(page_, "p"));
+  EXPECT_EQ(3U, BTreePageFormat::UpperBound(page_, "z"));
+}
+
+TEST_F(BTreePageFormatTest, FullPage) {
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+
+  std::string value_string(BTreePageFormat::MaxCellSize(kPageSize) -
+                           BTreePageFormat::kCellKeyOffset - 1, 'v');
+  string_view value(value_string.data(), value_string.size());
+  for (char key = 'a'; key < 'e'; ++key) {
+    ASSERT_TRUE(BTreePageFormat::InsertLeafCell(
+        page_, BTreePageFormat::CellCount(page_), string_view(&key, 1),
+        value));
+  }
+  EXPECT_FALSE(BTreePageFormat::InsertLeafCell(page_, 4, "e", value));
+  EXPECT_EQ(4U, BTreePageFormat::CellCount(page_));
+  EXPECT_FALSE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+}
+
+TEST_F(BTreePageFormatTest, RemoveAndCompact) {
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 0, "a", "value a"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 1, "b", "value b"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 2, "c", "value c"));
+
+  size_t free_bytes = BTreePageFormat::FreeBytes(page_);
+  BTreePageFormat::RemoveCell(page_, 1);
+  EXPECT_EQ(2U, BTreePageFormat::CellCount(page_));
+  EXPECT_EQ("a", BTreePageFormat::KeySuffix(page_, 0));
+  EXPECT_EQ("c", BTreePageFormat::KeySuffix(page_, 1));
+  EXPECT_EQ(BTreePageFormat::LeafCellSize(1, 7),
+            BTreePageFormat::FragmentedBytes(page_));
+  EXPECT_EQ(free_bytes + BTreePageFormat::kSlotSize,
+            BTreePageFormat::FreeBytes(page_));
+  CheckKeyPrefixes(page_);
+
+  BTreePageFormat::Compact(page_, kPageSize, scratch_);
+  EXPECT_EQ(0U, BTreePageFormat::FragmentedBytes(page_));
+  EXPECT_EQ(free_bytes + BTreePageFormat::kSlotSize +
+            BTreePageFormat::LeafCellSize(1, 7),
+            BTreePageFormat::FreeBytes(page_));
+  EXPECT_EQ("a", BTreePageFormat::KeySuffix(page_, 0));
+  EXPECT_EQ("value a", BTreePageFormat::Value(page_, 0));
+  EXPECT_EQ("c", BTreePageFormat::KeySuffix(page_, 1));
+  EXPECT_EQ("value c", BTreePageFormat::Value(page_, 1));
+  CheckKeyPrefixes(page_);
+}
+
+TEST_F(BTreePageFormatTest, CommonPrefix) {
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  EXPECT_EQ(kPageSize, BTreePageFormat::CommonPrefixOffset(page_));
+  EXPECT_EQ(0U, BTreePageFormat::CommonPrefixSize(page_));
+  EXPECT_TRUE(BTreePageFormat::HasCommonPrefix(page_, ""));
+
+  BTreePageFormat::SetCommonPrefix(page_, "user/", "1234/");
+  EXPECT_EQ("user/1234/", BTreePageFormat::CommonPrefix(page_));
+  EXPECT_EQ(kPageSize - BTreePageFormat::AlignCellSize(10),
+            BTreePageFormat::CommonPrefixOffset(page_));
+  EXPECT_EQ(BTreePageFormat::CommonPrefixOffset(page_),
+            BTreePageFormat::HeapStart(page_));
+  EXPECT_TRUE(BTreePageFormat::HasCommonPrefix(page_, "user/1234/"));
+  EXPECT_TRUE(BTreePageFormat::HasCommonPrefix(page_, "user/1234/name"));
+  EXPECT_FALSE(BTreePageFormat::HasCommonPrefix(page_, "user/1234"));
+  EXPECT_FALSE(BTreePageFormat::HasCommonPrefix(page_, "user/1235/name"));
+  EXPECT_FALSE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(
+      page_, 0, "user/1234/name", "value"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 0, "user/1234/", "root"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(
+      page_, 2, "user/1234/zip", "value"));
+  ASSERT_EQ(3U, BTreePageFormat::CellCount(page_));
+  EXPECT_EQ("", BTreePageFormat::KeySuffix(page_, 0));
+  EXPECT_EQ("name", BTreePageFormat::KeySuffix(page_, 1));
+  EXPECT_EQ("zip", BTreePageFormat::KeySuffix(page_, 2));
+  EXPECT_EQ(BTreePageFormat::LeafCellSize(4, 5),
+            BTreePageFormat::CellSize(page_, 1));
+  CheckKeyPrefixes(page_);
+
+  // Keys without the common prefix sort before or after all the page's keys.
+  bool found;
+  EXPECT_EQ(0U, BTreePageFormat::LowerBound(page_, "user/1234", &found));
+  EXPECT_FALSE(found);
+  EXPECT_EQ(0U, BTreePageFormat::LowerBound(page_, "", &found));
+  EXPECT_FALSE(found);
+  EXPECT_EQ(3U, BTreePageFormat::LowerBound(page_, "user/1235", &found));
+  EXPECT_FALSE(found);
+  EXPECT_EQ(0U, BTreePageFormat::UpperBound(page_, "a"));
+  EXPECT_EQ(3U, BTreePageFormat::UpperBound(page_, "z"));
+
+  EXPECT_EQ(0U, BTreePageFormat::LowerBound(page_, "user/1234/", &found));
+  EXPECT_TRUE(found);
+  EXPECT_EQ(1U, BTreePageFormat::LowerBound(page_, "user/1234/name", &found));
+  EXPECT_TRUE(found);
+  EXPECT_EQ(2U, BTreePageFormat::LowerBound(page_, "user/1234/p", &found));
+  EXPECT_FALSE(found);
+  EXPECT_EQ(2U, BTreePageFormat::UpperBound(page_, "user/1234/name"));
+
+  // Compaction must preserve the common prefix.
+  BTreePageFormat::RemoveCell(page_, 0);
+  BTreePageFormat::Compact(page_, kPageSize, scratch_);
+  EXPECT_EQ("user/1234/", BTreePageFormat::CommonPrefix(page_));
+  EXPECT_EQ("user/1234/name", Key(page_, 0));
+  EXPECT_EQ("value", BTreePageFormat::Value(page_, 0));
+  EXPECT_EQ("user/1234/zip", Key(page_, 1));
+  EXPECT_FALSE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+  CheckKeyPrefixes(page_);
+}
+
+TEST_F(BTreePageFormatTest, AppendCell) {
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  BTreePageFormat::SetCommonPrefix(page_, "ab", "c");
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 0, "abcd1", "value 1"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 1, "abcd2", "value 2"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 2, "abce", "value 3"));
+
+  // A destination with a longer prefix removes bytes from the key suffixes.
+  BTreePageFormat::InitLeaf(page2_, kPageSize);
+  BTreePageFormat::SetCommonPrefix(page2_, "abcd", "");
+  ASSERT_TRUE(BTreePageFormat::AppendCell(page_, 0, page2_));
+  ASSERT_TRUE(BTreePageFormat::AppendCell(page_, 1, page2_));
+  ASSERT_EQ(2U, BTreePageFormat::CellCount(page2_));
+  EXPECT_EQ("1", BTreePageFormat::KeySuffix(page2_, 0));
+  EXPECT_EQ("value 1", BTreePageFormat::Value(page2_, 0));
+  EXPECT_EQ("2", BTreePageFormat::KeySuffix(page2_, 1));
+  EXPECT_EQ("value 2", BTreePageFormat::Value(page2_, 1));
+  CheckKeyPrefixes(page2_);
+
+  // A destination with a shorter prefix adds bytes to the key suffixes.
+  BTreePageFormat::InitLeaf(page2_, kPageSize);
+  BTreePageFormat::SetCommonPrefix(page2_, "a", "");
+  for (size_t slot = 0; slot < 3; ++slot)
+    ASSERT_TRUE(BTreePageFormat::AppendCell(page_, slot, page2_));
+  ASSERT_EQ(3U, BTreePageFormat::CellCount(page2_));
+  EXPECT_EQ("bcd1", BTreePageFormat::KeySuffix(page2_, 0));
+  EXPECT_EQ("bcd2", BTreePageFormat::KeySuffix(page2_, 1));
+  EXPECT_EQ("bce", BTreePageFormat::KeySuffix(page2_, 2));
+  EXPECT_EQ("value 3", BTreePageFormat::Value(page2_, 2));
+  for (size_t slot = 0; slot < 3; ++slot)
+    EXPECT_EQ(Key(page_, slot), Key(page2_, slot));
+  CheckKeyPrefixes(page2_);
+
+  BTreePageFormat::InitInner(page_, kPageSize, 1);
+  ASSERT_TRUE(BTreePageFormat::InsertInnerCell(page_, 0, "inner", 42));
+  BTreePageFormat::InitInner(page2_, kPageSize, 2);
+  BTreePageFormat::SetCommonPrefix(page2_, "in", "");
+  ASSERT_TRUE(BTreePageFormat::AppendCell(page_, 0, page2_));
+  EXPECT_EQ("ner", BTreePageFormat::KeySuffix(page2_, 0));
+  EXPECT_EQ(42U, BTreePageFormat::ChildId64(page2_, 0));
+  EXPECT_EQ(2U, BTreePageFormat::LeftmostChildId64(page2_));
+  CheckKeyPrefixes(page2_);
+}
+
+TEST_F(BTreePageFormatTest, OverflowValues) {
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 0, "a", "value a"));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(
+      page_, 1, "b", "reference b", true));
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 2, "c", "value c"));
+  EXPECT_FALSE(BTreePageFormat::IsOverflowValue(page_, 0));
+  EXPECT_TRUE(BTreePageFormat::IsOverflowValue(page_, 1));
+  EXPECT_EQ("reference b", BTreePageFormat::Value(page_, 1));
+
+  // The flag is not counted towards the cell's size.
+  size_t free_bytes = BTreePageFormat::FreeBytes(page_);
+  BTreePageFormat::RemoveCell(page_, 1);
+  EXPECT_EQ(BTreePageFormat::LeafCellSize(1, 11),
+            BTreePageFormat::FragmentedBytes(page_));
+  EXPECT_EQ(free_bytes + BTreePageFormat::kSlotSize,
+            BTreePageFormat::FreeBytes(page_));
+
+  // The flag survives compaction, and cells moved between pages.
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(
+      page_, 1, "bb", "reference bb", true));
+  BTreePageFormat::Compact(page_, kPageSize, scratch_);
+  EXPECT_FALSE(BTreePageFormat::IsOverflowValue(page_, 0));
+  EXPECT_TRUE(BTreePageFormat::IsOverflowValue(page_, 1));
+  EXPECT_EQ("reference bb", BTreePageFormat::Value(page_, 1));
+  EXPECT_FALSE(BTreePageFormat::IsOverflowValue(page_, 2));
+
+  BTreePageFormat::InitLeaf(page2_, kPageSize);
+  for (size_t slot = 0; slot < 3; ++slot)
+    ASSERT_TRUE(BTreePageFormat::AppendCell(page_, slot, page2_));
+  EXPECT_FALSE(BTreePageFormat::IsOverflowValue(page2_, 0));
+  EXPECT_TRUE(BTreePageFormat::IsOverflowValue(page2_, 1));
+  EXPECT_EQ("reference bb", BTreePageFormat::Value(page2_, 1));
+  EXPECT_FALSE(BTreePageFormat::IsOverflowValue(page2_, 2));
+  EXPECT_EQ("value c", BTreePageFormat::Value(page2_, 2));
+}
+
+TEST_F(BTreePageFormatTest, SearchLargePage) {
+  // Large pages exercise the vectorized search over the key prefix array.
+  constexpr size_t kLargePageSize = 16384;
+  std::vector<uint64_t> buffer(kLargePageSize / sizeof(uint64_t));
+  uint8_t* page_data = reinterpret_cast<uint8_t*>(buffer.data());
+  BTreePageFormat::InitLeaf(page_data, kLargePageSize);
+
+  // Many keys share their first 4 bytes, so ties must be broken by comparing
+  // the full keys.
+  std::vector<std::string> keys;
+  for (int i = 0; i < 600; i += 2) {
+    char key[16];
+    std::snprintf(key, sizeof(key), (i % 3 == 0) ? "key%d" : "k%d", i);
+    keys.push_back(key);
+  }
+  keys.push_back("");
+  keys.push_back("key");
+  keys.push_back("\xFF\xFF\xFF\xFF");
+  std::shuffle(keys.begin(), keys.end(), std::mt19937());
+
+  std::vector<std::string> sorted_keys;
+  for (const std::string& key : keys) {
+    string_view key_view(key.data(), key.size());
+    bool found;
+    size_t slot = BTreePageFormat::LowerBound(page_data, key_view, &found);
+    ASSERT_FALSE(found);
+    ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_data, slot, key_view, ""));
+
+    sorted_keys.insert(
+        std::lower_bound(sorted_keys.begin(), sorted_keys.end(), key), key);
+  }
+  CheckKeyPrefixes(page_data);
+  ASSERT_EQ(sorted_keys.size(), BTreePageFormat::CellCount(page_data));
+
+  for (size_t i = 0; i < sorted_keys.size(); ++i) {
+    const std::string& key = sorted_keys[i];
+    string_view key_view(key.data(), key.size());
+    EXPECT_EQ(key_view, BTreePageFormat::KeySuffix(page_data, i));
+
+    bool found;
+    EXPECT_EQ(i, BTreePageFormat::LowerBound(page_data, key_view, &found));
+    EXPECT_TRUE(found);
+    EXPECT_EQ(i + 1, BTreePageFormat::UpperBound(page_data, key_view));
+
+    // A key that sorts right after the current key, and is not in the page.
+    std::string next_key = key + '\0';
+    string_view next_key_view(next_key.data(), next_key.size());
+    EXPECT_EQ(i + 1,
+              BTreePageFormat::LowerBound(page_data, next_key_view, &found));
+    EXPECT_FALSE(found);
+    EXPECT_EQ(i + 1, BTreePageFormat::UpperBound(page_data, next_key_view));
+  }
+}
+
+TEST_F(BTreePageFormatTest, CorruptPage) {
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  ASSERT_TRUE(BTreePageFormat::InsertLeafCell(page_, 0, "a", "value a"));
+  EXPECT_FALSE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+
+  StoreUint32(kPageSize + 8, page_ + BTreePageFormat::kHeapStartOffset);
+  EXPECT_TRUE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  StoreUint32(1000, page_ + BTreePageFormat::kCellCountOffset);
+  EXPECT_TRUE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  StoreUint32(BTreePageFormat::kFirstSlotOffset,
+              page_ + BTreePageFormat::kHeapStartOffset);
+  StoreUint32(1, page_ + BTreePageFormat::kCellCountOffset);
+  EXPECT_TRUE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  BTreePageFormat::SetCommonPrefix(page_, "prefix", "");
+  EXPECT_FALSE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+  StoreUint32(kPageSize, page_ + BTreePageFormat::kCommonPrefixSizeOffset);
+  EXPECT_TRUE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+
+  BTreePageFormat::InitLeaf(page_, kPageSize);
+  StoreUint32(kPageSize + 8,
+              page_ + BTreePageFormat::kCommonPrefixOffsetOffset);
+  EXPECT_TRUE(BTreePageFormat::IsCorruptPage(page_, kPageSize));
+}
+
+}  // namespace berrydb
@@ -0,0 +1,14 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./catalog_entry_format.h"
+
+namespace berrydb {
+
+constexpr size_t CatalogEntryFormat::kTypeOffset;
+constexpr size_t CatalogEntryFormat::kReservedOffset;
+constexpr size_t CatalogEntryFormat::kRootPageIdOffset;
+constexpr size_t CatalogEntryFormat::kEntrySize;
+
+}  // namespace berrydb
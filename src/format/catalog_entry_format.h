@@ -0,0 +1,90 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_FORMAT_CATALOG_ENTRY_FORMAT_H_
+#define BERRYDB_FORMAT_CATALOG_ENTRY_FORMAT_H_
+
+#include "berrydb/platform.h"
+
+namespace berrydb {
+
+/** The on-disk layout of the entries in a catalog.
+ *
+ * This class should only be used by the CatalogImpl implementation and tests.
+ *
+ * A catalog is a B+tree whose keys are the names of the catalog's entries. The
+ * value stored for each name describes a space or a catalog, both of which are
+ * B+trees identified by their root pages.
+ *
+ * The entry format is as follows:
+ *
+ *  0: 1-byte entry type, see EntryType
+ *  1: 7 reserved bytes, must be 0
+ *  8: 8-byte page ID of the root page of the entry's B+tree
+ *
+ * Entries are stored right after their keys in leaf cells, so they are not
+ * necessarily aligned. The methods below require 8-byte aligned entries, so
+ * entries must be copied out of leaf cells before they are read.
+ */
+class CatalogEntryFormat {
+ public:
+  /** The kinds of objects described by catalog entries. */
+  enum class EntryType : uint8_t {
+    kSpace = 1,
+    kCatalog = 2,
+  };
+
+  /** The type of the object described by an entry. */
+  static inline EntryType Type(const uint8_t* entry) noexcept {
+    DCHECK(entry != nullptr);
+    return static_cast<EntryType>(entry[kTypeOffset]);
+  }
+
+  /** Reads the root page ID of the entry's B+tree.
+   *
+   * Like BTreePageFormat::NextLeafId64(), this returns a 64-bit number. */
+  static inline uint64_t RootPageId64(const uint8_t* entry) noexcept {
+    DCHECK(entry != nullptr);
+    return LoadUint64(entry + kRootPageIdOffset);
+  }
+
+  /** True if an entry's content is guaranteed to be invalid. */
+  static inline bool IsCorruptEntry(const uint8_t* entry) noexcept {
+    EntryType type = Type(entry);
+    if (type != EntryType::kSpace && type != EntryType::kCatalog)
+      return true;
+    for (size_t i = kReservedOffset; i < kRootPageIdOffset; ++i) {
+      if (entry[i] != 0)
+        return true;
+    }
+    return false;
+  }
+
+  /** Writes an entry.
+   *
+   * @param type           the type of the object described by the entry
+   * @param root_page_id64 the page ID of the root page of the object's B+tree
+   * @param entry          buffer of kEntrySize bytes; must be 8-byte-aligned
+   */
+  static inline void SetEntry(EntryType type, uint64_t root_page_id64,
+                              uint8_t* entry) noexcept {
+    DCHECK(entry != nullptr);
+    StoreUint64(0, entry);
+    entry[kTypeOffset] = static_cast<uint8_t>(type);
+    StoreUint64(root_page_id64, entry + kRootPageIdOffset);
+  }
+
+  /** The offset of the entry type. */
+  static constexpr size_t kTypeOffset = 0;
+  /** The offset of the reserved bytes. */
+  static constexpr size_t kReservedOffset = 1;
+  /** The offset of the root page ID. */
+  static constexpr size_t kRootPageIdOffset = 8;
+  /** The number of bytes in an entry. */
+  static constexpr size_t kEntrySize = 16;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_FORMAT_CATALOG_ENTRY_FORMAT_H_
@@ -0,0 +1,48 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./catalog_entry_format.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+namespace berrydb {
+
+TEST(CatalogEntryFormatTest, SetEntry) {
+  alignas(8) uint8_t entry[32];
+
+  std::memset(entry, 0xCC, 32);
+
+  uint64_t root_page_id64 = 0x1234567890ABCDEF;
+  CatalogEntryFormat::SetEntry(CatalogEntryFormat::EntryType::kCatalog,
+                               root_page_id64, entry);
+  EXPECT_EQ(CatalogEntryFormat::EntryType::kCatalog,
+            CatalogEntryFormat::Type(entry));
+  EXPECT_EQ(root_page_id64, CatalogEntryFormat::RootPageId64(entry));
+  EXPECT_FALSE(CatalogEntryFormat::IsCorruptEntry(entry));
+
+  for (size_t i = CatalogEntryFormat::kEntrySize; i < 32; ++i)
+    EXPECT_EQ(0xCC, entry[i]) << "offset: " << i;
+}
+
+TEST(CatalogEntryFormatTest, IsCorruptEntry) {
+  alignas(8) uint8_t entry[CatalogEntryFormat::kEntrySize];
+
+  CatalogEntryFormat::SetEntry(CatalogEntryFormat::EntryType::kSpace, 3,
+                               entry);
+  EXPECT_FALSE(CatalogEntryFormat::IsCorruptEntry(entry));
+
+  entry[CatalogEntryFormat::kReservedOffset] = 1;
+  EXPECT_TRUE(CatalogEntryFormat::IsCorruptEntry(entry));
+
+  CatalogEntryFormat::SetEntry(CatalogEntryFormat::EntryType::kSpace, 3,
+                               entry);
+  entry[CatalogEntryFormat::kTypeOffset] = 0;
+  EXPECT_TRUE(CatalogEntryFormat::IsCorruptEntry(entry));
+  entry[CatalogEntryFormat::kTypeOffset] = 3;
+  EXPECT_TRUE(CatalogEntryFormat::IsCorruptEntry(entry));
+}
+
+}  // namespace berrydb
@@ -0,0 +1,199 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./key_prefix_format.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BERRYDB_KEY_PREFIX_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BERRYDB_KEY_PREFIX_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__) && \
+    !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#define BERRYDB_KEY_PREFIX_NEON 1
+#endif
+
+#if defined(BERRYDB_KEY_PREFIX_AVX2) || defined(BERRYDB_KEY_PREFIX_SSE2) || \
+    defined(BERRYDB_KEY_PREFIX_NEON)
+#define BERRYDB_KEY_PREFIX_VECTORIZED 1
+#endif
+
+namespace berrydb {
+
+constexpr size_t KeyPrefixFormat::kPrefixSize;
+constexpr size_t KeyPrefixFormat::kScanSize;
+
+namespace {
+
+#if defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+
+/** Counts the prefixes in a range that are below (or equal to) a prefix.
+ *
+ * Because the prefix array is sorted, the count is the position of the range's
+ * lower (or upper) bound. The prefix comparisons do not depend on each other,
+ * so they are done several at a time, without any branches.
+ *
+ * @tparam kIncludeEqual if true, prefixes equal to the given prefix are counted
+ */
+template <bool kIncludeEqual>
+size_t ScanCount(const uint8_t* prefixes, size_t count,
+                 uint32_t prefix) noexcept {
+  size_t result = 0;
+  size_t index = 0;
+
+#if defined(BERRYDB_KEY_PREFIX_AVX2) || defined(BERRYDB_KEY_PREFIX_SSE2)
+  // SSE2 and AVX2 only have signed 32-bit comparisons. Flipping the sign bit
+  // maps the unsigned order onto the signed order.
+  constexpr uint32_t kSignBit = 0x80000000;
+  const int32_t biased_prefix = static_cast<int32_t>(prefix ^ kSignBit);
+#endif  // defined(BERRYDB_KEY_PREFIX_AVX2) || defined(BERRYDB_KEY_PREFIX_SSE2)
+
+#if defined(BERRYDB_KEY_PREFIX_AVX2)
+  const __m256i sign_bits = _mm256_set1_epi32(static_cast<int32_t>(kSignBit));
+  const __m256i needle = _mm256_set1_epi32(biased_prefix);
+  __m256i counts = _mm256_setzero_si256();
+  for (; index + 8 <= count; index += 8) {
+    __m256i block = _mm256_xor_si256(sign_bits, _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(prefixes + index * 4)));
+    // Matching lanes are set to -1, so subtracting them increments the counts.
+    if (kIncludeEqual) {
+      counts = _mm256_add_epi32(counts, _mm256_cmpgt_epi32(block, needle));
+      counts = _mm256_sub_epi32(counts, _mm256_set1_epi32(-1));
+    } else {
+      counts = _mm256_sub_epi32(counts, _mm256_cmpgt_epi32(needle, block));
+    }
+  }
+  alignas(32) uint32_t lane_counts[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lane_counts), counts);
+  for (uint32_t lane_count : lane_counts)
+    result += lane_count;
+#elif defined(BERRYDB_KEY_PREFIX_SSE2)
+  const __m128i sign_bits = _mm_set1_epi32(static_cast<int32_t>(kSignBit));
+  const __m128i needle = _mm_set1_epi32(biased_prefix);
+  __m128i counts = _mm_setzero_si128();
+  for (; index + 4 <= count; index += 4) {
+    __m128i block = _mm_xor_si128(sign_bits, _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(prefixes + index * 4)));
+    // Matching lanes are set to -1, so subtracting them increments the counts.
+    if (kIncludeEqual) {
+      counts = _mm_add_epi32(counts, _mm_cmpgt_epi32(block, needle));
+      counts = _mm_sub_epi32(counts, _mm_set1_epi32(-1));
+    } else {
+      counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(needle, block));
+    }
+  }
+  alignas(16) uint32_t lane_counts[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lane_counts), counts);
+  for (uint32_t lane_count : lane_counts)
+    result += lane_count;
+#elif defined(BERRYDB_KEY_PREFIX_NEON)
+  const uint32x4_t needle = vdupq_n_u32(prefix);
+  uint32x4_t counts = vdupq_n_u32(0);
+  for (; index + 4 <= count; index += 4) {
+    uint32x4_t block = vld1q_u32(
+        reinterpret_cast<const uint32_t*>(prefixes + index * 4));
+    // Matching lanes are set to all ones, so subtracting them increments the
+    // counts.
+    if (kIncludeEqual)
+      counts = vsubq_u32(counts, vcleq_u32(block, needle));
+    else
+      counts = vsubq_u32(counts, vcltq_u32(block, needle));
+  }
+  result += vaddvq_u32(counts);
+#endif  // defined(BERRYDB_KEY_PREFIX_AVX2)
+
+  for (; index < count; ++index) {
+    uint32_t entry = LoadUint32(prefixes + index * 4);
+    if (entry < prefix || (kIncludeEqual && entry == prefix))
+      ++result;
+  }
+  return result;
+}
+
+#endif  // defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+
+}  // namespace
+
+size_t KeyPrefixFormat::LowerBound(
+    const uint8_t* prefixes, size_t count, uint32_t prefix) noexcept {
+#if defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+  DCHECK(prefixes != nullptr || count == 0);
+
+  size_t low = 0, high = count;
+  while (high - low > kScanSize) {
+    size_t middle = low + (high - low) / 2;
+    if (LoadUint32(prefixes + middle * kPrefixSize) < prefix)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low + ScanCount<false>(prefixes + low * kPrefixSize, high - low,
+                                prefix);
+#else   // defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+  return ScalarLowerBound(prefixes, count, prefix);
+#endif  // defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+}
+
+size_t KeyPrefixFormat::UpperBound(
+    const uint8_t* prefixes, size_t count, uint32_t prefix) noexcept {
+#if defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+  DCHECK(prefixes != nullptr || count == 0);
+
+  size_t low = 0, high = count;
+  while (high - low > kScanSize) {
+    size_t middle = low + (high - low) / 2;
+    if (LoadUint32(prefixes + middle * kPrefixSize) <= prefix)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low + ScanCount<true>(prefixes + low * kPrefixSize, high - low,
+                               prefix);
+#else   // defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+  return ScalarUpperBound(prefixes, count, prefix);
+#endif  // defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+}
+
+size_t KeyPrefixFormat::ScalarLowerBound(
+    const uint8_t* prefixes, size_t count, uint32_t prefix) noexcept {
+  DCHECK(prefixes != nullptr || count == 0);
+
+  size_t low = 0, high = count;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (LoadUint32(prefixes + middle * kPrefixSize) < prefix)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+size_t KeyPrefixFormat::ScalarUpperBound(
+    const uint8_t* prefixes, size_t count, uint32_t prefix) noexcept {
+  DCHECK(prefixes != nullptr || count == 0);
+
+  size_t low = 0, high = count;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (LoadUint32(prefixes + middle * kPrefixSize) <= prefix)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+bool KeyPrefixFormat::IsVectorized() noexcept {
+#if defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+  return true;
+#else   // defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+  return false;
+#endif  // defined(BERRYDB_KEY_PREFIX_VECTORIZED)
+}
+
+}  // namespace berrydb
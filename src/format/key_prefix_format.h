@@ -0,0 +1,92 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_KEY_PREFIX_FORMAT_H_
+#define BERRYDB_KEY_PREFIX_FORMAT_H_
+
+#include "berrydb/platform.h"
+#include "berrydb/string_view.h"
+
+namespace berrydb {
+
+/** Dense arrays of fixed-size key prefixes, used to speed up in-page search.
+ *
+ * A key's prefix is its first 4 bytes, padded with zeros, read as a big-endian
+ * number. Prefixes preserve the key order, so prefix(a) < prefix(b) implies
+ * a < b. Equal prefixes do not imply equal keys, so ties must be resolved by
+ * comparing the full keys.
+ *
+ * A prefix array stores the prefixes of a sorted list of keys, using the same
+ * layout as StoreUint32(). The array is much smaller than the cells holding the
+ * keys, so searching it touches fewer cache lines, and the comparisons can be
+ * done by SIMD instructions, when they are available.
+ *
+ * The SIMD code paths read the array directly, so they assume that the 32-bit
+ * numbers are stored in the platform's native byte order, like the default
+ * LoadUint32() implementation. Embedders that change the on-disk byte order
+ * must also disable the vectorized search.
+ */
+class KeyPrefixFormat {
+ public:
+  /** Computes the prefix of a key. */
+  static inline uint32_t Prefix(string_view key) noexcept {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(key.data());
+    size_t size = key.size();
+    if (size >= kPrefixSize) {
+      return (static_cast<uint32_t>(bytes[0]) << 24) |
+          (static_cast<uint32_t>(bytes[1]) << 16) |
+          (static_cast<uint32_t>(bytes[2]) << 8) |
+          static_cast<uint32_t>(bytes[3]);
+    }
+
+    uint32_t prefix = 0;
+    for (size_t i = 0; i < size; ++i)
+      prefix |= static_cast<uint32_t>(bytes[i]) << (24 - 8 * i);
+    return prefix;
+  }
+
+  /** Finds the first entry in a prefix array that is >= a given prefix.
+   *
+   * @param  prefixes the prefix array; must be 4-byte aligned
+   * @param  count    the number of prefixes in the array
+   * @param  prefix   the prefix to search for
+   * @return          a position in [0, count]; count means that all the
+   *                  prefixes in the array are smaller than the given prefix
+   */
+  static size_t LowerBound(const uint8_t* prefixes, size_t count,
+                           uint32_t prefix) noexcept;
+
+  /** Finds the first entry in a prefix array that is > a given prefix.
+   *
+   * See LowerBound() for the arguments and return value. */
+  static size_t UpperBound(const uint8_t* prefixes, size_t count,
+                           uint32_t prefix) noexcept;
+
+  /** LowerBound() implementation that does not use SIMD instructions.
+   *
+   * This is used on platforms without SIMD support, and in tests and
+   * benchmarks. */
+  static size_t ScalarLowerBound(const uint8_t* prefixes, size_t count,
+                                 uint32_t prefix) noexcept;
+
+  /** UpperBound() implementation that does not use SIMD instructions. */
+  static size_t ScalarUpperBound(const uint8_t* prefixes, size_t count,
+                                 uint32_t prefix) noexcept;
+
+  /** True if LowerBound() and UpperBound() use SIMD instructions. */
+  static bool IsVectorized() noexcept;
+
+  /** The size of a prefix array entry. */
+  static constexpr size_t kPrefixSize = 4;
+
+  /** Prefix ranges of this size or smaller are scanned by SIMD instructions.
+   *
+   * Larger ranges are narrowed down by a binary search first. The scan reads
+   * 128 bytes, which is 2 cache lines on most CPUs. */
+  static constexpr size_t kScanSize = 32;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_KEY_PREFIX_FORMAT_H_
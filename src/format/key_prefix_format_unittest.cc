@@ -0,0 +1,137 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./key_prefix_format.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace berrydb {
+
+class KeyPrefixFormatTest : public ::testing::Test {
+ protected:
+  /** Writes a sorted list of prefixes into prefixes_. */
+  void SetPrefixes(std::vector<uint32_t> values) {
+    std::sort(values.begin(), values.end());
+    count_ = values.size();
+    prefixes_.resize(count_);
+    for (size_t i = 0; i < count_; ++i) {
+      StoreUint32(values[i],
+                  reinterpret_cast<uint8_t*>(prefixes_.data() + i));
+    }
+  }
+
+  /** Checks LowerBound() and UpperBound() against the scalar versions. */
+  void CheckBounds(uint32_t prefix) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(prefixes_.data());
+
+    size_t lower_bound = KeyPrefixFormat::ScalarLowerBound(
+        data, count_, prefix);
+    size_t upper_bound = KeyPrefixFormat::ScalarUpperBound(
+        data, count_, prefix);
+    EXPECT_EQ(lower_bound, KeyPrefixFormat::LowerBound(data, count_, prefix))
+        << "prefix: " << prefix << " count: " << count_;
+    EXPECT_EQ(upper_bound, KeyPrefixFormat::UpperBound(data, count_, prefix))
+        << "prefix: " << prefix << " count: " << count_;
+
+    for (size_t i = 0; i < lower_bound; ++i)
+      EXPECT_LT(LoadUint32(data + i * 4), prefix);
+    for (size_t i = lower_bound; i < upper_bound; ++i)
+      EXPECT_EQ(prefix, LoadUint32(data + i * 4));
+    for (size_t i = upper_bound; i < count_; ++i)
+      EXPECT_GT(LoadUint32(data + i * 4), prefix);
+  }
+
+  // uint32_t guarantees the 4-byte alignment required by LoadUint32().
+  std::vector<uint32_t> prefixes_;
+  size_t count_;
+  std::mt19937 rnd_;
+};
+
+TEST_F(KeyPrefixFormatTest, Prefix) {
+  EXPECT_EQ(0U, KeyPrefixFormat::Prefix(""));
+  EXPECT_EQ(0x61000000U, KeyPrefixFormat::Prefix("a"));
+  EXPECT_EQ(0x61620000U, KeyPrefixFormat::Prefix("ab"));
+  EXPECT_EQ(0x61626300U, KeyPrefixFormat::Prefix("abc"));
+  EXPECT_EQ(0x61626364U, KeyPrefixFormat::Prefix("abcd"));
+  EXPECT_EQ(0x61626364U, KeyPrefixFormat::Prefix("abcde"));
+  EXPECT_EQ(0xFF000000U, KeyPrefixFormat::Prefix("\xFF"));
+  EXPECT_EQ(0x61006200U, KeyPrefixFormat::Prefix(string_view("a\0b", 3)));
+}
+
+TEST_F(KeyPrefixFormatTest, PrefixPreservesKeyOrder) {
+  std::vector<std::string> keys = {
+    "", std::string(1, '\0'), std::string(5, '\0'), "a", "ab", "abc", "abcd",
+    "abcde", "abd", "b", "\x7F\xFF", "\x80", "\x80\x01", "\xFF\xFF\xFF\xFF",
+    "\xFF\xFF\xFF\xFF\xFF",
+  };
+  for (const std::string& key1 : keys) {
+    for (const std::string& key2 : keys) {
+      string_view view1(key1.data(), key1.size());
+      string_view view2(key2.data(), key2.size());
+      uint32_t prefix1 = KeyPrefixFormat::Prefix(view1);
+      uint32_t prefix2 = KeyPrefixFormat::Prefix(view2);
+      if (view1 <= view2) {
+        EXPECT_LE(prefix1, prefix2);
+      }
+      if (prefix1 < prefix2) {
+        EXPECT_LT(view1, view2);
+      }
+    }
+  }
+}
+
+TEST_F(KeyPrefixFormatTest, EmptyArray) {
+  SetPrefixes({});
+  CheckBounds(0);
+  CheckBounds(0x80000000);
+  CheckBounds(0xFFFFFFFF);
+}
+
+TEST_F(KeyPrefixFormatTest, SignBitBoundary) {
+  // Vectorized implementations may use signed comparisons internally.
+  SetPrefixes({0, 1, 0x7FFFFFFF, 0x7FFFFFFF, 0x80000000, 0x80000001,
+               0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF});
+  for (uint32_t prefix : {0U, 1U, 2U, 0x7FFFFFFEU, 0x7FFFFFFFU, 0x80000000U,
+                          0x80000001U, 0xFFFFFFFEU, 0xFFFFFFFFU}) {
+    CheckBounds(prefix);
+  }
+}
+
+TEST_F(KeyPrefixFormatTest, AllEqual) {
+  for (size_t count : {1, 3, 4, 5, 8, 31, 32, 33, 100}) {
+    SetPrefixes(std::vector<uint32_t>(count, 0x61626364));
+    CheckBounds(0);
+    CheckBounds(0x61626363);
+    CheckBounds(0x61626364);
+    CheckBounds(0x61626365);
+    CheckBounds(0xFFFFFFFF);
+  }
+}
+
+TEST_F(KeyPrefixFormatTest, RandomArrays) {
+  // Small value ranges cause many duplicates, large ranges cause few.
+  for (uint32_t max_value : {3U, 100U, 0xFFFFFFFFU}) {
+    std::uniform_int_distribution<uint32_t> distribution(0, max_value);
+    for (size_t count = 0; count < 300; count += 1 + count / 8) {
+      std::vector<uint32_t> values(count);
+      for (uint32_t& value : values)
+        value = distribution(rnd_);
+      SetPrefixes(values);
+
+      for (uint32_t value : values)
+        CheckBounds(value);
+      for (int i = 0; i < 16; ++i)
+        CheckBounds(distribution(rnd_));
+      CheckBounds(0);
+      CheckBounds(0xFFFFFFFF);
+    }
+  }
+}
+
+}  // namespace berrydb
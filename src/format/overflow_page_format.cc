@@ -0,0 +1,17 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./overflow_page_format.h"
+
+namespace berrydb {
+
+constexpr size_t OverflowPageFormat::kNextPageIdOffset;
+constexpr size_t OverflowPageFormat::kChunkSizeOffset;
+constexpr size_t OverflowPageFormat::kReservedOffset;
+constexpr size_t OverflowPageFormat::kChunkOffset;
+constexpr size_t OverflowPageFormat::kFirstPageIdOffset;
+constexpr size_t OverflowPageFormat::kValueSizeOffset;
+constexpr size_t OverflowPageFormat::kReferenceSize;
+
+}  // namespace berrydb
@@ -0,0 +1,141 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_FORMAT_OVERFLOW_PAGE_FORMAT_H_
+#define BERRYDB_FORMAT_OVERFLOW_PAGE_FORMAT_H_
+
+#include "berrydb/platform.h"
+
+namespace berrydb {
+
+/** The on-disk layout of the pages that hold large values.
+ *
+ * This class should only be used by the OverflowChain implementation and
+ * tests.
+ *
+ * A large value is split into chunks, which are stored in a chain of overflow
+ * pages. Each page holds one chunk, and links to the page holding the next
+ * chunk. The leaf cell for the value's key stores a fixed-size reference to
+ * the chain instead of the value. Chains are usually allocated as runs of
+ * consecutive pages, but the format does not rely on that.
+ *
+ * The page format is as follows:
+ *
+ *  0: 8-byte page ID of the next page in the chain; 0 for the last page
+ *  8: 4-byte number of value bytes stored in the page
+ * 12: 4 reserved bytes, must be 0
+ * 16: the value bytes (the chunk)
+ *
+ * The reference format is as follows:
+ *
+ *  0: 8-byte page ID of the chain's first page
+ *  8: 8-byte size of the whole value
+ *
+ * References are stored right after their keys in leaf cells, so they are not
+ * necessarily aligned. The methods below require 8-byte aligned references, so
+ * references must be copied out of leaf cells before they are read.
+ */
+class OverflowPageFormat {
+ public:
+  /** Reads the page ID of the next page in a chain.
+   *
+   * Like BTreePageFormat::NextLeafId64(), this returns a 64-bit number.
+   *
+   * @return the next page's ID; 0 for the chain's last page */
+  static inline uint64_t NextPageId64(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return LoadUint64(page_data + kNextPageIdOffset);
+  }
+  static inline void SetNextPageId64(uint64_t page_id64,
+                                     uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    StoreUint64(page_id64, page_data + kNextPageIdOffset);
+  }
+
+  /** The number of value bytes stored in a page. */
+  static inline size_t ChunkSize(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return static_cast<size_t>(LoadUint32(page_data + kChunkSizeOffset));
+  }
+  static inline void SetChunkSize(size_t chunk_size,
+                                  uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    StoreUint32(static_cast<uint32_t>(chunk_size),
+                page_data + kChunkSizeOffset);
+    StoreUint32(0, page_data + kReservedOffset);
+  }
+
+  /** The value bytes stored in a page. */
+  static inline const uint8_t* Chunk(const uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return page_data + kChunkOffset;
+  }
+  static inline uint8_t* MutableChunk(uint8_t* page_data) noexcept {
+    DCHECK(page_data != nullptr);
+    return page_data + kChunkOffset;
+  }
+
+  /** The maximum number of value bytes stored in a page. */
+  static inline constexpr size_t ChunkCapacity(size_t page_size) noexcept {
+    return page_size - kChunkOffset;
+  }
+
+  /** True if a page's header is guaranteed to be invalid.
+   *
+   * @param  page_data the page's data buffer
+   * @param  page_size the page size of the store data file
+   * @return           true if the page is guaranteed to be corrupted
+   */
+  static inline bool IsCorruptPage(const uint8_t* page_data,
+                                   size_t page_size) noexcept {
+    size_t chunk_size = ChunkSize(page_data);
+    return chunk_size == 0 || chunk_size > ChunkCapacity(page_size);
+  }
+
+  /** Reads the page ID of the first page in a chain. See NextPageId64(). */
+  static inline uint64_t FirstPageId64(const uint8_t* reference) noexcept {
+    DCHECK(reference != nullptr);
+    return LoadUint64(reference + kFirstPageIdOffset);
+  }
+
+  /** Reads the size of the value stored in a chain. */
+  static inline uint64_t ValueSize64(const uint8_t* reference) noexcept {
+    DCHECK(reference != nullptr);
+    return LoadUint64(reference + kValueSizeOffset);
+  }
+
+  /** Writes the reference to a chain.
+   *
+   * @param first_page_id64 the page ID of the chain's first page
+   * @param value_size64    the size of the value stored in the chain
+   * @param reference       buffer of kReferenceSize bytes
+   */
+  static inline void SetReference(uint64_t first_page_id64,
+                                  uint64_t value_size64,
+                                  uint8_t* reference) noexcept {
+    DCHECK(reference != nullptr);
+    StoreUint64(first_page_id64, reference + kFirstPageIdOffset);
+    StoreUint64(value_size64, reference + kValueSizeOffset);
+  }
+
+  /** The offset of the next page's ID in a page. */
+  static constexpr size_t kNextPageIdOffset = 0;
+  /** The offset of the number of value bytes in a page. */
+  static constexpr size_t kChunkSizeOffset = 8;
+  /** The offset of the reserved header bytes in a page. */
+  static constexpr size_t kReservedOffset = 12;
+  /** The offset of the value bytes in a page. */
+  static constexpr size_t kChunkOffset = 16;
+
+  /** The offset of the first page's ID in a reference. */
+  static constexpr size_t kFirstPageIdOffset = 0;
+  /** The offset of the value size in a reference. */
+  static constexpr size_t kValueSizeOffset = 8;
+  /** The number of bytes in a reference. */
+  static constexpr size_t kReferenceSize = 16;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_FORMAT_OVERFLOW_PAGE_FORMAT_H_
@@ -0,0 +1,94 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./overflow_page_format.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+namespace berrydb {
+
+TEST(OverflowPageFormatTest, NextPageId64) {
+  alignas(8) uint8_t page_data[256];
+
+  std::memset(page_data, 0xCC, 256);
+
+  uint64_t next_page_id64 = 0x1234567890ABCDEF;
+  OverflowPageFormat::SetNextPageId64(next_page_id64, page_data);
+  EXPECT_EQ(next_page_id64, OverflowPageFormat::NextPageId64(page_data));
+
+  size_t bytes_changed = 0;
+  for (size_t i = 0; i < 256; ++i) {
+    if (page_data[i] != 0xCC)
+      bytes_changed += 1;
+  }
+  EXPECT_EQ(8U, bytes_changed);
+}
+
+TEST(OverflowPageFormatTest, ChunkSize) {
+  alignas(8) uint8_t page_data[256];
+
+  std::memset(page_data, 0xCC, 256);
+
+  OverflowPageFormat::SetChunkSize(0x1234, page_data);
+  EXPECT_EQ(0x1234U, OverflowPageFormat::ChunkSize(page_data));
+
+  // The reserved bytes are cleared together with the chunk size.
+  for (size_t i = 0; i < 256; ++i) {
+    if (i < OverflowPageFormat::kChunkSizeOffset ||
+        i >= OverflowPageFormat::kChunkOffset) {
+      EXPECT_EQ(0xCC, page_data[i]) << "offset: " << i;
+    }
+  }
+  for (size_t i = OverflowPageFormat::kReservedOffset;
+       i < OverflowPageFormat::kChunkOffset; ++i) {
+    EXPECT_EQ(0, page_data[i]) << "offset: " << i;
+  }
+}
+
+TEST(OverflowPageFormatTest, Chunk) {
+  alignas(8) uint8_t page_data[256];
+
+  std::memset(page_data, 0xCC, 256);
+
+  EXPECT_EQ(page_data + OverflowPageFormat::kChunkOffset,
+            OverflowPageFormat::Chunk(page_data));
+  EXPECT_EQ(page_data + OverflowPageFormat::kChunkOffset,
+            OverflowPageFormat::MutableChunk(page_data));
+  EXPECT_EQ(240U, OverflowPageFormat::ChunkCapacity(256));
+}
+
+TEST(OverflowPageFormatTest, IsCorruptPage) {
+  alignas(8) uint8_t page_data[256];
+
+  std::memset(page_data, 0, 256);
+  EXPECT_TRUE(OverflowPageFormat::IsCorruptPage(page_data, 256));
+
+  OverflowPageFormat::SetChunkSize(1, page_data);
+  EXPECT_FALSE(OverflowPageFormat::IsCorruptPage(page_data, 256));
+  OverflowPageFormat::SetChunkSize(240, page_data);
+  EXPECT_FALSE(OverflowPageFormat::IsCorruptPage(page_data, 256));
+  OverflowPageFormat::SetChunkSize(241, page_data);
+  EXPECT_TRUE(OverflowPageFormat::IsCorruptPage(page_data, 256));
+}
+
+TEST(OverflowPageFormatTest, Reference) {
+  alignas(8) uint8_t reference[OverflowPageFormat::kReferenceSize + 8];
+
+  std::memset(reference, 0xCC, sizeof(reference));
+
+  uint64_t first_page_id64 = 0x1234567890ABCDEF;
+  uint64_t value_size64 = 0xFEDCBA0987654321;
+  OverflowPageFormat::SetReference(first_page_id64, value_size64, reference);
+  EXPECT_EQ(first_page_id64, OverflowPageFormat::FirstPageId64(reference));
+  EXPECT_EQ(value_size64, OverflowPageFormat::ValueSize64(reference));
+
+  for (size_t i = OverflowPageFormat::kReferenceSize; i < sizeof(reference);
+       ++i) {
+    EXPECT_EQ(0xCC, reference[i]) << "offset: " << i;
+  }
+}
+
+}  // namespace berrydb
@@ -23,12 +23,8 @@ namespace berrydb {
 // number will be bumped to 1, and files using format 0 will be rejected.
 
 StoreHeader::StoreHeader(size_t page_shift, size_t page_count)
-    : page_count(page_count)
-#if DCHECK_IS_ON()
-    , free_list_head_page(kInvalidFreeListHeadPage)
-#endif  // DCHECK_IS_ON()
-    , page_shift(page_shift)
-    {
+    : page_count(page_count), free_list_head_page(kInvalidFreeListHeadPage),
+      page_shift(page_shift) {
 }
 
 void StoreHeader::Serialize(uint8_t* to) {
@@ -72,7 +68,8 @@ bool StoreHeader::Deserialize(const uint8_t *from) {
     // corruption or a difficult-to-debug crash.
     return false;
   }
-  if (free_list_head_page == kInvalidFreeListHeadPage) {
+  // kInvalidFreeListHeadPage stands for an empty free list.
+  if (free_list_head_page >= page_count) {
     // Another data corruption case that is best caught early on.
     return false;
   }
@@ -88,4 +85,6 @@ bool StoreHeader::Deserialize(const uint8_t *from) {
   return true;
 }
 
+constexpr size_t StoreHeader::kInvalidFreeListHeadPage;
+
 }  // namespace berrydb
@@ -50,7 +50,9 @@ struct StoreHeader {
    * meaningful data. */
   size_t page_count;
 
-  /** 0-based index of the page at the head of the free list. */
+  /** 0-based index of the page at the head of the free list.
+   *
+   * kInvalidFreeListHeadPage if the free list is empty. */
   size_t free_list_head_page;
 
   /** Base-2 log of the store's page size.
@@ -30,6 +30,22 @@ TEST(StoreHeaderTest, SerializeDeserialize) {
   EXPECT_EQ(header.free_list_head_page, header2.free_list_head_page);
 }
 
+TEST(StoreHeaderTest, EmptyFreeList) {
+  alignas(8) uint8_t buffer[StoreHeader::kSerializedSize];
+  StoreHeader header(12, 3);
+  EXPECT_EQ(StoreHeader::kInvalidFreeListHeadPage, header.free_list_head_page);
+  header.Serialize(buffer);
+
+  StoreHeader header2;
+  ASSERT_EQ(true, header2.Deserialize(buffer));
+  EXPECT_EQ(StoreHeader::kInvalidFreeListHeadPage, header2.free_list_head_page);
+
+  // The free list head must be a page in the store.
+  header.free_list_head_page = 3;
+  header.Serialize(buffer);
+  EXPECT_FALSE(header2.Deserialize(buffer));
+}
+
 TEST(StoreHeaderTest, HeaderErrors) {
   alignas(8) uint8_t buffer[StoreHeader::kSerializedSize];
   StoreHeader header;
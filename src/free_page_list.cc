@@ -53,6 +53,9 @@ Status FreePageList::Pop(TransactionImpl* transaction, size_t* page_id) {
 
     *page_id = head_page_id_;
     head_page_id_ = new_head_page_id;
+    // The next Pop() call reads the new head page.
+    if (new_head_page_id != kInvalidPageId)
+      page_pool->Prefetch(store, &new_head_page_id, 1);
     if (new_head_page_id == kInvalidPageId) {
       tail_page_id_ = kInvalidPageId;
 
@@ -33,7 +33,7 @@ class FreePageListTest : public ::testing::Test {
     BlockAccessFile* raw_data_file;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
         data_file_deleter_.path(), kStorePageShift, true, false,
-        &raw_data_file, &data_file_size_));
+        false, &raw_data_file, &data_file_size_));
     data_file_.reset(raw_data_file);
     RandomAccessFile* raw_log_file;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForRandomAccess(
@@ -312,10 +312,12 @@ TEST_F(FreePageListTest, PopState) {
   EXPECT_EQ(store->init_transaction(), list_head_page->transaction());
   EXPECT_FALSE(list_head_page->is_dirty());
 
-  // Make sure that the list didn't touch any page unnecessarily.
+  // Make sure that the list didn't touch any page unnecessarily. The new head
+  // page was prefetched, because the next Pop() reads it.
   EXPECT_LT(2U, page_pool->page_capacity());
   EXPECT_EQ(2U, page_pool->allocated_pages());
-  EXPECT_EQ(1U, page_pool->unused_pages());
+  EXPECT_EQ(0U, page_pool->unused_pages());
+  EXPECT_EQ(1U, page_pool->readahead_count());
 
   // Evict the tail page to make sure it doesn't get accessed anymore.
   page_pool->UnassignPageFromStore(list_tail_page);
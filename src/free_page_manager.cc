@@ -5,6 +5,8 @@
 #include "./free_page_manager.h"
 
 #include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "./format/store_header.h"
 #include "./free_page_list.h"
 #include "./page.h"
 #include "./page_pool.h"
@@ -21,35 +23,212 @@ FreePageManager::FreePageManager(StoreImpl* store) : store_(store) {
 }
 
 FreePageManager::~FreePageManager() {
+  if (alloc_transaction_ != nullptr)
+    alloc_transaction_->Release();
 }
 
-size_t FreePageManager::AllocPage(
-    TransactionImpl* transaction, TransactionImpl* alloc_transaction) {
+Status FreePageManager::AllocPage(TransactionImpl* transaction,
+                                  size_t* page_id) {
   DCHECK_EQ(store_, transaction->store());
-  DCHECK_EQ(store_, alloc_transaction->store());
-
-  UNUSED(store_);
-  UNUSED(transaction);
-  UNUSED(alloc_transaction);
+  DCHECK(page_id != nullptr);
 
   // TODO(pwnall): Check for free pages scoped to the transaction.
 
-  // TODO(pwnall): Check for free pages scoped to the store.
-  // TODO(pwnall): Write the new header to the db using alloc_transaction.
+  std::lock_guard<std::mutex> lock(mutex_);
+  TransactionImpl* alloc_transaction = AllocTransaction();
+  StoreHeader* header = store_->header();
+  FreePageList free_list;
+  free_list.set_head_page_id(header->free_list_head_page);
+  size_t free_page_id;
+  Status status = free_list.Pop(alloc_transaction, &free_page_id);
+  if (status != Status::kSuccess)
+    return status;
+
+  if (free_page_id != kInvalidPageId) {
+    transaction->PagesAllocated(free_page_id, 1);
+    *page_id = free_page_id;
+    if (free_list.head_page_id() == header->free_list_head_page)
+      return Status::kSuccess;
+    header->free_list_head_page = free_list.head_page_id();
+    return store_->WriteHeader(alloc_transaction);
+  }
 
-  return kInvalidPageId;
+  // The free list is empty, so the store's data file must grow.
+  size_t new_page_id = header->page_count;
+  header->page_count += 1;
+  status = store_->WriteHeader(alloc_transaction);
+  if (status != Status::kSuccess) {
+    header->page_count -= 1;
+    return status;
+  }
+  transaction->PagesAllocated(new_page_id, 1);
+  *page_id = new_page_id;
+  return Status::kSuccess;
 }
 
-Status FreePageManager::FreePage(
-    size_t page_id, TransactionImpl *transaction,
-    TransactionImpl *alloc_transaction) {
+Status FreePageManager::AllocPageRun(
+    TransactionImpl* transaction, size_t page_count, size_t* first_page_id) {
+  DCHECK_EQ(store_, transaction->store());
+  DCHECK(first_page_id != nullptr);
+  DCHECK_GT(page_count, 0U);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  StoreHeader* header = store_->header();
+  size_t new_page_id = header->page_count;
+  header->page_count += page_count;
+  Status status = store_->WriteHeader(AllocTransaction());
+  if (status != Status::kSuccess) {
+    header->page_count -= page_count;
+    return status;
+  }
+  transaction->PagesAllocated(new_page_id, page_count);
+  *first_page_id = new_page_id;
+  return Status::kSuccess;
+}
+
+Status FreePageManager::TrimPageRun(
+    TransactionImpl* transaction, size_t first_page_id, size_t page_count,
+    size_t used_page_count) {
+  DCHECK_EQ(store_, transaction->store());
+  DCHECK_LE(used_page_count, page_count);
+
+  if (used_page_count == page_count)
+    return Status::kSuccess;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StoreHeader* header = store_->header();
+    if (header->page_count == first_page_id + page_count) {
+      size_t old_page_count = header->page_count;
+      header->page_count = first_page_id + used_page_count;
+      Status status = store_->WriteHeader(AllocTransaction());
+      if (status != Status::kSuccess) {
+        header->page_count = old_page_count;
+        return status;
+      }
+      transaction->PagesReleased(first_page_id + used_page_count,
+                                 page_count - used_page_count);
+      return Status::kSuccess;
+    }
+  }
+
+  // Other pages were allocated after the run, so the run's tail cannot be
+  // trimmed off the data file.
+  for (size_t i = used_page_count; i < page_count; ++i) {
+    Status status = FreePage(first_page_id + i, transaction);
+    if (status != Status::kSuccess)
+      return status;
+  }
+  return Status::kSuccess;
+}
+
+Status FreePageManager::FreePage(size_t page_id,
+                                 TransactionImpl* transaction) {
+  DCHECK_EQ(store_, transaction->store());
+  DCHECK_NE(page_id, kInvalidPageId);
+
+  // The store's free list is only changed when the transaction commits.
+  return transaction->free_pages()->Push(transaction, page_id);
+}
+
+Status FreePageManager::CommitFreedPages(TransactionImpl* transaction) {
+  DCHECK_EQ(store_, transaction->store());
+
+  // The allocation changes made since the last commit are persisted by this
+  // commit. This includes allocations made by other open transactions, which
+  // return their pages to the free list if they are rolled back.
+  if (alloc_transaction_ != nullptr && transaction != alloc_transaction_)
+    transaction->TakePagesFrom(alloc_transaction_);
+  transaction->ClearAllocatedPages();
+
+  FreePageList* freed_pages = transaction->free_pages();
+  if (freed_pages->is_empty())
+    return Status::kSuccess;
+
+  StoreHeader* header = store_->header();
+  if (header->free_list_head_page == kInvalidPageId) {
+    // The transaction's list becomes the store's list.
+    header->free_list_head_page = freed_pages->head_page_id();
+    Status status = store_->WriteHeader(transaction);
+    if (status != Status::kSuccess)
+      header->free_list_head_page = kInvalidPageId;
+    return status;
+  }
+
+  // Merging never changes the store list's head page, so the header does not
+  // need to be written.
+  FreePageList free_list;
+  free_list.set_head_page_id(header->free_list_head_page);
+  return free_list.Merge(transaction, freed_pages);
+}
+
+Status FreePageManager::RollbackAllocatedPages(TransactionImpl* transaction) {
+  DCHECK_EQ(store_, transaction->store());
+
+  TransactionImpl::PageRunVector* page_runs = transaction->allocated_pages();
+  if (page_runs->empty())
+    return Status::kSuccess;
+
+  // Runs are allocated in increasing page ID order when the file grows, so
+  // going backwards trims the most pages off the end of the file.
+  std::lock_guard<std::mutex> lock(mutex_);
+  StoreHeader* header = store_->header();
+  size_t old_page_count = header->page_count;
+  Status status = Status::kSuccess;
+  for (auto it = page_runs->rbegin(); it != page_runs->rend(); ++it) {
+    size_t first_page_id = it->first_page_id;
+    size_t page_count = it->page_count;
+    if (header->page_count == first_page_id + page_count) {
+      header->page_count = first_page_id;
+      continue;
+    }
+    for (size_t i = 0; i < page_count; ++i) {
+      status = PushFreePage(first_page_id + i);
+      if (status != Status::kSuccess)
+        break;
+    }
+    if (status != Status::kSuccess)
+      break;
+  }
+  transaction->ClearAllocatedPages();
+
+  if (header->page_count != old_page_count) {
+    Status header_status = store_->WriteHeader(AllocTransaction());
+    if (status == Status::kSuccess)
+      status = header_status;
+  }
+  return status;
+}
+
+Status FreePageManager::Close() {
+  if (alloc_transaction_ == nullptr)
+    return Status::kSuccess;
+
+  // Allocation data is not worth writing if the store already failed writes.
+  if (store_->has_write_error())
+    return alloc_transaction_->Rollback();
+  return alloc_transaction_->Commit();
+}
+
+TransactionImpl* FreePageManager::AllocTransaction() {
+  if (alloc_transaction_ == nullptr)
+    alloc_transaction_ = TransactionImpl::Create(store_);
+  return alloc_transaction_;
+}
 
-  UNUSED(store_);
-  UNUSED(page_id);
-  UNUSED(transaction);
-  UNUSED(alloc_transaction);
+Status FreePageManager::PushFreePage(size_t page_id) {
+  TransactionImpl* alloc_transaction = AllocTransaction();
+  StoreHeader* header = store_->header();
+  FreePageList free_list;
+  free_list.set_head_page_id(header->free_list_head_page);
+  Status status = free_list.Push(alloc_transaction, page_id);
+  if (status != Status::kSuccess)
+    return status;
 
-  return Status::kIoError;
+  if (free_list.head_page_id() == header->free_list_head_page)
+    return Status::kSuccess;
+  header->free_list_head_page = free_list.head_page_id();
+  return store_->WriteHeader(alloc_transaction);
 }
 
 }  // namespace berrydb
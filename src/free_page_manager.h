@@ -5,6 +5,8 @@
 #ifndef BERRYDB_FREE_PAGE_MANAGER_H
 #define BERRYDB_FREE_PAGE_MANAGER_H
 
+#include <mutex>
+
 #include "berrydb/platform.h"
 
 namespace berrydb {
@@ -49,32 +51,119 @@ class FreePageManager {
    * exceptional circumstance, such as an I/O error or a quota error, so the
    * caller should bail on errors and eventually roll back the transaction.
    *
-   * @param  transaction       the transaction that will use the newly allocated
-   *                           page
-   * @param  alloc_transaction the transaction used to change allocation data
-   * @return                   the ID of the allocated page, or kInvalidPageId
-   *                           if the page allocation fails
+   * @param  transaction the transaction that will use the newly allocated page
+   * @param  page_id     if the call succeeds, receives the ID of the allocated
+   *                     page
+   * @return             most likely kSuccess or kIoError
+   */
+  Status AllocPage(TransactionImpl* transaction, size_t* page_id);
+
+  /** Allocates consecutive pages and assigns them to a transaction.
+   *
+   * The pages are always carved out of the end of the store's data file, so
+   * they can be written using large sequential writes. The free page list is
+   * not used, because its pages are scattered throughout the data file.
+   *
+   * @param  transaction   the transaction that will use the pages
+   * @param  page_count    the number of pages to be allocated
+   * @param  first_page_id if the call succeeds, receives the ID of the first
+   *                       allocated page; the other pages follow it
+   * @return               most likely kSuccess or kIoError
+   */
+  Status AllocPageRun(TransactionImpl* transaction, size_t page_count,
+                      size_t* first_page_id);
+
+  /** Gives back the unused pages at the end of a run from AllocPageRun().
+   *
+   * If the run is still at the end of the data file, the file shrinks.
+   * Otherwise, the unused pages are freed when the transaction commits.
+   *
+   * @param  transaction     the transaction that allocated the run
+   * @param  first_page_id   the ID of the first page in the run
+   * @param  page_count      the number of pages in the run
+   * @param  used_page_count the number of pages at the start of the run that
+   *                         remain allocated
+   * @return                 most likely kSuccess or kIoError
    */
-  size_t AllocPage(TransactionImpl* transaction,
-                   TransactionImpl* alloc_transaction);
+  Status TrimPageRun(TransactionImpl* transaction, size_t first_page_id,
+                     size_t page_count, size_t used_page_count);
 
   /** Queues up a page to be freed when a transaction commits.
    *
    * The free operation is bound to the given transaction's lifecycle. The page
-   * is permanently added to the free list when the transaction commits. If the
-   * transaction is rolled back, the page is not freed anymore.
+   * is added to the transaction's free page list, which is merged into the
+   * store's free list by CommitFreedPages(). If the transaction is rolled back,
+   * the list's changes are discarded, so the page is not freed anymore.
+   *
+   * @param  page_id     the ID of the page that will be freed; this must be a
+   *                     page ID that was previously obtained from AllocPage()
+   *                     or AllocPageRun()
+   * @param  transaction the transaction whose commit will free the page
+   * @return             most likely kSuccess or kIoError
+   */
+  Status FreePage(size_t page_id, TransactionImpl* transaction);
+
+  /** Makes a committing transaction persist the store's allocation data.
+   *
+   * The pages modified by the allocation transaction are handed over to the
+   * committing transaction, and the pages freed by the committing transaction
+   * are added to the store's free list. The caller must hold mutex() until the
+   * transaction's pages are written, so no allocation changes the pages in the
+   * meantime.
+   *
+   * This must be called by TransactionImpl::Commit() before the transaction's
+   * pages are written, because merging the lists modifies free list pages.
    *
-   * @param  page_id    the ID of the page that will be freed; this must be a
-   *                    page ID that was previously obtained from AllocPage()
-   * @param  transation the transaction whose commit will free the page
-   * @return            most likely kSuccess or kIoError
+   * @param  transaction the transaction that is about to commit
+   * @return             most likely kSuccess or kIoError
    */
-  Status FreePage(size_t page_id,
-                  TransactionImpl* transaction,
-                  TransactionImpl* alloc_transaction);
+  Status CommitFreedPages(TransactionImpl* transaction);
+
+  /** Returns the pages allocated by a transaction that is rolled back.
+   *
+   * Pages at the end of the data file are trimmed off. The other pages are
+   * added to the store's free list.
+   *
+   * @param  transaction the transaction that is being rolled back; must not be
+   *                     assigned any pages
+   * @return             most likely kSuccess or kIoError
+   */
+  Status RollbackAllocatedPages(TransactionImpl* transaction);
+
+  /** Persists the allocation data changed since the last commit.
+   *
+   * Called when the store is closed, after the store's transactions are rolled
+   * back, so the pages they allocated end up on the free list.
+   *
+   * @return most likely kSuccess or kIoError
+   */
+  Status Close();
+
+  /** The transaction that changes the store header and the free list pages.
+   *
+   * Transactions that allocate pages do not modify these pages themselves,
+   * because concurrent transactions cannot modify the same page. The changes
+   * are handed over to the next committing transaction. Null until the first
+   * allocation. Guarded by mutex(). */
+  inline TransactionImpl* alloc_transaction() const noexcept {
+    return alloc_transaction_;
+  }
+
+  /** Guards the store header, the free list, and the allocation transaction.
+   *
+   * Acquired before the page pool's assignment latch. */
+  inline std::mutex* mutex() noexcept { return &mutex_; }
 
  private:
-  const StoreImpl* store_;
+  /** The allocation transaction, created if needed. Requires mutex(). */
+  TransactionImpl* AllocTransaction();
+
+  /** Adds a page to the store's free list. Requires mutex(). */
+  Status PushFreePage(size_t page_id);
+
+  StoreImpl* const store_;
+  TransactionImpl* alloc_transaction_ = nullptr;
+  std::mutex mutex_;
 };
 
 }  // namespace berrydb
@@ -0,0 +1,37 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./ghost_page_list.h"
+
+namespace berrydb {
+
+GhostPageList::GhostPageList(size_t capacity)
+    : capacity_(capacity),
+      keys_(reinterpret_cast<Key*>(Allocate(sizeof(Key) * capacity))),
+      page_table_(capacity) {
+  DCHECK_GT(capacity, 0U);
+}
+
+GhostPageList::~GhostPageList() {
+  Deallocate(keys_, sizeof(Key) * capacity_);
+}
+
+void GhostPageList::Add(StoreImpl* store, size_t page_id) noexcept {
+  Key& key = keys_[next_key_];
+  if (used_keys_ == capacity_)
+    page_table_.Erase(key.store, key.page_id);
+  else
+    ++used_keys_;
+
+  key.store = store;
+  key.page_id = page_id;
+  // The table's values are not used.
+  page_table_.Insert(store, page_id, nullptr);
+
+  ++next_key_;
+  if (next_key_ == capacity_)
+    next_key_ = 0;
+}
+
+}  // namespace berrydb
@@ -0,0 +1,87 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_GHOST_PAGE_LIST_H_
+#define BERRYDB_GHOST_PAGE_LIST_H_
+
+#include <cstddef>
+
+#include "./page_table.h"
+#include "berrydb/platform.h"
+
+namespace berrydb {
+
+class StoreImpl;
+
+/** The store pages most recently evicted from a page pool's probation queue.
+ *
+ * This is the A1out queue in the 2Q algorithm. The list only remembers which
+ * pages were evicted, and not their data, so its entries are much smaller than
+ * page pool entries. When a page in the list is fetched again, the page is
+ * admitted directly into the pool's main queue, because it was used more than
+ * once within a short time.
+ *
+ * The list is a circular buffer of keys, so adding a page forgets the oldest
+ * page once the list is full. Membership checks use a PageTable whose values
+ * are not used.
+ */
+class GhostPageList {
+ public:
+  /** Sets up an empty list.
+   *
+   * @param capacity the number of pages that the list remembers; must be
+   *                 positive */
+  explicit GhostPageList(size_t capacity);
+  ~GhostPageList();
+
+  /** Remembers that a store page was evicted.
+   *
+   * The page must not already be in the list. If the list is full, the oldest
+   * page in the list is forgotten. */
+  void Add(StoreImpl* store, size_t page_id) noexcept;
+
+  /** Forgets a store page.
+   *
+   * @return true if the page was in the list */
+  inline bool Remove(StoreImpl* store, size_t page_id) noexcept {
+    // The page's key stays in the ring buffer, and is skipped when Add()
+    // reuses its slot. If the page is added again before that, it drops out of
+    // the list early. This is rare, and only makes the pool forget a hint.
+    return page_table_.Erase(store, page_id);
+  }
+
+  /** Number of pages in the list. */
+  inline size_t size() const noexcept { return page_table_.size(); }
+
+  /** The maximum number of pages remembered by the list. */
+  inline size_t capacity() const noexcept { return capacity_; }
+
+ private:
+  // Lists cannot be copied or moved.
+  GhostPageList(const GhostPageList& other) = delete;
+  GhostPageList(GhostPageList&& other) = delete;
+  GhostPageList& operator=(const GhostPageList& other) = delete;
+  GhostPageList& operator=(GhostPageList&& other) = delete;
+
+  /** A page in the ring buffer. */
+  struct Key {
+    StoreImpl* store;
+    size_t page_id;
+  };
+
+  const size_t capacity_;
+  /** The pages in the list, in the order in which they were added. */
+  Key* const keys_;
+  /** The ring buffer slot that will be used by the next Add(). */
+  size_t next_key_ = 0;
+  /** Number of ring buffer slots used so far. At most capacity_. */
+  size_t used_keys_ = 0;
+
+  /** The pages in the list. */
+  PageTable page_table_;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_GHOST_PAGE_LIST_H_
@@ -0,0 +1,59 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./ghost_page_list.h"
+
+#include "gtest/gtest.h"
+
+namespace berrydb {
+
+namespace {
+
+// The list never dereferences the store pointers it stores.
+StoreImpl* FakeStore(uintptr_t id) {
+  return reinterpret_cast<StoreImpl*>(id * 64);
+}
+
+}  // namespace
+
+TEST(GhostPageListTest, AddRemove) {
+  GhostPageList list(4);
+  EXPECT_EQ(4U, list.capacity());
+  EXPECT_EQ(0U, list.size());
+
+  list.Add(FakeStore(1), 1);
+  list.Add(FakeStore(2), 1);
+  list.Add(FakeStore(1), 2);
+  EXPECT_EQ(3U, list.size());
+
+  EXPECT_TRUE(list.Remove(FakeStore(2), 1));
+  EXPECT_FALSE(list.Remove(FakeStore(2), 1));
+  EXPECT_FALSE(list.Remove(FakeStore(2), 2));
+  EXPECT_EQ(2U, list.size());
+  EXPECT_TRUE(list.Remove(FakeStore(1), 1));
+  EXPECT_TRUE(list.Remove(FakeStore(1), 2));
+  EXPECT_EQ(0U, list.size());
+}
+
+TEST(GhostPageListTest, ForgetsOldestPages) {
+  GhostPageList list(4);
+  StoreImpl* store = FakeStore(1);
+  for (size_t i = 0; i < 10; ++i)
+    list.Add(store, i);
+  EXPECT_EQ(4U, list.size());
+
+  for (size_t i = 0; i < 6; ++i)
+    EXPECT_FALSE(list.Remove(store, i)) << "page id: " << i;
+
+  // Removed pages free up room in the list.
+  EXPECT_TRUE(list.Remove(store, 6));
+  EXPECT_TRUE(list.Remove(store, 7));
+  list.Add(store, 10);
+  EXPECT_EQ(3U, list.size());
+  EXPECT_TRUE(list.Remove(store, 8));
+  EXPECT_TRUE(list.Remove(store, 9));
+  EXPECT_TRUE(list.Remove(store, 10));
+}
+
+}  // namespace berrydb
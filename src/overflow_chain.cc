@@ -0,0 +1,188 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./overflow_chain.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "berrydb/status.h"
+#include "./format/overflow_page_format.h"
+#include "./free_page_manager.h"
+#include "./page.h"
+#include "./page_pool.h"
+#include "./store_impl.h"
+#include "./transaction_impl.h"
+
+namespace berrydb {
+
+Status OverflowChain::Write(TransactionImpl* transaction, string_view value,
+                            uint8_t* reference) {
+  DCHECK(transaction != nullptr);
+  DCHECK(reference != nullptr);
+  DCHECK_GT(value.size(), 0U);
+
+  StoreImpl* store = transaction->store();
+  PagePool* page_pool = store->page_pool();
+  size_t page_size = page_pool->page_size();
+  size_t chunk_capacity = OverflowPageFormat::ChunkCapacity(page_size);
+  size_t page_count = (value.size() + chunk_capacity - 1) / chunk_capacity;
+
+  size_t first_page_id;
+  Status status = store->free_page_manager()->AllocPageRun(
+      transaction, page_count, &first_page_id);
+  if (status != Status::kSuccess)
+    return status;
+
+  const uint8_t* value_data = reinterpret_cast<const uint8_t*>(value.data());
+  size_t remaining_size = value.size();
+  for (size_t i = 0; i < page_count; ++i) {
+    Page* page;
+    status = page_pool->StorePage(store, first_page_id + i,
+                                  PagePool::kIgnorePageData, &page);
+    if (status != Status::kSuccess)
+      return status;
+    transaction->WillModifyPage(page);
+
+    uint8_t* page_data = page->data();
+    size_t chunk_size = std::min(remaining_size, chunk_capacity);
+    uint64_t next_page_id64 = (i + 1 < page_count) ?
+        first_page_id + i + 1 : FreePageManager::kInvalidPageId;
+    OverflowPageFormat::SetNextPageId64(next_page_id64, page_data);
+    OverflowPageFormat::SetChunkSize(chunk_size, page_data);
+    uint8_t* chunk = OverflowPageFormat::MutableChunk(page_data);
+    std::memcpy(chunk, value_data, chunk_size);
+    // The unused bytes of the last page are cleared, so the store file does
+    // not depend on the pool's previous use of the page buffer.
+    std::memset(chunk + chunk_size, 0, chunk_capacity - chunk_size);
+
+    // The page is not read again by this write, so it should be evicted (and
+    // written to the store) before the pool's other pages.
+    page_pool->UnpinStorePage(page, PagePool::kDiscardPage);
+    value_data += chunk_size;
+    remaining_size -= chunk_size;
+  }
+
+  OverflowPageFormat::SetReference(first_page_id, value.size(), reference);
+  return Status::kSuccess;
+}
+
+Status OverflowChain::Free(TransactionImpl* transaction,
+                           string_view reference) {
+  DCHECK(transaction != nullptr);
+  DCHECK_EQ(OverflowPageFormat::kReferenceSize, reference.size());
+
+  // References stored in leaf cells are not aligned.
+  alignas(8) uint8_t reference_data[OverflowPageFormat::kReferenceSize];
+  std::memcpy(reference_data, reference.data(), sizeof(reference_data));
+  uint64_t first_page_id64 = OverflowPageFormat::FirstPageId64(reference_data);
+  uint64_t value_size64 = OverflowPageFormat::ValueSize64(reference_data);
+
+  StoreImpl* store = transaction->store();
+  size_t chunk_capacity =
+      OverflowPageFormat::ChunkCapacity(store->page_pool()->page_size());
+  uint64_t page_count64 = (value_size64 + chunk_capacity - 1) / chunk_capacity;
+  uint64_t store_page_count64 = store->header()->page_count;
+  if (first_page_id64 == FreePageManager::kInvalidPageId ||
+      first_page_id64 >= store_page_count64 ||
+      page_count64 > store_page_count64 - first_page_id64) {
+    return Status::kDataCorrupted;
+  }
+
+  // The checks above guarantee that the page IDs fit in size_t.
+  size_t first_page_id = static_cast<size_t>(first_page_id64);
+  size_t page_count = static_cast<size_t>(page_count64);
+  FreePageManager* free_page_manager = store->free_page_manager();
+  for (size_t i = 0; i < page_count; ++i) {
+    Status status = free_page_manager->FreePage(first_page_id + i,
+                                                transaction);
+    if (status != Status::kSuccess)
+      return status;
+  }
+  return Status::kSuccess;
+}
+
+OverflowChain::OverflowChain(TransactionImpl* transaction,
+                             string_view reference) noexcept
+    : store_(transaction->store()),
+      page_pool_(transaction->store()->page_pool()) {
+  DCHECK_EQ(OverflowPageFormat::kReferenceSize, reference.size());
+
+  // References stored in leaf cells are not aligned.
+  alignas(8) uint8_t reference_data[OverflowPageFormat::kReferenceSize];
+  std::memcpy(reference_data, reference.data(), sizeof(reference_data));
+  value_size64_ = OverflowPageFormat::ValueSize64(reference_data);
+  remaining_size64_ = value_size64_;
+  next_page_id64_ = OverflowPageFormat::FirstPageId64(reference_data);
+}
+
+OverflowChain::~OverflowChain() {
+  if (page_ != nullptr)
+    page_pool_->UnpinStorePage(page_, PagePool::kDiscardPage);
+}
+
+Status OverflowChain::Next(string_view* chunk) {
+  DCHECK(chunk != nullptr);
+
+  if (page_ != nullptr) {
+    page_pool_->UnpinStorePage(page_, PagePool::kDiscardPage);
+    page_ = nullptr;
+  }
+  if (remaining_size64_ == 0)
+    return Status::kNotFound;
+
+  size_t page_id = static_cast<size_t>(next_page_id64_);
+  // This check should be optimized out on 64-bit architectures.
+  if (page_id != next_page_id64_)
+    return Status::kDatabaseTooLarge;
+  if (page_id == FreePageManager::kInvalidPageId)
+    return Status::kDataCorrupted;
+
+  Page* page;
+  Status status = page_pool_->StorePage(
+      store_, page_id, PagePool::kFetchPageData, &page);
+  if (status != Status::kSuccess)
+    return status;
+
+  // Each page must hold at least one value byte, so corrupted chains that
+  // contain cycles are detected once the value's size is exceeded.
+  const uint8_t* page_data = page->data();
+  size_t chunk_size = OverflowPageFormat::ChunkSize(page_data);
+  if (OverflowPageFormat::IsCorruptPage(page_data, page_pool_->page_size()) ||
+      chunk_size > remaining_size64_) {
+    page_pool_->UnpinStorePage(page, PagePool::kDiscardPage);
+    return Status::kDataCorrupted;
+  }
+
+  page_ = page;
+  remaining_size64_ -= chunk_size;
+  next_page_id64_ = OverflowPageFormat::NextPageId64(page_data);
+  // The next page is read while the caller uses this page's chunk.
+  size_t next_page_id = static_cast<size_t>(next_page_id64_);
+  if (remaining_size64_ != 0 && next_page_id == next_page_id64_ &&
+      next_page_id != FreePageManager::kInvalidPageId) {
+    page_pool_->Prefetch(store_, &next_page_id, 1);
+  }
+  *chunk = string_view(
+      reinterpret_cast<const char*>(OverflowPageFormat::Chunk(page_data)),
+      chunk_size);
+  return Status::kSuccess;
+}
+
+Status OverflowChain::ReadAll(uint8_t* buffer) {
+  DCHECK(buffer != nullptr || remaining_size64_ == 0);
+
+  while (true) {
+    string_view chunk;
+    Status status = Next(&chunk);
+    if (status == Status::kNotFound)
+      return Status::kSuccess;
+    if (status != Status::kSuccess)
+      return status;
+    std::memcpy(buffer, chunk.data(), chunk.size());
+    buffer += chunk.size();
+  }
+}
+
+}  // namespace berrydb
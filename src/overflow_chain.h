@@ -0,0 +1,120 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_OVERFLOW_CHAIN_H_
+#define BERRYDB_OVERFLOW_CHAIN_H_
+
+#include "berrydb/platform.h"
+#include "berrydb/string_view.h"
+
+namespace berrydb {
+
+class Page;
+class PagePool;
+enum class Status : int;
+class StoreImpl;
+class TransactionImpl;
+
+/** A value stored in a chain of overflow pages.
+ *
+ * Values that are too large to be stored in B+tree leaves are written to a
+ * chain of overflow pages by Write(), which produces the reference stored in
+ * the leaf cell. The page layout is described in OverflowPageFormat.
+ *
+ * A chain is read one page at a time, so values of any size can be streamed
+ * through a small page pool. Only the page holding the most recently read chunk
+ * is pinned. Chain pages are unpinned with PagePool::kDiscardPage, so reading
+ * or writing a large value does not evict the pool's frequently used pages.
+ *
+ * OverflowChain instances are lightweight, like BTree instances, and are
+ * intended to be created on the stack for each read.
+ */
+class OverflowChain {
+ public:
+  /** Writes a value to a new chain of overflow pages.
+   *
+   * The chain's pages are allocated as a single run, so the value is stored in
+   * consecutive pages.
+   *
+   * @param  transaction the transaction that allocates and writes the pages
+   * @param  value       the value to be stored; must not be empty
+   * @param  reference   receives the chain's reference; must point to a buffer
+   *                     of OverflowPageFormat::kReferenceSize bytes
+   * @return             most likely kSuccess or kIoError
+   */
+  static Status Write(TransactionImpl* transaction, string_view value,
+                      uint8_t* reference);
+
+  /** Frees the pages of a chain whose value is overwritten or deleted.
+   *
+   * The pages are freed when the transaction commits. Chains are written to
+   * consecutive pages, so the page IDs are computed from the reference, and the
+   * chain's pages do not need to be read.
+   *
+   * @param  transaction the transaction that removes the value
+   * @param  reference   the chain's reference, as produced by Write()
+   * @return             kDataCorrupted if the reference points outside the
+   *                     store's data file; otherwise, most likely kSuccess or
+   *                     kIoError
+   */
+  static Status Free(TransactionImpl* transaction, string_view reference);
+
+  /** Sets up reading a chain.
+   *
+   * @param transaction the transaction used to read the chain's pages
+   * @param reference   the chain's reference, as produced by Write(); the
+   *                    reference is copied, so the buffer does not need to
+   *                    outlive this instance
+   */
+  OverflowChain(TransactionImpl* transaction, string_view reference) noexcept;
+
+  /** Removes the pin on the page holding the last chunk, if there is one. */
+  ~OverflowChain();
+
+  /** The size of the value stored in the chain. */
+  inline uint64_t value_size64() const noexcept { return value_size64_; }
+
+  /** Reads the value's next chunk.
+   *
+   * @param  chunk if the call succeeds, receives the chunk's bytes, which
+   *               remain valid until the next call or until this instance is
+   *               destroyed
+   * @return       kNotFound if the whole value was read; kDataCorrupted if the
+   *               chain's pages are not valid; otherwise, most likely kSuccess
+   *               or kIoError
+   */
+  Status Next(string_view* chunk);
+
+  /** Reads the rest of the value into a buffer.
+   *
+   * @param  buffer receives the value's bytes that were not returned by Next()
+   * @return        kDataCorrupted if the chain's pages are not valid;
+   *                otherwise, most likely kSuccess or kIoError
+   */
+  Status ReadAll(uint8_t* buffer);
+
+ private:
+  // Chains hold page pins, so they cannot be copied or moved.
+  OverflowChain(const OverflowChain& other) = delete;
+  OverflowChain(OverflowChain&& other) = delete;
+  OverflowChain& operator=(const OverflowChain& other) = delete;
+  OverflowChain& operator=(OverflowChain&& other) = delete;
+
+  /** The store that holds the chain's pages. */
+  StoreImpl* const store_;
+  /** The page pool used by the chain's store. */
+  PagePool* const page_pool_;
+  /** The size of the value stored in the chain. */
+  uint64_t value_size64_;
+  /** The number of value bytes that haven't been returned by Next() yet. */
+  uint64_t remaining_size64_;
+  /** The ID of the page holding the next chunk. */
+  uint64_t next_page_id64_;
+  /** The page holding the chunk returned by Next(). nullptr if none. */
+  Page* page_ = nullptr;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_OVERFLOW_CHAIN_H_
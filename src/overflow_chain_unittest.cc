@@ -0,0 +1,197 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./overflow_chain.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/options.h"
+#include "berrydb/status.h"
+#include "./format/overflow_page_format.h"
+#include "./page_pool.h"
+#include "./pool_impl.h"
+#include "./store_impl.h"
+#include "./test/file_deleter.h"
+#include "./transaction_impl.h"
+#include "./util/unique_ptr.h"
+
+// TODO(pwnall): Remove this once we don't need to print a Status value.
+#include "berrydb/ostream_ops.h"
+
+namespace berrydb {
+
+class OverflowChainTest : public ::testing::Test {
+ protected:
+  OverflowChainTest()
+      : data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) { }
+
+  void SetUp() override {
+    PoolOptions options;
+    options.page_shift = kStorePageShift;
+    options.page_pool_size = 16;
+    pool_.reset(PoolImpl::Create(options));
+
+    StoreImpl* raw_store;
+    ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+        kStoreFileName, StoreOptions(), &raw_store));
+    store_.reset(raw_store);
+    transaction_.reset(store_->CreateTransaction());
+  }
+
+  /** A value whose bytes depend on their positions. */
+  std::string Value(size_t size) {
+    std::string value;
+    for (size_t i = 0; i < size; ++i)
+      value.push_back(static_cast<char>('a' + (i * 11) % 26));
+    return value;
+  }
+
+  /** Writes a value to a new chain, and returns its reference. */
+  std::string WriteChain(const std::string& value) {
+    alignas(8) uint8_t reference[OverflowPageFormat::kReferenceSize];
+    EXPECT_EQ(Status::kSuccess, OverflowChain::Write(
+        transaction_.get(), string_view(value.data(), value.size()),
+        reference));
+    return std::string(reinterpret_cast<char*>(reference), sizeof(reference));
+  }
+
+  const std::string kStoreFileName = "test_overflow_chain.berry";
+  static constexpr size_t kStorePageShift = 9;  // 512-byte pages
+  static constexpr size_t kChunkCapacity =
+      OverflowPageFormat::ChunkCapacity(1 << kStorePageShift);
+
+  // Must precede UniquePtr members, because on Windows all file handles must be
+  // closed before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  UniquePtr<PoolImpl> pool_;
+  UniquePtr<StoreImpl> store_;
+  UniquePtr<TransactionImpl> transaction_;
+};
+
+constexpr size_t OverflowChainTest::kStorePageShift;
+constexpr size_t OverflowChainTest::kChunkCapacity;
+
+TEST_F(OverflowChainTest, WriteAndStream) {
+  std::string value = Value(kChunkCapacity * 3 + 7);
+  std::string reference = WriteChain(value);
+  ASSERT_EQ(OverflowPageFormat::kReferenceSize, reference.size());
+  PagePool* page_pool = store_->page_pool();
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  OverflowChain chain(transaction_.get(),
+                      string_view(reference.data(), reference.size()));
+  EXPECT_EQ(value.size(), chain.value_size64());
+
+  std::string read_value;
+  string_view chunk;
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_EQ(Status::kSuccess, chain.Next(&chunk));
+    EXPECT_EQ((i < 3) ? kChunkCapacity : 7U, chunk.size());
+    EXPECT_EQ(1U, page_pool->pinned_pages());
+    read_value.append(chunk.data(), chunk.size());
+  }
+  EXPECT_EQ(Status::kNotFound, chain.Next(&chunk));
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+  EXPECT_EQ(value, read_value);
+}
+
+TEST_F(OverflowChainTest, ReadAll) {
+  std::string value = Value(kChunkCapacity * 2);
+  std::string reference = WriteChain(value);
+
+  OverflowChain chain(transaction_.get(),
+                      string_view(reference.data(), reference.size()));
+  string_view chunk;
+  ASSERT_EQ(Status::kSuccess, chain.Next(&chunk));
+
+  // ReadAll() picks up after the chunks returned by Next().
+  std::string rest(kChunkCapacity, '\0');
+  ASSERT_EQ(Status::kSuccess,
+            chain.ReadAll(reinterpret_cast<uint8_t*>(&rest[0])));
+  EXPECT_EQ(value.substr(kChunkCapacity), rest);
+  EXPECT_EQ(Status::kNotFound, chain.Next(&chunk));
+}
+
+TEST_F(OverflowChainTest, ValueLargerThanPool) {
+  // The value needs many more pages than the pool can cache.
+  std::string value = Value(kChunkCapacity * 100 + 1);
+  std::string reference = WriteChain(value);
+  PagePool* page_pool = store_->page_pool();
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  OverflowChain chain(transaction_.get(),
+                      string_view(reference.data(), reference.size()));
+  std::string read_value(value.size(), '\0');
+  ASSERT_EQ(Status::kSuccess,
+            chain.ReadAll(reinterpret_cast<uint8_t*>(&read_value[0])));
+  EXPECT_EQ(value, read_value);
+
+  // The chain survives the transaction's commit.
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  transaction_.reset(store_->CreateTransaction());
+  OverflowChain committed_chain(
+      transaction_.get(), string_view(reference.data(), reference.size()));
+  read_value.assign(value.size(), '\0');
+  ASSERT_EQ(Status::kSuccess, committed_chain.ReadAll(
+      reinterpret_cast<uint8_t*>(&read_value[0])));
+  EXPECT_EQ(value, read_value);
+}
+
+TEST_F(OverflowChainTest, CorruptChain) {
+  // The last page is not full, so it holds fewer bytes than the first page.
+  std::string value = Value(kChunkCapacity * 3 - 1);
+  std::string reference = WriteChain(value);
+  const uint8_t* reference_data =
+      reinterpret_cast<const uint8_t*>(reference.data());
+  size_t first_page_id = static_cast<size_t>(
+      OverflowPageFormat::FirstPageId64(reference_data));
+
+  // Point the chain's second page back to the first page.
+  PagePool* page_pool = store_->page_pool();
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store_.get(), first_page_id + 1, PagePool::kFetchPageData, &page));
+  transaction_->WillModifyPage(page);
+  OverflowPageFormat::SetNextPageId64(first_page_id, page->data());
+  page_pool->UnpinStorePage(page);
+
+  // The cycle is detected when the chunks exceed the value's size.
+  {
+    OverflowChain chain(transaction_.get(),
+                        string_view(reference.data(), reference.size()));
+    string_view chunk;
+    ASSERT_EQ(Status::kSuccess, chain.Next(&chunk));
+    ASSERT_EQ(Status::kSuccess, chain.Next(&chunk));
+    EXPECT_EQ(Status::kDataCorrupted, chain.Next(&chunk));
+  }
+
+  // Pages that claim to hold no bytes are detected right away.
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store_.get(), first_page_id + 1, PagePool::kFetchPageData, &page));
+  transaction_->WillModifyPage(page);
+  OverflowPageFormat::SetChunkSize(0, page->data());
+  page_pool->UnpinStorePage(page);
+  {
+    OverflowChain chain(transaction_.get(),
+                        string_view(reference.data(), reference.size()));
+    std::string read_value(value.size(), '\0');
+    EXPECT_EQ(Status::kDataCorrupted,
+              chain.ReadAll(reinterpret_cast<uint8_t*>(&read_value[0])));
+  }
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  // References to the store's header page are invalid.
+  alignas(8) uint8_t bad_reference[OverflowPageFormat::kReferenceSize];
+  OverflowPageFormat::SetReference(0, 1, bad_reference);
+  OverflowChain chain(transaction_.get(), string_view(
+      reinterpret_cast<char*>(bad_reference), sizeof(bad_reference)));
+  string_view chunk;
+  EXPECT_EQ(Status::kDataCorrupted, chain.Next(&chunk));
+}
+
+}  // namespace berrydb
@@ -18,7 +18,8 @@ Page* Page::Create(PagePool* page_pool) {
 
   size_t block_size = sizeof(Page) + page_pool->page_size();
   void* page_block = Allocate(block_size);
-  Page* page = new (page_block) Page(page_pool);
+  uint8_t* data = reinterpret_cast<uint8_t*>(page_block) + sizeof(Page);
+  Page* page = new (page_block) Page(page_pool, data);
   DCHECK_EQ(reinterpret_cast<void*>(page), page_block);
 
   // Make sure that page data is 8-byte aligned.
@@ -27,18 +28,53 @@ Page* Page::Create(PagePool* page_pool) {
   return page;
 }
 
+Page* Page::CreateAt(PagePool* page_pool, void* control_block,
+                     uint8_t* data) {
+  DCHECK(page_pool != nullptr);
+  DCHECK(page_pool->owns_entry_memory());
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(data) & (page_pool->page_size() - 1),
+            0U);
+
+  return new (control_block) Page(page_pool, data);
+}
+
+Page* Page::CreateMapped(PagePool* page_pool,
+                         TransactionImpl* init_transaction, size_t page_id,
+                         uint8_t* data) {
+  DCHECK(page_pool != nullptr);
+  DCHECK(init_transaction->IsInit());
+
+  void* heap_block = Allocate(sizeof(Page));
+  Page* page = new (heap_block) Page(page_pool, data);
+  DCHECK_EQ(reinterpret_cast<void*>(page), heap_block);
+  page->is_mapped_ = true;
+  page->WillCacheStoreData(init_transaction, page_id);
+  return page;
+}
+
 void Page::Release(PagePool *page_pool) {
 #if DCHECK_IS_ON()
   DCHECK_EQ(page_pool_, page_pool);
 #endif  // DCHECK_IS_ON()
 
+  if (is_mapped_) {
+    DoesNotCacheStoreData();
+    Deallocate(reinterpret_cast<void*>(this), sizeof(Page));
+    return;
+  }
+
+  // The memory of these entries is released together with the slabs or the
+  // frame table.
+  if (page_pool->owns_entry_memory())
+    return;
+
   size_t block_size = sizeof(Page) + page_pool->page_size();
   void* heap_block = reinterpret_cast<void*>(this);
   Deallocate(heap_block, block_size);
 }
 
-Page::Page(PagePool* page_pool)
-    : pin_count_(1)
+Page::Page(PagePool* page_pool, uint8_t* data)
+    : data_(data), pin_count_(1)
 #if DCHECK_IS_ON()
     , page_pool_(page_pool)
 #endif  // DCHECK_IS_ON()
@@ -81,7 +117,11 @@ void Page::DcheckTransactionReassignmentIsValid(TransactionImpl* transaction) {
   DCHECK(transaction != nullptr);
   DCHECK(transaction_ != nullptr);
   DCHECK(transaction_ != transaction);
-  DCHECK(transaction_->IsInit() != transaction->IsInit());
+  // The store's allocation transaction hands its pages to the transactions
+  // that commit allocations.
+  DCHECK(transaction_->IsInit() != transaction->IsInit() ||
+         transaction_ ==
+             transaction_->store()->free_page_manager()->alloc_transaction());
 }
 #endif  // DCHECK_IS_ON()
 
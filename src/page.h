@@ -26,8 +26,10 @@ class TransactionImpl;
  * entry's buffer.
  *
  * Each entry in a page pool has a control block (the members of this class),
- * which is laid out in memory right before the buffer that holds the content of
- * of the cached store page.
+ * and a buffer that holds the content of the cached store page. By default,
+ * the control block is laid out in memory right before the buffer. Entries
+ * carved out of page pool slabs or frame tables have their control blocks
+ * stored separately, so the buffers can be aligned to the page size.
  *
  * An entry belongs to the same PagePool for its entire lifetime. The entry's
  * control block does not hold a reference to the pool (in release mode) to save
@@ -54,6 +56,34 @@ class Page {
    * The returned page has one pin on it, which is owned by the caller. */
   static Page* Create(PagePool* page_pool);
 
+  /** Sets up an entry whose memory is owned by the page pool.
+   *
+   * This is used by pools that carve their entries out of slabs or out of a
+   * frame table. The returned page has one pin on it, which is owned by the
+   * caller.
+   *
+   * @param page_pool     the pool that the entry will belong to
+   * @param control_block memory for the entry's control block; must be
+   *                      suitably aligned for Page
+   * @param data          the entry's page data buffer */
+  static Page* CreateAt(PagePool* page_pool, void* control_block,
+                        uint8_t* data);
+
+  /** Allocates a control block for a page in a memory-mapped store.
+   *
+   * The entry does not have a buffer. Its data points into the store's
+   * read-only mapping, and it is never added to the page pool's maps or
+   * eviction lists. The entry keeps the pin it is created with for its entire
+   * lifetime, so it is never considered for eviction.
+   *
+   * @param page_pool        the pool used by the store
+   * @param init_transaction the init transaction of the store
+   * @param page_id          the store page that the entry describes
+   * @param data             the page's data in the store's mapping */
+  static Page* CreateMapped(PagePool* page_pool,
+                            TransactionImpl* init_transaction, size_t page_id,
+                            uint8_t* data);
+
   /** Releases the memory resources used up by this page pool entry.
    *
    * This method invalidates the Page instance, so it must not be used
@@ -94,11 +124,60 @@ class Page {
     return is_dirty_;
   }
 
-  /** The page data held by this page. */
-  inline uint8_t* data() noexcept {
-    return reinterpret_cast<uint8_t*>(this + 1);
+  /** The page pool shard that caches this entry's store page.
+   *
+   * This is only meaningful for entries that cache store pages. Entries stay
+   * in a shard while their store page is cached, so the shard's latch can be
+   * found without hashing the page's store and ID.
+   */
+  inline size_t shard_index() const noexcept { return shard_index_; }
+
+  /** Bookkeeping used by the page pool's eviction policy.
+   *
+   * The meaning of the value depends on the policy. It is only meaningful for
+   * entries that cache store pages.
+   */
+  inline uint8_t eviction_state() const noexcept { return eviction_state_; }
+
+  /** Eviction policy state setter for PagePool. */
+  inline void SetEvictionState(uint8_t eviction_state) noexcept {
+    eviction_state_ = eviction_state;
   }
 
+  /** True while the page's data is being read from its store.
+   *
+   * Loading entries are already in the page pool, so threads that need the same
+   * store page wait for the read instead of issuing another one. The page
+   * pool's cleaner also marks the dirty pages that it writes as loading, so
+   * they are not modified during the writes. The flag is guarded by the latch
+   * of the entry's page pool shard.
+   */
+  inline bool is_loading() const noexcept { return is_loading_; }
+
+  /** Loading flag setter for PagePool. */
+  inline void SetLoading(bool is_loading) noexcept { is_loading_ = is_loading; }
+
+  /** True while the page is loading, and its read was started by Prefetch().
+   *
+   * PagePool::Prefetch() does not wait for its reads, so the threads that need
+   * a prefetched page collect the read's completion themselves. The flag is
+   * guarded by the latch of the entry's page pool shard.
+   */
+  inline bool is_prefetched() const noexcept { return is_prefetched_; }
+
+  /** Prefetched flag setter for PagePool. */
+  inline void SetPrefetched(bool is_prefetched) noexcept {
+    is_prefetched_ = is_prefetched;
+  }
+
+  /** The page data held by this page. */
+  inline uint8_t* data() noexcept { return data_; }
+
+  /** True if the page's data lives in a memory-mapped store's mapping.
+   *
+   * Mapped pages are read-only, and are not managed by the page pool. */
+  inline bool is_mapped() const noexcept { return is_mapped_; }
+
 #if DCHECK_IS_ON()
   /** The pool that this page belongs to. Solely intended for use in DCHECKs. */
   inline const PagePool* page_pool() const noexcept { return page_pool_; }
@@ -107,6 +186,9 @@ class Page {
   /** True if the pool page's contents can be replaced. */
   inline bool IsUnpinned() const noexcept { return pin_count_ == 0; }
 
+  /** True if the pool page's only pin belongs to the caller. */
+  inline bool HasOnePin() const noexcept { return pin_count_ == 1; }
+
   /** Increments the page's pin count. */
   inline void AddPin() noexcept {
 #if DCHECK_IS_ON()
@@ -146,6 +228,16 @@ class Page {
     page_id_ = page_id;
   }
 
+  /** Shard index setter for PagePool.
+   *
+   * This must only be called while the caller owns the page pool entry's only
+   * pin, before the entry is added to the shard's page map. */
+  inline void SetShardIndex(size_t shard_index) noexcept {
+    DCHECK_EQ(pin_count_, 1U);
+    DCHECK_LE(shard_index, static_cast<size_t>(~static_cast<uint32_t>(0)));
+    shard_index_ = static_cast<uint32_t>(shard_index);
+  }
+
   /** Track the fact that the pool page entry no longer caches a store page.
    *
    * This method is exposed for use from TransactionImpl::UnassignPage().
@@ -192,7 +284,8 @@ class Page {
    * A page pool entry can only be reassigned to a transaction that belongs to
    * the same store. This implies that neither the current nor the new
    * transaction may be null. Either the current or the new transaction must be
-   * the store's init transaction.
+   * the store's init transaction, unless the page is taken from the store's
+   * allocation transaction.
    *
    * @param transaction the transaction that the Page is reassigned to
    */
@@ -206,7 +299,7 @@ class Page {
 
  private:
   /** Use Page::Create() to construct Page instances. */
-  Page(PagePool* page);
+  Page(PagePool* page, uint8_t* data);
   ~Page();
 
   // Pages cannot be copied or moved.
@@ -253,6 +346,9 @@ class Page {
 
   TransactionImpl* transaction_;
 
+  /** See data(). */
+  uint8_t* const data_;
+
   /** The cached page ID, for pool entries that are caching a store's pages.
    *
    * This member's memory is available for use (perhaps via an union) by
@@ -262,7 +358,17 @@ class Page {
 
   /** Number of times the page was pinned. Very similar to a reference count. */
   size_t pin_count_;
+  /** See shard_index(). Fits next to is_dirty_ in the struct's padding. */
+  uint32_t shard_index_ = 0;
   bool is_dirty_ = false;
+  /** See eviction_state(). */
+  uint8_t eviction_state_ = 0;
+  /** See is_mapped(). */
+  bool is_mapped_ = false;
+  /** See is_loading(). */
+  bool is_loading_ = false;
+  /** See is_prefetched(). */
+  bool is_prefetched_ = false;
 
 #if DCHECK_IS_ON()
   PagePool* const page_pool_;
@@ -0,0 +1,59 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./page_frame_table.h"
+
+#include <algorithm>
+
+#include "./page_slabs.h"
+
+namespace berrydb {
+
+namespace {
+
+/** Size of the block holding the frames' page data. */
+size_t DataSize(size_t page_shift, size_t frame_capacity,
+                bool use_huge_pages) {
+  size_t data_size = frame_capacity << page_shift;
+  // Huge pages are only used for whole, aligned huge page ranges.
+  if (use_huge_pages) {
+    data_size = (data_size + PageSlabs::kSlabSize - 1) &
+                ~(PageSlabs::kSlabSize - 1);
+  }
+  return data_size;
+}
+
+}  // namespace
+
+PageFrameTable::PageFrameTable(size_t page_shift, size_t frame_capacity,
+                               bool use_huge_pages)
+    : page_shift_(page_shift), frame_capacity_(frame_capacity),
+      data_size_(DataSize(page_shift, frame_capacity, use_huge_pages)),
+      frames_((frame_capacity == 0) ? nullptr : reinterpret_cast<Page*>(
+          Allocate(sizeof(Page) * frame_capacity))),
+      data_((frame_capacity == 0) ? nullptr : reinterpret_cast<uint8_t*>(
+          AllocateAligned(
+              data_size_,
+              use_huge_pages ? std::max(PageSlabs::kSlabSize,
+                                        static_cast<size_t>(1) << page_shift)
+                             : static_cast<size_t>(1) << page_shift,
+              use_huge_pages))) {}
+
+PageFrameTable::~PageFrameTable() {
+  if (frame_capacity_ == 0)
+    return;
+  Deallocate(frames_, sizeof(Page) * frame_capacity_);
+  DeallocateAligned(data_, data_size_);
+}
+
+Page* PageFrameTable::CreatePage(PagePool* page_pool) {
+  DCHECK_LT(frame_count_, frame_capacity_);
+
+  size_t frame_index = frame_count_;
+  ++frame_count_;
+  return Page::CreateAt(page_pool, frames_ + frame_index,
+                        data_ + (frame_index << page_shift_));
+}
+
+}  // namespace berrydb
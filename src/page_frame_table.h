@@ -0,0 +1,83 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_PAGE_FRAME_TABLE_H_
+#define BERRYDB_PAGE_FRAME_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "./page.h"
+#include "berrydb/platform.h"
+
+namespace berrydb {
+
+class PagePool;
+
+/** Holds all of a page pool's entries in two contiguous arrays.
+ *
+ * Each page pool entry occupies a frame, identified by a frame number. The
+ * control blocks of all frames are stored in one array, and the data buffers
+ * are stored in a separate memory block, in the same order. Buffers are
+ * aligned to the page size.
+ *
+ * Keeping the control blocks together lets the pool scan its entries' metadata
+ * with a linear pass over a small array, without touching the page data. The
+ * memory for the whole pool is reserved when the table is created. Most
+ * platforms only commit memory when it is touched, and frames are set up in
+ * order as the pool grows, so small working sets do not use up the full pool
+ * size.
+ */
+class PageFrameTable {
+ public:
+  /** Reserves memory for a pool's frames.
+   *
+   * @param page_shift     log2 of the page pool's page size
+   * @param frame_capacity the maximum number of frames; the table does not
+   *                       allocate any memory if this is zero
+   * @param use_huge_pages if true, the data block is backed by huge pages */
+  PageFrameTable(size_t page_shift, size_t frame_capacity,
+                 bool use_huge_pages);
+  ~PageFrameTable();
+
+  /** Sets up a page pool entry in the next unused frame.
+   *
+   * @return a page with one pin on it, owned by the caller */
+  Page* CreatePage(PagePool* page_pool);
+
+  /** The entry in a frame that was set up by CreatePage(). */
+  inline Page* frame(size_t frame_index) const noexcept {
+    DCHECK_LT(frame_index, frame_count_);
+    return frames_ + frame_index;
+  }
+
+  /** Number of frames set up by CreatePage(). */
+  inline size_t frame_count() const noexcept { return frame_count_; }
+
+  /** The maximum number of frames. */
+  inline size_t frame_capacity() const noexcept { return frame_capacity_; }
+
+ private:
+  // Frame tables cannot be copied or moved.
+  PageFrameTable(const PageFrameTable& other) = delete;
+  PageFrameTable(PageFrameTable&& other) = delete;
+  PageFrameTable& operator=(const PageFrameTable& other) = delete;
+  PageFrameTable& operator=(PageFrameTable&& other) = delete;
+
+  const size_t page_shift_;
+  const size_t frame_capacity_;
+  /** Size of the data block, in bytes. */
+  const size_t data_size_;
+
+  /** The control blocks of the frames. */
+  Page* const frames_;
+  /** The data buffers of the frames. */
+  uint8_t* const data_;
+
+  size_t frame_count_ = 0;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_PAGE_FRAME_TABLE_H_
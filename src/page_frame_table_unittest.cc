@@ -0,0 +1,68 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./page_frame_table.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/options.h"
+#include "./page.h"
+#include "./page_pool.h"
+#include "./page_slabs.h"
+#include "./pool_impl.h"
+#include "./util/unique_ptr.h"
+
+namespace berrydb {
+
+class PageFrameTableTest : public ::testing::Test {
+ protected:
+  void CreatePool(int page_shift) {
+    PoolOptions options;
+    options.page_shift = page_shift;
+    options.page_pool_size = 16;
+    options.page_pool_frame_table = true;
+    pool_.reset(PoolImpl::Create(options));
+  }
+
+  UniquePtr<PoolImpl> pool_;
+};
+
+TEST_F(PageFrameTableTest, FramesAreContiguous) {
+  CreatePool(12);
+  PageFrameTable frame_table(12, 8, false);
+  EXPECT_EQ(8U, frame_table.frame_capacity());
+  EXPECT_EQ(0U, frame_table.frame_count());
+
+  Page* first_page = frame_table.CreatePage(pool_->page_pool());
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(first_page->data()) & 4095);
+  for (size_t i = 1; i < 8; ++i) {
+    Page* page = frame_table.CreatePage(pool_->page_pool());
+    EXPECT_EQ(i + 1, frame_table.frame_count());
+    EXPECT_EQ(first_page + i, page);
+    EXPECT_EQ(page, frame_table.frame(i));
+    EXPECT_EQ(first_page->data() + (i << 12), page->data());
+    EXPECT_FALSE(page->IsUnpinned());
+    std::memset(page->data(), static_cast<int>(i), 1 << 12);
+  }
+  EXPECT_EQ(first_page, frame_table.frame(0));
+}
+
+TEST_F(PageFrameTableTest, HugePages) {
+  CreatePool(12);
+  PageFrameTable frame_table(12, 4, true);
+  Page* page = frame_table.CreatePage(pool_->page_pool());
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(page->data()) &
+                (PageSlabs::kSlabSize - 1));
+  std::memset(page->data(), 0, 1 << 12);
+}
+
+TEST_F(PageFrameTableTest, EmptyTable) {
+  PageFrameTable frame_table(12, 0, false);
+  EXPECT_EQ(0U, frame_table.frame_capacity());
+  EXPECT_EQ(0U, frame_table.frame_count());
+}
+
+}  // namespace berrydb
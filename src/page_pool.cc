@@ -4,41 +4,289 @@
 
 #include "./page_pool.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
 
 #include "berrydb/platform.h"
 #include "./store_impl.h"
+#include "./util/platform_allocator.h"
 
 namespace berrydb {
 
+namespace {
+
+/** The number of shards used by a multi-threaded pool.
+ *
+ * @param  shard_count the number of shards requested by the pool's user; 0
+ *                     means one shard per hardware thread
+ * @return the requested number of shards, rounded up to a power of two */
+size_t MultiThreadedShardCount(size_t shard_count) {
+  if (shard_count == 0)
+    shard_count = std::thread::hardware_concurrency();
+  size_t power = 1;
+  while (power < shard_count)
+    power <<= 1;
+  return power;
+}
+
+/** The options for a single-threaded LRU page pool. */
+PoolOptions DefaultPagePoolOptions(size_t page_shift, size_t page_capacity) {
+  PoolOptions options;
+  options.page_shift = page_shift;
+  options.page_pool_size = page_capacity;
+  return options;
+}
+
+/** The number of pages in a 2Q shard's probation queue.
+ *
+ * The 2Q paper recommends a probation queue holding 25% of the pool's pages,
+ * and remembering the IDs of as many pages as would fit in 50% of the pool.
+ *
+ * @param shard_capacity the number of pages that a shard is expected to cache
+ */
+size_t TwoQueueProbationCapacity(size_t shard_capacity) {
+  return std::max(shard_capacity / 4, static_cast<size_t>(1));
+}
+
+/** The number of page IDs remembered by a 2Q shard's ghost list. */
+size_t TwoQueueGhostCapacity(size_t shard_capacity) {
+  return std::max(shard_capacity / 2, static_cast<size_t>(1));
+}
+
+/** The number of eviction candidates examined in each shard by CleanPages().
+ *
+ * @param clean_fraction the fraction of the pool that is kept clean
+ * @param shard_capacity the number of pages that a shard is expected to cache
+ */
+size_t CleanWindow(double clean_fraction, size_t shard_capacity) {
+  if (!(clean_fraction > 0))
+    return 0;
+  if (clean_fraction >= 1)
+    return shard_capacity;
+  return static_cast<size_t>(
+      std::ceil(clean_fraction * static_cast<double>(shard_capacity)));
+}
+
+/** Number of pages read ahead by the second miss in a sequential run. */
+constexpr size_t kMinReadaheadPages = 4;
+
+/** The largest number of pages read ahead by a miss.
+ *
+ * Pools also limit readahead to a quarter of their capacity, so scans do not
+ * flush small pools. Pools that cannot read ahead kMinReadaheadPages under this
+ * limit do not read ahead at all. */
+constexpr size_t kMaxReadaheadPages = 64;
+
+/** The largest number of pages read ahead by a miss in a pool. */
+size_t MaxReadahead(size_t page_capacity) {
+  if (page_capacity / 4 < kMinReadaheadPages)
+    return 0;
+  return std::min(kMaxReadaheadPages, page_capacity / 4);
+}
+
+/** The largest number of a store's pages whose prefetch reads are in progress.
+ *
+ * This is the depth of the stores' prefetch queues. Each prefetched page is
+ * read separately, because its entry's buffer is not adjacent to the buffers
+ * of the entries holding the neighboring pages. */
+constexpr size_t kMaxPrefetchReads = 32;
+
+/** How long the background cleaner sleeps if it is not woken up. */
+constexpr std::chrono::milliseconds kCleanerInterval(50);
+
+}  // namespace
+
 PagePool::PagePool(PoolImpl* pool, size_t page_shift, size_t page_capacity)
-    : page_shift_(page_shift), page_size_(static_cast<size_t>(1) << page_shift),
-      page_capacity_(page_capacity), pool_(pool), free_list_(), lru_list_(),
-      log_list_() {
+    : PagePool(pool, DefaultPagePoolOptions(page_shift, page_capacity)) {}
+
+PagePool::PagePool(PoolImpl* pool, const PoolOptions& options)
+    : page_shift_(options.page_shift),
+      page_size_(static_cast<size_t>(1) << options.page_shift),
+      page_capacity_(options.page_pool_size), pool_(pool),
+      eviction_policy_(options.page_eviction_policy),
+      // Direct I/O needs page data aligned to the page size, which separately
+      // allocated entries don't have.
+      uses_slabs_((options.page_pool_slabs || options.page_pool_direct_io) &&
+                  !options.page_pool_frame_table),
+      uses_frame_table_(options.page_pool_frame_table),
+      uses_direct_io_(options.page_pool_direct_io),
+      is_multi_threaded_(options.multi_threaded),
+      shard_mask_(options.multi_threaded ?
+                  MultiThreadedShardCount(options.page_pool_shards) - 1 : 0),
+      shards_(reinterpret_cast<Shard*>(
+          Allocate(sizeof(Shard) * (shard_mask_ + 1)))),
+      clean_fraction_(options.page_pool_clean_fraction),
+      clean_window_(CleanWindow(
+          clean_fraction_, (page_capacity_ + shard_mask_) / (shard_mask_ + 1))),
+      max_readahead_(MaxReadahead(page_capacity_)),
+      slabs_(options.page_shift, options.page_pool_huge_pages),
+      frame_table_(options.page_shift,
+                   uses_frame_table_ ? options.page_pool_size : 0,
+                   options.page_pool_huge_pages),
+      free_list_(), retired_list_(), log_list_() {
   DCHECK(pool != nullptr);
   // The page size should be a power of two.
   DCHECK_EQ(page_size_ & (page_size_ - 1), 0U);
+  // The shard count must be a power of two, so hashes can be masked.
+  DCHECK_EQ(shard_mask_ & (shard_mask_ + 1), 0U);
+
+  // Pools that don't use 2Q get tiny ghost lists, which are never used.
+  size_t shard_capacity = (page_capacity_ + shard_mask_) / (shard_mask_ + 1);
+  size_t probation_capacity = TwoQueueProbationCapacity(shard_capacity);
+  size_t ghost_capacity = (eviction_policy_ == PageEvictionPolicy::kTwoQueue) ?
+      TwoQueueGhostCapacity(shard_capacity) : 1;
+  for (size_t i = 0; i <= shard_mask_; ++i)
+    new (&shards_[i]) Shard(shard_capacity, probation_capacity, ghost_capacity);
+
+  if (is_multi_threaded_ && clean_window_ != 0)
+    cleaner_thread_ = std::thread(&PagePool::RunCleaner, this);
 }
 
 PagePool::~PagePool() {
+  if (cleaner_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(cleaner_mutex_);
+      cleaner_stopping_ = true;
+    }
+    cleaner_condition_.notify_one();
+    cleaner_thread_.join();
+  }
+
   DCHECK_EQ(pinned_pages(), 0U);
 
   // We cannot use C++11's range-based for loop because the iterator would get
   // invalidated if we release the page it's pointing to.
 
-  for (auto it = free_list_.begin(); it != free_list_.end(); ) {
-    Page* page = *it;
-    ++it;
-    page->Release(this);
+  for (LinkedList<Page>* list : {&free_list_, &retired_list_}) {
+    for (auto it = list->begin(); it != list->end(); ) {
+      Page* page = *it;
+      ++it;
+      page->Release(this);
+    }
+  }
+
+  for (size_t i = 0; i <= shard_mask_; ++i) {
+    // The eviction lists should be empty, unless we crash-close.
+    for (LinkedList<Page>* list :
+         {&shards_[i].eviction_list, &shards_[i].probation_list}) {
+      for (auto it = list->begin(); it != list->end(); ) {
+        Page* page = *it;
+        ++it;
+        page->Release(this);
+      }
+    }
+    shards_[i].~Shard();
   }
+  Deallocate(shards_, sizeof(Shard) * (shard_mask_ + 1));
+}
+
+size_t PagePool::page_capacity() const noexcept {
+  AssignmentLock assignment_lock(this);
+  return page_capacity_;
+}
 
-  // The LRU list should be empty, unless we crash-close.
+Status PagePool::SetPageCapacity(size_t page_capacity) {
+  if (page_capacity == 0)
+    return Status::kInvalidArgument;
+  // The frame table's memory is reserved when the pool is created.
+  if (uses_frame_table_ && page_capacity > frame_table_.frame_capacity())
+    return Status::kInvalidArgument;
 
-  for (auto it = lru_list_.begin(); it != lru_list_.end(); ) {
-    Page* page = *it;
-    ++it;
-    page->Release(this);
+  AssignmentLock assignment_lock(this);
+  page_capacity_ = page_capacity;
+  size_t shard_capacity = (page_capacity + shard_mask_) / (shard_mask_ + 1);
+  clean_window_ = CleanWindow(clean_fraction_, shard_capacity);
+  max_readahead_ = MaxReadahead(page_capacity);
+  for (size_t i = 0; i <= shard_mask_; ++i) {
+    Shard* shard = &shards_[i];
+    ShardLock lock(this, shard);
+    // Tables are not shrunk, because they are much smaller than the pages.
+    shard->page_table.Reserve(shard_capacity);
+    shard->probation_capacity = TwoQueueProbationCapacity(shard_capacity);
   }
+
+  ShrinkToCapacity();
+  return Status::kSuccess;
+}
+
+void PagePool::ShrinkToCapacity() {
+  while (page_count_ > page_capacity_) {
+    Page* page;
+    if (!free_list_.empty()) {
+      page = free_list_.front();
+      free_list_.pop_front();
+      page->AddPin();
+    } else {
+      page = EvictPage(0);
+      // The remaining pages are pinned. They will be shed by later misses.
+      if (page == nullptr)
+        return;
+    }
+
+    --page_count_;
+    if (uses_slabs_)
+      slabs_.RetirePage(page);
+    else if (uses_frame_table_)
+      retired_list_.push_back(page);
+    else
+      page->Release(this);
+  }
+}
+
+size_t PagePool::allocated_pages() const noexcept {
+  AssignmentLock assignment_lock(this);
+  return page_count_;
+}
+
+size_t PagePool::unused_pages() const noexcept {
+  AssignmentLock assignment_lock(this);
+  return free_list_.size();
+}
+
+size_t PagePool::pinned_pages() const noexcept {
+  AssignmentLock assignment_lock(this);
+  size_t unpinned_pages = free_list_.size();
+  for (size_t i = 0; i <= shard_mask_; ++i) {
+    ShardLock lock(this, &shards_[i]);
+    unpinned_pages += shards_[i].unpinned_pages;
+  }
+  return page_count_ - unpinned_pages;
+}
+
+size_t PagePool::hit_count() const noexcept {
+  size_t hit_count = 0;
+  for (size_t i = 0; i <= shard_mask_; ++i) {
+    ShardLock lock(this, &shards_[i]);
+    hit_count += shards_[i].hit_count;
+  }
+  return hit_count;
+}
+
+size_t PagePool::miss_count() const noexcept {
+  AssignmentLock assignment_lock(this);
+  return miss_count_;
+}
+
+size_t PagePool::readahead_count() const noexcept {
+  AssignmentLock assignment_lock(this);
+  return readahead_count_;
+}
+
+size_t PagePool::foreground_write_count() const noexcept {
+  AssignmentLock assignment_lock(this);
+  return foreground_write_count_;
+}
+
+size_t PagePool::background_write_count() const noexcept {
+  AssignmentLock assignment_lock(this);
+  return background_write_count_;
 }
 
 void PagePool::UnpinUnassignedPage(Page* page) {
@@ -48,6 +296,7 @@ void PagePool::UnpinUnassignedPage(Page* page) {
 #endif  // DCHECK_IS_ON()
   DCHECK(page->transaction() == nullptr);
 
+  AssignmentLock assignment_lock(this);
   page->RemovePin();
   if (page->IsUnpinned())
     free_list_.push_back(page);
@@ -61,21 +310,89 @@ void PagePool::UnassignPageFromStore(Page* page) {
   DCHECK_EQ(page->page_pool(), this);
 #endif  // DCHECK_IS_ON()
 
+  AssignmentLock assignment_lock(this);
+  RemovePageFromShard(page);
+  DetachPageFromStore(page);
+}
+
+void PagePool::DiscardPageFromStore(Page* page) {
+  DCHECK(page != nullptr);
+  DCHECK(page->transaction() != nullptr);
+  DCHECK(page->transaction()->store() != nullptr);
+#if DCHECK_IS_ON()
+  DCHECK_EQ(page->page_pool(), this);
+#endif  // DCHECK_IS_ON()
+
+  AssignmentLock assignment_lock(this);
+  RemovePageFromShard(page);
+  TransactionImpl* transaction = page->transaction();
+  if (page->is_dirty())
+    transaction->UnassignPersistedPage(page);
+  else
+    transaction->UnassignPage(page);
+}
+
+void PagePool::RemovePageFromShard(Page* page) {
+  Shard* shard = &shards_[page->shard_index()];
+  ShardLock lock(this, shard);
+  EraseShardPage(shard, page);
+}
+
+void PagePool::EraseShardPage(Shard* shard, Page* page) {
+  bool erased = shard->page_table.Erase(page->transaction()->store(),
+                                        page->page_id());
+  DCHECK(erased);
+  UNUSED(erased);
+
+  // The caller has a pin on the page, so it is only in an eviction list if the
+  // policy tracks pinned pages.
+  switch (eviction_policy_) {
+    case PageEvictionPolicy::kLru:
+      break;
+    case PageEvictionPolicy::kClock:
+      if (!uses_frame_table_)
+        shard->eviction_list.erase(page);
+      break;
+    case PageEvictionPolicy::kTwoQueue:
+      if (page->eviction_state() == kTwoQueueProbation)
+        shard->probation_list.erase(page);
+      break;
+  }
+}
+
+void PagePool::DetachPageFromStore(Page* page) {
   TransactionImpl* transaction = page->transaction();
   StoreImpl* store = transaction->store();
-  DCHECK_EQ(1U, page_map_.count(std::make_pair(store, page->page_id())));
-  page_map_.erase(std::make_pair(store, page->page_id()));
   if (page->is_dirty()) {
     Status write_status = store->WritePage(page);
     transaction->UnassignPersistedPage(page);
+    // Like the cleaner, evictions cannot close the store, because other threads
+    // may be using it, and the caller holds the assignment latch.
     if (write_status != Status::kSuccess)
-      store->Close();
+      store->BackgroundWriteFailed();
   } else {
     transaction->UnassignPage(page);
   }
 }
 
+void PagePool::DetachEvictedPage(Page* page) {
+  if (page->is_dirty()) {
+    // The cleaner fell behind, so it should catch up before the next miss.
+    ++foreground_write_count_;
+    WakeCleaner();
+  }
+  DetachPageFromStore(page);
+}
+
 Page* PagePool::AllocPage() {
+  AssignmentLock assignment_lock(this);
+  return AllocPageFromShard(0);
+}
+
+Page* PagePool::AllocPageFromShard(size_t shard_index) {
+  if (page_count_ > page_capacity_)
+    ShrinkToCapacity();
+
   if (!free_list_.empty()) {
     // The free list is used as a stack (LIFO), because the last used free page
     // has the highest chance of being in the CPU's caches.
@@ -89,21 +406,363 @@ Page* PagePool::AllocPage() {
 
   if (page_count_ < page_capacity_) {
     ++page_count_;
-    Page* page = Page::Create(this);
+    if (!retired_list_.empty()) {
+      // Retired frame table entries are pinned, like newly created entries.
+      Page* page = retired_list_.front();
+      retired_list_.pop_front();
+      return page;
+    }
+    if (uses_slabs_)
+      return slabs_.CreatePage(this, page_capacity_ - page_count_ + 1);
+    if (uses_frame_table_)
+      return frame_table_.CreatePage(this);
+    return Page::Create(this);
+  }
+
+  return EvictPage(shard_index);
+}
+
+Page* PagePool::EvictPage(size_t shard_index) {
+  if (SweepsFrameTable()) {
+    Page* page = PinFrameTableVictim();
+    if (page != nullptr)
+      DetachEvictedPage(page);
+    return page;
+  }
+
+  // Each shard picks its victim using the eviction policy. The shard that will
+  // cache the new page is tried first, so shards with more misses give up more
+  // pages.
+  for (size_t i = 0; i <= shard_mask_; ++i) {
+    Shard* shard = &shards_[(shard_index + i) & shard_mask_];
+    Page* page;
+    {
+      ShardLock lock(this, shard);
+      page = PinShardVictim(shard);
+      if (page == nullptr)
+        continue;
+      bool erased = shard->page_table.Erase(page->transaction()->store(),
+                                            page->page_id());
+      DCHECK(erased);
+      UNUSED(erased);
+    }
+    // The page cannot be found by other threads, so it can be written back
+    // without holding the shard's latch.
+    DetachEvictedPage(page);
     return page;
   }
 
-  if (!lru_list_.empty()) {
-    Page* page = lru_list_.front();
+  return nullptr;
+}
+
+Page* PagePool::PinShardVictim(Shard* shard) {
+  if (shard->unpinned_pages == 0)
+    return nullptr;
+
+  LinkedList<Page>& eviction_list = shard->eviction_list;
+  switch (eviction_policy_) {
+    case PageEvictionPolicy::kLru:
+      break;
+
+    case PageEvictionPolicy::kClock:
+      // The hand clears reference bits as it advances, so it finds an
+      // unreferenced page within two turns around the clock.
+      while (true) {
+        Page* page = eviction_list.front();
+        if (page->IsUnpinned() &&
+            page->eviction_state() == kClockUnreferenced) {
+          break;
+        }
+        page->SetEvictionState(kClockUnreferenced);
+        eviction_list.pop_front();
+        eviction_list.push_back(page);
+      }
+      break;
+
+    case PageEvictionPolicy::kTwoQueue:
+      // The probation queue is trimmed down to its capacity first. The main
+      // queue is only used when the probation queue is small.
+      if (shard->probation_list.size() > shard->probation_capacity ||
+          eviction_list.empty()) {
+        Page* page = PinTwoQueueProbationVictim(shard);
+        if (page != nullptr)
+          return page;
+      }
+      // If the probation queue has no unpinned pages, the shard's unpinned
+      // pages are in the main queue.
+      DCHECK(!eviction_list.empty());
+      break;
+  }
+
+  Page* page = eviction_list.front();
+  DCHECK(page->IsUnpinned());
+  eviction_list.pop_front();
+  page->AddPin();
+  --shard->unpinned_pages;
+  return page;
+}
+
+Page* PagePool::PinFrameTableVictim() {
+  DCHECK(free_list_.empty());
+
+  // The hand clears reference bits as it advances, so it finds an unreferenced
+  // page within two turns around the clock, unless all pages are pinned.
+  size_t frame_count = frame_table_.frame_count();
+  for (size_t i = 0; i < 2 * frame_count; ++i) {
+    Page* page = frame_table_.frame(clock_hand_);
+    if (++clock_hand_ == frame_count)
+      clock_hand_ = 0;
+
+    // Pages that are not assigned to stores are pinned or in the free list.
+    // Evictions are serialized by the assignment latch, so the page's shard
+    // cannot change while it is checked.
+    Shard* shard = &shards_[page->shard_index()];
+    ShardLock lock(this, shard);
+    if (!page->IsUnpinned())
+      continue;
+    if (page->eviction_state() == kClockReferenced) {
+      page->SetEvictionState(kClockUnreferenced);
+      continue;
+    }
+
     page->AddPin();
-    lru_list_.pop_front();
-    UnassignPageFromStore(page);
+    --shard->unpinned_pages;
+    bool erased = shard->page_table.Erase(page->transaction()->store(),
+                                          page->page_id());
+    DCHECK(erased);
+    UNUSED(erased);
     return page;
   }
+  return nullptr;
+}
 
+Page* PagePool::PinTwoQueueProbationVictim(Shard* shard) {
+  // The pages at the front of the queue are rarely pinned, so this loop is
+  // usually short.
+  for (Page* page : shard->probation_list) {
+    if (!page->IsUnpinned())
+      continue;
+
+    shard->probation_list.erase(page);
+    page->AddPin();
+    --shard->unpinned_pages;
+    shard->ghost_pages.Add(page->transaction()->store(), page->page_id());
+    return page;
+  }
   return nullptr;
 }
 
+size_t PagePool::CleanPages() {
+  // The collected pages are pinned and marked as loading, so they can be
+  // written without holding the assignment latch. Transactions that want to
+  // modify the pages wait for the writes, like they wait for reads.
+  // Transactions also wait for the writes before they commit or close, so the
+  // pages stay assigned to their stores, and the stores stay open.
+  //
+  // TODO(pwnall): Cleaning writes uncommitted data, like evictions do, so
+  //               rollbacks will need the log.
+  PageVector pages;
+  {
+    AssignmentLock assignment_lock(this);
+    if (clean_window_ == 0)
+      return 0;
+
+    if (SweepsFrameTable()) {
+      CollectFrameTableDirtyPages(&pages);
+    } else {
+      for (size_t i = 0; i <= shard_mask_; ++i)
+        CollectShardDirtyPages(&shards_[i], &pages);
+    }
+    if (pages.empty())
+      return 0;
+  }
+
+  // Adjacent pages can only be merged into one write if they are sorted. The
+  // collection order is needed to put the pages back in their eviction order.
+  PageVector sorted_pages(pages);
+  std::sort(sorted_pages.begin(), sorted_pages.end(),
+            [](const Page* page1, const Page* page2) {
+              StoreImpl* store1 = page1->transaction()->store();
+              StoreImpl* store2 = page2->transaction()->store();
+              if (store1 != store2)
+                return std::less<StoreImpl*>()(store1, store2);
+              return page1->page_id() < page2->page_id();
+            });
+
+  // Each store's pages are written together, so adjacent pages are merged.
+  StoreVector failed_stores;
+  size_t written_pages = 0;
+  size_t group_start = 0;
+  while (group_start < sorted_pages.size()) {
+    StoreImpl* store = sorted_pages[group_start]->transaction()->store();
+    size_t group_end = group_start + 1;
+    while (group_end < sorted_pages.size() &&
+           sorted_pages[group_end]->transaction()->store() == store) {
+      ++group_end;
+    }
+
+    Status write_status = store->WritePages(
+        sorted_pages.data() + group_start, group_end - group_start);
+    if (write_status == Status::kSuccess) {
+      written_pages += group_end - group_start;
+    } else {
+      // The store cannot be closed here, because other threads may be using
+      // it. Its next commit reports the error.
+      store->BackgroundWriteFailed();
+      failed_stores.push_back(store);
+    }
+    group_start = group_end;
+  }
+
+  AssignmentLock assignment_lock(this);
+  FinishCleaningPages(pages, failed_stores);
+  background_write_count_ += written_pages;
+  return written_pages;
+}
+
+void PagePool::CollectShardDirtyPages(Shard* shard, PageVector* pages) {
+  ShardLock lock(this, shard);
+
+  size_t first_page = pages->size();
+  size_t scanned_pages = 0;
+  auto scan_list = [&](LinkedList<Page>* list) {
+    for (Page* page : *list) {
+      if (scanned_pages == clean_window_)
+        return;
+      ++scanned_pages;
+      if (page->IsUnpinned() && page->is_dirty() &&
+          !page->transaction()->store()->has_write_error()) {
+        pages->push_back(page);
+      }
+    }
+  };
+  // 2Q pools evict probation pages before main queue pages.
+  if (eviction_policy_ == PageEvictionPolicy::kTwoQueue)
+    scan_list(&shard->probation_list);
+  scan_list(&shard->eviction_list);
+
+  // Pinning pages can remove them from the lists, so it must happen after the
+  // lists are scanned.
+  for (size_t i = first_page; i < pages->size(); ++i)
+    PinCleanedPage(shard, (*pages)[i]);
+}
+
+void PagePool::CollectFrameTableDirtyPages(PageVector* pages) {
+  size_t frame_count = frame_table_.frame_count();
+  size_t window = std::min(clean_window_ * shard_count(), frame_count);
+  size_t frame_index = clock_hand_;
+  for (size_t i = 0; i < window; ++i) {
+    Page* page = frame_table_.frame(frame_index);
+    if (++frame_index == frame_count)
+      frame_index = 0;
+
+    // Pages are assigned to stores while holding the assignment latch, so this
+    // check is stable. Unassigned pages have no shard.
+    if (page->transaction() == nullptr)
+      continue;
+    Shard* shard = &shards_[page->shard_index()];
+    ShardLock lock(this, shard);
+    if (page->IsUnpinned() && page->is_dirty() &&
+        !page->transaction()->store()->has_write_error()) {
+      PinCleanedPage(shard, page);
+      pages->push_back(page);
+    }
+  }
+}
+
+void PagePool::PinCleanedPage(Shard* shard, Page* page) {
+  DCHECK(page->IsUnpinned());
+  DCHECK(page->is_dirty());
+  DCHECK(!page->is_loading());
+
+  --shard->unpinned_pages;
+  switch (eviction_policy_) {
+    case PageEvictionPolicy::kLru:
+      shard->eviction_list.erase(page);
+      break;
+    case PageEvictionPolicy::kClock:
+      break;
+    case PageEvictionPolicy::kTwoQueue:
+      if (page->eviction_state() == kTwoQueueMain)
+        shard->eviction_list.erase(page);
+      break;
+  }
+  page->AddPin();
+  page->SetLoading(true);
+}
+
+void PagePool::FinishCleaningPages(const PageVector& pages,
+                                   const StoreVector& failed_stores) {
+  // Pages are pushed to the front of the eviction lists, so going backwards
+  // restores the order in which they were collected.
+  for (size_t i = pages.size(); i-- > 0; ) {
+    Page* page = pages[i];
+    TransactionImpl* transaction = page->transaction();
+    if (transaction == nullptr) {
+      // The page's transaction was closed after the write, and unassigned the
+      // page. Unassigned pages are only pinned under the assignment latch.
+      page->SetLoading(false);
+      page->RemovePin();
+      if (page->IsUnpinned())
+        free_list_.push_back(page);
+      continue;
+    }
+
+    Shard* shard = &shards_[page->shard_index()];
+    ShardLock lock(this, shard);
+    StoreImpl* store = transaction->store();
+    bool written = std::find(failed_stores.begin(), failed_stores.end(),
+                             store) == failed_stores.end();
+    // The page was not modified during the write, because it was loading. If
+    // its transaction pinned it to commit, the commit persists it.
+    if (written && page->is_dirty() && page->HasOnePin())
+      transaction->PageWasPersisted(page, store->init_transaction());
+
+    page->RemovePin();
+    if (page->IsUnpinned()) {
+      ++shard->unpinned_pages;
+      // The page was collected because it was about to be evicted, and
+      // cleaning it does not count as using it.
+      if (eviction_policy_ == PageEvictionPolicy::kLru ||
+          (eviction_policy_ == PageEvictionPolicy::kTwoQueue &&
+           page->eviction_state() == kTwoQueueMain)) {
+        shard->eviction_list.push_front(page);
+      }
+    }
+    page->SetLoading(false);
+    if (is_multi_threaded_)
+      shard->load_condition.notify_all();
+  }
+}
+
+void PagePool::WakeCleaner() {
+  if (!cleaner_thread_.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(cleaner_mutex_);
+    cleaner_wake_pending_ = true;
+  }
+  cleaner_condition_.notify_one();
+}
+
+void PagePool::RunCleaner() {
+  std::unique_lock<std::mutex> lock(cleaner_mutex_);
+  while (true) {
+    cleaner_condition_.wait_for(lock, kCleanerInterval, [this]() {
+      return cleaner_stopping_ || cleaner_wake_pending_;
+    });
+    if (cleaner_stopping_)
+      return;
+    cleaner_wake_pending_ = false;
+
+    // Evictions wake up the cleaner while holding the assignment latch, so
+    // the cleaner must not hold its mutex while acquiring the latch.
+    lock.unlock();
+    CleanPages();
+    lock.lock();
+  }
+}
+
 Status PagePool::FetchStorePage(Page *page, PageFetchMode fetch_mode) {
   DCHECK(page != nullptr);
   DCHECK(page->transaction() != nullptr);
@@ -138,29 +797,171 @@ Status PagePool::AssignPageToStore(
   DCHECK_EQ(page->page_pool(), this);
 #endif  // DCHECK_IS_ON()
 
-  TransactionImpl* transaction = store->init_transaction();
-  transaction->AssignPage(page, page_id);
-  Status fetch_status = FetchStorePage(page, fetch_mode);
-  if (fetch_status == Status::kSuccess) {
-    page_map_[std::make_pair(store, page_id)] = page;
-    return Status::kSuccess;
+  if (fetch_mode == kIgnorePageData) {
+    AssignmentLock assignment_lock(this);
+    store->init_transaction()->AssignPage(page, page_id);
+    // Skipping the read cannot fail, so the page is complete right away.
+    Status fetch_status = FetchStorePage(page, fetch_mode);
+    DCHECK_EQ(Status::kSuccess, fetch_status);
+    InsertPageIntoShard(page, store, page_id);
+    return fetch_status;
   }
 
-  transaction->UnassignPage(page);
+  {
+    AssignmentLock assignment_lock(this);
+    ClaimStorePage(page, store, page_id);
+  }
+  Status fetch_status = FetchStorePage(page, fetch_mode);
+  FinishPageLoads(&page, 1, fetch_status == Status::kSuccess);
+  if (fetch_status != Status::kSuccess)
+    UnassignFailedPages(&page, 1);
   return fetch_status;
 }
 
+void PagePool::ClaimStorePage(Page* page, StoreImpl* store, size_t page_id) {
+  DCHECK(page->HasOnePin());
+  store->init_transaction()->AssignPage(page, page_id);
+  // The page is not visible to other threads yet, so its shard's latch is not
+  // needed.
+  page->SetLoading(true);
+  InsertPageIntoShard(page, store, page_id);
+}
+
+void PagePool::FinishPageLoads(Page* const* pages, size_t count,
+                               bool succeeded) {
+  for (size_t i = 0; i < count; ++i) {
+    Page* page = pages[i];
+    Shard* shard = &shards_[page->shard_index()];
+    ShardLock lock(this, shard);
+    DCHECK(page->is_loading());
+    page->SetLoading(false);
+    // Pages that could not be read leave their shards right away, so no other
+    // thread pins them anymore.
+    if (!succeeded)
+      EraseShardPage(shard, page);
+    if (is_multi_threaded_)
+      shard->load_condition.notify_all();
+  }
+}
+
+void PagePool::UnassignFailedPages(Page* const* pages, size_t count) {
+  // The threads that were waiting for the pages drop their pins as soon as they
+  // wake up, so this wait is short.
+  if (is_multi_threaded_) {
+    for (size_t i = 0; i < count; ++i) {
+      Page* page = pages[i];
+      Shard* shard = &shards_[page->shard_index()];
+      ShardLock lock(this, shard);
+      while (!page->HasOnePin())
+        lock.Wait(shard);
+    }
+  }
+
+  AssignmentLock assignment_lock(this);
+  for (size_t i = 0; i < count; ++i)
+    pages[i]->transaction()->UnassignPage(pages[i]);
+}
+
+void PagePool::InsertPageIntoShard(Page* page, StoreImpl* store,
+                                   size_t page_id) {
+  size_t shard_index = ShardIndex(store, page_id);
+  page->SetShardIndex(shard_index);
+  Shard* shard = &shards_[shard_index];
+  ShardLock lock(this, shard);
+  // Evictions can move pages between shards, so a shard may end up caching
+  // more than its share of the pool's pages.
+  if (shard->page_table.size() == shard->page_table.max_size())
+    shard->page_table.Reserve(shard->page_table.max_size() * 2);
+  shard->page_table.Insert(store, page_id, page);
+  switch (eviction_policy_) {
+    case PageEvictionPolicy::kLru:
+      break;
+    case PageEvictionPolicy::kClock:
+      // The fetch that caused the page to be cached counts as a use.
+      page->SetEvictionState(kClockReferenced);
+      if (!uses_frame_table_)
+        shard->eviction_list.push_back(page);
+      break;
+    case PageEvictionPolicy::kTwoQueue:
+      // Pages that were evicted from probation recently are used for the
+      // second time, so they skip probation.
+      if (shard->ghost_pages.Remove(store, page_id)) {
+        page->SetEvictionState(kTwoQueueMain);
+      } else {
+        page->SetEvictionState(kTwoQueueProbation);
+        shard->probation_list.push_back(page);
+      }
+      break;
+  }
+}
+
+size_t PagePool::ReadaheadRunSize(StoreImpl* store, size_t page_id) {
+  StoreImpl::ReadaheadState* state = store->readahead_state();
+  bool continues_run = page_id != 0 && page_id == state->next_page_id;
+  state->next_page_id = page_id + 1;
+  if (!continues_run || max_readahead_ == 0) {
+    state->window = 0;
+    return 1;
+  }
+
+  state->window = (state->window == 0) ?
+      kMinReadaheadPages : std::min(state->window * 2, max_readahead_);
+
+  size_t data_file_page_count = store->data_file_page_count();
+  if (page_id >= data_file_page_count)
+    return 1;
+  size_t run_size = std::min(1 + state->window, data_file_page_count - page_id);
+
+  // Cached pages may be newer than their on-disk copies. Other threads cannot
+  // cache pages while the assignment latch is held.
+  for (size_t i = 1; i < run_size; ++i) {
+    if (IsStorePageCached(store, page_id + i))
+      return i;
+  }
+  return run_size;
+}
+
+bool PagePool::IsStorePageCached(StoreImpl* store, size_t page_id) {
+  Shard* shard = &shards_[ShardIndex(store, page_id)];
+  ShardLock lock(this, shard);
+  return shard->page_table.Find(store, page_id) != nullptr;
+}
+
 void PagePool::PinStorePage(Page* page) {
   DCHECK(page != nullptr);
   DCHECK(page->transaction() != nullptr);
 #if DCHECK_IS_ON()
   DCHECK_EQ(page->page_pool(), this);
 #endif  // DCHECK_IS_ON()
+  if (page->is_mapped())
+    return;
+
+  Shard* shard = &shards_[page->shard_index()];
+  ShardLock lock(this, shard);
+  PinShardPage(shard, page);
+}
 
-  // If the page is already pinned, it is not contained in any list. If the page
-  // has no pins, it must be in the LRU list.
+void PagePool::PinShardPage(Shard* shard, Page* page) {
   if (page->IsUnpinned())
-    lru_list_.erase(page);
+    --shard->unpinned_pages;
+
+  switch (eviction_policy_) {
+    case PageEvictionPolicy::kLru:
+      // If the page is already pinned, it is not contained in any list. If the
+      // page has no pins, it must be in the LRU list.
+      if (page->IsUnpinned())
+        shard->eviction_list.erase(page);
+      break;
+    case PageEvictionPolicy::kClock:
+      page->SetEvictionState(kClockReferenced);
+      break;
+    case PageEvictionPolicy::kTwoQueue:
+      // Pages in the main queue are handled like LRU pages. Probation pages
+      // stay in place, so a burst of uses does not count as frequent use.
+      if (page->IsUnpinned() && page->eviction_state() == kTwoQueueMain)
+        shard->eviction_list.erase(page);
+      break;
+  }
   page->AddPin();
 }
 
@@ -168,54 +969,497 @@ void PagePool::PinTransactionPages(
     LinkedList<Page, Page::TransactionLinkedListBridge> *page_list) {
   DCHECK(page_list != nullptr);
 
-  for (Page* page : *page_list) {
-    DCHECK(page->transaction() != nullptr);
+  // The cleaner may be writing some of the pages. They must not be persisted
+  // or unassigned by the caller until the writes are done.
+  PageVector cleaned_pages;
+  {
+    AssignmentLock assignment_lock(this);
+    for (Page* page : *page_list) {
+      DCHECK(page->transaction() != nullptr);
+#if DCHECK_IS_ON()
+      DCHECK_EQ(page->page_pool(), this);
+#endif  // DCHECK_IS_ON()
+      if (page->is_mapped())
+        continue;
+
+      Shard* shard = &shards_[page->shard_index()];
+      ShardLock lock(this, shard);
+      PinShardPage(shard, page);
+      if (page->is_loading())
+        cleaned_pages.push_back(page);
+    }
+  }
+
+  // The writes are waited for like reads, so misses can assign pages while the
+  // cleaner writes. The pins keep the pages assigned to the transaction.
+  for (Page* page : cleaned_pages) {
+    Shard* shard = &shards_[page->shard_index()];
+    ShardLock lock(this, shard);
+    bool loaded = WaitForPageLoad(&lock, shard,
+                                  page->transaction()->store(),
+                                  page->page_id(), page);
+    DCHECK(loaded);
+    UNUSED(loaded);
+  }
+}
+
+Page* PagePool::PinCachedStorePage(Shard* shard, StoreImpl* store,
+                                   size_t page_id) {
+  ShardLock lock(this, shard);
+  Page* page = PinShardStorePage(shard, store, page_id);
+  if (page == nullptr || !page->is_loading())
+    return page;
+  return WaitForPageLoad(&lock, shard, store, page_id, page) ? page : nullptr;
+}
+
+Page* PagePool::PinShardStorePage(Shard* shard, StoreImpl* store,
+                                  size_t page_id) {
+  Page* page = shard->page_table.Find(store, page_id);
+  if (page == nullptr)
+    return nullptr;
+
+  DCHECK_EQ(store, page->transaction()->store());
+  DCHECK_EQ(page_id, page->page_id());
 #if DCHECK_IS_ON()
-    DCHECK_EQ(page->page_pool(), this);
+  DCHECK_EQ(page->page_pool(), this);
 #endif  // DCHECK_IS_ON()
-    PinStorePage(page);
+  // Single-threaded pools finish reading pages before anyone can look them up,
+  // unless the reads were started by Prefetch().
+  DCHECK(is_multi_threaded_ || !page->is_loading() || page->is_prefetched());
+
+  // The page can either be pinned (by another transaction/cursor) or unpinned
+  // and tracked by the eviction policy. The check in PinShardPage() is needed
+  // for correctness.
+  PinShardPage(shard, page);
+  ++shard->hit_count;
+  return page;
+}
+
+bool PagePool::WaitForPageLoad(ShardLock* lock, Shard* shard, StoreImpl* store,
+                               size_t page_id, Page* page) {
+  while (page->is_loading()) {
+    if (page->is_prefetched()) {
+      // Prefetch() does not wait for its reads, so their completions are
+      // collected by the threads that need the pages.
+      lock->Unlock();
+      {
+        std::lock_guard<std::mutex> prefetch_lock(*store->prefetch_mutex());
+        PollPrefetchReads(store, 1);
+      }
+      lock->Relock();
+      continue;
+    }
+    DCHECK(is_multi_threaded_);
+    lock->Wait(shard);
   }
+
+  // The caller's pin keeps the entry from being reassigned, so the entry only
+  // left the page table if its read failed.
+  if (shard->page_table.Find(store, page_id) == page)
+    return true;
+
+  // The thread that read the page unassigns it after the waiters' pins are
+  // gone.
+  page->RemovePin();
+  shard->load_condition.notify_all();
+  return false;
 }
 
 Status PagePool::StorePage(
     StoreImpl* store, size_t page_id, PageFetchMode fetch_mode, Page** result) {
   DCHECK(store != nullptr);
 
-  const auto& it = page_map_.find(std::make_pair(store, page_id));
-  if (it != page_map_.end()) {
-    Page* page = it->second;
-    DCHECK(page != nullptr);
-    DCHECK_EQ(store, page->transaction()->store());
-    DCHECK_EQ(page_id, page->page_id());
-#if DCHECK_IS_ON()
-    DCHECK_EQ(page->page_pool(), this);
-#endif  // DCHECK_IS_ON()
+  if (store->is_mapped()) {
+    // Mapped pages are read-only, so their data is always needed.
+    DCHECK_EQ(fetch_mode, kFetchPageData);
+    return store->MappedPage(page_id, result);
+  }
 
-    // The page can either be pinned (by another transaction/cursor) or unpinned
-    // and waiting in the LRU list. The check in PinStorePage() is needed for
-    // correctness.
-    PinStorePage(page);
-    *result = page;
-    return Status::kSuccess;
+  size_t shard_index = ShardIndex(store, page_id);
+  Shard* shard = &shards_[shard_index];
+  bool miss_counted = false;
+  while (true) {
+    Page* page = PinCachedStorePage(shard, store, page_id);
+    if (page != nullptr) {
+      *result = page;
+      return Status::kSuccess;
+    }
+
+    AssignmentLock assignment_lock(this);
+    // Another thread may have started caching the page before we got the
+    // latch. Its read must be waited for without holding the latch.
+    if (is_multi_threaded_ && IsStorePageCached(store, page_id))
+      continue;
+
+    if (fetch_mode == kIgnorePageData) {
+      ++miss_count_;
+      page = AllocPageFromShard(shard_index);
+      if (page == nullptr)
+        return Status::kPoolFull;
+      // kIgnorePageData skips the read, so the assignment cannot fail.
+      Status status = AssignPageToStore(page, store, page_id, kIgnorePageData);
+      DCHECK_EQ(Status::kSuccess, status);
+      *result = page;
+      return status;
+    }
+
+    // Retried misses do not read ahead.
+    size_t run_size = 1;
+    if (!miss_counted) {
+      ++miss_count_;
+      miss_counted = true;
+      run_size = ReadaheadRunSize(store, page_id);
+      run_size = std::min(run_size, 1 + max_readahead_ -
+          std::min(max_readahead_, loading_readahead_pages_));
+    }
+
+    Page* pages[1 + kMaxReadaheadPages];
+    DCHECK_LE(run_size, 1 + kMaxReadaheadPages);
+    size_t claim_count = 0;
+    for (; claim_count < run_size; ++claim_count) {
+      page = AllocPageFromShard(ShardIndex(store, page_id + claim_count));
+      if (page == nullptr)
+        break;
+      pages[claim_count] = page;
+    }
+    if (claim_count == 0) {
+      // The pages read ahead by other threads are unpinned soon.
+      if (loading_readahead_pages_ == 0)
+        return Status::kPoolFull;
+      DCHECK(is_multi_threaded_);
+      assignment_lock.Wait(&readahead_condition_);
+      continue;
+    }
+    for (size_t i = 0; i < claim_count; ++i)
+      ClaimStorePage(pages[i], store, page_id + i);
+    store->readahead_state()->next_page_id = page_id + claim_count;
+    loading_readahead_pages_ += claim_count - 1;
+    assignment_lock.Unlock();
+
+    // The run is read straight into the entries, using a vectored read.
+    Status status = (claim_count == 1) ?
+        store->ReadPage(pages[0]) : store->ReadPages(pages, claim_count);
+    FinishPageLoads(pages, claim_count, status == Status::kSuccess);
+    if (status == Status::kSuccess) {
+      for (size_t i = 1; i < claim_count; ++i)
+        UnpinStorePage(pages[i]);
+      if (claim_count > 1) {
+        AssignmentLock counter_lock(this);
+        readahead_count_ += claim_count - 1;
+        ReadaheadPagesUnpinned(claim_count - 1);
+      }
+      *result = pages[0];
+      return Status::kSuccess;
+    }
+
+    UnassignFailedPages(pages, claim_count);
+    for (size_t i = 0; i < claim_count; ++i)
+      UnpinUnassignedPage(pages[i]);
+    if (claim_count == 1)
+      return status;
+    // The failure may be caused by the pages read ahead, so the missing page is
+    // read again by itself.
+    AssignmentLock readahead_lock(this);
+    store->readahead_state()->window = 0;
+    ReadaheadPagesUnpinned(claim_count - 1);
   }
+}
 
-  Page* page = AllocPage();
-  if (page == nullptr)
-    return Status::kPoolFull;
-#if DCHECK_IS_ON()
-  DCHECK_EQ(page->page_pool(), this);
-#endif  // DCHECK_IS_ON()
+void PagePool::ReadaheadPagesUnpinned(size_t page_count) {
+  DCHECK_LE(page_count, loading_readahead_pages_);
+  loading_readahead_pages_ -= page_count;
+  if (is_multi_threaded_)
+    readahead_condition_.notify_all();
+}
 
-  Status status = AssignPageToStore(page, store, page_id, fetch_mode);
-  if (status == Status::kSuccess) {
-    *result = page;
-  } else {
-    // Calling UnpinUnassignedPage will perform an extra check compared to
-    // inlining the code, because the inlined version would know that the page
-    // is unpinned. We favor code size over speed here because this is an error
-    // condition.
+Page* PagePool::PinCachedStorePage(StoreImpl* store, size_t page_id) {
+  DCHECK(store != nullptr);
+
+  if (store->is_mapped()) {
+    Page* page;
+    return (store->MappedPage(page_id, &page) == Status::kSuccess) ?
+        page : nullptr;
+  }
+  return PinCachedStorePage(&shards_[ShardIndex(store, page_id)], store,
+                            page_id);
+}
+
+void PagePool::Prefetch(StoreImpl* store, const size_t* page_ids,
+                        size_t count) {
+  DCHECK(store != nullptr);
+  DCHECK(page_ids != nullptr || count == 0);
+
+  std::vector<size_t, PlatformAllocator<size_t>> sorted_page_ids(
+      page_ids, page_ids + count);
+  std::sort(sorted_page_ids.begin(), sorted_page_ids.end());
+  sorted_page_ids.erase(
+      std::unique(sorted_page_ids.begin(), sorted_page_ids.end()),
+      sorted_page_ids.end());
+
+  // The OS reads ahead mapped pages, so the pool only needs to pass the hint.
+  if (store->is_mapped()) {
+    store->AdviseMappedPages(sorted_page_ids.data(), sorted_page_ids.size());
+    return;
+  }
+
+  // Access methods hint pages that are usually cached already, so those pages
+  // are dropped without taking the assignment latch. The pages that are left
+  // are checked again while holding the latch.
+  size_t uncached_count = 0;
+  for (size_t page_id : sorted_page_ids) {
+    if (!IsStorePageCached(store, page_id))
+      sorted_page_ids[uncached_count++] = page_id;
+  }
+  sorted_page_ids.resize(uncached_count);
+  if (sorted_page_ids.empty())
+    return;
+
+  // The pages whose reads completed since the last call stop counting against
+  // the store's prefetch budget.
+  StoreImpl::PrefetchState* state = store->prefetch_state();
+  size_t reading_count;
+  {
+    std::lock_guard<std::mutex> prefetch_lock(*store->prefetch_mutex());
+    PollPrefetchReads(store, 0);
+    reading_count = state->reading_pages.size();
+  }
+  ReleaseFailedPrefetches(store);
+
+  PageVector pages;
+  {
+    AssignmentLock assignment_lock(this);
+    size_t data_file_page_count = store->data_file_page_count();
+    // Prefetched pages are pinned until their reads are collected, so
+    // prefetching too many pages would leave cache misses without entries.
+    size_t page_budget = std::min(page_capacity_ / 2, kMaxPrefetchReads);
+    page_budget -= std::min(page_budget, reading_count);
+    for (size_t page_id : sorted_page_ids) {
+      if (pages.size() == page_budget || page_id >= data_file_page_count)
+        break;
+      if (IsStorePageCached(store, page_id))
+        continue;
+
+      Page* page = AllocPageFromShard(ShardIndex(store, page_id));
+      if (page == nullptr)
+        break;
+      ClaimStorePage(page, store, page_id);
+      pages.push_back(page);
+    }
+    readahead_count_ += pages.size();
+  }
+  if (pages.empty())
+    return;
+
+  std::lock_guard<std::mutex> prefetch_lock(*store->prefetch_mutex());
+  if (state->queue == nullptr &&
+      store->data_file()->CreateIoQueue(kMaxPrefetchReads, &state->queue) !=
+          Status::kSuccess) {
+    state->queue = nullptr;
+  }
+  for (Page* page : pages) {
+    // Other threads' prefetches may have used up the queue since the budget
+    // was computed.
+    if (state->queue == nullptr || state->queue->SubmitRead(
+            page->page_id() << page_shift_, page_size_, page->data(), page) !=
+            Status::kSuccess) {
+      FinishPrefetchRead(store, page, false);
+      continue;
+    }
+    state->reading_pages.push_back(page);
+
+    // Threads that found the page loading before its read was submitted wait
+    // for the load condition, and start collecting completions when woken up.
+    Shard* shard = &shards_[page->shard_index()];
+    ShardLock lock(this, shard);
+    page->SetPrefetched(true);
+    if (is_multi_threaded_)
+      shard->load_condition.notify_all();
+  }
+  // Polling starts the submitted reads.
+  PollPrefetchReads(store, 0);
+}
+
+void PagePool::PollPrefetchReads(StoreImpl* store, size_t min_count) {
+  StoreImpl::PrefetchState* state = store->prefetch_state();
+  if (state->reading_pages.empty())
+    return;
+
+  BlockIoCompletion completions[kMaxPrefetchReads];
+  size_t completion_count;
+  Status status = state->queue->Poll(
+      std::min(min_count, state->reading_pages.size()), kMaxPrefetchReads,
+      completions, &completion_count);
+  if (status != Status::kSuccess) {
+    // The queue cannot be used anymore. Releasing it waits for the reads in
+    // progress, whose results are lost.
+    state->queue->Release();
+    state->queue = nullptr;
+    for (Page* page : state->reading_pages)
+      FinishPrefetchRead(store, page, false);
+    state->reading_pages.clear();
+    return;
+  }
+
+  for (size_t i = 0; i < completion_count; ++i) {
+    Page* page = reinterpret_cast<Page*>(completions[i].tag);
+    auto it = std::find(state->reading_pages.begin(),
+                        state->reading_pages.end(), page);
+    DCHECK(it != state->reading_pages.end());
+    state->reading_pages.erase(it);
+    FinishPrefetchRead(store, page,
+                       completions[i].status == Status::kSuccess);
+  }
+}
+
+void PagePool::FinishPrefetchRead(StoreImpl* store, Page* page,
+                                  bool succeeded) {
+  Shard* shard = &shards_[page->shard_index()];
+  {
+    ShardLock lock(this, shard);
+    DCHECK(page->is_loading());
+    page->SetLoading(false);
+    page->SetPrefetched(false);
+    if (succeeded) {
+      page->RemovePin();
+      if (page->IsUnpinned())
+        ShardPageUnpinned(shard, page, kCachePage);
+    } else {
+      // Pages that could not be read leave their shards right away, so no
+      // other thread pins them anymore.
+      EraseShardPage(shard, page);
+    }
+    if (is_multi_threaded_)
+      shard->load_condition.notify_all();
+  }
+  if (!succeeded)
+    store->prefetch_state()->failed_pages.push_back(page);
+}
+
+void PagePool::ReleaseFailedPrefetches(StoreImpl* store) {
+  PageVector pages;
+  {
+    std::lock_guard<std::mutex> prefetch_lock(*store->prefetch_mutex());
+    pages.swap(store->prefetch_state()->failed_pages);
+  }
+  if (pages.empty())
+    return;
+
+  UnassignFailedPages(pages.data(), pages.size());
+  for (Page* page : pages)
     UnpinUnassignedPage(page);
-    DCHECK(page->IsUnpinned());
+}
+
+void PagePool::FinishPrefetches(StoreImpl* store) {
+  DCHECK(store != nullptr);
+
+  {
+    std::lock_guard<std::mutex> prefetch_lock(*store->prefetch_mutex());
+    StoreImpl::PrefetchState* state = store->prefetch_state();
+    while (!state->reading_pages.empty())
+      PollPrefetchReads(store, state->reading_pages.size());
+    if (state->queue != nullptr) {
+      state->queue->Release();
+      state->queue = nullptr;
+    }
+  }
+  ReleaseFailedPrefetches(store);
+}
+
+Status PagePool::StorePages(StoreImpl* store, const size_t* page_ids,
+                            size_t count, Page** results) {
+  DCHECK(store != nullptr);
+  DCHECK(page_ids != nullptr || count == 0);
+  DCHECK(results != nullptr || count == 0);
+
+  if (store->is_mapped()) {
+    // Mapped pages are never unpinned, so the error path has nothing to undo.
+    for (size_t i = 0; i < count; ++i) {
+      Status status = store->MappedPage(page_ids[i], &results[i]);
+      if (status != Status::kSuccess)
+        return status;
+    }
+    return Status::kSuccess;
+  }
+
+  // The pages that are not in the pool are claimed while holding the assignment
+  // latch, and are all read at the end. Pages that other threads are reading
+  // are only waited for after our reads complete, so two StorePages() calls
+  // never wait for each other's pages.
+  PageVector missing_pages;
+  std::vector<size_t, PlatformAllocator<size_t>> loading_indexes;
+  Status status = Status::kSuccess;
+  size_t pinned_count = 0;
+  {
+    AssignmentLock assignment_lock(this);
+    for (; pinned_count < count; ++pinned_count) {
+      size_t page_id = page_ids[pinned_count];
+      size_t shard_index = ShardIndex(store, page_id);
+      Shard* shard = &shards_[shard_index];
+      Page* page;
+      {
+        ShardLock lock(this, shard);
+        page = PinShardStorePage(shard, store, page_id);
+        if (page != nullptr && page->is_loading())
+          loading_indexes.push_back(pinned_count);
+      }
+      if (page == nullptr) {
+        ++miss_count_;
+        page = AllocPageFromShard(shard_index);
+        if (page == nullptr) {
+          status = Status::kPoolFull;
+          break;
+        }
+        ClaimStorePage(page, store, page_id);
+        missing_pages.push_back(page);
+      }
+      results[pinned_count] = page;
+    }
+  }
+
+  if (status == Status::kSuccess && !missing_pages.empty()) {
+    std::sort(missing_pages.begin(), missing_pages.end(),
+              [](const Page* page1, const Page* page2) {
+                return page1->page_id() < page2->page_id();
+              });
+    status = store->ReadPages(missing_pages.data(), missing_pages.size());
+  }
+  bool loads_failed = status != Status::kSuccess;
+  FinishPageLoads(missing_pages.data(), missing_pages.size(), !loads_failed);
+
+  for (size_t index : loading_indexes) {
+    size_t page_id = page_ids[index];
+    Shard* shard = &shards_[ShardIndex(store, page_id)];
+    {
+      ShardLock lock(this, shard);
+      if (WaitForPageLoad(&lock, shard, store, page_id, results[index]))
+        continue;
+    }
+    // The other thread's read failed. Our pages are not loading anymore, so
+    // the page can be fetched again without holding up other threads.
+    results[index] = nullptr;
+    if (status == Status::kSuccess)
+      status = StorePage(store, page_id, kFetchPageData, &results[index]);
+  }
+  if (status == Status::kSuccess)
+    return Status::kSuccess;
+
+  // This is an error path, so the quadratic search is acceptable.
+  for (size_t i = 0; i < pinned_count; ++i) {
+    Page* page = results[i];
+    if (page == nullptr)
+      continue;
+    if (loads_failed && std::find(missing_pages.begin(), missing_pages.end(),
+                                  page) != missing_pages.end()) {
+      continue;
+    }
+    UnpinStorePage(page);
+  }
+  // The entries that were claimed above hold garbage, so they must not remain
+  // assigned to the store.
+  if (loads_failed) {
+    UnassignFailedPages(missing_pages.data(), missing_pages.size());
+    for (Page* page : missing_pages)
+      UnpinUnassignedPage(page);
   }
   return status;
 }
@@ -5,16 +5,23 @@
 #ifndef BERRYDB_PAGE_POOL_H_
 #define BERRYDB_PAGE_POOL_H_
 
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
-#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include "./ghost_page_list.h"
 #include "./page.h"
+#include "./page_frame_table.h"
+#include "./page_slabs.h"
+#include "./page_table.h"
 #include "./store_impl.h"
 #include "./transaction_impl.h"
 #include "./util/linked_list.h"
 #include "./util/platform_allocator.h"
+#include "berrydb/options.h"
 #include "berrydb/platform.h"
 #include "berrydb/status.h"
 
@@ -61,9 +68,9 @@ class StoreImpl;
  * scratch space by some part of the system, every page pool user (component
  * that calls into PagePool) is responsible for maintaining a pin on the entries
  * that are used as scratch space. Page pool entries that have at least one pin
- * on them are pinned. Unpinned entries are tracked in an LRU cache, and can be
- * evicted at any time so, once a user releases its pin on an entry, it must not
- * touch that entry again.
+ * on them are pinned. Unpinned entries are tracked by an eviction policy, such
+ * as LRU, CLOCK or 2Q, and can be evicted at any time so, once a user releases
+ * its pin on an entry, it must not touch that entry again.
  *
  * Page pool users are required to notify the pool when they modify a page pool
  * entry's data. Notifying is accomplished by marking the entry as dirty. The
@@ -79,6 +86,41 @@ class StoreImpl;
  * making any changes to the buffer. When a user is done with a Page buffer, it
  * calls UnpinStorePage(), so the page pool entry can become eligible for
  * eviction again.
+ *
+ * Multi-threaded page pools partition the cached store pages into shards, by
+ * hashing each page's store and page ID. Each shard has its own page table,
+ * eviction policy state and latch, so threads that fetch cached pages
+ * (StorePage() hits) and unpin pages (UnpinStorePage()) only contend when they
+ * use the same shard.
+ * Evictions and the other operations that change which store page is cached
+ * by an entry are serialized by the pool's assignment latch, which also guards
+ * the page lists of all the transactions using the pool. A thread acquires the
+ * assignment latch before a shard latch, and holds at most one shard latch at
+ * a time. Single-threaded pools have one shard and skip all latching.
+ *
+ * A cache miss claims pool entries for the pages it reads while holding the
+ * assignment latch, and reads the pages after releasing the latch. The claimed
+ * entries are marked as loading until their read completes, and threads that
+ * need the same pages wait for the read instead of issuing their own.
+ *
+ * Evicting a dirty page requires writing it, which makes the cache miss that
+ * needs the page's entry wait for the write. Multi-threaded pools can run a
+ * background cleaner thread, which writes the dirty pages that are closest to
+ * being evicted ahead of time. The cleaner is configured by
+ * PoolOptions::page_pool_clean_fraction. The cleaner pins the pages it writes,
+ * and marks them as loading, so it does not hold the assignment latch during
+ * the writes.
+ *
+ * StorePage() detects stores that are read sequentially, such as by scans. When
+ * a cache miss continues a run of misses on consecutive pages, the pages
+ * following the missing page are read ahead, using one large read. The number
+ * of pages read ahead doubles with each miss in the run, up to a limit.
+ *
+ * Callers that know which pages they will need next can call Prefetch(), which
+ * submits the pages' reads to the store's asynchronous I/O queue and returns
+ * right away. Prefetched pages are marked as loading until the completions of
+ * their reads are collected. The threads that need the pages collect the
+ * completions, so prefetching does not need a background thread.
  */
 class PagePool {
  public:
@@ -111,10 +153,52 @@ class PagePool {
     kDiscardPage = true,
   };
 
-  /** Sets up a page pool. Page memory may be allocated on-demand. */
+  /** Holds a pool's assignment latch, if the pool is multi-threaded.
+   *
+   * The assignment latch must be held while changing the page list of any
+   * transaction whose store uses the pool. The latch is recursive, so PagePool
+   * methods can be called while holding it.
+   */
+  class AssignmentLock {
+   public:
+    inline explicit AssignmentLock(const PagePool* page_pool) noexcept
+        : lock_(page_pool->assignment_latch_, std::defer_lock) {
+      if (page_pool->is_multi_threaded_)
+        lock_.lock();
+    }
+
+    /** Releases the latch early, so the caller can block without holding it. */
+    inline void Unlock() noexcept {
+      if (lock_.owns_lock())
+        lock_.unlock();
+    }
+
+    /** Releases the latch until a condition is signaled.
+     *
+     * Only used by multi-threaded pools. The caller must not hold the latch
+     * recursively. */
+    inline void Wait(std::condition_variable_any* condition) {
+      condition->wait(lock_);
+    }
+
+   private:
+    std::unique_lock<std::recursive_mutex> lock_;
+  };
+
+  /** Sets up a page pool. Page memory may be allocated on-demand.
+   *
+   * @param pool    the resource pool that owns this page pool
+   * @param options the page pool's settings; the VFS is ignored */
+  PagePool(PoolImpl* pool, const PoolOptions& options);
+
+  /** Sets up a single-threaded LRU page pool. Intended for testing.
+   *
+   * @param pool          the resource pool that owns this page pool
+   * @param page_shift    the base-2 log of the pool's page size
+   * @param page_capacity maximum number of pages cached by the pool */
   PagePool(PoolImpl* pool, size_t page_shift, size_t page_capacity);
 
-  /** Deallocates the memory used by the pool's pages. */
+  /** Stops the background cleaner and deallocates the pool's pages. */
   ~PagePool();
 
   /** Fetches a page from a store and pins it.
@@ -139,6 +223,67 @@ class PagePool {
                    PageFetchMode fetch_mode,
                    Page** result);
 
+  /** Fetches many pages from a store and pins them.
+   *
+   * This is equivalent to calling StorePage() with kFetchPageData for each
+   * page. However, the pages that are not already in the pool are read from
+   * the store together, so reads of adjacent pages can be coalesced.
+   *
+   * If the call succeeds, the caller owns a pin on each returned page. If the
+   * call fails, the caller does not own any pin.
+   *
+   * @param  store    the store to fetch pages from
+   * @param  page_ids the pages that will be fetched; must not contain
+   *                  duplicates
+   * @param  count    the number of pages to be fetched
+   * @param  results  if the call succeeds, receives pointers to the page pool
+   *                  entries holding the pages, in the order of page_ids
+   * @return          may return kPoolFull if the page pool cannot hold all the
+   *                  pages, or kIoError if reading the store pages failed */
+  Status StorePages(StoreImpl* store, const size_t* page_ids, size_t count,
+                    Page** results);
+
+  /** Starts reading store pages into the pool, without pinning them.
+   *
+   * This is a hint given by callers that will soon fetch the pages. The reads
+   * of the pages that are not already in the pool are submitted to the store's
+   * prefetch queue, and this does not wait for them to complete. Pages past the
+   * end of the store's data file are skipped, and so are the pages that do not
+   * fit in the store's prefetch budget. A store's prefetched pages are pinned
+   * until their reads are collected, so the budget is the smaller of half of
+   * the pool and the queue's depth.
+   *
+   * Reads are collected by the threads that fetch the prefetched pages, by
+   * later Prefetch() calls, and by FinishPrefetches() when the store closes.
+   *
+   * Errors are not reported, because the pages that could not be read will be
+   * read again, and the errors reported, when they are fetched.
+   *
+   * @param  store    the store to read pages from
+   * @param  page_ids the pages that will be read; may contain duplicates
+   * @param  count    the number of pages to be read */
+  void Prefetch(StoreImpl* store, const size_t* page_ids, size_t count);
+
+  /** Pins a store page if it is already in the pool.
+   *
+   * This never reads the page from the store, so it is suitable for hints such
+   * as Transaction::Prefetch(). If the page is being read, this waits for the
+   * read to complete. The pages of memory-mapped stores are always available.
+   *
+   * @param  store   the store whose page is looked up
+   * @param  page_id the page that is looked up
+   * @return         the pinned page, or nullptr if the page is not in the
+   *                 pool, or if its read failed */
+  Page* PinCachedStorePage(StoreImpl* store, size_t page_id);
+
+  /** Waits for a store's prefetched pages, and releases its prefetch queue.
+   *
+   * Called when the store is closed, before its init transaction is rolled
+   * back. The caller may hold the assignment latch.
+   *
+   * @param store the store that is closing */
+  void FinishPrefetches(StoreImpl* store);
+
   /** Releases a Page previously obtained by StorePage().
    *
    * The method removes the caller's pin from this pool page entry. The page
@@ -148,12 +293,16 @@ class PagePool {
    * used by cursors from multiple readonly transactions.
    *
    * If the last pin is removed, the page entry will eventually cache another
-   * store page. However, for a short while, the entry will end up in the LRU
-   * queue, and remain associated with the store. Sadly, this means that the
-   * calling code may be able to access the page entry's data without errors.
+   * store page. However, for a short while, the entry will be tracked by the
+   * eviction policy, and remain associated with the store. Sadly, this means
+   * that the calling code may be able to access the page entry's data without
+   * errors.
    * Nevertheless, the caller must not use the page entry anymore after
    * releasing its pin.
    *
+   * Pages of memory-mapped stores are permanently pinned, so unpinning them
+   * does nothing.
+   *
    * @param  page a page pool entry that was previously obtained from this pool
    *              using StorePage()
    * @param  mode the desired behavior when unpinning makes this page pool
@@ -166,17 +315,14 @@ class PagePool {
 #if DCHECK_IS_ON()
     DCHECK_EQ(page->page_pool(), this);
 #endif  // DCHECK_IS_ON()
+    if (page->is_mapped())
+      return;
 
+    Shard* shard = &shards_[page->shard_index()];
+    ShardLock lock(this, shard);
     page->RemovePin();
-    if (page->IsUnpinned()) {
-      // NOTE: This looks like a lot of code for an inlined function. However,
-      //       all call sites will specify a constant mode, so one branch will
-      //       always be optimized out.
-      if (mode == kCachePage)
-        lru_list_.push_back(page);
-      else
-        lru_list_.push_front(page);
-    }
+    if (page->IsUnpinned())
+      ShardPageUnpinned(shard, page, mode);
   }
 
   /** Releases and writes back a dirty Page previously obtained by StorePage().
@@ -198,10 +344,59 @@ class PagePool {
   inline size_t page_size() const noexcept { return page_size_; }
 
   /** Maximum number of pages cached by this page pool. */
-  inline size_t page_capacity() const noexcept { return page_capacity_; }
+  size_t page_capacity() const noexcept;
+
+  /** Changes the maximum number of pages cached by this page pool.
+   *
+   * Growing the pool only raises the limit. Shrinking the pool evicts unpinned
+   * pages right away, writing them back if they are dirty. If too many pages
+   * are pinned, the pool sheds the rest of its excess pages as they get
+   * evicted by later cache misses.
+   *
+   * The memory of entries allocated separately is returned to the platform
+   * allocator. Entries carved out of slabs are retired by the slabs, which
+   * return the entries' page data to the OS, and release the slabs whose
+   * entries are all retired. Frame table entries are set aside and reused when
+   * the pool grows. Frame tables keep the memory of all their entries, so
+   * shrinking a pool that uses a frame table does not reduce its memory use.
+   *
+   * @param  page_capacity the new maximum number of cached pages
+   * @return               kInvalidArgument if the capacity is 0, or if the pool
+   *                       uses a frame table that cannot hold the pages;
+   *                       otherwise, kSuccess */
+  Status SetPageCapacity(size_t page_capacity);
+
+  /** The algorithm used to choose the cached pages that get evicted. */
+  inline PageEvictionPolicy eviction_policy() const noexcept {
+    return eviction_policy_;
+  }
+
+  /** True if the pool's entries are carved out of slabs. */
+  inline bool uses_slabs() const noexcept { return uses_slabs_; }
+
+  /** True if the pool's entries are kept in a frame table. */
+  inline bool uses_frame_table() const noexcept { return uses_frame_table_; }
+
+  /** True if the stores' data files should bypass the OS page cache. */
+  inline bool uses_direct_io() const noexcept { return uses_direct_io_; }
+
+  /** True if the entries' memory belongs to the pool's slabs or frame table.
+   *
+   * Otherwise, each entry is allocated separately. */
+  inline bool owns_entry_memory() const noexcept {
+    return uses_slabs_ || uses_frame_table_;
+  }
+
+  /** True if the pool may be used by multiple threads at the same time. */
+  inline bool is_multi_threaded() const noexcept { return is_multi_threaded_; }
+
+  /** Number of shards that the pool's cached pages are partitioned into.
+   *
+   * This is always a power of two. Single-threaded pools have one shard. */
+  inline size_t shard_count() const noexcept { return shard_mask_ + 1; }
 
   /** Total number of pages allocated for this pool. */
-  inline size_t allocated_pages() const noexcept { return page_count_; }
+  size_t allocated_pages() const noexcept;
 
   /** Number of pages that were allocated and are now unused.
    *
@@ -209,16 +404,50 @@ class PagePool {
    * errors. These pages are added to a free list, so future demand can be met
    * without invoking the platform allocator.
    */
-  inline size_t unused_pages() const noexcept { return free_list_.size(); }
+  size_t unused_pages() const noexcept;
 
   /** Number of pages that are pinned by running transactions.
    *
    * Only unpinned pages can be evicted and reused to meed demands for new
    * pages. If all pages in the pool become pinned, transactions that need more
    * page pool entries will be rolled back. */
-  inline size_t pinned_pages() const noexcept {
-    return page_count_ - free_list_.size() - lru_list_.size();
-  }
+  size_t pinned_pages() const noexcept;
+
+  /** Number of StorePage() and StorePages() requests served from the pool. */
+  size_t hit_count() const noexcept;
+
+  /** Number of StorePage() and StorePages() requests that needed a new entry.
+   *
+   * This includes requests that failed because the pool was full. */
+  size_t miss_count() const noexcept;
+
+  /** Number of pages read by StorePage() readahead or started by Prefetch().
+   */
+  size_t readahead_count() const noexcept;
+
+  /** Number of dirty pages written because they were evicted.
+   *
+   * These writes are done by the threads whose StorePage() or AllocPage() calls
+   * needed the evicted pages' entries, so they add latency to cache misses. */
+  size_t foreground_write_count() const noexcept;
+
+  /** Number of dirty pages written ahead of eviction by CleanPages(). */
+  size_t background_write_count() const noexcept;
+
+  /** Writes the dirty pages among the next pages to be evicted.
+   *
+   * Each shard's unpinned pages are examined in the order in which the eviction
+   * policy would evict them, up to the fraction of the shard set by
+   * PoolOptions::page_pool_clean_fraction. The dirty pages are written in page
+   * ID order, and keep their places in the eviction order. If a store's pages
+   * cannot be written, they stay dirty, and the store is flagged with
+   * StoreImpl::BackgroundWriteFailed().
+   *
+   * This is called periodically by the background cleaner thread, and can also
+   * be called directly, such as by single-threaded pools.
+   *
+   * @return the number of pages written */
+  size_t CleanPages();
 
   /** The resource pool that this page pool belongs to. */
   inline PoolImpl* pool() const noexcept { return pool_; }
@@ -281,6 +510,15 @@ class PagePool {
    */
   void UnassignPageFromStore(Page* page);
 
+  /** Frees up a pool entry without writing back its modifications.
+   *
+   * This is used to roll back transactions. Like UnassignPageFromStore(), the
+   * caller must have a pin on the page.
+   *
+   * @param page the page pool entry to be freed
+   */
+  void DiscardPageFromStore(Page* page);
+
   /** Adds a pin to a pool entry that is currently caching a store page.
    *
    * This is intended for internal use and for testing.
@@ -293,7 +531,8 @@ class PagePool {
    *
    * After this method returns, the list of pages assigned to the transaction is
    * guaranteed to be stable, assuming that the transaction refuses to fetch new
-   * pages.
+   * pages. This waits for the writes issued by CleanPages() to complete,
+   * without holding the assignment latch.
    *
    * @param page_list the list of pages to acquire pins on
    */
@@ -307,23 +546,465 @@ class PagePool {
   PagePool& operator=(const PagePool& other) = delete;
   PagePool& operator=(PagePool&& other) = delete;
 
-  /** Entries that belong to this page pool that are assigned to stores. */
-  using PageMapKey = std::pair<StoreImpl*, size_t>;
-  std::unordered_map<PageMapKey,
-                     Page*,
-                     PointerSizeHasher<StoreImpl>,
-                     std::equal_to<PageMapKey>,
-                     PlatformAllocator<std::pair<const PageMapKey, Page*>>>
-      page_map_;
+  /** A partition of the store pages cached by the pool. */
+  struct Shard {
+    /** Sets up an empty shard.
+     *
+     * @param page_capacity       the shard's share of the pool's page capacity
+     * @param probation_capacity  the size of the 2Q probation queue
+     * @param ghost_capacity      the number of pages remembered after they are
+     *                            evicted from the 2Q probation queue */
+    Shard(size_t page_capacity, size_t probation_capacity,
+          size_t ghost_capacity)
+        : page_table(page_capacity), probation_capacity(probation_capacity),
+          ghost_pages(ghost_capacity) {}
+
+    /** The shard's entries that are assigned to stores.
+     *
+     * The table starts out sized for the shard's share of the pool's pages.
+     * Evictions can move pages between shards, so the table doubles its
+     * maximum size when a shard caches more pages than it can hold. */
+    PageTable page_table;
+
+    /** The shard's pages that are tracked by the eviction policy.
+     *
+     * LRU pools keep the unpinned pages in this list, ordered by the relative
+     * time of last use. The first page in the list is the least recently used
+     * (LRU) page. Evicting removes the first page in this list (pop_front),
+     * and unpinned pages are added at the end of the list (push_back).
+     *
+     * CLOCK pools keep all the shard's pages in this list, in clock order. The
+     * first page in the list is under the clock hand. Pages are added at the
+     * end of the list, which is right behind the hand, and the hand advances
+     * by moving the first page to the end of the list. CLOCK pools that use a
+     * frame table do not use this list, because the clock hand sweeps the
+     * frame table.
+     *
+     * 2Q pools keep the unpinned pages in the main queue in this list, in LRU
+     * order.
+     */
+    LinkedList<Page> eviction_list;
+
+    /** The pages in the 2Q probation queue, in the order they were cached.
+     *
+     * The queue holds pinned pages as well, so pages keep their place in the
+     * queue when they are used. Only used by 2Q pools. */
+    LinkedList<Page> probation_list;
+
+    /** The number of pages above which the probation queue is evicted from. */
+    size_t probation_capacity;
+
+    /** The shard's pages recently evicted from the 2Q probation queue. */
+    GhostPageList ghost_pages;
+
+    /** Number of the shard's pages that have no pins. */
+    size_t unpinned_pages = 0;
+
+    /** Number of lookups that found a page in the shard. */
+    size_t hit_count = 0;
+
+    /** Guards the members above, and the pin counts of the shard's pages.
+     *
+     * Only used by multi-threaded pools. */
+    std::mutex latch;
+
+    /** Signaled when the shard's pages finish loading, and when the threads
+     * that waited for a failed load drop their pins on the page.
+     *
+     * Only used by multi-threaded pools. */
+    std::condition_variable load_condition;
+  };
+
+  /** Holds a shard's latch, if the pool is multi-threaded. */
+  class ShardLock {
+   public:
+    inline ShardLock(const PagePool* page_pool, Shard* shard) noexcept
+        : lock_(shard->latch, std::defer_lock) {
+      if (page_pool->is_multi_threaded_)
+        lock_.lock();
+    }
+
+    /** Waits until the shard's load condition is signaled.
+     *
+     * Only used by multi-threaded pools. */
+    inline void Wait(Shard* shard) { shard->load_condition.wait(lock_); }
+
+    /** Releases the latch, so the caller can block without holding it. */
+    inline void Unlock() noexcept {
+      if (lock_.owns_lock()) {
+        lock_.unlock();
+        is_unlocked_ = true;
+      }
+    }
+
+    /** Re-acquires a latch released by Unlock(). */
+    inline void Relock() noexcept {
+      if (is_unlocked_) {
+        lock_.lock();
+        is_unlocked_ = false;
+      }
+    }
+
+   private:
+    std::unique_lock<std::mutex> lock_;
+    bool is_unlocked_ = false;
+  };
+
+  /** The shard that caches a store page. */
+  inline size_t ShardIndex(StoreImpl* store, size_t page_id) const noexcept {
+    return PointerSizeHasher<StoreImpl>()(std::make_pair(store, page_id)) &
+           shard_mask_;
+  }
+
+  /** Pins a store page if it is cached by a shard.
+   *
+   * If another thread is reading the page, this waits for the read to complete,
+   * so the caller must not hold the assignment latch.
+   *
+   * @return the pinned page, or nullptr if the shard does not cache the page,
+   *         or if the page could not be read */
+  Page* PinCachedStorePage(Shard* shard, StoreImpl* store, size_t page_id);
+
+  /** Pins a store page if it is cached by a shard, even if it is loading.
+   *
+   * The caller must hold the shard's latch.
+   *
+   * @return the pinned page, or nullptr if the shard does not cache the page */
+  Page* PinShardStorePage(Shard* shard, StoreImpl* store, size_t page_id);
+
+  /** Waits until a pinned page that is loading has its data read.
+   *
+   * If the page was prefetched, this collects the completions of the store's
+   * prefetch reads until the page's read is done. The caller must hold the
+   * shard's latch, and must not hold the assignment latch.
+   *
+   * @param  lock    holds the latch of the page's shard
+   * @param  page    the caller's pinned page, which caches store / page_id
+   * @return         false if the read failed, in which case the caller's pin
+   *                 on the page was removed */
+  bool WaitForPageLoad(ShardLock* lock, Shard* shard, StoreImpl* store,
+                       size_t page_id, Page* page);
+
+  /** Pins a page cached by a shard. The caller must hold the shard's latch. */
+  void PinShardPage(Shard* shard, Page* page);
+
+  /** Page eviction_state() values used by CLOCK pools. */
+  enum ClockState : uint8_t {
+    /** The page was not used since the clock hand passed it. */
+    kClockUnreferenced = 0,
+    /** The page was used since the clock hand passed it. */
+    kClockReferenced = 1,
+  };
+
+  /** Page eviction_state() values used by 2Q pools. */
+  enum TwoQueueState : uint8_t {
+    /** The page is in the probation queue. */
+    kTwoQueueProbation = 0,
+    /** The page is in the main queue. */
+    kTwoQueueMain = 1,
+  };
+
+  /** Updates the eviction policy after a shard page lost its last pin.
+   *
+   * The caller must hold the shard's latch. */
+  inline void ShardPageUnpinned(Shard* shard, Page* page,
+                                PageUnpinMode mode) noexcept {
+    ++shard->unpinned_pages;
+
+    // NOTE: This looks like a lot of code for an inlined function. However,
+    //       all call sites will specify a constant mode, so some branches will
+    //       always be optimized out.
+    switch (eviction_policy_) {
+      case PageEvictionPolicy::kLru:
+        if (mode == kCachePage)
+          shard->eviction_list.push_back(page);
+        else
+          shard->eviction_list.push_front(page);
+        break;
+      case PageEvictionPolicy::kClock:
+        // Pages that should be discarded lose their second chance.
+        if (mode == kDiscardPage)
+          page->SetEvictionState(kClockUnreferenced);
+        break;
+      case PageEvictionPolicy::kTwoQueue:
+        if (page->eviction_state() == kTwoQueueMain) {
+          if (mode == kCachePage)
+            shard->eviction_list.push_back(page);
+          else
+            shard->eviction_list.push_front(page);
+        } else if (mode == kDiscardPage) {
+          // Probation pages that should be discarded are evicted next.
+          shard->probation_list.erase(page);
+          shard->probation_list.push_front(page);
+        }
+        break;
+    }
+  }
+
+  /** Removes an unpinned page from a shard's eviction policy and pins it.
+   *
+   * The caller must hold the shard's latch.
+   *
+   * @return the page, or nullptr if all the shard's pages are pinned */
+  Page* PinShardVictim(Shard* shard);
+
+  /** Pins the oldest unpinned page in a 2Q shard's probation queue.
+   *
+   * The page is removed from the probation queue, and remembered in the
+   * shard's ghost list. The caller must hold the shard's latch.
+   *
+   * @return the page, or nullptr if all the probation pages are pinned */
+  Page* PinTwoQueueProbationVictim(Shard* shard);
+
+  /** Sweeps the frame table with the clock hand, and pins the page it stops at.
+   *
+   * The page is removed from its shard. Only used by CLOCK pools that use a
+   * frame table. The caller must hold the assignment latch, and the free list
+   * must be empty.
+   *
+   * @return the page, or nullptr if all the pool's pages are pinned */
+  Page* PinFrameTableVictim();
+
+  /** True if the pool's CLOCK hand sweeps the frame table. */
+  inline bool SweepsFrameTable() const noexcept {
+    return uses_frame_table_ &&
+           eviction_policy_ == PageEvictionPolicy::kClock;
+  }
+
+  /** Allocates a page and pins it, evicting a page if necessary.
+   *
+   * The caller must hold the assignment latch.
+   *
+   * @param  shard_index the first shard that is asked for a victim
+   * @return a pinned page, or nullptr if the pool is at capacity */
+  Page* AllocPageFromShard(size_t shard_index);
+
+  /** Makes a page that was assigned to a store visible to StorePage().
+   *
+   * The page's data must be fully loaded, or the page must be marked as
+   * loading. The caller must hold the assignment latch, and must have a pin on
+   * the page. */
+  void InsertPageIntoShard(Page* page, StoreImpl* store, size_t page_id);
+
+  /** Assigns a pool entry to a store page that will be read by the caller.
+   *
+   * The entry is marked as loading and becomes visible to StorePage(), so other
+   * threads wait for the caller's read instead of reading the page themselves.
+   * The caller must hold the assignment latch, must own the entry's only pin,
+   * and must call FinishPageLoads() after reading the page.
+   *
+   * @param page    a page pool entry that is not associated with a store
+   * @param page_id the store page that is not cached by the pool */
+  void ClaimStorePage(Page* page, StoreImpl* store, size_t page_id);
+
+  /** Ends the loading state of pages claimed by ClaimStorePage().
+   *
+   * Wakes up the threads waiting for the pages. If the reads failed, the pages
+   * are also removed from their shards, and the caller must then call
+   * UnassignFailedPages(). This never waits for other threads' reads. */
+  void FinishPageLoads(Page* const* pages, size_t count, bool succeeded);
+
+  /** Unassigns claimed pages whose reads failed from their store.
+   *
+   * Waits until the threads that were waiting for the pages drop their pins, so
+   * the caller must not hold the assignment latch. The caller keeps its pins on
+   * the unassigned pages. */
+  void UnassignFailedPages(Page* const* pages, size_t count);
+
+  /** Number of pages that a StorePage() miss should read from the store.
+   *
+   * Updates the store's sequential read detection state. The pages read ahead
+   * stop before the first page that is already cached, and at the end of the
+   * store's data file. The caller must hold the assignment latch.
+   *
+   * @return 1 + the number of pages that should be read ahead */
+  size_t ReadaheadRunSize(StoreImpl* store, size_t page_id);
+
+  /** Collects the completions of a store's prefetch reads.
+   *
+   * The caller must hold the store's prefetch mutex.
+   *
+   * @param store     the store whose prefetch queue is polled
+   * @param min_count the number of completions to wait for; capped to the
+   *                  number of reads in progress */
+  void PollPrefetchReads(StoreImpl* store, size_t min_count);
+
+  /** Ends the loading state of a page whose prefetch read completed.
+   *
+   * Successfully read pages lose the prefetch's pin. Pages that could not be
+   * read are removed from their shard, and are queued for
+   * ReleaseFailedPrefetches(), because the caller may be a thread that holds a
+   * pin on the page. The caller must hold the store's prefetch mutex. */
+  void FinishPrefetchRead(StoreImpl* store, Page* page, bool succeeded);
+
+  /** Unassigns and frees the prefetched pages whose reads failed.
+   *
+   * Waits until the threads that were waiting for the pages drop their pins, so
+   * the caller must not hold pins on the pages, and must not hold the store's
+   * prefetch mutex. */
+  void ReleaseFailedPrefetches(StoreImpl* store);
+
+  /** Accounts for pages read ahead of their use that were unpinned.
+   *
+   * Wakes up the cache misses that are waiting for the pages. The caller must
+   * hold the assignment latch. */
+  void ReadaheadPagesUnpinned(size_t page_count);
+
+  /** True if a store page is cached in the pool, or is being loaded.
+   *
+   * The caller must hold the assignment latch, so the answer stays valid. */
+  bool IsStorePageCached(StoreImpl* store, size_t page_id);
+
+  /** Evicts an unpinned page, and returns its entry pinned and unassigned.
+   *
+   * The caller must hold the assignment latch.
+   *
+   * @param  shard_index the shard whose eviction policy is consulted first
+   * @return             nullptr if all the pool's pages are pinned */
+  Page* EvictPage(size_t shard_index);
+
+  /** Releases unused and evictable entries until the pool is within capacity.
+   *
+   * The caller must hold the assignment latch. */
+  void ShrinkToCapacity();
+
+  /** Removes a page from its shard, so it cannot be found by StorePage().
+   *
+   * The caller must hold the assignment latch. */
+  void RemovePageFromShard(Page* page);
+
+  /** Removes a pinned page from a shard's page table and eviction policy.
+   *
+   * The caller must hold the shard's latch. */
+  void EraseShardPage(Shard* shard, Page* page);
+
+  /** Writes back a page that was removed from its shard, and unassigns it.
+   *
+   * The caller must hold the assignment latch. */
+  void DetachPageFromStore(Page* page);
+
+  /** Detaches a page that was chosen for eviction from its store.
+   *
+   * The caller must hold the assignment latch. */
+  void DetachEvictedPage(Page* page);
+
+  using PageVector = std::vector<Page*, PlatformAllocator<Page*>>;
+  using StoreVector = std::vector<StoreImpl*, PlatformAllocator<StoreImpl*>>;
+
+  /** Pins the dirty pages among a shard's next pages to be evicted.
+   *
+   * The caller must hold the assignment latch, and must call
+   * FinishCleaningPages() after writing the pages.
+   *
+   * @param pages receives the pages that must be written */
+  void CollectShardDirtyPages(Shard* shard, PageVector* pages);
+
+  /** Pins the dirty pages in the frames ahead of the clock hand.
+   *
+   * The caller must hold the assignment latch, and must call
+   * FinishCleaningPages() after writing the pages.
+   *
+   * @param pages receives the pages that must be written */
+  void CollectFrameTableDirtyPages(PageVector* pages);
+
+  /** Pins an unpinned dirty page that will be written by CleanPages().
+   *
+   * The page is marked as loading, so transactions that want to modify it wait
+   * until it is written. Cleaning a page does not count as using it, so the
+   * eviction policy is not told about the pin. The caller must hold the
+   * assignment latch and the page's shard latch. */
+  void PinCleanedPage(Shard* shard, Page* page);
+
+  /** Releases the pages pinned by CollectShardDirtyPages() and friends.
+   *
+   * The written pages that were not pinned by their transactions in the
+   * meantime are moved to their stores' init transactions. The other pages stay
+   * dirty. Unpinned pages go back to the front of their eviction orders, so
+   * the pages must be given in the order in which they were collected. The
+   * caller must hold the assignment latch.
+   *
+   * @param pages         the pages, in the order they were collected
+   * @param failed_stores the stores whose pages could not be written */
+  void FinishCleaningPages(const PageVector& pages,
+                           const StoreVector& failed_stores);
+
+  /** Wakes up the background cleaner thread, if the pool has one. */
+  void WakeCleaner();
+
+  /** The background cleaner thread's main loop. */
+  void RunCleaner();
 
   size_t page_shift_;
   size_t page_size_;
+  /** Guarded by the assignment latch. */
   size_t page_capacity_;
   PoolImpl* const pool_;
 
+  const PageEvictionPolicy eviction_policy_;
+  const bool uses_slabs_;
+  const bool uses_frame_table_;
+  const bool uses_direct_io_;
+  const bool is_multi_threaded_;
+  /** Maps hashes to shard indexes. shard_count() - 1. */
+  const size_t shard_mask_;
+  /** The pool's shards. Has shard_count() elements. */
+  Shard* const shards_;
+  /** The fraction of the eviction candidates kept clean by CleanPages(). */
+  const double clean_fraction_;
+  /** Number of eviction candidates examined in each shard by CleanPages().
+   *
+   * Guarded by the assignment latch. */
+  size_t clean_window_;
+  /** The largest number of pages read ahead by a StorePage() miss.
+   *
+   * Guarded by the assignment latch. */
+  size_t max_readahead_;
+
+  /** Serializes the operations that assign pages to stores.
+   *
+   * Guards the members below and the transaction page lists. Only used by
+   * multi-threaded pools. */
+  mutable std::recursive_mutex assignment_latch_;
+
   /** Number of pages currently held by the pool. */
   size_t page_count_ = 0;
 
+  /** Memory for the pool's entries, if the pool uses slabs. */
+  PageSlabs slabs_;
+
+  /** The pool's entries, if the pool uses a frame table.
+   *
+   * The table's memory is never allocated in other pools. */
+  PageFrameTable frame_table_;
+
+  /** The frame under the clock hand, if the pool sweeps the frame table. */
+  size_t clock_hand_ = 0;
+
+  /** Number of lookups that needed a new pool entry. */
+  size_t miss_count_ = 0;
+
+  /** Number of pages read ahead of their use. */
+  size_t readahead_count_ = 0;
+
+  /** Number of pages read ahead by misses whose reads are in progress.
+   *
+   * These pages are pinned until their reads complete. Pages read ahead by
+   * different threads are capped together, so readahead cannot pin a large
+   * fraction of the pool. */
+  size_t loading_readahead_pages_ = 0;
+
+  /** Signaled when pages read ahead of their use are unpinned.
+   *
+   * Cache misses that find all the pool's pages pinned wait for this, if any
+   * pages are being read ahead. Used with the assignment latch. */
+  std::condition_variable_any readahead_condition_;
+
+  /** Number of dirty pages written when they were evicted. */
+  size_t foreground_write_count_ = 0;
+
+  /** Number of dirty pages written by CleanPages(). */
+  size_t background_write_count_ = 0;
+
   /** The list of pages that haven't been returned to the OS.
    *
    * This is only populated when a Store is closed and its pages are flushed
@@ -331,17 +1012,27 @@ class PagePool {
    */
   LinkedList<Page> free_list_;
 
-  /** Pages that can be evicted, ordered by the relative time of last use.
+  /** Pinned entries set aside when the pool was shrunk.
    *
-   * The first page in the list is the least recently used (LRU) page. The LRU
-   * cache replacement policy should be implemented by removing the first page
-   * in this list (pop_front), and pages should be added at the end of the list
-   * (push_back).
+   * Only used by pools whose entries are kept in a frame table. The entries are
+   * reused before new entries are created. Slab entries are retired by the
+   * slabs instead.
    */
-  LinkedList<Page> lru_list_;
+  LinkedList<Page> retired_list_;
 
   /** Log pages waiting to be written to disk. */
   LinkedList<Page> log_list_;
+
+  /** Guards the background cleaner's wake-up flags. */
+  std::mutex cleaner_mutex_;
+  /** Signaled when the background cleaner should run or stop. */
+  std::condition_variable cleaner_condition_;
+  /** True if the background cleaner should run before its next deadline. */
+  bool cleaner_wake_pending_ = false;
+  /** True if the background cleaner should exit. */
+  bool cleaner_stopping_ = false;
+  /** Runs CleanPages() periodically, if the pool has a background cleaner. */
+  std::thread cleaner_thread_;
 };
 
 }  // namespace berrydb
@@ -4,9 +4,14 @@
 
 #include "./page_pool.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <mutex>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -22,6 +27,69 @@
 
 namespace berrydb {
 
+namespace {
+
+/** Holds up the reads (or the writes) of one page until the test lets them
+ * through. */
+class GatedBlockAccessFile : public BlockAccessFileWrapper {
+ public:
+  GatedBlockAccessFile(BlockAccessFile* file, size_t gated_offset,
+                       bool gates_writes = false)
+      : BlockAccessFileWrapper(file), gated_offset_(gated_offset),
+        gates_writes_(gates_writes) {}
+
+  Status Read(size_t offset, size_t byte_count, uint8_t* buffer) override {
+    if (offset == gated_offset_ && !gates_writes_)
+      HoldUpTransfer();
+    return BlockAccessFileWrapper::Read(offset, byte_count, buffer);
+  }
+
+  Status WriteV(const BlockIoBuffer* buffers, size_t buffer_count,
+                size_t offset) override {
+    if (offset == gated_offset_ && gates_writes_)
+      HoldUpTransfer();
+    return BlockAccessFileWrapper::WriteV(buffers, buffer_count, offset);
+  }
+
+  /** Waits until a read or write of the gated page is held up. */
+  void WaitForGatedTransfer() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() { return gated_transfers_ != 0; });
+  }
+
+  /** Lets the held up transfers through, along with all future transfers. */
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_open_ = true;
+    }
+    condition_.notify_all();
+  }
+
+  /** The number of reads and writes of the gated page. */
+  size_t gated_transfers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return gated_transfers_;
+  }
+
+ private:
+  void HoldUpTransfer() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++gated_transfers_;
+    condition_.notify_all();
+    condition_.wait(lock, [this]() { return is_open_; });
+  }
+
+  const size_t gated_offset_;
+  const bool gates_writes_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  size_t gated_transfers_ = 0;
+  bool is_open_ = false;
+};
+
+}  // namespace
+
 class PagePoolTest : public ::testing::Test {
  protected:
   PagePoolTest()
@@ -32,7 +100,7 @@ class PagePoolTest : public ::testing::Test {
     BlockAccessFile* raw_data_file1;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
         data_file1_deleter_.path(), kStorePageShift, true, false,
-        &raw_data_file1, &data_file1_size_));
+        false, &raw_data_file1, &data_file1_size_));
     data_file1_.reset(raw_data_file1);
     RandomAccessFile* raw_log_file1;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForRandomAccess(
@@ -41,11 +109,217 @@ class PagePoolTest : public ::testing::Test {
     log_file1_.reset(raw_log_file1);
   }
 
-  void CreatePool(int page_shift, int page_capacity) {
+  void CreatePool(
+      int page_shift, int page_capacity,
+      PageEvictionPolicy eviction_policy = PageEvictionPolicy::kLru) {
     PoolOptions options;
     options.page_shift = page_shift;
     options.page_pool_size = page_capacity;
+    options.page_eviction_policy = eviction_policy;
+    pool_.reset(PoolImpl::Create(options));
+  }
+
+  /** Fetches a store page and unpins it right away. */
+  void TouchStorePage(StoreImpl* store, size_t page_id,
+                      PagePool::PageUnpinMode mode = PagePool::kCachePage) {
+    PagePool* page_pool = pool_->page_pool();
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store, page_id, PagePool::kFetchPageData, &page));
+    if (mode == PagePool::kCachePage)
+      page_pool->UnpinStorePage(page, PagePool::kCachePage);
+    else
+      page_pool->UnpinStorePage(page, PagePool::kDiscardPage);
+  }
+
+  void CreateMultiThreadedPool(int page_shift, int page_capacity,
+                               int shard_count,
+                               PoolOptions options = PoolOptions()) {
+    options.page_shift = page_shift;
+    options.page_pool_size = page_capacity;
+    options.multi_threaded = true;
+    options.page_pool_shards = shard_count;
+    pool_.reset(PoolImpl::Create(options));
+  }
+
+  /** Fetches pages from many threads, through a small multi-threaded pool. */
+  void CheckMultiThreadedStorePage(const PoolOptions& options) {
+    constexpr size_t kPageCount = 16;
+    constexpr size_t kThreadCount = 4;
+    std::vector<uint8_t> buffer(kPageCount << kStorePageShift);
+    for(size_t i = 0; i < buffer.size(); ++i)
+      buffer[i] = static_cast<uint8_t>(rnd_());
+
+    // The pool cannot hold all the pages, so the threads also race on misses.
+    CreateMultiThreadedPool(kStorePageShift, kPageCount / 2, 4, options);
+    PagePool* page_pool = pool_->page_pool();
+    UniquePtr<StoreImpl> store(StoreImpl::Create(
+        data_file1_.release(), data_file1_size_, log_file1_.release(),
+        log_file1_size_, page_pool, StoreOptions()));
+
+    for (size_t i = 0; i < kPageCount; ++i)
+      WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+    std::atomic<size_t> failures(0);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < kThreadCount; ++thread) {
+      threads.emplace_back([&, thread]() {
+        std::mt19937 rnd(static_cast<uint32_t>(thread));
+        for (size_t i = 0; i < 1000; ++i) {
+          size_t page_id = rnd() % kPageCount;
+          Page* page;
+          if (page_pool->StorePage(store.get(), page_id,
+                                   PagePool::kFetchPageData,
+                                   &page) != Status::kSuccess) {
+            ++failures;
+            continue;
+          }
+          if (page->page_id() != page_id || std::memcmp(
+              page->data(), buffer.data() + (page_id << kStorePageShift),
+              1 << kStorePageShift) != 0) {
+            ++failures;
+          }
+          page_pool->UnpinStorePage(page);
+        }
+      });
+    }
+    for (std::thread& thread : threads)
+      thread.join();
+
+    EXPECT_EQ(0U, failures.load());
+    EXPECT_EQ(0U, page_pool->pinned_pages());
+    EXPECT_EQ(kPageCount / 2, page_pool->allocated_pages());
+  }
+
+  /** Shrinks and grows a pool that caches a store's pages. */
+  void CheckSetPageCapacity(PoolOptions options) {
+    std::vector<uint8_t> buffer(12 << kStorePageShift);
+    for(size_t i = 0; i < buffer.size(); ++i)
+      buffer[i] = static_cast<uint8_t>(rnd_());
+
+    options.page_shift = kStorePageShift;
+    options.page_pool_size = 8;
     pool_.reset(PoolImpl::Create(options));
+    PagePool* page_pool = pool_->page_pool();
+    UniquePtr<StoreImpl> store(StoreImpl::Create(
+        data_file1_.release(), data_file1_size_, log_file1_.release(),
+        log_file1_size_, page_pool, StoreOptions()));
+    for (size_t i = 0; i < 12; ++i)
+      WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+    for (size_t i = 0; i < 8; ++i)
+      TouchStorePage(store.get(), i);
+    EXPECT_EQ(8U, page_pool->allocated_pages());
+
+    EXPECT_EQ(Status::kInvalidArgument, page_pool->SetPageCapacity(0));
+    EXPECT_EQ(8U, page_pool->page_capacity());
+
+    // Pinned pages are not evicted.
+    Page* pages[2];
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), 7, PagePool::kFetchPageData, &pages[0]));
+    ASSERT_EQ(Status::kSuccess, page_pool->SetPageCapacity(3));
+    EXPECT_EQ(3U, page_pool->page_capacity());
+    EXPECT_EQ(3U, page_pool->allocated_pages());
+    EXPECT_EQ(1U, page_pool->pinned_pages());
+
+    // The pool sheds the pages that were pinned when it was shrunk as they
+    // get evicted.
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), 0, PagePool::kFetchPageData, &pages[1]));
+    ASSERT_EQ(Status::kSuccess, page_pool->SetPageCapacity(1));
+    EXPECT_EQ(2U, page_pool->allocated_pages());
+    EXPECT_EQ(2U, page_pool->pinned_pages());
+    page_pool->UnpinStorePage(pages[0]);
+    page_pool->UnpinStorePage(pages[1]);
+    TouchStorePage(store.get(), 9);
+    EXPECT_EQ(1U, page_pool->allocated_pages());
+    EXPECT_EQ(0U, page_pool->pinned_pages());
+
+    ASSERT_EQ(Status::kSuccess, page_pool->SetPageCapacity(8));
+    EXPECT_EQ(8U, page_pool->page_capacity());
+    for (size_t i = 0; i < 8; ++i) {
+      Page* page;
+      ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+          store.get(), i, PagePool::kFetchPageData, &page));
+      EXPECT_EQ(i, page->page_id());
+      EXPECT_EQ(0, std::memcmp(page->data(),
+                               buffer.data() + (i << kStorePageShift),
+                               1 << kStorePageShift));
+      page_pool->UnpinStorePage(page);
+    }
+    EXPECT_EQ(8U, page_pool->allocated_pages());
+    EXPECT_EQ(0U, page_pool->pinned_pages());
+  }
+
+  /** Fetches batches of pages, some of which are cached. */
+  void CheckStorePages(PoolOptions options) {
+    uint8_t buffer[6 << kStorePageShift];
+    for(size_t i = 0; i < sizeof(buffer); ++i)
+      buffer[i] = static_cast<uint8_t>(rnd_());
+
+    options.page_shift = kStorePageShift;
+    options.page_pool_size = 4;
+    pool_.reset(PoolImpl::Create(options));
+    PagePool* page_pool = pool_->page_pool();
+    BlockAccessFileWrapper data_file_wrapper(data_file1_.release());
+    UniquePtr<StoreImpl> store(StoreImpl::Create(
+        &data_file_wrapper, data_file1_size_, log_file1_.release(),
+        log_file1_size_, page_pool, StoreOptions()));
+
+    for (size_t i = 0; i < 6; ++i)
+      WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+    Page* cached_page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), 1, PagePool::kFetchPageData, &cached_page));
+
+    // Pages 2 and 3 are adjacent, so they are read together. Page 1 is cached.
+    size_t read_count = data_file_wrapper.read_count();
+    size_t page_ids[] = {3, 1, 2};
+    Page* pages[3];
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePages(
+        store.get(), page_ids, 3, pages));
+    EXPECT_EQ(read_count + 1, data_file_wrapper.read_count());
+    EXPECT_EQ(cached_page, pages[1]);
+    for (size_t i = 0; i < 3; ++i) {
+      EXPECT_FALSE(pages[i]->is_dirty());
+      EXPECT_FALSE(pages[i]->IsUnpinned());
+      EXPECT_EQ(page_ids[i], pages[i]->page_id());
+      EXPECT_EQ(0, std::memcmp(
+          pages[i]->data(), buffer + (page_ids[i] << kStorePageShift),
+          1 << kStorePageShift));
+    }
+    EXPECT_EQ(3U, page_pool->allocated_pages());
+    EXPECT_EQ(3U, page_pool->pinned_pages());
+
+    for (size_t i = 0; i < 3; ++i)
+      page_pool->UnpinStorePage(pages[i]);
+    page_pool->UnpinStorePage(cached_page);
+    EXPECT_EQ(0U, page_pool->pinned_pages());
+
+    // The pool cannot hold 5 pages, so none of them are pinned.
+    size_t too_many_page_ids[] = {1, 2, 3, 4, 5};
+    Page* too_many_pages[5];
+    EXPECT_EQ(Status::kPoolFull, page_pool->StorePages(
+        store.get(), too_many_page_ids, 5, too_many_pages));
+    EXPECT_EQ(0U, page_pool->pinned_pages());
+
+    data_file_wrapper.SetAccessError(Status::kIoError);
+    size_t missing_page_ids[] = {1, 4, 5};
+    Page* missing_pages[3];
+    EXPECT_EQ(Status::kIoError, page_pool->StorePages(
+        store.get(), missing_page_ids, 3, missing_pages));
+    EXPECT_EQ(0U, page_pool->pinned_pages());
+
+    // The failed reads do not leave garbage in the pool.
+    data_file_wrapper.SetAccessError(Status::kSuccess);
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), 4, PagePool::kFetchPageData, &page));
+    EXPECT_EQ(0, std::memcmp(
+        page->data(), buffer + (4 << kStorePageShift), 1 << kStorePageShift));
+    page_pool->UnpinStorePage(page);
+
   }
 
   void WriteStorePage(StoreImpl* store, size_t page_id, const uint8_t* data) {
@@ -94,6 +368,33 @@ TEST_F(PagePoolTest, Constructor) {
   EXPECT_EQ(0U, page_pool.pinned_pages());
 }
 
+TEST_F(PagePoolTest, ShardCount) {
+  CreatePool(12, 42);
+  PagePool page_pool(pool_.get(), 12, 42);
+  EXPECT_FALSE(page_pool.is_multi_threaded());
+  EXPECT_EQ(1U, page_pool.shard_count());
+
+  PoolOptions options;
+  options.page_shift = 12;
+  options.page_pool_size = 42;
+  options.multi_threaded = true;
+  options.page_pool_shards = 1;
+  PagePool page_pool2(pool_.get(), options);
+  EXPECT_TRUE(page_pool2.is_multi_threaded());
+  EXPECT_EQ(1U, page_pool2.shard_count());
+
+  options.page_pool_shards = 3;
+  PagePool page_pool3(pool_.get(), options);
+  EXPECT_TRUE(page_pool3.is_multi_threaded());
+  EXPECT_EQ(4U, page_pool3.shard_count());
+
+  options.page_pool_shards = 0;
+  PagePool page_pool4(pool_.get(), options);
+  EXPECT_TRUE(page_pool4.is_multi_threaded());
+  EXPECT_LE(1U, page_pool4.shard_count());
+  EXPECT_EQ(0U, page_pool4.shard_count() & (page_pool4.shard_count() - 1));
+}
+
 TEST_F(PagePoolTest, AllocPageState) {
   CreatePool(12, 1);
   PagePool page_pool(pool_.get(), 12, 1);
@@ -135,6 +436,68 @@ TEST_F(PagePoolTest, AllocRespectsCapacity) {
   EXPECT_EQ(0U, page_pool.pinned_pages());
 }
 
+TEST_F(PagePoolTest, SetPageCapacity) {
+  CheckSetPageCapacity(PoolOptions());
+}
+
+TEST_F(PagePoolTest, SetPageCapacityWithSlabs) {
+  PoolOptions options;
+  options.page_pool_slabs = true;
+  CheckSetPageCapacity(options);
+}
+
+TEST_F(PagePoolTest, SetPageCapacityWithFrameTable) {
+  PoolOptions options;
+  options.page_eviction_policy = PageEvictionPolicy::kClock;
+  options.page_pool_frame_table = true;
+  CheckSetPageCapacity(options);
+
+  // The frame table is sized for the pool's initial capacity.
+  PagePool* page_pool = pool_->page_pool();
+  EXPECT_EQ(Status::kInvalidArgument, page_pool->SetPageCapacity(9));
+  EXPECT_EQ(8U, page_pool->page_capacity());
+}
+
+TEST_F(PagePoolTest, SetPageCapacityTwoQueue) {
+  PoolOptions options;
+  options.page_eviction_policy = PageEvictionPolicy::kTwoQueue;
+  CheckSetPageCapacity(options);
+}
+
+TEST_F(PagePoolTest, SlabsAlignPageData) {
+  uint8_t buffer[4 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  PoolOptions options;
+  options.page_shift = kStorePageShift;
+  options.page_pool_size = 3;
+  options.page_pool_slabs = true;
+  pool_.reset(PoolImpl::Create(options));
+  PagePool* page_pool = pool_->page_pool();
+  EXPECT_TRUE(page_pool->uses_slabs());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 4; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  // Evictions reuse the slab entries.
+  for (size_t i = 0; i < 8; ++i) {
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), i % 4, PagePool::kFetchPageData, &page));
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(page->data()) &
+                  ((1 << kStorePageShift) - 1));
+    EXPECT_EQ(0, std::memcmp(
+        page->data(), buffer + ((i % 4) << kStorePageShift),
+        1 << kStorePageShift));
+    page_pool->UnpinStorePage(page);
+  }
+  EXPECT_EQ(3U, page_pool->allocated_pages());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
 TEST_F(PagePoolTest, AllocUsesFreeList) {
   CreatePool(12, 1);
   PagePool* page_pool = pool_->page_pool();
@@ -309,10 +672,15 @@ TEST_F(PagePoolTest, UnassignPageFromStoreIoError) {
 #if DCHECK_IS_ON()
   EXPECT_EQ(nullptr, page->transaction());
 #endif  // DCHECK_IS_ON()
-  EXPECT_EQ(true, store->IsClosed());
-  EXPECT_EQ(true, transaction->IsClosed());
+  EXPECT_TRUE(store->has_write_error());
+  EXPECT_FALSE(store->IsClosed());
 
   page_pool->UnpinUnassignedPage(page);
+
+  // The error is reported by the next commit.
+  EXPECT_EQ(Status::kIoError, transaction->Commit());
+  EXPECT_TRUE(store->IsClosed());
+  EXPECT_TRUE(transaction->IsClosed());
 }
 
 TEST_F(PagePoolTest, AssignPageToStoreSuccess) {
@@ -541,4 +909,1226 @@ TEST_F(PagePoolTest, StorePage) {
   EXPECT_EQ(0U, page_pool->pinned_pages());
 }
 
+TEST_F(PagePoolTest, StorePages) {
+  CheckStorePages(PoolOptions());
+}
+
+TEST_F(PagePoolTest, MultiThreadedStorePages) {
+  PoolOptions options;
+  options.multi_threaded = true;
+  options.page_pool_shards = 4;
+  CheckStorePages(options);
+}
+
+TEST_F(PagePoolTest, StorePageReadsAhead) {
+  std::vector<uint8_t> buffer(40 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  // The pool reads ahead at most 64 / 4 = 16 pages.
+  CreatePool(kStorePageShift, 64);
+  PagePool* page_pool = pool_->page_pool();
+  BlockAccessFileWrapper data_file_wrapper(data_file1_.release());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file_wrapper, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  for (size_t i = 0; i < 40; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  // Page 1 continues the run started by page 0, so it reads 4 pages ahead. The
+  // following misses read 8 pages and 16 pages ahead, and the last miss stops
+  // at the end of the store.
+  size_t read_count = data_file_wrapper.read_count();
+  size_t misses = page_pool->miss_count();
+  for (size_t i = 0; i < 40; ++i) {
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), i, PagePool::kFetchPageData, &page));
+    EXPECT_FALSE(page->is_dirty());
+    EXPECT_EQ(store->init_transaction(), page->transaction());
+    EXPECT_EQ(i, page->page_id());
+    EXPECT_EQ(0, std::memcmp(page->data(),
+                             buffer.data() + (i << kStorePageShift),
+                             1 << kStorePageShift));
+    EXPECT_EQ(1U, page_pool->pinned_pages());
+    page_pool->UnpinStorePage(page);
+  }
+  EXPECT_EQ(read_count + 5, data_file_wrapper.read_count());
+  EXPECT_EQ(misses + 5, page_pool->miss_count());
+  EXPECT_EQ(4U + 8U + 16U + 7U, page_pool->readahead_count());
+  EXPECT_EQ(40U, page_pool->allocated_pages());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, StorePageReadaheadStopsAtCachedPages) {
+  std::vector<uint8_t> buffer(16 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreatePool(kStorePageShift, 64);
+  PagePool* page_pool = pool_->page_pool();
+  BlockAccessFileWrapper data_file_wrapper(data_file1_.release());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file_wrapper, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  for (size_t i = 0; i < 16; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  // Misses on pages that are not consecutive do not read ahead.
+  for (size_t page_id : {9, 5, 12, 10, 1})
+    TouchStorePage(store.get(), page_id);
+  EXPECT_EQ(0U, page_pool->readahead_count());
+
+  // The cached copy of page 5 may be newer than the one in the data file, so
+  // the run read by page 2 stops before it.
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 5, PagePool::kFetchPageData, &page));
+  transaction->WillModifyPage(page);
+  std::memset(page->data(), 0x42, 1 << kStorePageShift);
+  page_pool->UnpinStorePage(page);
+
+  size_t read_count = data_file_wrapper.read_count();
+  TouchStorePage(store.get(), 2);
+  EXPECT_EQ(read_count + 1, data_file_wrapper.read_count());
+  EXPECT_EQ(2U, page_pool->readahead_count());
+  TouchStorePage(store.get(), 3);
+  TouchStorePage(store.get(), 4);
+  EXPECT_EQ(read_count + 1, data_file_wrapper.read_count());
+
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 5, PagePool::kFetchPageData, &page));
+  EXPECT_TRUE(page->is_dirty());
+  EXPECT_EQ(transaction.get(), page->transaction());
+  EXPECT_EQ(0x42, page->data()[0]);
+  page_pool->UnpinStorePage(page);
+  ASSERT_EQ(Status::kSuccess, transaction->Rollback());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, Prefetch) {
+  std::vector<uint8_t> buffer(12 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreatePool(kStorePageShift, 16);
+  PagePool* page_pool = pool_->page_pool();
+  BlockAccessFileWrapper data_file_wrapper(data_file1_.release());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file_wrapper, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  for (size_t i = 0; i < 12; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+  TouchStorePage(store.get(), 4);
+
+  // Page 4 is cached, so pages 3, 5, 6, and 9 are read. Page 100 is past the
+  // end of the store.
+  size_t read_count = data_file_wrapper.read_count();
+  size_t misses = page_pool->miss_count();
+  size_t page_ids[] = {9, 3, 5, 100, 6, 3, 4};
+  page_pool->Prefetch(store.get(), page_ids, 7);
+  EXPECT_EQ(4U, page_pool->readahead_count());
+  EXPECT_EQ(misses, page_pool->miss_count());
+  EXPECT_EQ(5U, page_pool->allocated_pages());
+
+  // The reads are collected by the StorePage() calls that need the pages.
+  for (size_t page_id : {3, 5, 6, 9}) {
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), page_id, PagePool::kFetchPageData, &page));
+    EXPECT_FALSE(page->is_dirty());
+    EXPECT_EQ(store->init_transaction(), page->transaction());
+    EXPECT_EQ(page_id, page->page_id());
+    EXPECT_EQ(0, std::memcmp(page->data(),
+                             buffer.data() + (page_id << kStorePageShift),
+                             1 << kStorePageShift));
+    page_pool->UnpinStorePage(page);
+  }
+  EXPECT_EQ(read_count + 4, data_file_wrapper.read_count());
+  EXPECT_EQ(misses, page_pool->miss_count());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  // Failed reads do not leave garbage in the pool.
+  data_file_wrapper.SetAccessError(Status::kIoError);
+  size_t failed_page_ids[] = {10, 11};
+  page_pool->Prefetch(store.get(), failed_page_ids, 2);
+  Page* page;
+  EXPECT_EQ(Status::kIoError, page_pool->StorePage(
+      store.get(), 10, PagePool::kFetchPageData, &page));
+  data_file_wrapper.SetAccessError(Status::kSuccess);
+  for (size_t page_id : {10, 11}) {
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), page_id, PagePool::kFetchPageData, &page));
+    EXPECT_EQ(0, std::memcmp(page->data(),
+                             buffer.data() + (page_id << kStorePageShift),
+                             1 << kStorePageShift));
+    page_pool->UnpinStorePage(page);
+  }
+
+  // Closing the store collects the reads that no page fetch needed.
+  page_pool->Prefetch(store.get(), failed_page_ids, 2);
+  size_t more_page_ids[] = {0, 1, 2};
+  page_pool->Prefetch(store.get(), more_page_ids, 3);
+  EXPECT_EQ(Status::kSuccess, store->Close());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, PrefetchDoesNotWaitForReads) {
+  std::vector<uint8_t> buffer(8 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreatePool(kStorePageShift, 16);
+  PagePool* page_pool = pool_->page_pool();
+  GatedBlockAccessFile data_file(data_file1_.release(), 5 << kStorePageShift);
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 8; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  size_t misses = page_pool->miss_count();
+  size_t page_ids[] = {5};
+  page_pool->Prefetch(store.get(), page_ids, 1);
+  data_file.WaitForGatedTransfer();
+  // The read holds the prefetch pin until it is collected.
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+
+  data_file.Open();
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 5, PagePool::kFetchPageData, &page));
+  EXPECT_EQ(0, std::memcmp(page->data(),
+                           buffer.data() + (5 << kStorePageShift),
+                           1 << kStorePageShift));
+  page_pool->UnpinStorePage(page);
+  EXPECT_EQ(misses, page_pool->miss_count());
+  EXPECT_EQ(1U, data_file.gated_transfers());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, MultiThreadedEvictsAcrossShards) {
+  uint8_t buffer[4 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreateMultiThreadedPool(kStorePageShift, 2, 8);
+  PagePool* page_pool = pool_->page_pool();
+  EXPECT_EQ(8U, page_pool->shard_count());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  for (size_t i = 0; i < 4; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  // The pool has fewer pages than shards, so most shards must evict pages
+  // cached by other shards.
+  for (size_t round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < 4; ++i) {
+      Page* page;
+      ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+          store.get(), i, PagePool::kFetchPageData, &page));
+      EXPECT_EQ(i, page->page_id());
+      EXPECT_EQ(0, std::memcmp(page->data(), buffer + (i << kStorePageShift),
+                               1 << kStorePageShift));
+      EXPECT_EQ(1U, page_pool->pinned_pages());
+      page_pool->UnpinStorePage(page);
+    }
+  }
+  EXPECT_EQ(2U, page_pool->allocated_pages());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  Page* pages[4];
+  size_t page_ids[4] = {0, 1, 2, 3};
+  EXPECT_EQ(Status::kPoolFull, page_pool->StorePages(
+      store.get(), page_ids, 4, pages));
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePages(
+      store.get(), page_ids + 2, 2, pages));
+  for (size_t i = 0; i < 2; ++i) {
+    EXPECT_EQ(i + 2, pages[i]->page_id());
+    EXPECT_EQ(0, std::memcmp(pages[i]->data(),
+                             buffer + ((i + 2) << kStorePageShift),
+                             1 << kStorePageShift));
+    page_pool->UnpinStorePage(pages[i]);
+  }
+}
+
+TEST_F(PagePoolTest, MultiThreadedShardTablesGrow) {
+  uint8_t buffer[8 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreateMultiThreadedPool(kStorePageShift, 8, 8);
+  PagePool* page_pool = pool_->page_pool();
+  EXPECT_EQ(8U, page_pool->shard_count());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  for (size_t i = 0; i < 8; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  // Each shard's table starts out with room for one page, so pinning all the
+  // pool's pages makes the shards that cache several pages grow their tables.
+  Page* pages[8];
+  size_t page_ids[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePages(
+      store.get(), page_ids, 8, pages));
+  EXPECT_EQ(8U, page_pool->pinned_pages());
+  for (size_t i = 0; i < 8; ++i) {
+    EXPECT_EQ(i, pages[i]->page_id());
+    EXPECT_EQ(0, std::memcmp(pages[i]->data(), buffer + (i << kStorePageShift),
+                             1 << kStorePageShift));
+    page_pool->UnpinStorePage(pages[i]);
+  }
+
+  for (size_t i = 0; i < 8; ++i) {
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), i, PagePool::kFetchPageData, &page));
+    EXPECT_EQ(pages[i], page);
+    page_pool->UnpinStorePage(page);
+  }
+  EXPECT_EQ(8U, page_pool->allocated_pages());
+}
+
+TEST_F(PagePoolTest, MultiThreadedStorePage) {
+  CheckMultiThreadedStorePage(PoolOptions());
+}
+
+TEST_F(PagePoolTest, MultiThreadedFrameTableStorePage) {
+  PoolOptions options;
+  options.page_eviction_policy = PageEvictionPolicy::kClock;
+  options.page_pool_frame_table = true;
+  CheckMultiThreadedStorePage(options);
+}
+
+TEST_F(PagePoolTest, MultiThreadedReadahead) {
+  constexpr size_t kPageCount = 128;
+  constexpr size_t kThreadCount = 4;
+  std::vector<uint8_t> buffer(kPageCount << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  // The pool cannot hold all the pages, so read ahead pages get evicted.
+  CreateMultiThreadedPool(kStorePageShift, kPageCount / 2, 4);
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  for (size_t i = 0; i < kPageCount; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  // Each thread scans the store sequentially, starting at a different page.
+  std::atomic<size_t> failures(0);
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kThreadCount; ++thread) {
+    threads.emplace_back([&, thread]() {
+      for (size_t i = 0; i < 4 * kPageCount; ++i) {
+        size_t page_id = (thread * kPageCount / kThreadCount + i) % kPageCount;
+        Page* page;
+        if (page_pool->StorePage(store.get(), page_id,
+                                 PagePool::kFetchPageData,
+                                 &page) != Status::kSuccess) {
+          ++failures;
+          continue;
+        }
+        if (page->page_id() != page_id || std::memcmp(
+            page->data(), buffer.data() + (page_id << kStorePageShift),
+            1 << kStorePageShift) != 0) {
+          ++failures;
+        }
+        page_pool->UnpinStorePage(page);
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(0U, failures.load());
+  EXPECT_LT(0U, page_pool->readahead_count());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, MultiThreadedPrefetch) {
+  constexpr size_t kPageCount = 64;
+  constexpr size_t kThreadCount = 4;
+  std::vector<uint8_t> buffer(kPageCount << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  // The pool cannot hold all the pages, so prefetched pages get evicted.
+  CreateMultiThreadedPool(kStorePageShift, kPageCount / 2, 4);
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  for (size_t i = 0; i < kPageCount; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  // Each thread prefetches a few pages, and then fetches them.
+  std::atomic<size_t> failures(0);
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kThreadCount; ++thread) {
+    threads.emplace_back([&, thread]() {
+      std::mt19937 rnd(static_cast<uint32_t>(thread));
+      for (size_t round = 0; round < 64; ++round) {
+        size_t page_ids[3];
+        for (size_t& page_id : page_ids)
+          page_id = rnd() % kPageCount;
+        page_pool->Prefetch(store.get(), page_ids, 3);
+
+        for (size_t page_id : page_ids) {
+          Page* page;
+          if (page_pool->StorePage(store.get(), page_id,
+                                   PagePool::kFetchPageData,
+                                   &page) != Status::kSuccess) {
+            ++failures;
+            continue;
+          }
+          if (page->page_id() != page_id || std::memcmp(
+              page->data(), buffer.data() + (page_id << kStorePageShift),
+              1 << kStorePageShift) != 0) {
+            ++failures;
+          }
+          page_pool->UnpinStorePage(page);
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(0U, failures.load());
+  EXPECT_LT(0U, page_pool->readahead_count());
+  ASSERT_EQ(Status::kSuccess, store->Close());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, MultiThreadedMissesDoNotWaitForReads) {
+  std::vector<uint8_t> buffer(8 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreateMultiThreadedPool(kStorePageShift, 16, 4);
+  PagePool* page_pool = pool_->page_pool();
+  GatedBlockAccessFile data_file(data_file1_.release(), 1 << kStorePageShift);
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 8; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  std::atomic<size_t> fetched_pages(0);
+  auto fetch_page1 = [&]() {
+    Page* page;
+    if (page_pool->StorePage(store.get(), 1, PagePool::kFetchPageData,
+                             &page) != Status::kSuccess) {
+      return;
+    }
+    if (std::memcmp(page->data(), buffer.data() + (1 << kStorePageShift),
+                    1 << kStorePageShift) == 0) {
+      ++fetched_pages;
+    }
+    page_pool->UnpinStorePage(page);
+  };
+  std::thread thread1(fetch_page1);
+  data_file.WaitForGatedTransfer();
+  // The second thread finds page 1 loading, and waits for the first thread.
+  std::thread thread2(fetch_page1);
+
+  // Misses on other pages are not held up by the read of page 1.
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 2, PagePool::kFetchPageData, &page));
+  EXPECT_EQ(0, std::memcmp(page->data(),
+                           buffer.data() + (2 << kStorePageShift),
+                           1 << kStorePageShift));
+  page_pool->UnpinStorePage(page);
+  EXPECT_EQ(0U, fetched_pages.load());
+
+  data_file.Open();
+  thread1.join();
+  thread2.join();
+  EXPECT_EQ(2U, fetched_pages.load());
+  EXPECT_EQ(1U, data_file.gated_transfers());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, MultiThreadedReadErrorsReachWaiters) {
+  std::vector<uint8_t> buffer(4 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreateMultiThreadedPool(kStorePageShift, 16, 4);
+  PagePool* page_pool = pool_->page_pool();
+  GatedBlockAccessFile data_file(data_file1_.release(), 1 << kStorePageShift);
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 4; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  std::atomic<size_t> failures(0);
+  auto fetch_page1 = [&]() {
+    Page* page;
+    if (page_pool->StorePage(store.get(), 1, PagePool::kFetchPageData,
+                             &page) != Status::kIoError) {
+      page_pool->UnpinStorePage(page);
+      return;
+    }
+    ++failures;
+  };
+  std::thread thread1(fetch_page1);
+  data_file.WaitForGatedTransfer();
+  std::thread thread2(fetch_page1);
+  data_file.SetAccessError(Status::kIoError);
+  data_file.Open();
+  thread1.join();
+  thread2.join();
+  EXPECT_EQ(2U, failures.load());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  // The failed reads do not leave garbage in the pool.
+  data_file.SetAccessError(Status::kSuccess);
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 1, PagePool::kFetchPageData, &page));
+  EXPECT_EQ(0, std::memcmp(page->data(),
+                           buffer.data() + (1 << kStorePageShift),
+                           1 << kStorePageShift));
+  page_pool->UnpinStorePage(page);
+}
+
+TEST_F(PagePoolTest, MultiThreadedMappedStorePage) {
+  constexpr size_t kPageCount = 16;
+  constexpr size_t kThreadCount = 4;
+  std::vector<uint8_t> buffer(kPageCount << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+  ASSERT_EQ(Status::kSuccess, data_file1_->Write(
+      buffer.data(), 0, buffer.size()));
+
+  // The pool has room for a single page, and mapped pages do not use it.
+  CreateMultiThreadedPool(kStorePageShift, 1, 4);
+  PagePool* page_pool = pool_->page_pool();
+  StoreOptions options;
+  options.memory_mapped = true;
+  options.mapping_advice = MappingAdvice::kRandom;
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), buffer.size(), log_file1_.release(),
+      log_file1_size_, page_pool, options));
+  ASSERT_EQ(Status::kSuccess, store->Initialize(options));
+  ASSERT_TRUE(store->is_mapped());
+
+  // The threads race to create the pages' control blocks.
+  std::atomic<size_t> failures(0);
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kThreadCount; ++thread) {
+    threads.emplace_back([&, thread]() {
+      std::mt19937 rnd(static_cast<uint32_t>(thread));
+      for (size_t i = 0; i < 1000; ++i) {
+        size_t page_id = rnd() % kPageCount;
+        Page* page;
+        if (page_pool->StorePage(store.get(), page_id,
+                                 PagePool::kFetchPageData,
+                                 &page) != Status::kSuccess) {
+          ++failures;
+          continue;
+        }
+        if (!page->is_mapped() || page->page_id() != page_id ||
+            std::memcmp(page->data(),
+                        buffer.data() + (page_id << kStorePageShift),
+                        1 << kStorePageShift) != 0) {
+          ++failures;
+        }
+        page_pool->UnpinStorePage(page);
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+  EXPECT_EQ(0U, failures.load());
+
+  // Batched fetches and prefetches also bypass the pool.
+  size_t page_ids[] = {9, 3, 5, 100, 6, 3, 4};
+  page_pool->Prefetch(store.get(), page_ids, 7);
+  Page* pages[3];
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePages(
+      store.get(), page_ids, 3, pages));
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(page_ids[i], pages[i]->page_id());
+    EXPECT_EQ(store->init_transaction(), pages[i]->transaction());
+    page_pool->UnpinStorePage(pages[i]);
+  }
+  Page* page;
+  EXPECT_EQ(Status::kIoError, page_pool->StorePage(
+      store.get(), kPageCount, PagePool::kFetchPageData, &page));
+  EXPECT_EQ(Status::kIoError, page_pool->StorePages(
+      store.get(), page_ids, 4, pages));
+
+  EXPECT_EQ(0U, page_pool->allocated_pages());
+  EXPECT_EQ(0U, page_pool->miss_count());
+  EXPECT_EQ(0U, page_pool->readahead_count());
+  ASSERT_EQ(Status::kSuccess, store->Close());
+}
+
+TEST_F(PagePoolTest, MultiThreadedSetPageCapacity) {
+  constexpr size_t kPageCount = 16;
+  constexpr size_t kThreadCount = 4;
+  std::vector<uint8_t> buffer(kPageCount << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreateMultiThreadedPool(kStorePageShift, kPageCount / 2, 4);
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < kPageCount; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  // The pool is resized while the threads fetch pages. Each thread pins at
+  // most one page, so the pool can always serve the fetches.
+  std::atomic<size_t> failures(0);
+  std::atomic<bool> done(false);
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kThreadCount; ++thread) {
+    threads.emplace_back([&, thread]() {
+      std::mt19937 rnd(static_cast<uint32_t>(thread));
+      while (!done.load()) {
+        size_t page_id = rnd() % kPageCount;
+        Page* page;
+        if (page_pool->StorePage(store.get(), page_id,
+                                 PagePool::kFetchPageData,
+                                 &page) != Status::kSuccess) {
+          ++failures;
+          continue;
+        }
+        if (page->page_id() != page_id || std::memcmp(
+            page->data(), buffer.data() + (page_id << kStorePageShift),
+            1 << kStorePageShift) != 0) {
+          ++failures;
+        }
+        page_pool->UnpinStorePage(page);
+      }
+    });
+  }
+  for (size_t i = 0; i < 200; ++i) {
+    EXPECT_EQ(Status::kSuccess, page_pool->SetPageCapacity(
+        (i % 2 == 0) ? kThreadCount : kPageCount));
+    std::this_thread::yield();
+  }
+  done.store(true);
+  for (std::thread& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(0U, failures.load());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+  EXPECT_EQ(kPageCount, page_pool->page_capacity());
+}
+
+TEST_F(PagePoolTest, ClockGivesReferencedPagesSecondChance) {
+  uint8_t buffer[5 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreatePool(kStorePageShift, 3, PageEvictionPolicy::kClock);
+  PagePool* page_pool = pool_->page_pool();
+  EXPECT_EQ(PageEvictionPolicy::kClock, page_pool->eviction_policy());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 5; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  for (size_t i = 0; i < 3; ++i)
+    TouchStorePage(store.get(), i);
+  // All the pages are referenced, so the hand clears all the reference bits
+  // and comes back to page 0.
+  TouchStorePage(store.get(), 3);
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  // Page 1 is used again, so it survives the next eviction, unlike page 2.
+  size_t misses = page_pool->miss_count();
+  TouchStorePage(store.get(), 1);
+  EXPECT_EQ(misses, page_pool->miss_count());
+  TouchStorePage(store.get(), 4);
+  EXPECT_EQ(misses + 1, page_pool->miss_count());
+
+  size_t hits = page_pool->hit_count();
+  TouchStorePage(store.get(), 1);
+  TouchStorePage(store.get(), 3);
+  TouchStorePage(store.get(), 4);
+  EXPECT_EQ(hits + 3, page_pool->hit_count());
+  EXPECT_EQ(misses + 1, page_pool->miss_count());
+  TouchStorePage(store.get(), 2);
+  EXPECT_EQ(misses + 2, page_pool->miss_count());
+}
+
+TEST_F(PagePoolTest, ClockSkipsPinnedAndDiscardedPages) {
+  uint8_t buffer[4 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreatePool(kStorePageShift, 2, PageEvictionPolicy::kClock);
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 4; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  Page* page0;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 0, PagePool::kFetchPageData, &page0));
+  TouchStorePage(store.get(), 1);
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+
+  // Page 0 is pinned, so page 1 is evicted, even though it is referenced.
+  TouchStorePage(store.get(), 2);
+  EXPECT_EQ(0, std::memcmp(page0->data(), buffer, 1 << kStorePageShift));
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+
+  // Pages unpinned with kDiscardPage lose their second chance.
+  page_pool->UnpinStorePage(page0, PagePool::kDiscardPage);
+  TouchStorePage(store.get(), 2);
+  size_t misses = page_pool->miss_count();
+  TouchStorePage(store.get(), 3);
+  TouchStorePage(store.get(), 2);
+  EXPECT_EQ(misses + 1, page_pool->miss_count());
+  TouchStorePage(store.get(), 0);
+  EXPECT_EQ(misses + 2, page_pool->miss_count());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  // All the pages are pinned.
+  Page* pages[2];
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 0, PagePool::kFetchPageData, &pages[0]));
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 2, PagePool::kFetchPageData, &pages[1]));
+  Page* page;
+  EXPECT_EQ(Status::kPoolFull, page_pool->StorePage(
+      store.get(), 1, PagePool::kFetchPageData, &page));
+  page_pool->UnpinStorePage(pages[0]);
+  page_pool->UnpinStorePage(pages[1]);
+}
+
+TEST_F(PagePoolTest, TwoQueueAdmitsPagesUsedTwice) {
+  uint8_t buffer[10 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  // The probation queue holds 1 page, and the ghost list remembers 2 pages.
+  CreatePool(kStorePageShift, 4, PageEvictionPolicy::kTwoQueue);
+  PagePool* page_pool = pool_->page_pool();
+  EXPECT_EQ(PageEvictionPolicy::kTwoQueue, page_pool->eviction_policy());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 10; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  for (size_t i = 0; i < 4; ++i)
+    TouchStorePage(store.get(), i);
+  // Page 0 is evicted from probation. Its second use puts it in the main queue.
+  TouchStorePage(store.get(), 4);
+  size_t misses = page_pool->miss_count();
+  TouchStorePage(store.get(), 0);
+  EXPECT_EQ(misses + 1, page_pool->miss_count());
+
+  // Pages used once do not push page 0 out of the pool, even though they were
+  // used more recently.
+  for (size_t i = 5; i < 10; ++i)
+    TouchStorePage(store.get(), i);
+  EXPECT_EQ(misses + 6, page_pool->miss_count());
+  size_t hits = page_pool->hit_count();
+  TouchStorePage(store.get(), 0);
+  EXPECT_EQ(hits + 1, page_pool->hit_count());
+  EXPECT_EQ(misses + 6, page_pool->miss_count());
+
+  // Repeated uses of a probation page do not promote it to the main queue.
+  TouchStorePage(store.get(), 9);
+  TouchStorePage(store.get(), 9);
+  TouchStorePage(store.get(), 1);
+  TouchStorePage(store.get(), 2);
+  TouchStorePage(store.get(), 3);
+  EXPECT_EQ(misses + 9, page_pool->miss_count());
+  TouchStorePage(store.get(), 0);
+  EXPECT_EQ(misses + 9, page_pool->miss_count());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(PagePoolTest, TwoQueueSkipsPinnedAndDiscardedPages) {
+  uint8_t buffer[4 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreatePool(kStorePageShift, 2, PageEvictionPolicy::kTwoQueue);
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 4; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  Page* page0;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 0, PagePool::kFetchPageData, &page0));
+  TouchStorePage(store.get(), 1);
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+
+  // Page 0 is older, but it is pinned, so page 1 is evicted.
+  TouchStorePage(store.get(), 2);
+  EXPECT_EQ(0, std::memcmp(page0->data(), buffer, 1 << kStorePageShift));
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+
+  // Pages unpinned with kDiscardPage are evicted first.
+  page_pool->UnpinStorePage(page0, PagePool::kDiscardPage);
+  TouchStorePage(store.get(), 3);
+  size_t misses = page_pool->miss_count();
+  TouchStorePage(store.get(), 2);
+  TouchStorePage(store.get(), 3);
+  EXPECT_EQ(misses, page_pool->miss_count());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  // All the pages are pinned.
+  Page* pages[2];
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 2, PagePool::kFetchPageData, &pages[0]));
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 3, PagePool::kFetchPageData, &pages[1]));
+  Page* page;
+  EXPECT_EQ(Status::kPoolFull, page_pool->StorePage(
+      store.get(), 1, PagePool::kFetchPageData, &page));
+  page_pool->UnpinStorePage(pages[0]);
+  page_pool->UnpinStorePage(pages[1]);
+}
+
+TEST_F(PagePoolTest, FrameTableClockSweep) {
+  uint8_t buffer[5 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  PoolOptions options;
+  options.page_shift = kStorePageShift;
+  options.page_pool_size = 3;
+  options.page_eviction_policy = PageEvictionPolicy::kClock;
+  options.page_pool_frame_table = true;
+  pool_.reset(PoolImpl::Create(options));
+  PagePool* page_pool = pool_->page_pool();
+  EXPECT_TRUE(page_pool->uses_frame_table());
+  EXPECT_FALSE(page_pool->uses_slabs());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 5; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  for (size_t i = 0; i < 3; ++i)
+    TouchStorePage(store.get(), i);
+  // All the pages are referenced, so the hand clears all the reference bits
+  // and comes back to the first frame, which holds page 0.
+  TouchStorePage(store.get(), 3);
+
+  // Page 1 is used again, so it survives the next eviction, unlike page 2.
+  size_t misses = page_pool->miss_count();
+  TouchStorePage(store.get(), 1);
+  TouchStorePage(store.get(), 4);
+  EXPECT_EQ(misses + 1, page_pool->miss_count());
+  TouchStorePage(store.get(), 1);
+  TouchStorePage(store.get(), 3);
+  TouchStorePage(store.get(), 4);
+  EXPECT_EQ(misses + 1, page_pool->miss_count());
+
+  // The sweep skips pinned pages, and fails if all pages are pinned.
+  Page* pages[3];
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), i + 2, PagePool::kFetchPageData, &pages[i]));
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(pages[i]->data()) &
+                  ((1 << kStorePageShift) - 1));
+    EXPECT_EQ(0, std::memcmp(
+        pages[i]->data(), buffer + ((i + 2) << kStorePageShift),
+        1 << kStorePageShift));
+  }
+  EXPECT_EQ(3U, page_pool->pinned_pages());
+  Page* page;
+  EXPECT_EQ(Status::kPoolFull, page_pool->StorePage(
+      store.get(), 0, PagePool::kFetchPageData, &page));
+  for (size_t i = 0; i < 3; ++i)
+    page_pool->UnpinStorePage(pages[i]);
+  EXPECT_EQ(3U, page_pool->allocated_pages());
+}
+
+TEST_F(PagePoolTest, CleanPagesWritesNextVictims) {
+  uint8_t buffer[6 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  PoolOptions options;
+  options.page_shift = kStorePageShift;
+  options.page_pool_size = 4;
+  options.page_pool_clean_fraction = 0.5;
+  pool_.reset(PoolImpl::Create(options));
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 6; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+
+  // Pages 1-4 are modified in this order, so the LRU list is 1, 2, 3, 4.
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* pages[4];
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), i + 1, PagePool::kFetchPageData, &pages[i]));
+    transaction->WillModifyPage(pages[i]);
+    std::memset(pages[i]->data(), static_cast<int>(i + 1),
+                1 << kStorePageShift);
+    page_pool->UnpinStorePage(pages[i]);
+  }
+
+  // The cleaner looks at the 2 pages that would be evicted next.
+  EXPECT_EQ(2U, page_pool->CleanPages());
+  EXPECT_EQ(2U, page_pool->background_write_count());
+  EXPECT_FALSE(pages[0]->is_dirty());
+  EXPECT_FALSE(pages[1]->is_dirty());
+  EXPECT_TRUE(pages[2]->is_dirty());
+  EXPECT_TRUE(pages[3]->is_dirty());
+  EXPECT_EQ(store->init_transaction(), pages[0]->transaction());
+  EXPECT_EQ(transaction.get(), pages[2]->transaction());
+
+  // The cleaned pages kept their places in the LRU list, so they are evicted
+  // first, without being written again.
+  TouchStorePage(store.get(), 0);
+  TouchStorePage(store.get(), 5);
+  EXPECT_EQ(0U, page_pool->foreground_write_count());
+  TouchStorePage(store.get(), 1);
+  EXPECT_EQ(1U, page_pool->foreground_write_count());
+
+  // The cleaned page was read back from the store.
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 2, PagePool::kFetchPageData, &page));
+  uint8_t expected[1 << kStorePageShift];
+  std::memset(expected, 2, sizeof(expected));
+  EXPECT_EQ(0, std::memcmp(expected, page->data(), sizeof(expected)));
+  page_pool->UnpinStorePage(page);
+  EXPECT_EQ(2U, page_pool->background_write_count());
+
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+}
+
+TEST_F(PagePoolTest, CleanPagesWriteErrorKeepsPagesDirty) {
+  PoolOptions options;
+  options.page_shift = kStorePageShift;
+  options.page_pool_size = 4;
+  options.page_pool_clean_fraction = 1;
+  pool_.reset(PoolImpl::Create(options));
+  PagePool* page_pool = pool_->page_pool();
+  BlockAccessFileWrapper data_file_wrapper(data_file1_.release());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file_wrapper, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* pages[2];
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), i, PagePool::kIgnorePageData, &pages[i]));
+    transaction->WillModifyPage(pages[i]);
+    std::memset(pages[i]->data(), static_cast<int>(i + 1),
+                1 << kStorePageShift);
+    page_pool->UnpinStorePage(pages[i]);
+  }
+
+  // The cleaner does not close the store, and leaves the pages dirty.
+  data_file_wrapper.SetAccessError(Status::kIoError);
+  EXPECT_EQ(0U, page_pool->CleanPages());
+  EXPECT_TRUE(store->has_write_error());
+  EXPECT_FALSE(store->IsClosed());
+  for (size_t i = 0; i < 2; ++i) {
+    EXPECT_TRUE(pages[i]->is_dirty());
+    EXPECT_EQ(transaction.get(), pages[i]->transaction());
+    EXPECT_TRUE(pages[i]->IsUnpinned());
+    EXPECT_FALSE(pages[i]->is_loading());
+  }
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+  EXPECT_EQ(0U, page_pool->background_write_count());
+
+  // The failed store's pages are not written again.
+  data_file_wrapper.SetAccessError(Status::kSuccess);
+  EXPECT_EQ(0U, page_pool->CleanPages());
+
+  // The error is reported by the next commit.
+  EXPECT_EQ(Status::kIoError, transaction->Commit());
+  EXPECT_TRUE(store->IsClosed());
+  EXPECT_TRUE(transaction->IsClosed());
+}
+
+TEST_F(PagePoolTest, EvictionWriteErrorFlagsStore) {
+  PoolOptions options;
+  options.page_shift = kStorePageShift;
+  options.page_pool_size = 1;
+  options.page_pool_clean_fraction = 0;
+  pool_.reset(PoolImpl::Create(options));
+  PagePool* page_pool = pool_->page_pool();
+  BlockAccessFileWrapper data_file_wrapper(data_file1_.release());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file_wrapper, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 0, PagePool::kIgnorePageData, &page));
+  transaction->WillModifyPage(page);
+  std::memset(page->data(), 1, 1 << kStorePageShift);
+  page_pool->UnpinStorePage(page);
+
+  // Like the cleaner, the eviction does not close the store.
+  data_file_wrapper.SetAccessError(Status::kIoError);
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 1, PagePool::kIgnorePageData, &page));
+  EXPECT_EQ(1U, page_pool->foreground_write_count());
+  EXPECT_TRUE(store->has_write_error());
+  EXPECT_FALSE(store->IsClosed());
+  page_pool->UnpinStorePage(page);
+
+  // The error is reported by the next commit.
+  data_file_wrapper.SetAccessError(Status::kSuccess);
+  EXPECT_EQ(Status::kIoError, transaction->Commit());
+  EXPECT_TRUE(store->IsClosed());
+  EXPECT_TRUE(transaction->IsClosed());
+}
+
+TEST_F(PagePoolTest, CleanPagesSkipsPinnedPages) {
+  uint8_t buffer[3 << kStorePageShift];
+  for(size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  PoolOptions options;
+  options.page_shift = kStorePageShift;
+  options.page_pool_size = 3;
+  options.page_eviction_policy = PageEvictionPolicy::kClock;
+  options.page_pool_frame_table = true;
+  options.page_pool_clean_fraction = 1;
+  pool_.reset(PoolImpl::Create(options));
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  for (size_t i = 0; i < 3; ++i)
+    WriteStorePage(store.get(), i, buffer + (i << kStorePageShift));
+  EXPECT_EQ(0U, page_pool->CleanPages());
+
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* pages[3];
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), i, PagePool::kFetchPageData, &pages[i]));
+    transaction->WillModifyPage(pages[i]);
+  }
+  page_pool->UnpinStorePage(pages[0]);
+  page_pool->UnpinStorePage(pages[2]);
+
+  EXPECT_EQ(2U, page_pool->CleanPages());
+  EXPECT_FALSE(pages[0]->is_dirty());
+  EXPECT_TRUE(pages[1]->is_dirty());
+  EXPECT_FALSE(pages[2]->is_dirty());
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+  // The clean pages are not written again.
+  EXPECT_EQ(0U, page_pool->CleanPages());
+
+  page_pool->UnpinStorePage(pages[1]);
+  EXPECT_EQ(1U, page_pool->CleanPages());
+  EXPECT_EQ(3U, page_pool->background_write_count());
+  EXPECT_EQ(0U, page_pool->foreground_write_count());
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+}
+
+TEST_F(PagePoolTest, MultiThreadedMissesDoNotWaitForCleaning) {
+  std::vector<uint8_t> buffer(4 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  PoolOptions options;
+  options.page_pool_clean_fraction = 1;
+  CreateMultiThreadedPool(kStorePageShift, 16, 4, options);
+  PagePool* page_pool = pool_->page_pool();
+  GatedBlockAccessFile data_file(data_file1_.release(), 1 << kStorePageShift,
+                                 true);
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  // WriteStorePage() uses Write(), which is not held up.
+  for (size_t i = 0; i < 4; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 1, PagePool::kFetchPageData, &page));
+  transaction->WillModifyPage(page);
+  std::memset(page->data(), 1, 1 << kStorePageShift);
+  page_pool->UnpinStorePage(page);
+
+  // Either this thread or the background cleaner gets held up writing page 1.
+  std::thread cleaner([&]() { page_pool->CleanPages(); });
+  data_file.WaitForGatedTransfer();
+
+  // Misses are not held up by the cleaner's write.
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 3, PagePool::kFetchPageData, &page));
+  EXPECT_EQ(0, std::memcmp(page->data(),
+                           buffer.data() + (3 << kStorePageShift),
+                           1 << kStorePageShift));
+  page_pool->UnpinStorePage(page);
+
+  data_file.Open();
+  cleaner.join();
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 1, PagePool::kFetchPageData, &page));
+  uint8_t expected[1 << kStorePageShift];
+  std::memset(expected, 1, sizeof(expected));
+  EXPECT_EQ(0, std::memcmp(expected, page->data(), sizeof(expected)));
+  page_pool->UnpinStorePage(page);
+}
+
+TEST_F(PagePoolTest, MultiThreadedMissesDoNotWaitForCommits) {
+  std::vector<uint8_t> buffer(4 << kStorePageShift);
+  for(size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  PoolOptions options;
+  options.page_pool_clean_fraction = 1;
+  CreateMultiThreadedPool(kStorePageShift, 16, 4, options);
+  PagePool* page_pool = pool_->page_pool();
+  GatedBlockAccessFile data_file(data_file1_.release(), 1 << kStorePageShift,
+                                 true);
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file, data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+  // WriteStorePage() uses Write(), which is not held up.
+  for (size_t i = 0; i < 4; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* page;
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 1, PagePool::kFetchPageData, &page));
+  transaction->WillModifyPage(page);
+  std::memset(page->data(), 1, 1 << kStorePageShift);
+  page_pool->UnpinStorePage(page);
+
+  // Either this thread or the background cleaner gets held up writing page 1.
+  std::thread cleaner([&]() { page_pool->CleanPages(); });
+  data_file.WaitForGatedTransfer();
+
+  // The commit waits for the cleaner's write of page 1.
+  std::atomic<bool> committed(false);
+  Status commit_status = Status::kIoError;
+  std::thread committer([&]() {
+    commit_status = transaction->Commit();
+    committed.store(true);
+  });
+
+  // Misses are not held up while the commit waits.
+  for (size_t i = 0; i < 64; ++i) {
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), 4 + i, PagePool::kIgnorePageData, &page));
+    page_pool->UnpinStorePage(page);
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(committed.load());
+
+  data_file.Open();
+  cleaner.join();
+  committer.join();
+  ASSERT_EQ(Status::kSuccess, commit_status);
+
+  ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+      store.get(), 1, PagePool::kFetchPageData, &page));
+  uint8_t expected[1 << kStorePageShift];
+  std::memset(expected, 1, sizeof(expected));
+  EXPECT_EQ(0, std::memcmp(expected, page->data(), sizeof(expected)));
+  page_pool->UnpinStorePage(page);
+}
+
+TEST_F(PagePoolTest, MultiThreadedCleanerStorePage) {
+  constexpr size_t kThreadCount = 4;
+  constexpr size_t kThreadPageCount = 4;
+  constexpr size_t kPageCount = kThreadCount * kThreadPageCount;
+
+  PoolOptions options;
+  options.page_pool_clean_fraction = 0.5;
+  CreateMultiThreadedPool(kStorePageShift, kPageCount / 2, 4, options);
+  PagePool* page_pool = pool_->page_pool();
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      data_file1_.release(), data_file1_size_, log_file1_.release(),
+      log_file1_size_, page_pool, StoreOptions()));
+
+  std::vector<uint8_t> buffer(kPageCount << kStorePageShift, 0);
+  for (size_t i = 0; i < kPageCount; ++i)
+    WriteStorePage(store.get(), i, buffer.data() + (i << kStorePageShift));
+
+  // Each thread modifies its own pages, in its own transaction, while the
+  // cleaner and the evictions write them back.
+  std::vector<UniquePtr<TransactionImpl>> transactions(kThreadCount);
+  for (size_t thread = 0; thread < kThreadCount; ++thread)
+    transactions[thread].reset(store->CreateTransaction());
+  std::vector<uint8_t> page_values(kPageCount, 0);
+  std::atomic<size_t> failures(0);
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kThreadCount; ++thread) {
+    threads.emplace_back([&, thread]() {
+      std::mt19937 rnd(static_cast<uint32_t>(thread));
+      for (size_t i = 0; i < 500; ++i) {
+        size_t page_id = thread * kThreadPageCount + rnd() % kThreadPageCount;
+        Page* page;
+        if (page_pool->StorePage(store.get(), page_id,
+                                 PagePool::kFetchPageData,
+                                 &page) != Status::kSuccess) {
+          ++failures;
+          continue;
+        }
+        if (page->data()[0] != page_values[page_id])
+          ++failures;
+        page_values[page_id] = static_cast<uint8_t>(i);
+        transactions[thread]->WillModifyPage(page);
+        std::memset(page->data(), page_values[page_id], 1 << kStorePageShift);
+        page_pool->UnpinStorePage(page);
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+  EXPECT_EQ(0U, failures.load());
+
+  for (size_t thread = 0; thread < kThreadCount; ++thread)
+    ASSERT_EQ(Status::kSuccess, transactions[thread]->Commit());
+  for (size_t page_id = 0; page_id < kPageCount; ++page_id) {
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), page_id, PagePool::kFetchPageData, &page));
+    EXPECT_EQ(page_values[page_id], page->data()[kStorePageShift]);
+    page_pool->UnpinStorePage(page);
+  }
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+  EXPECT_LT(0U, page_pool->foreground_write_count() +
+                page_pool->background_write_count());
+}
+
 }  // namespace berrydb
@@ -0,0 +1,118 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./page_slabs.h"
+
+#include <algorithm>
+
+#include "./page.h"
+
+namespace berrydb {
+
+constexpr size_t PageSlabs::kSlabSize;
+
+PageSlabs::PageSlabs(size_t page_shift, bool use_huge_pages)
+    : page_shift_(page_shift), use_huge_pages_(use_huge_pages) {}
+
+PageSlabs::~PageSlabs() {
+  // The retired entries' memory is released with their slabs.
+  while (!retired_list_.empty())
+    retired_list_.pop_front();
+  for (const Slab& slab : slabs_)
+    ReleaseSlab(slab);
+}
+
+Page* PageSlabs::CreatePage(PagePool* page_pool, size_t max_new_pages) {
+  DCHECK_GT(max_new_pages, 0U);
+
+  if (!retired_list_.empty()) {
+    Page* page = retired_list_.front();
+    retired_list_.pop_front();
+    --SlabOf(page)->retired_pages;
+    return page;
+  }
+
+  if (slabs_.empty() || slabs_.back().used_pages == slabs_.back().page_count) {
+    // Pages larger than kSlabSize get a slab each.
+    size_t slab_pages = std::max(kSlabSize >> page_shift_,
+                                 static_cast<size_t>(1));
+    AddSlab(std::min(slab_pages, max_new_pages));
+  }
+
+  Slab& slab = slabs_.back();
+  void* control_block = reinterpret_cast<Page*>(slab.control_blocks) +
+                        slab.used_pages;
+  uint8_t* data = slab.data + (slab.used_pages << page_shift_);
+  ++slab.used_pages;
+  return Page::CreateAt(page_pool, control_block, data);
+}
+
+void PageSlabs::RetirePage(Page* page) {
+  DCHECK(page != nullptr);
+  DCHECK(!page->IsUnpinned());
+
+  Slab* slab = SlabOf(page);
+  DiscardAligned(page->data(), static_cast<size_t>(1) << page_shift_);
+  retired_list_.push_back(page);
+  ++slab->retired_pages;
+  if (slab->retired_pages != slab->used_pages)
+    return;
+
+  // The slab's entries are all in the retired list, so they can be dropped.
+  uint8_t* slab_end = slab->data + slab->data_size;
+  for (auto it = retired_list_.begin(); it != retired_list_.end(); ) {
+    Page* retired_page = *it;
+    ++it;
+    if (retired_page->data() >= slab->data && retired_page->data() < slab_end)
+      retired_list_.erase(retired_page);
+  }
+  ReleaseSlab(*slab);
+  slabs_.erase(slabs_.begin() + (slab - slabs_.data()));
+}
+
+size_t PageSlabs::page_capacity() const noexcept {
+  size_t page_capacity = 0;
+  for (const Slab& slab : slabs_)
+    page_capacity += slab.page_count;
+  return page_capacity;
+}
+
+void PageSlabs::AddSlab(size_t page_count) {
+  size_t page_size = static_cast<size_t>(1) << page_shift_;
+  size_t data_size = page_count << page_shift_;
+  size_t alignment = page_size;
+  if (use_huge_pages_) {
+    // Huge pages are only used for whole, aligned huge page ranges.
+    data_size = (data_size + kSlabSize - 1) & ~(kSlabSize - 1);
+    alignment = std::max(alignment, kSlabSize);
+  }
+
+  Slab slab;
+  slab.control_blocks = Allocate(sizeof(Page) * page_count);
+  slab.data = reinterpret_cast<uint8_t*>(
+      AllocateAligned(data_size, alignment, use_huge_pages_));
+  slab.data_size = data_size;
+  slab.page_count = page_count;
+  slab.used_pages = 0;
+  slab.retired_pages = 0;
+  slabs_.push_back(slab);
+}
+
+PageSlabs::Slab* PageSlabs::SlabOf(Page* page) noexcept {
+  // Pools have few slabs, because each slab holds many entries.
+  Slab* slab = slabs_.data();
+  while (page->data() < slab->data ||
+         page->data() >= slab->data + slab->data_size) {
+    ++slab;
+    DCHECK(slab != slabs_.data() + slabs_.size());
+  }
+  return slab;
+}
+
+void PageSlabs::ReleaseSlab(const Slab& slab) noexcept {
+  Deallocate(slab.control_blocks, sizeof(Page) * slab.page_count);
+  DeallocateAligned(slab.data, slab.data_size);
+}
+
+}  // namespace berrydb
@@ -0,0 +1,119 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_PAGE_SLABS_H_
+#define BERRYDB_PAGE_SLABS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "berrydb/platform.h"
+#include "./page.h"
+#include "./util/linked_list.h"
+#include "./util/platform_allocator.h"
+
+namespace berrydb {
+
+class PagePool;
+
+/** Carves page pool entries out of large memory blocks (slabs).
+ *
+ * Each slab has a data block, which holds the buffers of many page pool
+ * entries, and a separate array of control blocks. Buffers are aligned to the
+ * page size, which is required for direct I/O, and adjacent buffers do not
+ * have control blocks between them, so large pages fit neatly in huge pages.
+ *
+ * Slabs are allocated as the pool grows. Entries cannot be freed one at a
+ * time, so entries dropped by a shrinking pool are retired instead. The memory
+ * behind a retired entry's data is returned to the OS, and retired entries are
+ * reused before new entries are carved out. A slab is released when all its
+ * entries are retired, and the remaining slabs are released when the pool is
+ * destroyed.
+ */
+class PageSlabs {
+ public:
+  /** The size of a slab's data block. This is a common huge page size. */
+  static constexpr size_t kSlabSize = 2 << 20;
+
+  /** Sets up an empty set of slabs.
+   *
+   * @param page_shift     log2 of the page pool's page size
+   * @param use_huge_pages if true, data blocks are backed by huge pages */
+  PageSlabs(size_t page_shift, bool use_huge_pages);
+  ~PageSlabs();
+
+  /** Sets up a page pool entry in the slabs, allocating a slab if needed.
+   *
+   * Retired entries are reused before new entries are set up.
+   *
+   * @param  page_pool      the pool that the entry will belong to
+   * @param  max_new_pages  upper bound for the number of entries that the pool
+   *                        will create, including this entry; caps the size of
+   *                        a new slab
+   * @return a page with one pin on it, owned by the caller */
+  Page* CreatePage(PagePool* page_pool, size_t max_new_pages);
+
+  /** Sets aside an entry that the pool does not need anymore.
+   *
+   * The entry's data is discarded. If all the entries in the entry's slab are
+   * retired, the slab is released.
+   *
+   * @param page an entry created by this instance, with one pin on it */
+  void RetirePage(Page* page);
+
+  /** Number of slabs allocated so far. */
+  inline size_t slab_count() const noexcept { return slabs_.size(); }
+
+  /** Number of entries that the allocated slabs can hold. */
+  size_t page_capacity() const noexcept;
+
+  /** Number of retired entries that have not been reused or released. */
+  inline size_t retired_pages() const noexcept {
+    return retired_list_.size();
+  }
+
+ private:
+  // Slabs cannot be copied or moved.
+  PageSlabs(const PageSlabs& other) = delete;
+  PageSlabs(PageSlabs&& other) = delete;
+  PageSlabs& operator=(const PageSlabs& other) = delete;
+  PageSlabs& operator=(PageSlabs&& other) = delete;
+
+  /** A large memory block holding page pool entries. */
+  struct Slab {
+    /** The control blocks of the slab's entries. */
+    void* control_blocks;
+    /** The data buffers of the slab's entries. */
+    uint8_t* data;
+    /** Size of the data block, in bytes. */
+    size_t data_size;
+    /** Number of entries that fit in the slab. */
+    size_t page_count;
+    /** Number of entries set up in the slab. */
+    size_t used_pages;
+    /** Number of the slab's entries that are in the retired list. */
+    size_t retired_pages;
+  };
+
+  /** Allocates a slab that fits the given number of entries. */
+  void AddSlab(size_t page_count);
+
+  /** The slab whose data block holds an entry's data. */
+  Slab* SlabOf(Page* page) noexcept;
+
+  /** Releases a slab's memory. The slab's entries must not be used anymore. */
+  void ReleaseSlab(const Slab& slab) noexcept;
+
+  const size_t page_shift_;
+  const bool use_huge_pages_;
+
+  std::vector<Slab, PlatformAllocator<Slab>> slabs_;
+  /** Retired entries, which are pinned, like newly created entries. */
+  LinkedList<Page> retired_list_;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_PAGE_SLABS_H_
@@ -0,0 +1,126 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./page_slabs.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/options.h"
+#include "./page.h"
+#include "./page_pool.h"
+#include "./pool_impl.h"
+#include "./util/unique_ptr.h"
+
+namespace berrydb {
+
+class PageSlabsTest : public ::testing::Test {
+ protected:
+  void CreatePool(int page_shift) {
+    PoolOptions options;
+    options.page_shift = page_shift;
+    options.page_pool_size = 16;
+    options.page_pool_slabs = true;
+    pool_.reset(PoolImpl::Create(options));
+  }
+
+  UniquePtr<PoolImpl> pool_;
+};
+
+TEST_F(PageSlabsTest, CarvesPagesOutOfSlabs) {
+  CreatePool(12);
+  PageSlabs slabs(12, false);
+  EXPECT_EQ(0U, slabs.slab_count());
+
+  Page* first_page = slabs.CreatePage(pool_->page_pool(), 10);
+  EXPECT_EQ(1U, slabs.slab_count());
+  EXPECT_EQ(10U, slabs.page_capacity());
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(first_page->data()) & 4095);
+  for (size_t i = 1; i < 10; ++i) {
+    Page* page = slabs.CreatePage(pool_->page_pool(), 10 - i);
+    EXPECT_EQ(first_page->data() + (i << 12), page->data());
+    EXPECT_FALSE(page->IsUnpinned());
+    std::memset(page->data(), static_cast<int>(i), 1 << 12);
+  }
+  EXPECT_EQ(1U, slabs.slab_count());
+
+  Page* page = slabs.CreatePage(pool_->page_pool(), 100000);
+  EXPECT_EQ(2U, slabs.slab_count());
+  // A slab holds up to kSlabSize bytes of page data.
+  EXPECT_EQ(10U + (PageSlabs::kSlabSize >> 12), slabs.page_capacity());
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(page->data()) & 4095);
+
+  // Slabs do not exceed the number of pages that the pool will need.
+  slabs.CreatePage(pool_->page_pool(), 10000);
+  for (size_t i = 2; i < (PageSlabs::kSlabSize >> 12); ++i)
+    slabs.CreatePage(pool_->page_pool(), 3);
+  EXPECT_EQ(2U, slabs.slab_count());
+  slabs.CreatePage(pool_->page_pool(), 3);
+  EXPECT_EQ(3U, slabs.slab_count());
+  EXPECT_EQ(13U + (PageSlabs::kSlabSize >> 12), slabs.page_capacity());
+}
+
+TEST_F(PageSlabsTest, RetiresPages) {
+  CreatePool(12);
+  PageSlabs slabs(12, false);
+  Page* pages[4];
+  for (size_t i = 0; i < 4; ++i) {
+    pages[i] = slabs.CreatePage(pool_->page_pool(), 4 - i);
+    std::memset(pages[i]->data(), 0xAB, 1 << 12);
+  }
+  Page* page = slabs.CreatePage(pool_->page_pool(), 1);
+  EXPECT_EQ(2U, slabs.slab_count());
+
+  slabs.RetirePage(pages[1]);
+  EXPECT_EQ(1U, slabs.retired_pages());
+  EXPECT_EQ(2U, slabs.slab_count());
+#if defined(__linux__)
+  // The retired entry's data was returned to the OS.
+  for (size_t i = 0; i < (1 << 12); ++i)
+    ASSERT_EQ(0, pages[1]->data()[i]);
+#endif  // defined(__linux__)
+
+  // Retired entries are reused before new entries are set up.
+  EXPECT_EQ(pages[1], slabs.CreatePage(pool_->page_pool(), 1));
+  EXPECT_EQ(0U, slabs.retired_pages());
+  EXPECT_EQ(2U, slabs.slab_count());
+
+  // A slab is released when all its entries are retired.
+  for (size_t i = 0; i < 3; ++i)
+    slabs.RetirePage(pages[i]);
+  EXPECT_EQ(3U, slabs.retired_pages());
+  EXPECT_EQ(2U, slabs.slab_count());
+  slabs.RetirePage(pages[3]);
+  EXPECT_EQ(0U, slabs.retired_pages());
+  EXPECT_EQ(1U, slabs.slab_count());
+  EXPECT_EQ(1U, slabs.page_capacity());
+
+  slabs.RetirePage(page);
+  EXPECT_EQ(0U, slabs.slab_count());
+  EXPECT_EQ(0U, slabs.page_capacity());
+}
+
+TEST_F(PageSlabsTest, LargePages) {
+  CreatePool(22);
+  PageSlabs slabs(22, false);
+  Page* page1 = slabs.CreatePage(pool_->page_pool(), 2);
+  Page* page2 = slabs.CreatePage(pool_->page_pool(), 1);
+  EXPECT_EQ(2U, slabs.slab_count());
+  EXPECT_EQ(2U, slabs.page_capacity());
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(page1->data()) & ((1 << 22) - 1));
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(page2->data()) & ((1 << 22) - 1));
+}
+
+TEST_F(PageSlabsTest, HugePages) {
+  CreatePool(12);
+  PageSlabs slabs(12, true);
+  Page* page = slabs.CreatePage(pool_->page_pool(), 1);
+  EXPECT_EQ(1U, slabs.page_capacity());
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(page->data()) &
+                (PageSlabs::kSlabSize - 1));
+  std::memset(page->data(), 0, 1 << 12);
+}
+
+}  // namespace berrydb
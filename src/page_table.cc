@@ -0,0 +1,123 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./page_table.h"
+
+namespace berrydb {
+
+constexpr size_t PageTable::kGroupSize;
+constexpr uint8_t PageTable::kEmpty;
+constexpr uint64_t PageTable::kLowBits;
+constexpr uint64_t PageTable::kHighBits;
+
+namespace {
+
+/** log2 of the number of slots in a table that holds max_size entries.
+ *
+ * The table has at least twice as many slots as entries, and at least two
+ * groups of slots. */
+size_t SlotShift(size_t max_size) {
+  size_t slot_shift = 4;
+  while ((static_cast<size_t>(1) << slot_shift) < max_size * 2)
+    ++slot_shift;
+  return slot_shift;
+}
+
+/** Size of the heap block holding a table's slots and control bytes. */
+size_t BlockSize(size_t slot_count, size_t slot_size) {
+  return slot_count * slot_size + slot_count + PageTable::kGroupSize - 1;
+}
+
+}  // namespace
+
+PageTable::PageTable(size_t max_size)
+    : max_size_(max_size), slot_shift_(SlotShift(max_size)),
+      slot_count_(static_cast<size_t>(1) << slot_shift_),
+      slot_mask_(slot_count_ - 1),
+      slots_(reinterpret_cast<Slot*>(
+          Allocate(BlockSize(slot_count_, sizeof(Slot))))),
+      controls_(reinterpret_cast<uint8_t*>(slots_ + slot_count_)) {
+  // Fingerprint() uses the 7 hash bits below the bits used by HomeSlot().
+  DCHECK_LE(slot_shift_, 57U);
+  std::memset(controls_, kEmpty, slot_count_ + kGroupSize - 1);
+}
+
+PageTable::~PageTable() {
+  Deallocate(slots_, BlockSize(slot_count_, sizeof(Slot)));
+}
+
+void PageTable::Reserve(size_t max_size) {
+  if (max_size <= max_size_)
+    return;
+
+  Slot* old_slots = slots_;
+  const uint8_t* old_controls = controls_;
+  size_t old_slot_count = slot_count_;
+
+  max_size_ = max_size;
+  slot_shift_ = SlotShift(max_size);
+  slot_count_ = static_cast<size_t>(1) << slot_shift_;
+  slot_mask_ = slot_count_ - 1;
+  slots_ = reinterpret_cast<Slot*>(
+      Allocate(BlockSize(slot_count_, sizeof(Slot))));
+  controls_ = reinterpret_cast<uint8_t*>(slots_ + slot_count_);
+  std::memset(controls_, kEmpty, slot_count_ + kGroupSize - 1);
+
+  // The home slots depend on the table size, so all entries are re-inserted.
+  size_ = 0;
+  for (size_t slot = 0; slot < old_slot_count; ++slot) {
+    if (old_controls[slot] != kEmpty) {
+      const Slot& entry = old_slots[slot];
+      Insert(entry.store, entry.page_id, entry.page);
+    }
+  }
+  Deallocate(old_slots, BlockSize(old_slot_count, sizeof(Slot)));
+}
+
+void PageTable::Insert(StoreImpl* store, size_t page_id, Page* page) noexcept {
+  DCHECK_LT(size_, max_size_);
+  DCHECK_EQ(slot_count_, FindSlot(store, page_id));
+
+  // Linear probing places the entry in the first empty slot after its home.
+  uint64_t hash = Hash(store, page_id);
+  size_t slot = HomeSlot(hash);
+  while (controls_[slot] != kEmpty)
+    slot = (slot + 1) & slot_mask_;
+
+  slots_[slot].store = store;
+  slots_[slot].page_id = page_id;
+  slots_[slot].page = page;
+  SetControl(slot, Fingerprint(hash));
+  ++size_;
+}
+
+bool PageTable::Erase(StoreImpl* store, size_t page_id) noexcept {
+  size_t hole = FindSlot(store, page_id);
+  if (hole == slot_count_)
+    return false;
+
+  // Entries between the hole and the next empty slot are moved into the hole
+  // if the hole is on their probe sequence, so no probe sequence crosses an
+  // empty slot.
+  size_t slot = hole;
+  while (true) {
+    slot = (slot + 1) & slot_mask_;
+    if (controls_[slot] == kEmpty)
+      break;
+
+    const Slot& entry = slots_[slot];
+    size_t home = HomeSlot(Hash(entry.store, entry.page_id));
+    if (((slot - home) & slot_mask_) >= ((slot - hole) & slot_mask_)) {
+      slots_[hole] = entry;
+      SetControl(hole, controls_[slot]);
+      hole = slot;
+    }
+  }
+
+  SetControl(hole, kEmpty);
+  --size_;
+  return true;
+}
+
+}  // namespace berrydb
@@ -0,0 +1,225 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_PAGE_TABLE_H_
+#define BERRYDB_PAGE_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "berrydb/platform.h"
+
+namespace berrydb {
+
+class Page;
+class StoreImpl;
+
+/** Maps (store, page ID) pairs to the page pool entries that cache them.
+ *
+ * This is a flat open-addressing hash table with linear probing. The table is
+ * sized for a maximum number of entries when it is created, and only grows
+ * (and rehashes) when Reserve() raises the maximum. The load factor is kept at
+ * or below 50%, which keeps the probe sequences short.
+ *
+ * Each slot has a control byte, stored in a separate array. Empty slots have
+ * the control byte kEmpty. Occupied slots store 7 bits of their key's hash in
+ * the control byte. Lookups load the control bytes of a group of
+ * kGroupSize consecutive slots into a 64-bit word, and compare all of them
+ * against the key's hash bits at once, using bit tricks on the word (SIMD
+ * within a register). Keys are only compared for the slots whose control
+ * bytes match, so a typical hit reads one control word and one slot. Unlike
+ * the key prefix search in key_prefix_format.cc, this does not dispatch to
+ * SSE2 / AVX2 / NEON code. A group fits in a general-purpose register, and
+ * the vector paths would need 16-byte groups, which double the control bytes
+ * scanned by the short probe sequences that a 50% load factor produces.
+ *
+ * The control bytes of the first kGroupSize - 1 slots are cloned after the
+ * last control byte, so groups that wrap around the end of the table can be
+ * loaded with a single unaligned read.
+ *
+ * Entries are removed with backward shift deletion, which moves entries back
+ * into the removed entry's slot when that shortens their probe sequences. So,
+ * the table does not need tombstones, and lookups never slow down as entries
+ * are added and removed.
+ */
+class PageTable {
+ public:
+  /** Number of slots whose control bytes are matched at once. */
+  static constexpr size_t kGroupSize = 8;
+
+  /** Sets up an empty table.
+   *
+   * @param max_size the maximum number of entries that the table will hold */
+  explicit PageTable(size_t max_size);
+  ~PageTable();
+
+  /** The pool entry caching a store page.
+   *
+   * @return the pool entry, or nullptr if the table has no entry for the page
+   */
+  inline Page* Find(StoreImpl* store, size_t page_id) const noexcept {
+    size_t slot = FindSlot(store, page_id);
+    return (slot == slot_count_) ? nullptr : slots_[slot].page;
+  }
+
+  /** Adds an entry to the table.
+   *
+   * The table must not already have an entry for the page, and must hold fewer
+   * than max_size() entries. */
+  void Insert(StoreImpl* store, size_t page_id, Page* page) noexcept;
+
+  /** Removes an entry from the table.
+   *
+   * @return true if the table had an entry for the page */
+  bool Erase(StoreImpl* store, size_t page_id) noexcept;
+
+  /** Makes room for more entries. Does nothing if the table is large enough.
+   *
+   * @param max_size the maximum number of entries that the table will hold */
+  void Reserve(size_t max_size);
+
+  /** Number of entries in the table. */
+  inline size_t size() const noexcept { return size_; }
+
+  /** The maximum number of entries that the table can hold. */
+  inline size_t max_size() const noexcept { return max_size_; }
+
+  /** Number of slots in the table. Always a power of two. */
+  inline size_t slot_count() const noexcept { return slot_count_; }
+
+ private:
+  // Tables cannot be copied or moved.
+  PageTable(const PageTable& other) = delete;
+  PageTable(PageTable&& other) = delete;
+  PageTable& operator=(const PageTable& other) = delete;
+  PageTable& operator=(PageTable&& other) = delete;
+
+  /** An entry in the table. */
+  struct Slot {
+    StoreImpl* store;
+    size_t page_id;
+    Page* page;
+  };
+
+  /** Control byte value for slots that do not hold entries. */
+  static constexpr uint8_t kEmpty = 0x80;
+
+  /** Each byte of a control word with all bits but the highest cleared. */
+  static constexpr uint64_t kLowBits = 0x0101010101010101;
+  /** Each byte of a control word with all bits but the lowest cleared. */
+  static constexpr uint64_t kHighBits = 0x8080808080808080;
+
+  /** The 64-bit hash of a key. The upper bits are used for table lookups. */
+  static inline uint64_t Hash(StoreImpl* store, size_t page_id) noexcept {
+    // Fibonacci hashing spreads the bits of the pool's hash into the upper
+    // bits, which are used for lookups. PagePool picks shards using the lower
+    // bits of the pool's hash, so they are the same for a shard's keys.
+    uint64_t pool_hash = static_cast<uint64_t>(
+        PointerSizeHasher<StoreImpl>()(std::make_pair(store, page_id)));
+    return pool_hash * static_cast<uint64_t>(0x9E3779B97F4A7C15);
+  }
+
+  /** The first slot in the probe sequence for a key's hash. */
+  inline size_t HomeSlot(uint64_t hash) const noexcept {
+    return static_cast<size_t>(hash >> (64 - slot_shift_));
+  }
+
+  /** The control byte for a key's hash. */
+  inline uint8_t Fingerprint(uint64_t hash) const noexcept {
+    return static_cast<uint8_t>((hash >> (57 - slot_shift_)) & 0x7F);
+  }
+
+  /** The control bytes of kGroupSize slots, starting at the given slot. */
+  inline uint64_t LoadGroup(size_t slot) const noexcept {
+    uint64_t group;
+    std::memcpy(&group, controls_ + slot, sizeof(group));
+    return group;
+  }
+
+  /** Sets the high bit of the group bytes that may match a fingerprint.
+   *
+   * This can report false positives, which are weeded out by comparing keys.
+   * Empty slots are never reported.
+   */
+  static inline uint64_t MatchFingerprint(uint64_t group,
+                                          uint8_t fingerprint) noexcept {
+    uint64_t difference = group ^ (kLowBits * fingerprint);
+    return (difference - kLowBits) & ~difference & kHighBits;
+  }
+
+  /** Sets the high bit of the group bytes that belong to empty slots. */
+  static inline uint64_t MatchEmpty(uint64_t group) noexcept {
+    return group & kHighBits;
+  }
+
+  /** The position in its group of the slot for the lowest bit in a match. */
+  static inline size_t MatchOffset(uint64_t matches) noexcept {
+    DCHECK(matches != 0);
+#if defined(__GNUC__)
+    size_t word_byte = static_cast<size_t>(__builtin_ctzll(matches)) >> 3;
+#else  // defined(__GNUC__)
+    size_t word_byte = 0;
+    while ((matches & 0xFF) == 0) {
+      matches >>= 8;
+      ++word_byte;
+    }
+#endif  // defined(__GNUC__)
+
+    // Groups are loaded in the platform's byte order. Compilers fold this
+    // check into a constant.
+    const uint16_t byte_order_probe = 1;
+    uint8_t first_byte;
+    std::memcpy(&first_byte, &byte_order_probe, 1);
+    return (first_byte == 1) ? word_byte : kGroupSize - 1 - word_byte;
+  }
+
+  /** The slot holding a key's entry.
+   *
+   * @return the slot's index, or slot_count_ if the table has no such entry */
+  inline size_t FindSlot(StoreImpl* store, size_t page_id) const noexcept {
+    uint64_t hash = Hash(store, page_id);
+    uint8_t fingerprint = Fingerprint(hash);
+    size_t group_slot = HomeSlot(hash);
+    while (true) {
+      uint64_t group = LoadGroup(group_slot);
+      for (uint64_t matches = MatchFingerprint(group, fingerprint);
+           matches != 0; matches &= matches - 1) {
+        size_t slot = (group_slot + MatchOffset(matches)) & slot_mask_;
+        if (slots_[slot].store == store && slots_[slot].page_id == page_id)
+          return slot;
+      }
+      // Entries are stored before the first empty slot after their home slot.
+      if (MatchEmpty(group) != 0)
+        return slot_count_;
+      group_slot = (group_slot + kGroupSize) & slot_mask_;
+    }
+  }
+
+  /** Updates a slot's control byte and its clone, if it has one. */
+  inline void SetControl(size_t slot, uint8_t control) noexcept {
+    controls_[slot] = control;
+    if (slot < kGroupSize - 1)
+      controls_[slot_count_ + slot] = control;
+  }
+
+  size_t max_size_;
+  /** log2(slot_count_). */
+  size_t slot_shift_;
+  size_t slot_count_;
+  /** slot_count_ - 1. */
+  size_t slot_mask_;
+
+  /** The table's entries. Slots with kEmpty control bytes hold garbage. */
+  Slot* slots_;
+  /** The slots' control bytes, followed by clones of the first bytes. */
+  uint8_t* controls_;
+
+  size_t size_ = 0;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_PAGE_TABLE_H_
@@ -0,0 +1,142 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./page_table.h"
+
+#include <map>
+#include <random>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace berrydb {
+
+namespace {
+
+// The table never dereferences the pointers it stores.
+StoreImpl* FakeStore(uintptr_t id) {
+  return reinterpret_cast<StoreImpl*>(id * 64);
+}
+Page* FakePage(uintptr_t id) {
+  return reinterpret_cast<Page*>(id * 64 + 8);
+}
+
+}  // namespace
+
+TEST(PageTableTest, Sizing) {
+  PageTable table(42);
+  EXPECT_EQ(42U, table.max_size());
+  EXPECT_EQ(0U, table.size());
+  EXPECT_EQ(128U, table.slot_count());
+
+  PageTable tiny_table(1);
+  EXPECT_EQ(16U, tiny_table.slot_count());
+}
+
+TEST(PageTableTest, InsertFindErase) {
+  PageTable table(4);
+  StoreImpl* store1 = FakeStore(1);
+  StoreImpl* store2 = FakeStore(2);
+
+  EXPECT_EQ(nullptr, table.Find(store1, 1));
+  table.Insert(store1, 1, FakePage(1));
+  table.Insert(store2, 1, FakePage(2));
+  table.Insert(store1, 2, FakePage(3));
+  EXPECT_EQ(3U, table.size());
+
+  EXPECT_EQ(FakePage(1), table.Find(store1, 1));
+  EXPECT_EQ(FakePage(2), table.Find(store2, 1));
+  EXPECT_EQ(FakePage(3), table.Find(store1, 2));
+  EXPECT_EQ(nullptr, table.Find(store2, 2));
+
+  EXPECT_TRUE(table.Erase(store2, 1));
+  EXPECT_FALSE(table.Erase(store2, 1));
+  EXPECT_EQ(2U, table.size());
+  EXPECT_EQ(nullptr, table.Find(store2, 1));
+  EXPECT_EQ(FakePage(1), table.Find(store1, 1));
+  EXPECT_EQ(FakePage(3), table.Find(store1, 2));
+
+  table.Insert(store2, 1, FakePage(4));
+  EXPECT_EQ(FakePage(4), table.Find(store2, 1));
+}
+
+TEST(PageTableTest, FullTable) {
+  PageTable table(64);
+  StoreImpl* store = FakeStore(1);
+  for (size_t i = 0; i < 64; ++i)
+    table.Insert(store, i, FakePage(i));
+  EXPECT_EQ(64U, table.size());
+
+  for (size_t i = 0; i < 64; ++i)
+    EXPECT_EQ(FakePage(i), table.Find(store, i)) << "page id: " << i;
+  EXPECT_EQ(nullptr, table.Find(store, 64));
+
+  // Removing every other entry shifts the others back.
+  for (size_t i = 0; i < 64; i += 2)
+    EXPECT_TRUE(table.Erase(store, i));
+  for (size_t i = 0; i < 64; ++i) {
+    EXPECT_EQ((i % 2 == 0) ? nullptr : FakePage(i), table.Find(store, i))
+        << "page id: " << i;
+  }
+}
+
+TEST(PageTableTest, Reserve) {
+  PageTable table(8);
+  StoreImpl* store = FakeStore(1);
+  for (size_t i = 0; i < 8; ++i)
+    table.Insert(store, i, FakePage(i));
+
+  table.Reserve(4);
+  EXPECT_EQ(8U, table.max_size());
+  EXPECT_EQ(16U, table.slot_count());
+
+  table.Reserve(100);
+  EXPECT_EQ(100U, table.max_size());
+  EXPECT_EQ(256U, table.slot_count());
+  EXPECT_EQ(8U, table.size());
+  for (size_t i = 0; i < 8; ++i)
+    EXPECT_EQ(FakePage(i), table.Find(store, i)) << "page id: " << i;
+
+  for (size_t i = 8; i < 100; ++i)
+    table.Insert(store, i, FakePage(i));
+  EXPECT_EQ(100U, table.size());
+  for (size_t i = 0; i < 100; ++i)
+    EXPECT_EQ(FakePage(i), table.Find(store, i)) << "page id: " << i;
+  EXPECT_TRUE(table.Erase(store, 3));
+  EXPECT_EQ(nullptr, table.Find(store, 3));
+}
+
+TEST(PageTableTest, RandomOperations) {
+  // Many stores and a small table produce long probe sequences, which wrap
+  // around the end of the table.
+  constexpr size_t kMaxSize = 100;
+  PageTable table(kMaxSize);
+  std::map<std::pair<uintptr_t, size_t>, Page*> expected;
+  std::mt19937 rnd(42);
+
+  for (size_t i = 0; i < 100000; ++i) {
+    uintptr_t store_id = 1 + rnd() % 4;
+    size_t page_id = rnd() % 200;
+    auto key = std::make_pair(store_id, page_id);
+    auto it = expected.find(key);
+    ASSERT_EQ((it == expected.end()) ? nullptr : it->second,
+              table.Find(FakeStore(store_id), page_id));
+
+    if (it != expected.end()) {
+      ASSERT_TRUE(table.Erase(FakeStore(store_id), page_id));
+      expected.erase(it);
+    } else if (expected.size() < kMaxSize) {
+      table.Insert(FakeStore(store_id), page_id, FakePage(i));
+      expected[key] = FakePage(i);
+    }
+    ASSERT_EQ(expected.size(), table.size());
+  }
+
+  for (const auto& entry : expected) {
+    EXPECT_EQ(entry.second,
+              table.Find(FakeStore(entry.first.first), entry.first.second));
+  }
+}
+
+}  // namespace berrydb
@@ -27,8 +27,8 @@ class PageTest : public ::testing::Test {
   void SetUp() override {
     BlockAccessFile* raw_data_file;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-        data_file_deleter_.path(), kStorePageShift, true, false, &raw_data_file,
-        &data_file_size_));
+        data_file_deleter_.path(), kStorePageShift, true, false, false,
+        &raw_data_file, &data_file_size_));
     data_file_.reset(raw_data_file);
     RandomAccessFile* raw_log_file;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForRandomAccess(
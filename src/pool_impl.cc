@@ -27,7 +27,7 @@ PoolImpl* PoolImpl::Create(const PoolOptions& options) {
 }
 
 PoolImpl::PoolImpl(const PoolOptions& options)
-    : api_(), page_pool_(this, options.page_shift, options.page_pool_size),
+    : api_(), page_pool_(this, options),
       vfs_((options.vfs == nullptr) ? DefaultVfs() : options.vfs) {
 }
 
@@ -81,29 +81,44 @@ void PoolImpl::StoreClosed(StoreImpl* store) {
 Status PoolImpl::OpenStore(
     const std::string& path, const StoreOptions& options,
     StoreImpl** result) {
+  // Memory-mapped stores are read-only, so they must already exist, and they
+  // do not need write access. Their pages are read via the OS page cache, so
+  // direct I/O does not apply to them.
+  bool memory_mapped = options.memory_mapped;
   BlockAccessFile* data_file;
   size_t data_file_size;
-  Status status = vfs_->OpenForBlockAccess(
-      path, page_pool_.page_shift(), options.create_if_missing,
-      options.error_if_exists, &data_file, &data_file_size);
+  Status status;
+  if (memory_mapped) {
+    status = vfs_->OpenForBlockReads(path, page_pool_.page_shift(),
+                                     &data_file, &data_file_size);
+  } else {
+    status = vfs_->OpenForBlockAccess(
+        path, page_pool_.page_shift(), options.create_if_missing,
+        options.error_if_exists, page_pool_.uses_direct_io(), &data_file,
+        &data_file_size);
+  }
   if (status != Status::kSuccess)
     return status;
 
-  status = data_file->Lock();
+  // Memory-mapped stores read pages straight out of the file, so they take a
+  // shared lock, which keeps writers out while the store is open.
+  status = memory_mapped ? data_file->LockShared() : data_file->Lock();
   if (status != Status::kSuccess) {
     data_file->Close();
     return status;
   }
 
-  std::string log_file_path = StoreImpl::LogFilePath(path);
-  RandomAccessFile* log_file;
-  size_t log_file_size;
-  status = vfs_->OpenForRandomAccess(
-      log_file_path, true /* create_if_missing */, false /* error_if_exists */,
-      &log_file, &log_file_size);
-  if (status != Status::kSuccess) {
-    data_file->Close();
-    return status;
+  RandomAccessFile* log_file = nullptr;
+  size_t log_file_size = 0;
+  if (!memory_mapped) {
+    std::string log_file_path = StoreImpl::LogFilePath(path);
+    status = vfs_->OpenForRandomAccess(
+        log_file_path, true /* create_if_missing */,
+        false /* error_if_exists */, &log_file, &log_file_size);
+    if (status != Status::kSuccess) {
+      data_file->Close();
+      return status;
+    }
   }
 
   StoreImpl* store = StoreImpl::Create(
@@ -51,6 +51,9 @@ class PoolImpl {
   inline size_t page_pool_size() const noexcept {
     return page_pool_.page_capacity();
   }
+  inline Status SetPagePoolSize(size_t page_pool_size) {
+    return page_pool_.SetPageCapacity(page_pool_size);
+  }
 
   /** Called upon the creation of a Store instance that uses this pool. */
   void StoreCreated(StoreImpl* store);
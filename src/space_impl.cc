@@ -12,15 +12,15 @@ static_assert(std::is_standard_layout<SpaceImpl>::value,
     "SpaceImpl must be a standard layout type so its public API can be "
     "exposed cheaply");
 
-SpaceImpl* SpaceImpl::Create() {
+SpaceImpl* SpaceImpl::Create(size_t root_page_id) {
   void* heap_block = Allocate(sizeof(SpaceImpl));
-  SpaceImpl* space = new (heap_block) SpaceImpl();
+  SpaceImpl* space = new (heap_block) SpaceImpl(root_page_id);
   DCHECK_EQ(heap_block, static_cast<void*>(space));
   return space;
 }
 
-SpaceImpl::SpaceImpl()
-    : api_() {
+SpaceImpl::SpaceImpl(size_t root_page_id)
+    : api_(), root_page_id_(root_page_id) {
 }
 
 SpaceImpl::~SpaceImpl() { }
@@ -13,7 +13,11 @@ namespace berrydb {
 /** Internal representation for the Space class in the public API. */
 class SpaceImpl {
  public:
-  static SpaceImpl* Create();
+  /** Creates a SpaceImpl instance.
+   *
+   * @param root_page_id the ID of the root page of the space's B+tree
+   */
+  static SpaceImpl* Create(size_t root_page_id);
 
   /** Computes the internal representation for a pointer from the public API. */
   static inline SpaceImpl* FromApi(Space* api) noexcept {
@@ -31,17 +35,23 @@ class SpaceImpl {
   /** Computes the public API representation for this store. */
   inline Space* ToApi() noexcept { return &api_; }
 
+  /** The ID of the root page of the B+tree holding the space's data. */
+  inline size_t root_page_id() const noexcept { return root_page_id_; }
+
   // See the public API documention for details.
   void Release();
 
  private:
   /** Use SpaceImpl::Create() to obtain SpaceImpl instances. */
-  SpaceImpl();
+  SpaceImpl(size_t root_page_id);
   /** Use Release() to destroy StoreImpl instances. */
   ~SpaceImpl();
 
   /* The public API version of this class. */
   Space api_;  // Must be the first class member.
+
+  /** The ID of the root page of the B+tree holding the space's data. */
+  const size_t root_page_id_;
 };
 
 }  // namespace berrydb
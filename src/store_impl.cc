@@ -8,6 +8,8 @@
 
 #include "berrydb/options.h"
 #include "berrydb/vfs.h"
+#include "./catalog_impl.h"
+#include "./format/btree_page_format.h"
 #include "./free_page_list.h"
 #include "./pool_impl.h"
 #include "./transaction_impl.h"
@@ -18,6 +20,41 @@ static_assert(std::is_standard_layout<StoreImpl>::value,
     "StoreImpl must be a standard layout type so its public API can be "
     "exposed cheaply");
 
+namespace {
+
+/** The maximum number of buffers in a vectored read or write.
+ *
+ * Longer runs of pages are split into multiple reads or writes. This bounds
+ * the stack space used to describe a run. */
+constexpr size_t kMaxRunBuffers = 64;
+
+/** Appends a page pool entry's data to the buffers describing a run of pages.
+ *
+ * Entries that are adjacent in memory, such as frame table entries, share a
+ * buffer.
+ *
+ * @return false if the buffers array is full, so the data was not added */
+bool AddPageToRun(uint8_t* page_data, size_t page_size,
+                  BlockIoBuffer* buffers, size_t* buffer_count) {
+  if (*buffer_count > 0) {
+    BlockIoBuffer* last_buffer = &buffers[*buffer_count - 1];
+    if (last_buffer->data + last_buffer->byte_count == page_data) {
+      last_buffer->byte_count += page_size;
+      return true;
+    }
+  }
+  if (*buffer_count == kMaxRunBuffers)
+    return false;
+
+  buffers[*buffer_count] = {page_data, page_size};
+  ++*buffer_count;
+  return true;
+}
+
+}  // namespace
+
+constexpr size_t StoreImpl::kRootCatalogPageId;
+
 StoreImpl* StoreImpl::Create(
     BlockAccessFile* data_file, size_t data_file_size,
     RandomAccessFile* log_file, size_t log_file_size, PagePool* page_pool,
@@ -43,9 +80,13 @@ StoreImpl::StoreImpl(
     const StoreOptions& options)
     : data_file_(data_file), log_file_(log_file), page_pool_(page_pool),
       init_transaction_(this, true), header_(
-          page_pool->page_shift(), data_file_size >> page_pool->page_shift()) {
+          page_pool->page_shift(), data_file_size >> page_pool->page_shift()),
+      root_catalog_(CatalogImpl::Create(this, kRootCatalogPageId)),
+      free_page_manager_(this),
+      data_file_page_count_(data_file_size >> page_pool->page_shift()) {
   DCHECK(data_file != nullptr);
-  DCHECK(log_file != nullptr);
+  // Memory-mapped stores are read-only, so they do not open their log files.
+  DCHECK(log_file != nullptr || options.memory_mapped);
   DCHECK(page_pool != nullptr);
 
   // This will be used when we implement creating/loading the metadata page.
@@ -60,17 +101,36 @@ StoreImpl::~StoreImpl() {
     Close();
 
   DCHECK(state_ == State::kClosed);
+  root_catalog_->Release();
 }
 
 Status StoreImpl::Initialize(const StoreOptions &options) {
+  if (options.memory_mapped)
+    return MapDataFile(options.mapping_advice);
+
   // TODO(pwnall): Check the log and attempt recovery.
 
-  if (options.create_if_missing && header_.page_count < 3) {
-    Status status = Bootstrap();
-    if (status != Status::kSuccess)
-      return status;
-  }
+  if (options.create_if_missing && header_.page_count < 3)
+    return Bootstrap();
+  if (header_.page_count == 0)
+    return Status::kSuccess;
+  return ReadHeader();
+}
 
+Status StoreImpl::ReadHeader() {
+  Page* header_page;
+  Status status = page_pool_->StorePage(
+      this, 0, PagePool::kFetchPageData, &header_page);
+  if (status != Status::kSuccess)
+    return status;
+
+  // The constructor's header was derived from the data file's size. The free
+  // list head is only recorded in the header page.
+  size_t page_shift = header_.page_shift;
+  bool is_valid = header_.Deserialize(header_page->data());
+  page_pool_->UnpinStorePage(header_page);
+  if (!is_valid || header_.page_shift != page_shift)
+    return Status::kDataCorrupted;
   return Status::kSuccess;
 }
 
@@ -94,18 +154,18 @@ Status StoreImpl::Bootstrap() {
 
   Page* root_catalog_page;
   fetch_status = page_pool_->StorePage(
-      this, 1, PagePool::kIgnorePageData, &root_catalog_page);
+      this, kRootCatalogPageId, PagePool::kIgnorePageData, &root_catalog_page);
   if (fetch_status != Status::kSuccess) {
     transaction->Rollback();
     transaction->Release();
     return fetch_status;
   }
 
+  // The root catalog starts out as an empty B+tree.
   transaction->WillModifyPage(root_catalog_page);
-  std::memset(
-      root_catalog_page->data(), 0,
-      static_cast<size_t>(1) << header_.page_shift);
-  // TODO(pwnall): Bootstrap the root catalog here.
+  size_t page_size = static_cast<size_t>(1) << header_.page_shift;
+  std::memset(root_catalog_page->data(), 0, page_size);
+  BTreePageFormat::InitLeaf(root_catalog_page->data(), page_size);
   page_pool_->UnpinStorePage(root_catalog_page);
 
   Status commit_status = transaction->Commit();
@@ -150,13 +210,32 @@ Status StoreImpl::Close() {
       result = rollback_status;
   }
 
+  // The rolled back transactions returned their pages to the free list.
+  Status alloc_status = free_page_manager_.Close();
+  if (alloc_status != Status::kSuccess && result == Status::kSuccess)
+    result = alloc_status;
+
+  // Prefetched pages are assigned to the init transaction, so their reads
+  // must complete before it is rolled back. The prefetch queue must also be
+  // released before the data file is closed.
+  page_pool_->FinishPrefetches(this);
+
   // Rollback the init transaction to get the store's pages released.
   Status rollback_status = init_transaction_.Rollback();
   if (rollback_status != Status::kSuccess && result == Status::kSuccess)
     result = rollback_status;
 
+  // Pages that the background cleaner could not write may have been lost.
+  if (has_write_error() && result == Status::kSuccess)
+    result = Status::kIoError;
+
+  // The control blocks must be gone before the file's mapping.
+  if (is_mapped())
+    ReleaseMappedPages();
+
   data_file_->Close();
-  log_file_->Close();
+  if (log_file_ != nullptr)
+    log_file_->Close();
 
   state_ = State::kClosed;
   page_pool_->pool()->StoreClosed(this);
@@ -164,28 +243,251 @@ Status StoreImpl::Close() {
   return result;
 }
 
+Status StoreImpl::WriteHeader(TransactionImpl* transaction) {
+  DCHECK(transaction != nullptr);
+  DCHECK_EQ(this, transaction->store());
+
+  Page* header_page;
+  Status status = page_pool_->StorePage(
+      this, 0, PagePool::kFetchPageData, &header_page);
+  if (status != Status::kSuccess)
+    return status;
+
+  transaction->WillModifyPage(header_page);
+  header_.Serialize(header_page->data());
+  page_pool_->UnpinStorePage(header_page);
+  return Status::kSuccess;
+}
+
 Status StoreImpl::ReadPage(Page* page) {
   DCHECK(page != nullptr);
   DCHECK(page->transaction() != nullptr);
   DCHECK_EQ(this, page->transaction()->store());
   DCHECK(!page->is_dirty());
-  DCHECK(!page->IsUnpinned());
+  // NOTE: The page must be pinned. Other threads may pin the page while it is
+  //       read, so its pin count cannot be checked without its shard's latch.
 
   size_t file_offset = page->page_id() << header_.page_shift;
   size_t page_size = static_cast<size_t>(1) << header_.page_shift;
   return data_file_->Read(file_offset, page_size, page->data());
 }
 
+Status StoreImpl::ReadPages(Page* const* pages, size_t count) {
+  DCHECK(pages != nullptr || count == 0);
+
+  size_t run_start = 0;
+  while (run_start < count) {
+    size_t first_page_id = pages[run_start]->page_id();
+    size_t run_end = run_start + 1;
+    while (run_end < count &&
+           pages[run_end]->page_id() == first_page_id + (run_end - run_start)) {
+      ++run_end;
+    }
+
+#if DCHECK_IS_ON()
+    for (size_t i = run_start; i < run_end; ++i) {
+      Page* page = pages[i];
+      DCHECK(page->transaction() != nullptr);
+      DCHECK_EQ(this, page->transaction()->store());
+      DCHECK(!page->is_dirty());
+    }
+#endif  // DCHECK_IS_ON()
+
+    Status status = TransferPageRun(first_page_id, run_end - run_start,
+                                    pages + run_start, false);
+    if (status != Status::kSuccess)
+      return status;
+    run_start = run_end;
+  }
+  return Status::kSuccess;
+}
+
 Status StoreImpl::WritePage(Page* page) {
   DCHECK(page != nullptr);
   DCHECK(page->transaction() != nullptr);
   DCHECK_EQ(this, page->transaction()->store());
-  DCHECK(page->is_dirty());
+  DCHECK(page->is_dirty() || page->transaction()->IsInit());
   //DCHECK(!page->IsUnpinned());
 
   size_t file_offset = page->page_id() << header_.page_shift;
   size_t page_size = static_cast<size_t>(1) << header_.page_shift;
-  return data_file_->Write(page->data(), file_offset, page_size);
+  Status status = data_file_->Write(page->data(), file_offset, page_size);
+  if (status == Status::kSuccess)
+    DataFileWritten(page->page_id() + 1);
+  return status;
+}
+
+Status StoreImpl::WritePages(Page* const* pages, size_t count) {
+  DCHECK(pages != nullptr || count == 0);
+
+  size_t run_start = 0;
+  while (run_start < count) {
+    size_t first_page_id = pages[run_start]->page_id();
+    size_t run_end = run_start + 1;
+    while (run_end < count &&
+           pages[run_end]->page_id() == first_page_id + (run_end - run_start)) {
+      ++run_end;
+    }
+
+#if DCHECK_IS_ON()
+    for (size_t i = run_start; i < run_end; ++i) {
+      Page* page = pages[i];
+      DCHECK(page->transaction() != nullptr);
+      DCHECK_EQ(this, page->transaction()->store());
+      DCHECK(page->is_dirty() || page->transaction()->IsInit());
+    }
+#endif  // DCHECK_IS_ON()
+
+    Status status = TransferPageRun(first_page_id, run_end - run_start,
+                                    pages + run_start, true);
+    if (status != Status::kSuccess)
+      return status;
+    run_start = run_end;
+  }
+  return Status::kSuccess;
+}
+
+Status StoreImpl::WritePageRun(size_t first_page_id, size_t page_count,
+                               uint8_t* data) {
+  DCHECK(data != nullptr);
+  DCHECK_NE(0U, first_page_id);
+
+  size_t file_offset = first_page_id << header_.page_shift;
+  Status status = data_file_->Write(data, file_offset,
+                                    page_count << header_.page_shift);
+  if (status == Status::kSuccess)
+    DataFileWritten(first_page_id + page_count);
+  return status;
+}
+
+Status StoreImpl::TransferPageRun(size_t first_page_id, size_t page_count,
+                                  Page* const* pages, bool is_write) {
+  size_t page_shift = header_.page_shift;
+  size_t page_size = static_cast<size_t>(1) << page_shift;
+  size_t run_start = 0;
+  while (run_start < page_count) {
+    BlockIoBuffer buffers[kMaxRunBuffers];
+    size_t buffer_count = 0;
+    size_t run_end = run_start;
+    while (run_end < page_count &&
+           AddPageToRun(pages[run_end]->data(), page_size, buffers,
+                        &buffer_count)) {
+      ++run_end;
+    }
+
+    size_t file_offset = (first_page_id + run_start) << page_shift;
+    Status status = is_write ?
+        data_file_->WriteV(buffers, buffer_count, file_offset) :
+        data_file_->ReadV(file_offset, buffers, buffer_count);
+    if (status != Status::kSuccess)
+      return status;
+    if (is_write)
+      DataFileWritten(first_page_id + run_end);
+    run_start = run_end;
+  }
+  return Status::kSuccess;
+}
+
+Status StoreImpl::MapDataFile(MappingAdvice advice) {
+  DCHECK(!is_mapped());
+
+  // A store needs at least its header page and its root catalog page.
+  size_t page_count = data_file_page_count();
+  if (page_count < 2)
+    return Status::kDataCorrupted;
+
+  size_t byte_count = page_count << header_.page_shift;
+  uint8_t* mapped_data;
+  Status status = data_file_->MapForReading(byte_count, &mapped_data);
+  if (status != Status::kSuccess)
+    return status;
+  data_file_->AdviseMapping(0, byte_count, advice);
+
+  void* heap_block = Allocate(page_count * sizeof(std::atomic<Page*>));
+  mapped_pages_ = reinterpret_cast<std::atomic<Page*>*>(heap_block);
+  for (size_t i = 0; i < page_count; ++i)
+    new (&mapped_pages_[i]) std::atomic<Page*>(nullptr);
+  mapped_page_count_ = page_count;
+  mapped_data_ = mapped_data;
+  return Status::kSuccess;
+}
+
+Status StoreImpl::MappedPage(size_t page_id, Page** result) {
+  DCHECK(is_mapped());
+
+  if (page_id >= mapped_page_count_)
+    return Status::kIoError;
+
+  std::atomic<Page*>* slot = &mapped_pages_[page_id];
+  Page* page = slot->load(std::memory_order_acquire);
+  if (page == nullptr) {
+    // Threads racing to create the same control block all build one, and the
+    // losers discard theirs. This is rare, and does not require a latch.
+    Page* new_page = Page::CreateMapped(
+        page_pool_, &init_transaction_, page_id,
+        mapped_data_ + (page_id << header_.page_shift));
+    if (slot->compare_exchange_strong(page, new_page,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      page = new_page;
+    } else {
+      new_page->Release(page_pool_);
+    }
+  }
+
+  *result = page;
+  return Status::kSuccess;
+}
+
+void StoreImpl::AdviseMappedPages(const size_t* sorted_page_ids,
+                                  size_t count) {
+  DCHECK(is_mapped());
+  DCHECK(sorted_page_ids != nullptr || count == 0);
+
+  size_t page_shift = header_.page_shift;
+  size_t run_start = 0;
+  while (run_start < count) {
+    size_t first_page_id = sorted_page_ids[run_start];
+    if (first_page_id >= mapped_page_count_)
+      break;
+
+    size_t run_end = run_start + 1;
+    while (run_end < count &&
+           sorted_page_ids[run_end] == first_page_id + (run_end - run_start) &&
+           sorted_page_ids[run_end] < mapped_page_count_) {
+      ++run_end;
+    }
+
+    data_file_->AdviseMapping(first_page_id << page_shift,
+                              (run_end - run_start) << page_shift,
+                              MappingAdvice::kWillNeed);
+    run_start = run_end;
+  }
+}
+
+void StoreImpl::ReleaseMappedPages() {
+  DCHECK(is_mapped());
+
+  for (size_t i = 0; i < mapped_page_count_; ++i) {
+    Page* page = mapped_pages_[i].load(std::memory_order_relaxed);
+    if (page != nullptr)
+      page->Release(page_pool_);
+    mapped_pages_[i].~atomic();
+  }
+  Deallocate(reinterpret_cast<void*>(mapped_pages_),
+             mapped_page_count_ * sizeof(std::atomic<Page*>));
+  mapped_pages_ = nullptr;
+  mapped_page_count_ = 0;
+  mapped_data_ = nullptr;
+}
+
+void StoreImpl::DataFileWritten(size_t end_page_id) noexcept {
+  size_t page_count = data_file_page_count_.load(std::memory_order_relaxed);
+  while (page_count < end_page_id &&
+         !data_file_page_count_.compare_exchange_weak(
+             page_count, end_page_id, std::memory_order_release,
+             std::memory_order_relaxed)) {
+  }
 }
 
 void StoreImpl::TransactionClosed(TransactionImpl* transaction) {
@@ -5,10 +5,14 @@
 #ifndef BERRYDB_STORE_IMPL_H_
 #define BERRYDB_STORE_IMPL_H_
 
+#include <atomic>
 #include <functional>
+#include <mutex>
 #include <unordered_set>
+#include <vector>
 
 #include "./format/store_header.h"
+#include "./free_page_manager.h"
 #include "./page.h"
 #include "berrydb/platform.h"
 #include "berrydb/pool.h"
@@ -17,6 +21,7 @@
 // #include "./page_pool.h" would cause a cycle
 #include "./transaction_impl.h"
 #include "./util/linked_list.h"
+#include "./util/platform_allocator.h"
 
 namespace berrydb {
 
@@ -28,6 +33,12 @@ class PoolImpl;
 /** Internal representation for the Store class in the public API. */
 class StoreImpl {
  public:
+  /** The page that holds the root of the root catalog's B+tree.
+   *
+   * The page is set up when the store is bootstrapped, right after the page
+   * holding the store's header. */
+  static constexpr size_t kRootCatalogPageId = 1;
+
   /** Create a StoreImpl instance.
    *
    * This returns a minimally set up instance that can be registered with the
@@ -69,10 +80,112 @@ class StoreImpl {
   /** The page pool used by this store. */
   inline PagePool* page_pool() const noexcept { return page_pool_; }
 
+  /** Tracks the free pages in this store's data file. */
+  inline FreePageManager* free_page_manager() noexcept {
+    return &free_page_manager_;
+  }
+
+  /** Metadata in the data file's header.
+   *
+   * Changes to the header must be persisted by calling WriteHeader(). */
+  inline StoreHeader* header() noexcept { return &header_; }
+
+  /** The page pool's state for detecting sequential reads from this store.
+   *
+   * Guarded by the page pool's assignment latch. */
+  struct ReadaheadState {
+    /** The page whose cache miss would continue a sequential run of misses.
+     *
+     * Page 0 holds the store header, so it never continues a run. */
+    size_t next_page_id = 0;
+    /** Number of pages read ahead by the last miss in the current run. */
+    size_t window = 0;
+  };
+  inline ReadaheadState* readahead_state() noexcept {
+    return &readahead_state_;
+  }
+
+  /** The page pool's state for the reads started by PagePool::Prefetch().
+   *
+   * Guarded by prefetch_mutex(). */
+  struct PrefetchState {
+    /** Reads prefetched pages from the data file. Created on first use. */
+    BlockIoQueue* queue = nullptr;
+    /** The pages whose reads were submitted to the queue, and not polled. */
+    std::vector<Page*, PlatformAllocator<Page*>> reading_pages;
+    /** The prefetched pages whose reads failed.
+     *
+     * The pages were removed from their shards, but are still assigned to
+     * the store, and still pinned by the prefetch. */
+    std::vector<Page*, PlatformAllocator<Page*>> failed_pages;
+  };
+  inline PrefetchState* prefetch_state() noexcept {
+    return &prefetch_state_;
+  }
+
+  /** Guards prefetch_state().
+   *
+   * Acquired after the page pool's assignment latch, and before its shard
+   * latches. */
+  inline std::mutex* prefetch_mutex() noexcept { return &prefetch_mutex_; }
+
+  /** Handle to the store's data file. */
+  inline BlockAccessFile* data_file() const noexcept { return data_file_; }
+
+  /** Number of pages in the store's data file.
+   *
+   * Pages are written without holding any pool latch, so this may lag behind
+   * concurrent writes. The data file never shrinks, so all the pages below the
+   * returned value can be read. */
+  inline size_t data_file_page_count() const noexcept {
+    return data_file_page_count_.load(std::memory_order_acquire);
+  }
+
+  /** True if the page pool's cleaner or an eviction could not write a page.
+   *
+   * The page pool does not close the store, because other threads may be using
+   * it. The pages that the cleaner could not write stay dirty. The changes in
+   * evicted pages are lost. The store's next commit closes the store and
+   * reports the error. */
+  inline bool has_write_error() const noexcept {
+    return has_write_error_.load(std::memory_order_acquire);
+  }
+
+  /** Called by the page pool when the cleaner's or an eviction's writes fail.
+   */
+  inline void BackgroundWriteFailed() noexcept {
+    has_write_error_.store(true, std::memory_order_release);
+  }
+
+  /** True if the store was opened in memory-mapped read-only mode.
+   *
+   * The pages of mapped stores are read directly from the data file's mapping,
+   * so they bypass the page pool. See StoreOptions::memory_mapped. */
+  inline bool is_mapped() const noexcept { return mapped_data_ != nullptr; }
+
+  /** Returns the control block for a page in a memory-mapped store.
+   *
+   * Control blocks are created the first time a page is used, and live until
+   * the store is closed. They are permanently pinned, so callers do not need to
+   * pin or unpin them. This method is thread-safe.
+   *
+   * @param  page_id the ID of the desired page
+   * @param  result  receives the page's control block
+   * @return         kSuccess, or kIoError if the page is past the end of the
+   *                 data file */
+  Status MappedPage(size_t page_id, Page** result);
+
+  /** Hints to the OS that pages of a memory-mapped store will be used soon.
+   *
+   * @param sorted_page_ids the IDs of the pages; must be sorted, and must not
+   *                        contain duplicates
+   * @param count           the number of page IDs */
+  void AdviseMappedPages(const size_t* sorted_page_ids, size_t count);
+
   // See the public API documention for details.
   static std::string LogFilePath(const std::string& store_path);
   TransactionImpl* CreateTransaction();
-  inline CatalogImpl* RootCatalog() noexcept { return nullptr; }
+  inline CatalogImpl* RootCatalog() noexcept { return root_catalog_; }
   Status Close();
   inline bool IsClosed() const noexcept { return state_ == State::kClosed; }
   void Release();
@@ -102,15 +215,68 @@ class StoreImpl {
    * @return      most likely kSuccess or kIoError */
   Status ReadPage(Page* page);
 
+  /** Reads many pages from the store into the page pool.
+   *
+   * Pages with consecutive IDs are read using a single vectored file read, so
+   * this is faster than calling ReadPage() for each page. The requirements for
+   * the page pool entries are the same as for ReadPage().
+   *
+   * @param  pages the page pool entries that will hold the store's pages;
+   *               must be sorted by page ID, and must not contain duplicates
+   * @param  count the number of page pool entries
+   * @return       most likely kSuccess or kIoError; if the call fails, the
+   *               content of all the page pool entries is undefined */
+  Status ReadPages(Page* const* pages, size_t count);
+
+  /** Loads the in-memory header data from the data file's header page.
+   *
+   * @return kDataCorrupted if the header page is invalid, or does not match
+   *         the page pool's page size; otherwise, most likely kSuccess or
+   *         kIoError */
+  Status ReadHeader();
+
+  /** Stores the in-memory header data in the data file's header page.
+   *
+   * @param  transaction the transaction whose commit persists the new header
+   * @return             most likely kSuccess or kIoError */
+  Status WriteHeader(TransactionImpl* transaction);
+
   /** Writes a page to the store.
    *
    * The page pool entry must be flagged as dirty. The caller is responsible for
-   * clearing the page entry's dirty flag if this method succeeds.
+   * clearing the page entry's dirty flag if this method succeeds. The page
+   * pool's cleaner marks pages as persisted before writing them, so it also
+   * writes clean pages that belong to the init transaction.
    *
    * @param  page the page pool entry caching the store page to be written
    * @return      most likely kSuccess or kIoError */
   Status WritePage(Page* page);
 
+  /** Writes many pages from the page pool to the store.
+   *
+   * Pages with consecutive IDs are written using a single vectored file write,
+   * so this is faster than calling WritePage() for each page. The requirements
+   * for the page pool entries are the same as for WritePage().
+   *
+   * @param  pages the page pool entries caching the store pages to be written;
+   *               must be sorted by page ID, and must not contain duplicates
+   * @param  count the number of page pool entries
+   * @return       most likely kSuccess or kIoError; if the call fails, some of
+   *               the pages may have been written */
+  Status WritePages(Page* const* pages, size_t count);
+
+  /** Writes consecutive pages to the store, bypassing the page pool.
+   *
+   * This is intended for building new pages, such as the pages produced by
+   * bulk loading. The pages must have been allocated by the caller's
+   * transaction, and must not be cached by the page pool.
+   *
+   * @param  first_page_id the ID of the first page to be written
+   * @param  page_count    the number of pages to be written
+   * @param  data          the pages' content; must hold page_count pages
+   * @return               most likely kSuccess or kIoError */
+  Status WritePageRun(size_t first_page_id, size_t page_count, uint8_t* data);
+
   /** Updates the store to reflect a transaction's commit / roll back.
    *
    * @param transaction must be associated with this store, and closed */
@@ -124,6 +290,34 @@ class StoreImpl {
 #endif  // DCHECK_IS_ON()
 
  private:
+  /** Reads or writes pool pages with consecutive IDs.
+   *
+   * The pool entries' buffers are handed directly to the data file's vectored
+   * I/O methods, so the pages are not copied.
+   *
+   * @param  first_page_id the ID of the first page in the run
+   * @param  page_count    the number of pages in the run
+   * @param  pages         the page pool entries holding the pages
+   * @param  is_write      true for writing the pages, false for reading them
+   * @return               most likely kSuccess or kIoError */
+  Status TransferPageRun(size_t first_page_id, size_t page_count,
+                         Page* const* pages, bool is_write);
+
+  /** Maps the data file into memory, for memory-mapped read-only mode.
+   *
+   * @param  advice the OS hint applied to the whole mapping
+   * @return        kSuccess, kIoError if the VFS cannot map the file, or
+   *                kDataCorrupted if the file is too small to be a store */
+  Status MapDataFile(MappingAdvice advice);
+
+  /** Releases the control blocks created by MappedPage(). */
+  void ReleaseMappedPages();
+
+  /** Updates data_file_page_count_ after pages were written.
+   *
+   * @param end_page_id 1 + the ID of the last page written */
+  void DataFileWritten(size_t end_page_id) noexcept;
+
   /** Use StoreImpl::Create() to obtain StoreImpl instances. */
   StoreImpl(BlockAccessFile* data_file,
             size_t data_file_size,
@@ -173,6 +367,38 @@ class StoreImpl {
   /** Metadata in the data file's header. */
   StoreHeader header_;
 
+  /** See RootCatalog(). Owned by the store. */
+  CatalogImpl* const root_catalog_;
+
+  /** Tracks the free pages in the store's data file. */
+  FreePageManager free_page_manager_;
+
+  /** See readahead_state(). */
+  ReadaheadState readahead_state_;
+
+  /** See prefetch_state(). */
+  PrefetchState prefetch_state_;
+
+  /** See prefetch_mutex(). */
+  std::mutex prefetch_mutex_;
+
+  /** See data_file_page_count(). */
+  std::atomic<size_t> data_file_page_count_;
+
+  /** See has_write_error(). */
+  std::atomic<bool> has_write_error_{false};
+
+  /** The data file's memory mapping. Null if the store is not mapped. */
+  uint8_t* mapped_data_ = nullptr;
+
+  /** The control blocks for the pages in the mapping, indexed by page ID.
+   *
+   * Entries are null until their pages are first used. */
+  std::atomic<Page*>* mapped_pages_ = nullptr;
+
+  /** Number of pages in the data file's mapping. */
+  size_t mapped_page_count_ = 0;
+
   State state_ = State::kOpen;
 };
 
@@ -29,8 +29,8 @@ class StoreImplTest : public ::testing::Test {
   void SetUp() override {
     BlockAccessFile* raw_data_file;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
-        data_file_deleter_.path(), kStorePageShift, true, false, &raw_data_file,
-        &data_file_size_));
+        data_file_deleter_.path(), kStorePageShift, true, false, false,
+        &raw_data_file, &data_file_size_));
     data_file_.reset(raw_data_file);
     RandomAccessFile* raw_log_file;
     ASSERT_EQ(Status::kSuccess, vfs_->OpenForRandomAccess(
@@ -141,6 +141,91 @@ TEST_F(StoreImplTest, WriteReadPage) {
   EXPECT_TRUE(page->IsUnpinned());
 }
 
+TEST_F(StoreImplTest, WritePagesMergesRuns) {
+  constexpr size_t kPageCount = 6;
+  // Pages 2-4 and 8-9 are adjacent.
+  const size_t page_ids[kPageCount] = {2, 3, 4, 6, 8, 9};
+  uint8_t buffer[kPageCount << kStorePageShift];
+  for (size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = static_cast<uint8_t>(rnd_());
+
+  CreatePool(kStorePageShift, kPageCount);
+  PagePool* page_pool = pool_->page_pool();
+  BlockAccessFileWrapper data_file_wrapper(data_file_.release());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file_wrapper, data_file_size_, log_file_.release(),
+      log_file_size_, page_pool, StoreOptions()));
+
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  Page* pages[kPageCount];
+  for (size_t i = 0; i < kPageCount; ++i) {
+    pages[i] = page_pool->AllocPage();
+    ASSERT_TRUE(pages[i] != nullptr);
+    ASSERT_EQ(Status::kSuccess, page_pool->AssignPageToStore(
+        pages[i], store.get(), page_ids[i], PagePool::kIgnorePageData));
+    transaction->WillModifyPage(pages[i]);
+    std::memcpy(pages[i]->data(), buffer + (i << kStorePageShift),
+                1 << kStorePageShift);
+  }
+
+  size_t write_count = data_file_wrapper.write_count();
+  ASSERT_EQ(Status::kSuccess, store->WritePages(pages, kPageCount));
+  EXPECT_EQ(write_count + 3, data_file_wrapper.write_count());
+
+  // Clear the pages to make sure ReadPages fetches the correct content.
+  for (size_t i = 0; i < kPageCount; ++i) {
+    std::memset(pages[i]->data(), 0, 1 << kStorePageShift);
+    transaction->PageWasPersisted(pages[i], store->init_transaction());
+  }
+  ASSERT_EQ(Status::kSuccess, store->ReadPages(pages, kPageCount));
+  for (size_t i = 0; i < kPageCount; ++i) {
+    EXPECT_EQ(0, std::memcmp(pages[i]->data(), buffer + (i << kStorePageShift),
+                             1 << kStorePageShift)) << "page: " << page_ids[i];
+  }
+
+  for (size_t i = 0; i < kPageCount; ++i) {
+    page_pool->UnassignPageFromStore(pages[i]);
+    page_pool->UnpinUnassignedPage(pages[i]);
+  }
+  ASSERT_EQ(Status::kSuccess, transaction->Rollback());
+}
+
+TEST_F(StoreImplTest, CommitMergesWrites) {
+  CreatePool(kStorePageShift, 16);
+  PagePool* page_pool = pool_->page_pool();
+  BlockAccessFileWrapper data_file_wrapper(data_file_.release());
+  UniquePtr<StoreImpl> store(StoreImpl::Create(
+      &data_file_wrapper, data_file_size_, log_file_.release(),
+      log_file_size_, page_pool, StoreOptions()));
+
+  // The pages are modified out of order, and form two runs.
+  const size_t page_ids[] = {7, 3, 12, 5, 4, 6, 13, 11};
+  UniquePtr<TransactionImpl> transaction(store->CreateTransaction());
+  for (size_t page_id : page_ids) {
+    Page* page;
+    ASSERT_EQ(Status::kSuccess, page_pool->StorePage(
+        store.get(), page_id, PagePool::kIgnorePageData, &page));
+    transaction->WillModifyPage(page);
+    std::memset(page->data(), static_cast<int>(page_id), 1 << kStorePageShift);
+    page_pool->UnpinStorePage(page);
+  }
+
+  size_t write_count = data_file_wrapper.write_count();
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+  EXPECT_EQ(write_count + 2, data_file_wrapper.write_count());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  uint8_t expected[1 << kStorePageShift];
+  uint8_t data[1 << kStorePageShift];
+  for (size_t page_id : page_ids) {
+    std::memset(expected, static_cast<int>(page_id), sizeof(expected));
+    ASSERT_EQ(Status::kSuccess, data_file_wrapper.Read(
+        page_id << kStorePageShift, sizeof(data), data));
+    EXPECT_EQ(0, std::memcmp(expected, data, sizeof(data)))
+        << "page: " << page_id;
+  }
+}
+
 TEST_F(StoreImplTest, CloseUnassignsPages) {
   CreatePool(kStorePageShift, 16);
   PagePool* page_pool = pool_->page_pool();
@@ -22,6 +22,7 @@ Status BlockAccessFileWrapper::Read(
   DCHECK(!is_closed_);
   if (access_error_ != Status::kSuccess)
     return access_error_;
+  ++read_count_;
   return file_->Read(offset, byte_count, buffer);
 }
 
@@ -30,9 +31,28 @@ Status BlockAccessFileWrapper::Write(
   DCHECK(!is_closed_);
   if (access_error_ != Status::kSuccess)
     return access_error_;
+  ++write_count_;
   return file_->Write(buffer, offset, byte_count);
 }
 
+Status BlockAccessFileWrapper::ReadV(
+    size_t offset, const BlockIoBuffer* buffers, size_t buffer_count) {
+  DCHECK(!is_closed_);
+  if (access_error_ != Status::kSuccess)
+    return access_error_;
+  ++read_count_;
+  return file_->ReadV(offset, buffers, buffer_count);
+}
+
+Status BlockAccessFileWrapper::WriteV(
+    const BlockIoBuffer* buffers, size_t buffer_count, size_t offset) {
+  DCHECK(!is_closed_);
+  if (access_error_ != Status::kSuccess)
+    return access_error_;
+  ++write_count_;
+  return file_->WriteV(buffers, buffer_count, offset);
+}
+
 Status BlockAccessFileWrapper::Sync() {
   DCHECK(!is_closed_);
   if (access_error_ != Status::kSuccess)
@@ -47,6 +67,26 @@ Status BlockAccessFileWrapper::Lock() {
   return file_->Lock();
 }
 
+Status BlockAccessFileWrapper::LockShared() {
+  DCHECK(!is_closed_);
+  if (access_error_ != Status::kSuccess)
+    return access_error_;
+  return file_->LockShared();
+}
+
+Status BlockAccessFileWrapper::MapForReading(
+    size_t byte_count, uint8_t** result) {
+  DCHECK(!is_closed_);
+  if (access_error_ != Status::kSuccess)
+    return access_error_;
+  return file_->MapForReading(byte_count, result);
+}
+
+void BlockAccessFileWrapper::AdviseMapping(
+    size_t offset, size_t byte_count, MappingAdvice advice) {
+  DCHECK(!is_closed_);
+  file_->AdviseMapping(offset, byte_count, advice);
+}
 
 Status BlockAccessFileWrapper::Close() {
   DCHECK(!is_closed_);
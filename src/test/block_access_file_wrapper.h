@@ -36,16 +36,34 @@ class BlockAccessFileWrapper : public BlockAccessFile {
     access_error_ = access_error;
   }
 
+  /** The number of Read() and ReadV() calls forwarded to the underlying file.
+   */
+  inline size_t read_count() const noexcept { return read_count_; }
+
+  /** The number of Write() and WriteV() calls forwarded to the underlying file.
+   */
+  inline size_t write_count() const noexcept { return write_count_; }
+
   // BlockAccessFile API.
   Status Read(size_t offset, size_t byte_count, uint8_t* buffer) override;
   Status Write(uint8_t* buffer, size_t offset, size_t byte_count) override;
+  Status ReadV(size_t offset, const BlockIoBuffer* buffers,
+               size_t buffer_count) override;
+  Status WriteV(const BlockIoBuffer* buffers, size_t buffer_count,
+                size_t offset) override;
   Status Sync() override;
   Status Lock() override;
+  Status LockShared() override;
+  Status MapForReading(size_t byte_count, uint8_t** result) override;
+  void AdviseMapping(size_t offset, size_t byte_count,
+                     MappingAdvice advice) override;
   Status Close() override;
 
  private:
   BlockAccessFile* const file_;
   Status access_error_;
+  size_t read_count_ = 0;
+  size_t write_count_ = 0;
   bool is_closed_ = false;
   bool wrapped_file_is_closed_ = false;
 };
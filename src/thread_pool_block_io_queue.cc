@@ -0,0 +1,128 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./thread_pool_block_io_queue.h"
+
+#include <algorithm>
+
+#include "./util/platform_allocator.h"
+
+namespace berrydb {
+
+ThreadPoolBlockIoQueue* ThreadPoolBlockIoQueue::Create(
+    BlockAccessFile* file, size_t queue_depth, size_t thread_count) {
+  void* heap_block = Allocate(sizeof(ThreadPoolBlockIoQueue));
+  ThreadPoolBlockIoQueue* queue = new (heap_block) ThreadPoolBlockIoQueue(
+      file, queue_depth, thread_count);
+  DCHECK_EQ(heap_block, static_cast<void*>(queue));
+  return queue;
+}
+
+ThreadPoolBlockIoQueue::ThreadPoolBlockIoQueue(
+    BlockAccessFile* file, size_t queue_depth, size_t thread_count)
+    : file_(file), queue_depth_(queue_depth) {
+  DCHECK(file != nullptr);
+  DCHECK_GT(queue_depth, 0U);
+  DCHECK_GT(thread_count, 0U);
+
+  staged_operations_.reserve(queue_depth);
+  // Workers beyond the queue depth would never have anything to do.
+  thread_count = std::min(thread_count, queue_depth);
+  workers_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; ++i)
+    workers_.emplace_back(&ThreadPoolBlockIoQueue::RunWorker, this);
+}
+
+ThreadPoolBlockIoQueue::~ThreadPoolBlockIoQueue() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_exiting_ = true;
+  }
+  work_queued_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+}
+
+void ThreadPoolBlockIoQueue::Release() {
+  // Workers finish the queued operations before exiting, so the buffers are
+  // not used after the queue is gone. Staged operations are dropped.
+  void* heap_block = reinterpret_cast<void*>(this);
+  this->~ThreadPoolBlockIoQueue();
+  Deallocate(heap_block, sizeof(ThreadPoolBlockIoQueue));
+}
+
+Status ThreadPoolBlockIoQueue::SubmitRead(
+    size_t offset, size_t byte_count, uint8_t* buffer, void* tag) {
+  return Submit({buffer, offset, byte_count, tag, false});
+}
+
+Status ThreadPoolBlockIoQueue::SubmitWrite(
+    uint8_t* buffer, size_t offset, size_t byte_count, void* tag) {
+  return Submit({buffer, offset, byte_count, tag, true});
+}
+
+Status ThreadPoolBlockIoQueue::Submit(const Operation& operation) {
+  if (pending_count_ >= queue_depth_)
+    return Status::kInvalidArgument;
+
+  ++pending_count_;
+  staged_operations_.push_back(operation);
+  return Status::kSuccess;
+}
+
+Status ThreadPoolBlockIoQueue::Poll(
+    size_t min_count, size_t max_count, BlockIoCompletion* completions,
+    size_t* completion_count) {
+  DCHECK_LE(min_count, max_count);
+  DCHECK_LE(min_count, pending_count_);
+
+  size_t count;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!staged_operations_.empty()) {
+      queued_operations_.insert(queued_operations_.end(),
+                                staged_operations_.begin(),
+                                staged_operations_.end());
+      staged_operations_.clear();
+      work_queued_.notify_all();
+    }
+
+    while (completions_.size() < min_count)
+      work_completed_.wait(lock);
+
+    count = std::min(max_count, completions_.size());
+    std::copy(completions_.begin(), completions_.begin() + count, completions);
+    completions_.erase(completions_.begin(), completions_.begin() + count);
+  }
+
+  pending_count_ -= count;
+  *completion_count = count;
+  return Status::kSuccess;
+}
+
+void ThreadPoolBlockIoQueue::RunWorker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (queued_operations_.empty()) {
+      if (is_exiting_)
+        return;
+      work_queued_.wait(lock);
+      continue;
+    }
+
+    Operation operation = queued_operations_.front();
+    queued_operations_.pop_front();
+    lock.unlock();
+
+    Status status = operation.is_write ?
+        file_->Write(operation.buffer, operation.offset, operation.byte_count) :
+        file_->Read(operation.offset, operation.byte_count, operation.buffer);
+
+    lock.lock();
+    completions_.push_back({operation.tag, status});
+    work_completed_.notify_one();
+  }
+}
+
+}  // namespace berrydb
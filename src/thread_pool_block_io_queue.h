@@ -0,0 +1,103 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_THREAD_POOL_BLOCK_IO_QUEUE_H_
+#define BERRYDB_THREAD_POOL_BLOCK_IO_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "berrydb/platform.h"
+#include "berrydb/status.h"
+#include "berrydb/vfs.h"
+
+namespace berrydb {
+
+/** BlockIoQueue that performs synchronous I/O on worker threads.
+ *
+ * This works with any BlockAccessFile. Files whose Read() and Write() can be
+ * called concurrently, such as files using pread() and pwrite(), can be served
+ * by multiple workers, which keeps multiple operations in flight.
+ *
+ * Submitted operations are staged by the queue's user, and are handed to the
+ * workers in a batch by Poll(), so the workers' mutex is acquired once per
+ * batch.
+ */
+class ThreadPoolBlockIoQueue : public BlockIoQueue {
+ public:
+  /** Creates a queue that issues I/O to the given file.
+   *
+   * @param  file         the file that the queue's operations go to; must
+   *                      outlive the queue
+   * @param  queue_depth  the maximum number of operations that can be queued or
+   *                      in progress at a time
+   * @param  thread_count number of worker threads; must be 1 if the file does
+   *                      not support concurrent I/O
+   */
+  static ThreadPoolBlockIoQueue* Create(
+      BlockAccessFile* file, size_t queue_depth, size_t thread_count);
+
+  // BlockIoQueue.
+  Status SubmitRead(
+      size_t offset, size_t byte_count, uint8_t* buffer, void* tag) override;
+  Status SubmitWrite(
+      uint8_t* buffer, size_t offset, size_t byte_count, void* tag) override;
+  Status Poll(size_t min_count, size_t max_count,
+              BlockIoCompletion* completions,
+              size_t* completion_count) override;
+  void Release() override;
+
+  /** Number of operations submitted and not yet returned by Poll(). */
+  inline size_t pending_count() const noexcept { return pending_count_; }
+
+ private:
+  /** An operation that was submitted and has not completed yet. */
+  struct Operation {
+    uint8_t* buffer;
+    size_t offset;
+    size_t byte_count;
+    void* tag;
+    bool is_write;
+  };
+
+  ThreadPoolBlockIoQueue(
+      BlockAccessFile* file, size_t queue_depth, size_t thread_count);
+  ~ThreadPoolBlockIoQueue() override;
+
+  /** Queues an operation. */
+  Status Submit(const Operation& operation);
+
+  /** The main loop of a worker thread. */
+  void RunWorker();
+
+  BlockAccessFile* const file_;
+  const size_t queue_depth_;
+
+  /** Operations submitted since the last Poll(). Not shared with workers. */
+  std::vector<Operation> staged_operations_;
+  /** Operations submitted and not yet returned by Poll(). */
+  size_t pending_count_ = 0;
+
+  std::vector<std::thread> workers_;
+
+  /** Guards the members below. */
+  std::mutex mutex_;
+  /** Signaled when operations are queued, or when workers must exit. */
+  std::condition_variable work_queued_;
+  /** Signaled when operations complete. */
+  std::condition_variable work_completed_;
+  /** Operations handed to the workers that haven't started yet. */
+  std::deque<Operation> queued_operations_;
+  /** Operations that completed and were not returned by Poll(). */
+  std::deque<BlockIoCompletion> completions_;
+  /** Set when the queue is released. */
+  bool is_exiting_ = false;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_THREAD_POOL_BLOCK_IO_QUEUE_H_
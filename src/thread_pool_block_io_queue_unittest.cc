@@ -0,0 +1,175 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./thread_pool_block_io_queue.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/vfs.h"
+#include "./test/block_access_file_wrapper.h"
+#include "./test/file_deleter.h"
+#include "./util/unique_ptr.h"
+
+namespace berrydb {
+
+class ThreadPoolBlockIoQueueTest : public ::testing::Test {
+ protected:
+  ThreadPoolBlockIoQueueTest()
+      : vfs_(DefaultVfs()), file_deleter_(kFileName) { }
+
+  void SetUp() override {
+    BlockAccessFile* raw_file;
+    size_t file_size;
+    ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+        kFileName, kBlockShift, true, false, false, &raw_file, &file_size));
+    file_.reset(raw_file);
+
+    for (size_t i = 0; i < kBlockCount; ++i) {
+      for (size_t j = 0; j < kBlockSize; ++j)
+        buffer_[i][j] = static_cast<uint8_t>(rnd_());
+    }
+  }
+
+  /** Submits and polls the writes of all the blocks in buffer_. */
+  void WriteBlocks(BlockIoQueue* queue, size_t queue_depth) {
+    BlockIoCompletion completions[kBlockCount];
+    size_t completion_count;
+    for (size_t batch = 0; batch < kBlockCount; batch += queue_depth) {
+      for (size_t i = batch; i < batch + queue_depth; ++i) {
+        ASSERT_EQ(Status::kSuccess, queue->SubmitWrite(
+            buffer_[i], i << kBlockShift, kBlockSize,
+            reinterpret_cast<void*>(i)));
+      }
+      ASSERT_EQ(Status::kSuccess, queue->Poll(
+          queue_depth, queue_depth, completions, &completion_count));
+      ASSERT_EQ(queue_depth, completion_count);
+      for (size_t i = 0; i < completion_count; ++i)
+        EXPECT_EQ(Status::kSuccess, completions[i].status);
+    }
+  }
+
+  const std::string kFileName = "test_thread_pool_block_io_queue.berry";
+  constexpr static size_t kBlockShift = 12;
+  constexpr static size_t kBlockSize = 1 << kBlockShift;
+  constexpr static size_t kBlockCount = 32;
+
+  Vfs* vfs_;
+  // Must precede UniquePtr members, because on Windows all file handles must be
+  // closed before the files can be deleted.
+  FileDeleter file_deleter_;
+  UniquePtr<BlockAccessFile> file_;
+  uint8_t buffer_[kBlockCount][kBlockSize];
+  std::mt19937 rnd_;
+};
+
+constexpr size_t ThreadPoolBlockIoQueueTest::kBlockShift;
+constexpr size_t ThreadPoolBlockIoQueueTest::kBlockSize;
+constexpr size_t ThreadPoolBlockIoQueueTest::kBlockCount;
+
+TEST_F(ThreadPoolBlockIoQueueTest, WritesAndReads) {
+  constexpr size_t kQueueDepth = 8;
+  UniquePtr<ThreadPoolBlockIoQueue> queue(ThreadPoolBlockIoQueue::Create(
+      file_.get(), kQueueDepth, 4));
+  WriteBlocks(queue.get(), kQueueDepth);
+  EXPECT_EQ(0U, queue->pending_count());
+
+  uint8_t read_buffer[kBlockCount][kBlockSize];
+  BlockIoCompletion completions[kQueueDepth];
+  size_t completion_count;
+  bool was_read[kBlockCount] = {};
+  for (size_t i = 0; i < kQueueDepth; ++i) {
+    ASSERT_EQ(Status::kSuccess, queue->SubmitRead(
+        i << kBlockShift, kBlockSize, read_buffer[i],
+        reinterpret_cast<void*>(i)));
+  }
+  EXPECT_EQ(kQueueDepth, queue->pending_count());
+  EXPECT_EQ(Status::kInvalidArgument, queue->SubmitRead(
+      0, kBlockSize, read_buffer[0], nullptr));
+
+  // Each completion frees up a slot for the next read.
+  size_t next_block = kQueueDepth;
+  while (queue->pending_count() > 0) {
+    ASSERT_EQ(Status::kSuccess, queue->Poll(
+        1, kQueueDepth, completions, &completion_count));
+    ASSERT_LE(1U, completion_count);
+    for (size_t i = 0; i < completion_count; ++i) {
+      size_t block = reinterpret_cast<size_t>(completions[i].tag);
+      EXPECT_EQ(Status::kSuccess, completions[i].status);
+      EXPECT_FALSE(was_read[block]) << "block: " << block;
+      was_read[block] = true;
+
+      if (next_block < kBlockCount) {
+        ASSERT_EQ(Status::kSuccess, queue->SubmitRead(
+            next_block << kBlockShift, kBlockSize, read_buffer[next_block],
+            reinterpret_cast<void*>(next_block)));
+        ++next_block;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < kBlockCount; ++i) {
+    EXPECT_TRUE(was_read[i]) << "block: " << i;
+    EXPECT_EQ(0, std::memcmp(buffer_[i], read_buffer[i], kBlockSize))
+        << "block: " << i;
+  }
+}
+
+TEST_F(ThreadPoolBlockIoQueueTest, ReportsErrors) {
+  // The wrapper is not thread-safe, so the queue only gets one worker.
+  BlockAccessFileWrapper file_wrapper(file_.release());
+  UniquePtr<ThreadPoolBlockIoQueue> queue(ThreadPoolBlockIoQueue::Create(
+      &file_wrapper, 4, 1));
+  WriteBlocks(queue.get(), 4);
+  EXPECT_EQ(kBlockCount, file_wrapper.write_count());
+
+  file_wrapper.SetAccessError(Status::kIoError);
+  uint8_t read_buffer[kBlockSize];
+  ASSERT_EQ(Status::kSuccess, queue->SubmitRead(
+      0, kBlockSize, read_buffer, nullptr));
+  BlockIoCompletion completion;
+  size_t completion_count;
+  ASSERT_EQ(Status::kSuccess, queue->Poll(
+      1, 1, &completion, &completion_count));
+  ASSERT_EQ(1U, completion_count);
+  EXPECT_EQ(nullptr, completion.tag);
+  EXPECT_EQ(Status::kIoError, completion.status);
+}
+
+TEST_F(ThreadPoolBlockIoQueueTest, ReleaseFinishesStartedOperations) {
+  constexpr size_t kQueueDepth = 8;
+  constexpr size_t kStartedCount = 6;
+  ThreadPoolBlockIoQueue* queue = ThreadPoolBlockIoQueue::Create(
+      file_.get(), kQueueDepth, 4);
+  for (size_t i = 0; i < kStartedCount; ++i) {
+    ASSERT_EQ(Status::kSuccess, queue->SubmitWrite(
+        buffer_[i], i << kBlockShift, kBlockSize, nullptr));
+  }
+  // Polling starts the writes, without waiting for them.
+  BlockIoCompletion completions[kQueueDepth];
+  size_t completion_count;
+  ASSERT_EQ(Status::kSuccess, queue->Poll(
+      0, kQueueDepth, completions, &completion_count));
+
+  // Writes submitted after the last Poll() are dropped.
+  ASSERT_EQ(Status::kSuccess, queue->SubmitWrite(
+      buffer_[kStartedCount], kStartedCount << kBlockShift, kBlockSize,
+      nullptr));
+  queue->Release();
+
+  uint8_t read_buffer[kBlockSize];
+  for (size_t i = 0; i < kStartedCount; ++i) {
+    ASSERT_EQ(Status::kSuccess, file_->Read(
+        i << kBlockShift, kBlockSize, read_buffer));
+    EXPECT_EQ(0, std::memcmp(buffer_[i], read_buffer, kBlockSize))
+        << "block: " << i;
+  }
+  EXPECT_EQ(Status::kIoError, file_->Read(
+      kStartedCount << kBlockShift, kBlockSize, read_buffer));
+}
+
+}  // namespace berrydb
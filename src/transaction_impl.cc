@@ -4,9 +4,27 @@
 
 #include "./transaction_impl.h"
 
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
 #include "berrydb/status.h"
+#include "berrydb/value_handle.h"
+#include "./btree.h"
+#include "./bulk_loader_impl.h"
+#include "./catalog_impl.h"
+#include "./cursor_impl.h"
+#include "./format/btree_page_format.h"
+#include "./format/overflow_page_format.h"
+#include "./free_page_manager.h"
+#include "./overflow_chain.h"
 #include "./page_pool.h"
+#include "./space_impl.h"
 #include "./store_impl.h"
+#include "./util/platform_allocator.h"
+#include "./value_reader_impl.h"
+#include "./write_batch_impl.h"
 
 // TODO(pwnall): Remove this once we don't need to DCHECK a Status value.
 #include "berrydb/ostream_ops.h"
@@ -53,6 +71,9 @@ TransactionImpl::TransactionImpl(StoreImpl* store, bool is_init)
 TransactionImpl::~TransactionImpl() {
   if (!is_closed_)
     Rollback();
+
+  if (value_buffer_ != nullptr)
+    Deallocate(value_buffer_, value_buffer_size_);
 }
 
 
@@ -68,33 +89,428 @@ bool TransactionImpl::IsInit() const noexcept {
 }
 #endif  // DCHECK_IS_ON()
 
+void TransactionImpl::TakePageFromInitTransaction(Page* page) {
+  TransactionImpl* page_transaction = page->transaction();
+  DCHECK_NE(page_transaction, this);
+
+// A page may not be modified by two transactions at the same time. This follows
+// from the concurrency model, which states that a Space modified by a
+// transaction must not be accessed by any concurrent transaction. The only
+// exception is a free list page that the allocation transaction modified, and
+// then handed out as a free page.
+#if DCHECK_IS_ON()
+  DCHECK(page_transaction->is_init_ ||
+         page_transaction == store_->free_page_manager()->alloc_transaction());
+  DCHECK(!page->is_dirty() || !page_transaction->is_init_);
+#endif  // DCHECK_IS_ON()
+
+  // TODO(pwnall): Once logging is done, consider if it's possible for a page
+  //     not to be dirty while it is assigned to a non-init transaction. If not,
+  //     the check in WillModifyPage() can be turned into an early return when
+  //     the page is already assigned to this transaction.
+
+  // The init transaction's page list is shared with all the threads that use
+  // the store's pool.
+  PagePool::AssignmentLock assignment_lock(store_->page_pool());
+  page_transaction->pool_pages_.erase(page);
+  pool_pages_.push_back(page);
+  page->ReassignToTransaction(this);
+}
+
+void TransactionImpl::TakePagesFrom(TransactionImpl* other) {
+  DCHECK(other != this);
+  DCHECK_EQ(store_, other->store());
+
+  // Transaction page lists are changed under the assignment latch, because
+  // the page pool's cleaner can move their pages to the init transaction.
+  PagePool::AssignmentLock assignment_lock(store_->page_pool());
+  while (!other->pool_pages_.empty()) {
+    Page* page = other->pool_pages_.front();
+    other->pool_pages_.pop_front();
+    pool_pages_.push_back(page);
+    page->ReassignToTransaction(this);
+  }
+}
+
+void TransactionImpl::PagesReleased(size_t first_page_id,
+                                    size_t page_count) noexcept {
+  DCHECK(!allocated_pages_.empty());
+
+  // Runs are usually trimmed right after they are allocated.
+  size_t end_page_id = first_page_id + page_count;
+  size_t index = allocated_pages_.size() - 1;
+  while (allocated_pages_[index].first_page_id +
+         allocated_pages_[index].page_count != end_page_id) {
+    DCHECK_GT(index, 0U);
+    --index;
+  }
+
+  PageRun& run = allocated_pages_[index];
+  DCHECK_LE(page_count, run.page_count);
+  run.page_count -= page_count;
+  if (run.page_count == 0)
+    allocated_pages_.erase(allocated_pages_.begin() + index);
+}
+
 Status TransactionImpl::Get(Space* space, string_view key, string_view* value) {
+  DCHECK(space != nullptr);
+  DCHECK(value != nullptr);
+
   if (is_closed_)
     return Status::kAlreadyClosed;
 
-  UNUSED(space);
-  UNUSED(key);
-  UNUSED(value);
-  return Status::kIoError;
+  BTree tree(this, SpaceImpl::FromApi(space)->root_page_id());
+  Page* leaf;
+  size_t slot;
+  Status status = tree.Find(key, &leaf, &slot);
+  if (status != Status::kSuccess)
+    return status;
+
+  PagePool* page_pool = store_->page_pool();
+  string_view leaf_value = BTreePageFormat::Value(leaf->data(), slot);
+  if (!BTreePageFormat::IsOverflowValue(leaf->data(), slot)) {
+    uint8_t* buffer = ReserveValueBuffer(leaf_value.size());
+    std::memcpy(buffer, leaf_value.data(), leaf_value.size());
+    page_pool->UnpinStorePage(leaf);
+    *value = string_view(reinterpret_cast<char*>(buffer), leaf_value.size());
+    return Status::kSuccess;
+  }
+
+  // The value is copied straight from its overflow pages into the value
+  // buffer, without an intermediate copy.
+  OverflowChain chain(this, leaf_value);
+  page_pool->UnpinStorePage(leaf);
+  size_t value_size = static_cast<size_t>(chain.value_size64());
+  // This check should be optimized out on 64-bit architectures.
+  if (value_size != chain.value_size64())
+    return Status::kDatabaseTooLarge;
+
+  uint8_t* buffer = ReserveValueBuffer(value_size);
+  status = chain.ReadAll(buffer);
+  if (status != Status::kSuccess)
+    return status;
+  *value = string_view(reinterpret_cast<char*>(buffer), value_size);
+  return Status::kSuccess;
+}
+
+Status TransactionImpl::Get(Space* space, string_view key,
+                            ValueHandle* value) {
+  DCHECK(space != nullptr);
+  DCHECK(value != nullptr);
+  DCHECK(value->IsEmpty());
+
+  if (is_closed_)
+    return Status::kAlreadyClosed;
+
+  BTree tree(this, SpaceImpl::FromApi(space)->root_page_id());
+  Page* leaf;
+  size_t slot;
+  Status status = tree.Find(key, &leaf, &slot);
+  if (status != Status::kSuccess)
+    return status;
+
+  return ReadLeafValue(leaf, slot, value);
+}
+
+Status TransactionImpl::MultiGet(Space* space, size_t count,
+                                 const string_view* keys, ValueHandle* values,
+                                 Status* statuses) {
+  DCHECK(space != nullptr);
+  DCHECK(keys != nullptr || count == 0);
+  DCHECK(values != nullptr || count == 0);
+  DCHECK(statuses != nullptr || count == 0);
+
+  if (is_closed_)
+    return Status::kAlreadyClosed;
+
+  // The tree is walked in key order, so neighbouring keys share descents.
+  std::vector<size_t, PlatformAllocator<size_t>> key_order(count);
+  for (size_t i = 0; i < count; ++i)
+    key_order[i] = i;
+  std::sort(key_order.begin(), key_order.end(),
+            [keys](size_t index1, size_t index2) {
+              return keys[index1] < keys[index2];
+            });
+
+  std::vector<BTree::Lookup, PlatformAllocator<BTree::Lookup>> lookups(count);
+  for (size_t i = 0; i < count; ++i)
+    lookups[i].key = keys[key_order[i]];
+
+  BTree tree(this, SpaceImpl::FromApi(space)->root_page_id());
+  Status status = tree.FindMany(lookups.data(), count);
+  if (status != Status::kSuccess)
+    return status;
+
+  for (size_t i = 0; i < count; ++i) {
+    const BTree::Lookup& lookup = lookups[i];
+    size_t index = key_order[i];
+    statuses[index] = lookup.status;
+    if (lookup.status != Status::kSuccess)
+      continue;
+
+    // The leaf pin acquired for the lookup is consumed by ReadLeafValue(). A
+    // value whose overflow pages cannot be read only fails its own lookup.
+    statuses[index] = ReadLeafValue(lookup.leaf, lookup.slot, &values[index]);
+  }
+  return Status::kSuccess;
+}
+
+Status TransactionImpl::Prefetch(Space* space, size_t count,
+                                 const string_view* keys) {
+  DCHECK(space != nullptr);
+  DCHECK(keys != nullptr || count == 0);
+
+  if (is_closed_)
+    return Status::kAlreadyClosed;
+
+  std::vector<BTree::Lookup, PlatformAllocator<BTree::Lookup>> lookups(count);
+  for (size_t i = 0; i < count; ++i)
+    lookups[i].key = keys[i];
+  std::sort(lookups.begin(), lookups.end(),
+            [](const BTree::Lookup& lookup1, const BTree::Lookup& lookup2) {
+              return lookup1.key < lookup2.key;
+            });
+
+  // The tree walk only uses the nodes that are in the pool, so it never waits
+  // for reads. The first missing node on each key's path is prefetched.
+  BTree tree(this, SpaceImpl::FromApi(space)->root_page_id());
+  BTree::PageIdVector page_ids;
+  Status status = tree.FindManyCached(lookups.data(), count, &page_ids);
+  if (status != Status::kSuccess)
+    return status;
+
+  // Overflow chains are allocated as page runs, so their page IDs are known
+  // without reading the chains.
+  PagePool* page_pool = store_->page_pool();
+  size_t chunk_capacity =
+      OverflowPageFormat::ChunkCapacity(page_pool->page_size());
+  size_t chain_page_limit = page_ids.size() + page_pool->page_capacity();
+  for (const BTree::Lookup& lookup : lookups) {
+    if (lookup.status != Status::kSuccess)
+      continue;
+
+    const uint8_t* leaf_data = lookup.leaf->data();
+    if (BTreePageFormat::IsOverflowValue(leaf_data, lookup.slot)) {
+      // Leaf cells are not aligned, like in the OverflowChain constructor.
+      alignas(8) uint8_t reference[OverflowPageFormat::kReferenceSize];
+      string_view leaf_value = BTreePageFormat::Value(leaf_data, lookup.slot);
+      DCHECK_EQ(sizeof(reference), leaf_value.size());
+      std::memcpy(reference, leaf_value.data(), sizeof(reference));
+      uint64_t first_page_id64 = OverflowPageFormat::FirstPageId64(reference);
+      uint64_t page_count64 =
+          (OverflowPageFormat::ValueSize64(reference) + chunk_capacity - 1) /
+          chunk_capacity;
+      for (uint64_t i = 0; i < page_count64; ++i) {
+        size_t page_id = static_cast<size_t>(first_page_id64 + i);
+        // Chains that cannot be cached anyway are not prefetched.
+        if (page_id != first_page_id64 + i ||
+            page_ids.size() >= chain_page_limit) {
+          break;
+        }
+        page_ids.push_back(page_id);
+      }
+    }
+    page_pool->UnpinStorePage(lookup.leaf);
+  }
+  page_pool->Prefetch(store_, page_ids.data(), page_ids.size());
+  return Status::kSuccess;
 }
 
 Status TransactionImpl::Put(Space* space, string_view key, string_view value) {
+  DCHECK(space != nullptr);
+
   if (is_closed_)
     return Status::kAlreadyClosed;
+  if (store_->is_mapped())
+    return Status::kReadOnly;
 
-  UNUSED(space);
-  UNUSED(key);
-  UNUSED(value);
-  return Status::kIoError;
+  BTree tree(this, SpaceImpl::FromApi(space)->root_page_id());
+  return tree.Put(key, value);
 }
 
 Status TransactionImpl::Delete(Space* space, string_view key) {
+  DCHECK(space != nullptr);
+
   if (is_closed_)
     return Status::kAlreadyClosed;
+  if (store_->is_mapped())
+    return Status::kReadOnly;
 
-  UNUSED(space);
-  UNUSED(key);
-  return Status::kIoError;
+  BTree tree(this, SpaceImpl::FromApi(space)->root_page_id());
+  return tree.Delete(key);
+}
+
+Status TransactionImpl::Write(WriteBatch* batch) {
+  DCHECK(batch != nullptr);
+
+  if (is_closed_)
+    return Status::kAlreadyClosed;
+  if (store_->is_mapped())
+    return Status::kReadOnly;
+
+  WriteBatchImpl* batch_impl = WriteBatchImpl::FromApi(batch);
+  size_t count = batch_impl->size();
+  std::vector<WriteBatchImpl::Mutation,
+              PlatformAllocator<WriteBatchImpl::Mutation>> mutations(count);
+  batch_impl->ListMutations(mutations.data());
+
+  // Grouping by tree and sorting by key lets each tree apply its mutations
+  // leaf by leaf. The sort is stable, so mutations of the same key are applied
+  // in the order in which they were recorded.
+  std::stable_sort(mutations.begin(), mutations.end(),
+                   [](const WriteBatchImpl::Mutation& mutation1,
+                      const WriteBatchImpl::Mutation& mutation2) {
+                     size_t root1 =
+                         SpaceImpl::FromApi(mutation1.space)->root_page_id();
+                     size_t root2 =
+                         SpaceImpl::FromApi(mutation2.space)->root_page_id();
+                     if (root1 != root2)
+                       return root1 < root2;
+                     return mutation1.key < mutation2.key;
+                   });
+
+  std::vector<BTree::Mutation, PlatformAllocator<BTree::Mutation>>
+      tree_mutations(count);
+  for (size_t i = 0; i < count; ++i) {
+    tree_mutations[i].key = mutations[i].key;
+    tree_mutations[i].value = mutations[i].value;
+    tree_mutations[i].is_delete = mutations[i].is_delete;
+  }
+
+  // BTree::Apply() only checks the mutations of its own tree, so an oversized
+  // entry in a later group would be reported after the earlier groups were
+  // applied. Entry size limits only depend on the page size, so the whole
+  // batch is checked here, before any tree is modified.
+  if (count != 0) {
+    BTree size_checker(
+        this, SpaceImpl::FromApi(mutations[0].space)->root_page_id());
+    for (size_t i = 0; i < count; ++i) {
+      if (!tree_mutations[i].is_delete &&
+          !size_checker.EntryFits(tree_mutations[i].key,
+                                  tree_mutations[i].value)) {
+        return Status::kEntryTooLarge;
+      }
+    }
+  }
+
+  size_t group_start = 0;
+  while (group_start < count) {
+    size_t root_page_id =
+        SpaceImpl::FromApi(mutations[group_start].space)->root_page_id();
+    size_t group_end = group_start + 1;
+    while (group_end < count &&
+           SpaceImpl::FromApi(mutations[group_end].space)->root_page_id() ==
+               root_page_id) {
+      ++group_end;
+    }
+
+    BTree tree(this, root_page_id);
+    Status status = tree.Apply(tree_mutations.data() + group_start,
+                               group_end - group_start);
+    if (status != Status::kSuccess)
+      return status;
+    group_start = group_end;
+  }
+  return Status::kSuccess;
+}
+
+Status TransactionImpl::CreateCursor(
+    Space* space, const CursorOptions& options, CursorImpl** result) {
+  DCHECK(space != nullptr);
+  DCHECK(result != nullptr);
+
+  if (is_closed_)
+    return Status::kAlreadyClosed;
+
+  *result = CursorImpl::Create(this, SpaceImpl::FromApi(space)->root_page_id(),
+                               options);
+  return Status::kSuccess;
+}
+
+Status TransactionImpl::CreateBulkLoader(
+    Space* space, const BulkLoaderOptions& options, BulkLoaderImpl** result) {
+  DCHECK(space != nullptr);
+  DCHECK(result != nullptr);
+
+  if (is_closed_)
+    return Status::kAlreadyClosed;
+  if (store_->is_mapped())
+    return Status::kReadOnly;
+
+  size_t root_page_id = SpaceImpl::FromApi(space)->root_page_id();
+  BTree tree(this, root_page_id);
+  bool is_empty;
+  Status status = tree.IsEmpty(&is_empty);
+  if (status != Status::kSuccess)
+    return status;
+  if (!is_empty)
+    return Status::kInvalidArgument;
+
+  *result = BulkLoaderImpl::Create(this, root_page_id, options);
+  return Status::kSuccess;
+}
+
+Status TransactionImpl::CreateValueReader(
+    Space* space, string_view key, ValueReaderImpl** result) {
+  DCHECK(space != nullptr);
+  DCHECK(result != nullptr);
+
+  if (is_closed_)
+    return Status::kAlreadyClosed;
+
+  BTree tree(this, SpaceImpl::FromApi(space)->root_page_id());
+  Page* leaf;
+  size_t slot;
+  Status status = tree.Find(key, &leaf, &slot);
+  if (status != Status::kSuccess)
+    return status;
+
+  // The leaf's pin is handed over to the reader.
+  *result = ValueReaderImpl::Create(this, leaf, slot);
+  return Status::kSuccess;
+}
+
+Status TransactionImpl::ReadLeafValue(Page* leaf, size_t slot,
+                                      ValueHandle* value) {
+  DCHECK(leaf != nullptr);
+  DCHECK(value != nullptr);
+  DCHECK(value->IsEmpty());
+
+  string_view leaf_value = BTreePageFormat::Value(leaf->data(), slot);
+  if (!BTreePageFormat::IsOverflowValue(leaf->data(), slot)) {
+    // The leaf's pin is handed over to the ValueHandle.
+    value->page_ = leaf;
+    value->value_ = leaf_value;
+    return Status::kSuccess;
+  }
+
+  OverflowChain chain(this, leaf_value);
+  store_->page_pool()->UnpinStorePage(leaf);
+  size_t value_size = static_cast<size_t>(chain.value_size64());
+  // This check should be optimized out on 64-bit architectures.
+  if (value_size != chain.value_size64())
+    return Status::kDatabaseTooLarge;
+
+  void* buffer = Allocate(value_size);
+  Status status = chain.ReadAll(reinterpret_cast<uint8_t*>(buffer));
+  if (status != Status::kSuccess) {
+    Deallocate(buffer, value_size);
+    return status;
+  }
+  value->buffer_ = buffer;
+  value->value_ = string_view(reinterpret_cast<char*>(buffer), value_size);
+  return Status::kSuccess;
+}
+
+uint8_t* TransactionImpl::ReserveValueBuffer(size_t size) {
+  if (size <= value_buffer_size_)
+    return value_buffer_;
+
+  if (value_buffer_ != nullptr)
+    Deallocate(value_buffer_, value_buffer_size_);
+  value_buffer_ = reinterpret_cast<uint8_t*>(Allocate(size));
+  value_buffer_size_ = size;
+  return value_buffer_;
 }
 
 Status TransactionImpl::Close() {
@@ -109,15 +525,27 @@ Status TransactionImpl::Close() {
 
   // We cannot use C++11's range-based for loop because the iterator would get
   // invalidated when we remove the page it's pointing to from the list.
+  //
+  // TODO(pwnall): Rollbacks cannot undo the modifications that the page pool's
+  //               cleaner and evictions wrote. This needs the log.
   for (auto it = pool_pages_.begin(); it != pool_pages_.end(); ) {
     Page* page = *it;
     ++it;
-    page_pool->UnassignPageFromStore(page);
+    if (is_committed_)
+      page_pool->UnassignPageFromStore(page);
+    else
+      page_pool->DiscardPageFromStore(page);
     page_pool->UnpinUnassignedPage(page);
   }
 
+  // The pages are returned after they are unassigned, because the free list
+  // may use them as list pages.
+  Status status = Status::kSuccess;
+  if (!is_committed_)
+    status = store_->free_page_manager()->RollbackAllocatedPages(this);
+
   store_->TransactionClosed(this);
-  return Status::kSuccess;
+  return status;
 }
 
 Status TransactionImpl::Commit() {
@@ -126,6 +554,22 @@ Status TransactionImpl::Commit() {
   if (is_closed_)
     return Status::kAlreadyClosed;
 
+  // The pool's background cleaner could not write some of the store's pages.
+  // They are still dirty, but the data file is unlikely to take them now.
+  if (store_->has_write_error()) {
+    store_->Close();
+    return Status::kIoError;
+  }
+
+  // Merging the freed pages into the store's free list modifies pages, so it
+  // must happen before the transaction's pages are collected. Allocations
+  // must not modify the free list and header pages until they are written.
+  FreePageManager* free_page_manager = store_->free_page_manager();
+  std::unique_lock<std::mutex> alloc_lock(*free_page_manager->mutex());
+  Status status = free_page_manager->CommitFreedPages(this);
+  if (status != Status::kSuccess)
+    return status;
+
   // Write the pages modified by this transaction.
   //
   // This must be a non-init transaction, because only non-init transactions can
@@ -135,25 +579,34 @@ Status TransactionImpl::Commit() {
   PagePool* page_pool = store_->page_pool();
   page_pool->PinTransactionPages(&pool_pages_);
 
-  TransactionImpl* init_transaction = store_->init_transaction();
+  // The pages are written in page ID order, so adjacent pages are written
+  // together.
+  std::vector<Page*, PlatformAllocator<Page*>> pages;
+  pages.reserve(pool_pages_.size());
+  for (Page* page : pool_pages_)
+    pages.push_back(page);
+  std::sort(pages.begin(), pages.end(),
+            [](const Page* page1, const Page* page2) {
+              return page1->page_id() < page2->page_id();
+            });
+
+  // TODO(pwnall): Write REDO records for the pages to the log instead. The
+  //               log write status handling code will remain the same.
+  status = store_->WritePages(pages.data(), pages.size());
+
+  // TODO(pwnall): Handle errors, once we have logging in place.
+  DCHECK_EQ(status, Status::kSuccess);
+  UNUSED(status);
 
-  // We cannot use C++11's range-based for loop because the iterator would get
-  // invalidated when we remove the page it's pointing to from the list.
-  for (auto it = pool_pages_.begin(); it != pool_pages_.end(); ) {
-    Page* page = *it;
-    ++it;
-
-    // TODO(pwnall): Write REDO records for the pages to the log instead. The
-    //               log write status handling code will remain the same.
-    Status status = store_->WritePage(page);
-
-    // TODO(pwnall): Handle errors, once we have logging in place.
-    DCHECK_EQ(status, Status::kSuccess);
-    UNUSED(status);
-
-    PageWasPersisted(page, init_transaction);
-    page_pool->UnpinStorePage(page);
+  TransactionImpl* init_transaction = store_->init_transaction();
+  {
+    PagePool::AssignmentLock assignment_lock(page_pool);
+    for (Page* page : pages)
+      PageWasPersisted(page, init_transaction);
   }
+  alloc_lock.unlock();
+  for (Page* page : pages)
+    page_pool->UnpinStorePage(page);
 
   // TODO(pwnall): Instead of moving the pages between transaction lists one by
   //               one, we could insert the committed transaction list into the
@@ -172,25 +625,64 @@ Status TransactionImpl::Rollback() {
 
 Status TransactionImpl::CreateSpace(
     CatalogImpl* catalog, string_view name, SpaceImpl** result) {
+  DCHECK(result != nullptr);
+
   if (is_closed_)
     return Status::kAlreadyClosed;
+  if (store_->is_mapped())
+    return Status::kReadOnly;
 
-  UNUSED(catalog);
-  UNUSED(name);
-  UNUSED(result);
-  return Status::kIoError;
+  size_t root_page_id;
+  Status status = CreateCatalogEntry(
+      catalog, name, CatalogImpl::EntryType::kSpace, &root_page_id);
+  if (status != Status::kSuccess)
+    return status;
 
+  *result = SpaceImpl::Create(root_page_id);
+  return Status::kSuccess;
 }
 
 Status TransactionImpl::CreateCatalog(
     CatalogImpl* catalog, string_view name, CatalogImpl** result) {
+  DCHECK(result != nullptr);
 
   if (is_closed_)
     return Status::kAlreadyClosed;
-  UNUSED(catalog);
-  UNUSED(name);
-  UNUSED(result);
-  return Status::kIoError;
+  if (store_->is_mapped())
+    return Status::kReadOnly;
+
+  size_t root_page_id;
+  Status status = CreateCatalogEntry(
+      catalog, name, CatalogImpl::EntryType::kCatalog, &root_page_id);
+  if (status != Status::kSuccess)
+    return status;
+
+  *result = CatalogImpl::Create(store_, root_page_id);
+  return Status::kSuccess;
+}
+
+Status TransactionImpl::CreateCatalogEntry(
+    CatalogImpl* catalog, string_view name, CatalogImpl::EntryType type,
+    size_t* root_page_id) {
+  if (catalog == nullptr)
+    catalog = store_->RootCatalog();
+  DCHECK_EQ(store_, catalog->store());
+
+  // The lookup in AddEntry() would also catch duplicates, but only after the
+  // new tree's page was allocated.
+  CatalogImpl::EntryType existing_type;
+  size_t existing_root_page_id;
+  Status status = catalog->FindEntry(this, name, &existing_type,
+                                     &existing_root_page_id);
+  if (status == Status::kSuccess)
+    return Status::kAlreadyExists;
+  if (status != Status::kNotFound)
+    return status;
+
+  status = BTree::Create(this, root_page_id);
+  if (status != Status::kSuccess)
+    return status;
+  return catalog->AddEntry(this, name, type, *root_page_id);
 }
 
 Status TransactionImpl::Delete(CatalogImpl* catalog, string_view name) {
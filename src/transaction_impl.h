@@ -5,19 +5,31 @@
 #ifndef BERRYDB_TRANSACTION_IMPL_H_
 #define BERRYDB_TRANSACTION_IMPL_H_
 
+#include <vector>
+
+#include "./format/catalog_entry_format.h"
+#include "./free_page_list.h"
 #include "./page.h"
 #include "berrydb/transaction.h"
 // #include "./page_pool.h" would cause a cycle
 // #include "./store_impl.h" would cause a cycle
 #include "./util/linked_list.h"
+#include "./util/platform_allocator.h"
 
 namespace berrydb {
 
 class BlockAccessFile;
+class BulkLoaderImpl;
+struct BulkLoaderOptions;
 class CatalogImpl;
+class CursorImpl;
+struct CursorOptions;
 class SpaceImpl;
 class StoreImpl;
 class TransactionImpl;
+class ValueHandle;
+class ValueReaderImpl;
+class WriteBatch;
 
 /** Internal representation for the Transaction class in the public API.
  *
@@ -133,6 +145,8 @@ class TransactionImpl {
     DCHECK(!page->IsUnpinned());
     DCHECK(page->transaction() != nullptr);
     DCHECK_EQ(page->transaction()->store(), store_);
+    // Mapped pages point into a read-only mapping.
+    DCHECK(!page->is_mapped());
 
 // The init transaction will never be committed, so it cannot be used to
 // modify pages.
@@ -140,24 +154,8 @@ class TransactionImpl {
     DCHECK(!is_init_);
 #endif  // DCHECK_IS_ON()
 
-    TransactionImpl* page_transaction = page->transaction();
-    if (page_transaction != this) {
-// A page may not be modified by two transactions at the same time. This
-// follows from the concurrency model, which states that a Space modified
-// by a transaction must not be accessed by any concurrent transaction.
-#if DCHECK_IS_ON()
-      DCHECK(page->transaction()->is_init_);
-#endif  // DCHECK_IS_ON()
-      DCHECK(!page->is_dirty());
-
-      // TODO(pwnall): Once logging is done, consider if it's possible for a
-      //     page not to be dirty while it is assigned to a non-init
-      //     transaction. If not, this check can be turned into an early return
-      //     when the page is already assigned to this transaction.
-      page_transaction->pool_pages_.erase(page);
-      pool_pages_.push_back(page);
-      page->ReassignToTransaction(this);
-    }
+    if (page->transaction() != this)
+      TakePageFromInitTransaction(page);
 
     page->SetDirty(true);
   }
@@ -198,7 +196,8 @@ class TransactionImpl {
    *
    * The caller must have a pin on the page pool entry. The page pool entry must
    * be currently caching a page in this transaction's store, and must be
-   * assigned to this transaction. The page must have been recently
+   * assigned to this transaction. The page must have been recently written
+   * to the store, or its modifications must be discarded by a rollback.
    *
    * @param page a page pool entry that was caching a page in this transaction's
    *             store, and will not be caching the page anymore
@@ -219,8 +218,19 @@ class TransactionImpl {
 
   // See the public API documention for details.
   Status Get(Space* space, string_view key, string_view* value);
+  Status Get(Space* space, string_view key, ValueHandle* value);
+  Status MultiGet(Space* space, size_t count, const string_view* keys,
+                  ValueHandle* values, Status* statuses);
+  Status Prefetch(Space* space, size_t count, const string_view* keys);
   Status Put(Space* space, string_view key, string_view value);
   Status Delete(Space* space, string_view key);
+  Status Write(WriteBatch* batch);
+  Status CreateCursor(Space* space, const CursorOptions& options,
+                      CursorImpl** result);
+  Status CreateBulkLoader(Space* space, const BulkLoaderOptions& options,
+                          BulkLoaderImpl** result);
+  Status CreateValueReader(Space* space, string_view key,
+                           ValueReaderImpl** result);
   Status Commit();
   Status Rollback();
   Status CreateSpace(CatalogImpl* catalog,
@@ -231,6 +241,48 @@ class TransactionImpl {
                        CatalogImpl** result);
   Status Delete(CatalogImpl* catalog, string_view name);
 
+  /** The pages freed by this transaction.
+   *
+   * The pages are added to the store's free page list when the transaction
+   * commits. */
+  inline FreePageList* free_pages() noexcept { return &free_pages_; }
+
+  /** Consecutive pages allocated by a transaction. */
+  struct PageRun {
+    size_t first_page_id;
+    size_t page_count;
+  };
+  using PageRunVector = std::vector<PageRun, PlatformAllocator<PageRun>>;
+
+  /** The pages allocated by this transaction.
+   *
+   * The pages are returned to the store if the transaction is rolled back. */
+  inline PageRunVector* allocated_pages() noexcept { return &allocated_pages_; }
+
+  /** Records pages allocated by the store's FreePageManager. */
+  inline void PagesAllocated(size_t first_page_id, size_t page_count) {
+    if (!allocated_pages_.empty()) {
+      PageRun& last_run = allocated_pages_.back();
+      if (last_run.first_page_id + last_run.page_count == first_page_id) {
+        last_run.page_count += page_count;
+        return;
+      }
+    }
+    allocated_pages_.push_back({first_page_id, page_count});
+  }
+
+  /** Records that the end of an allocated run went back to the store. */
+  void PagesReleased(size_t first_page_id, size_t page_count) noexcept;
+
+  /** Forgets the allocated pages, because they were committed or returned. */
+  inline void ClearAllocatedPages() noexcept { allocated_pages_.clear(); }
+
+  /** Reassigns all the pages assigned to another transaction to this one.
+   *
+   * Used to commit the changes made by the store's allocation transaction
+   * together with this transaction's changes. */
+  void TakePagesFrom(TransactionImpl* other);
+
   inline bool IsClosed() const noexcept {
     DCHECK(!is_committed_ || is_closed_);
     return is_closed_;
@@ -259,6 +311,53 @@ class TransactionImpl {
   /** Common functionality in Commit() and Rollback(). */
   Status Close();
 
+  /** Ensures that the value buffer can hold at least the given number of bytes.
+   *
+   * @return the value buffer */
+  uint8_t* ReserveValueBuffer(size_t size);
+
+  /** Points a ValueHandle to the value stored in a leaf cell.
+   *
+   * Values stored in the leaf are not copied, and the handle takes over the
+   * caller's pin on the leaf. Values stored in overflow pages are copied into a
+   * buffer owned by the handle, and the leaf is unpinned. In both cases, this
+   * method consumes the caller's pin on the leaf.
+   *
+   * @param  leaf  the leaf holding the value's key
+   * @param  slot  the key's slot in the leaf
+   * @param  value must be empty; if the call succeeds, holds the value
+   * @return       most likely kSuccess or kIoError
+   */
+  Status ReadLeafValue(Page* leaf, size_t slot, ValueHandle* value);
+
+  /** Creates an empty B+tree and records it in a catalog.
+   *
+   * This is the common functionality in CreateSpace() and CreateCatalog().
+   *
+   * @param  catalog      the catalog that will reference the new tree; null
+   *                      stands for the store's root catalog
+   * @param  name         the name of the new catalog entry
+   * @param  type         the kind of object stored in the new tree
+   * @param  root_page_id if the call succeeds, receives the ID of the root
+   *                      page of the new tree
+   * @return              kAlreadyExists if the catalog already contains an
+   *                      entry with the given name; otherwise, most likely
+   *                      kSuccess or kIoError */
+  Status CreateCatalogEntry(CatalogImpl* catalog, string_view name,
+                            CatalogEntryFormat::EntryType type,
+                            size_t* root_page_id);
+
+  /** Reassigns a page from the store's init transaction to this transaction.
+   *
+   * Pages handed out by the free list may also be taken from the store's
+   * allocation transaction. This is WillModifyPage()'s slow path. It is not
+   * inlined because it needs the page pool's assignment latch, and this file
+   * cannot include page_pool.h.
+   *
+   * @param page the Page whose data buffer will be modified in this transaction
+   */
+  void TakePageFromInitTransaction(Page* page);
+
 #if DCHECK_IS_ON()
   /** DCHECKs that the given page pool entry was assigned to this transaction.
    *
@@ -287,9 +386,23 @@ class TransactionImpl {
    */
   LinkedList<Page, Page::TransactionLinkedListBridge> pool_pages_;
 
+  /** See free_pages(). */
+  FreePageList free_pages_;
+
+  /** See allocated_pages(). */
+  PageRunVector allocated_pages_;
+
   /** The store this transaction runs against. */
   StoreImpl* const store_;
 
+  /** Holds the value returned by the last Get() call.
+   *
+   * Page data cannot be returned directly, because the page pool entry holding
+   * the page may be evicted as soon as it is unpinned. The buffer is reused
+   * across Get() calls, and is only grown when a larger value is read. */
+  uint8_t* value_buffer_ = nullptr;
+  size_t value_buffer_size_ = 0;
+
   bool is_closed_ = false;
   bool is_committed_ = false;
 
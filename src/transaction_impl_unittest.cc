@@ -0,0 +1,916 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./transaction_impl.h"
+
+#include "berrydb/platform.h"
+
+#if defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+#include <sys/stat.h>
+#endif  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/options.h"
+#include "berrydb/space.h"
+#include "berrydb/status.h"
+#include "berrydb/value_handle.h"
+#include "berrydb/write_batch.h"
+#include "./catalog_impl.h"
+#include "./free_page_list.h"
+#include "./page_pool.h"
+#include "./pool_impl.h"
+#include "./space_impl.h"
+#include "./store_impl.h"
+#include "./test/file_deleter.h"
+#include "./util/unique_ptr.h"
+#include "./value_reader_impl.h"
+#include "./write_batch_impl.h"
+
+// TODO(pwnall): Remove this once we don't need to print a Status value.
+#include "berrydb/ostream_ops.h"
+
+namespace berrydb {
+
+namespace {
+
+/** A value that spans many store pages, whose bytes are not all equal. */
+std::string LargeValue(size_t size) {
+  std::string value;
+  for (size_t i = 0; i < size; ++i)
+    value.push_back(static_cast<char>('a' + (i * 7) % 26));
+  return value;
+}
+
+string_view ToStringView(const std::string& string) {
+  return string_view(string.data(), string.size());
+}
+
+}  // namespace
+
+class TransactionImplTest : public ::testing::Test {
+ protected:
+  TransactionImplTest()
+      : data_file_deleter_(kStoreFileName),
+        log_file_deleter_(StoreImpl::LogFilePath(kStoreFileName)) { }
+
+  void SetUp() override {
+    PoolOptions options;
+    options.page_shift = 12;
+    options.page_pool_size = 42;
+    pool_.reset(PoolImpl::Create(options));
+
+    StoreImpl* raw_store;
+    ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+        kStoreFileName, StoreOptions(), &raw_store));
+    store_.reset(raw_store);
+
+    transaction_.reset(store_->CreateTransaction());
+    SpaceImpl* raw_space;
+    ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+        nullptr, "space", &raw_space));
+    space_.reset(raw_space->ToApi());
+  }
+
+  const std::string kStoreFileName = "test_transaction.berry";
+
+  // Must precede UniquePtr members, because on Windows all file handles must be
+  // closed before the files can be deleted.
+  FileDeleter data_file_deleter_, log_file_deleter_;
+
+  UniquePtr<PoolImpl> pool_;
+  UniquePtr<StoreImpl> store_;
+  UniquePtr<TransactionImpl> transaction_;
+  UniquePtr<Space> space_;
+};
+
+TEST_F(TransactionImplTest, GetValueHandle) {
+  std::string large_value(900, 'v');
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large",
+      string_view(large_value.data(), large_value.size())));
+  PagePool* page_pool = store_->page_pool();
+
+  ValueHandle handle;
+  EXPECT_TRUE(handle.IsEmpty());
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &handle));
+  EXPECT_FALSE(handle.IsEmpty());
+  EXPECT_EQ("value", handle.value());
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+
+  // Handles pin pages, so two handles can point into the same page.
+  ValueHandle large_handle;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(
+      space_.get(), "large", &large_handle));
+  EXPECT_EQ(string_view(large_value.data(), large_value.size()),
+            large_handle.value());
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+
+  handle.Release();
+  EXPECT_TRUE(handle.IsEmpty());
+  EXPECT_EQ(string_view(), handle.value());
+  EXPECT_EQ(1U, page_pool->pinned_pages());
+  large_handle.Release();
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  EXPECT_EQ(Status::kNotFound,
+            transaction_->Get(space_.get(), "missing", &handle));
+  EXPECT_TRUE(handle.IsEmpty());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(TransactionImplTest, ValueHandleMoves) {
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+  PagePool* page_pool = store_->page_pool();
+
+  {
+    ValueHandle handle;
+    ASSERT_EQ(Status::kSuccess,
+              transaction_->Get(space_.get(), "key", &handle));
+    ValueHandle moved_handle(std::move(handle));
+    EXPECT_TRUE(handle.IsEmpty());
+    EXPECT_EQ("value", moved_handle.value());
+    EXPECT_EQ(1U, page_pool->pinned_pages());
+
+    ValueHandle assigned_handle;
+    assigned_handle = std::move(moved_handle);
+    EXPECT_TRUE(moved_handle.IsEmpty());
+    EXPECT_EQ("value", assigned_handle.value());
+    EXPECT_EQ(1U, page_pool->pinned_pages());
+  }
+  // The destructor releases the handle's pin.
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(TransactionImplTest, GetCopiesValue) {
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ("value", value);
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+  EXPECT_EQ(Status::kNotFound,
+            transaction_->Get(space_.get(), "missing", &value));
+}
+
+TEST_F(TransactionImplTest, MultiGet) {
+  // Enough keys to spread over many leaves.
+  std::vector<std::string> keys;
+  for (int i = 0; i < 400; ++i) {
+    char key[32];
+    std::snprintf(key, sizeof(key), "key%06d", (i * 7919) % 400);
+    keys.push_back(key);
+    std::string value = std::string(40, 'v') + key;
+    ASSERT_EQ(Status::kSuccess, transaction_->Put(
+        space_.get(), string_view(key),
+        string_view(value.data(), value.size())));
+  }
+  // Every third key is missing, and the keys are not sorted.
+  std::vector<std::string> lookup_keys;
+  for (size_t i = 0; i < keys.size(); i += 10) {
+    lookup_keys.push_back(keys[i]);
+    if (i % 3 == 0)
+      lookup_keys.push_back(keys[i] + "+");
+  }
+
+  size_t count = lookup_keys.size();
+  std::vector<string_view> key_views;
+  for (const std::string& key : lookup_keys)
+    key_views.push_back(string_view(key.data(), key.size()));
+  std::vector<ValueHandle> values(count);
+  std::vector<Status> statuses(count);
+  ASSERT_EQ(Status::kSuccess, transaction_->MultiGet(
+      space_.get(), count, key_views.data(), values.data(), statuses.data()));
+
+  PagePool* page_pool = store_->page_pool();
+  EXPECT_LT(1U, page_pool->pinned_pages());
+  for (size_t i = 0; i < count; ++i) {
+    const std::string& key = lookup_keys[i];
+    if (key.back() == '+') {
+      EXPECT_EQ(Status::kNotFound, statuses[i]);
+      EXPECT_TRUE(values[i].IsEmpty());
+      continue;
+    }
+    EXPECT_EQ(Status::kSuccess, statuses[i]);
+    std::string value = std::string(40, 'v') + key;
+    EXPECT_EQ(string_view(value.data(), value.size()), values[i].value());
+  }
+
+  for (ValueHandle& value : values)
+    value.Release();
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+}
+
+TEST_F(TransactionImplTest, MultiGetEmptySpace) {
+  string_view keys[] = {"b", "a"};
+  ValueHandle values[2];
+  Status statuses[2];
+  ASSERT_EQ(Status::kSuccess, transaction_->MultiGet(
+      space_.get(), 2, keys, values, statuses));
+  EXPECT_EQ(Status::kNotFound, statuses[0]);
+  EXPECT_EQ(Status::kNotFound, statuses[1]);
+  EXPECT_TRUE(values[0].IsEmpty());
+  EXPECT_TRUE(values[1].IsEmpty());
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+
+  ASSERT_EQ(Status::kSuccess, transaction_->MultiGet(
+      space_.get(), 0, nullptr, nullptr, nullptr));
+
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_EQ(Status::kAlreadyClosed, transaction_->MultiGet(
+      space_.get(), 2, keys, values, statuses));
+}
+
+TEST_F(TransactionImplTest, Prefetch) {
+  std::string large_value = LargeValue(20000);
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", ToStringView(large_value)));
+  std::vector<std::string> keys;
+  for (int i = 0; i < 200; ++i) {
+    char key[32];
+    std::snprintf(key, sizeof(key), "key%06d", i);
+    keys.push_back(key);
+    ASSERT_EQ(Status::kSuccess, transaction_->Put(
+        space_.get(), string_view(key), string_view(key)));
+  }
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  // Reopening the store empties the page pool.
+  transaction_.reset();
+  store_.reset();
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+  transaction_.reset(store_->CreateTransaction());
+  PagePool* page_pool = store_->page_pool();
+
+  string_view prefetch_keys[] = {
+      "large", ToStringView(keys[150]), "missing", ToStringView(keys[3])};
+  // Each call walks the cached part of the tree, so a cold tree is loaded one
+  // level per call.
+  size_t readahead_count = 0;
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_EQ(Status::kSuccess, transaction_->Prefetch(
+        space_.get(), 4, prefetch_keys));
+    if (page_pool->readahead_count() == readahead_count)
+      break;
+    readahead_count = page_pool->readahead_count();
+  }
+  EXPECT_LT(0U, readahead_count);
+
+  // The pages needed by the keys, including the large value's overflow pages,
+  // were all read by Prefetch().
+  size_t misses = page_pool->miss_count();
+  ValueHandle values[4];
+  Status statuses[4];
+  ASSERT_EQ(Status::kSuccess, transaction_->MultiGet(
+      space_.get(), 4, prefetch_keys, values, statuses));
+  EXPECT_EQ(misses, page_pool->miss_count());
+  EXPECT_EQ(Status::kSuccess, statuses[0]);
+  EXPECT_EQ(ToStringView(large_value), values[0].value());
+  EXPECT_EQ(Status::kSuccess, statuses[1]);
+  EXPECT_EQ(ToStringView(keys[150]), values[1].value());
+  EXPECT_EQ(Status::kNotFound, statuses[2]);
+  EXPECT_EQ(Status::kSuccess, statuses[3]);
+  EXPECT_EQ(ToStringView(keys[3]), values[3].value());
+  for (ValueHandle& value : values)
+    value.Release();
+
+  ASSERT_EQ(Status::kSuccess, transaction_->Prefetch(
+      space_.get(), 0, nullptr));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_EQ(Status::kAlreadyClosed, transaction_->Prefetch(
+      space_.get(), 4, prefetch_keys));
+}
+
+TEST_F(TransactionImplTest, WriteBatch) {
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "old", "value"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "deleted", "value"));
+  SpaceImpl* raw_space;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      nullptr, "space2", &raw_space));
+  UniquePtr<Space> space2(raw_space->ToApi());
+
+  // The keys are recorded in reverse order, and fill many leaves.
+  UniquePtr<WriteBatchImpl> batch(WriteBatchImpl::Create());
+  std::vector<std::string> keys;
+  for (int i = 999; i >= 0; --i) {
+    char key[32];
+    std::snprintf(key, sizeof(key), "key%06d", i);
+    keys.push_back(key);
+    batch->Put(space_.get(), string_view(key), string_view(key));
+  }
+  batch->Put(space2.get(), "old", "space2 value");
+  batch->Put(space_.get(), "old", "first update");
+  batch->Put(space_.get(), "old", "second update");
+  batch->Delete(space_.get(), "deleted");
+  batch->Delete(space_.get(), "missing");
+  ASSERT_EQ(Status::kSuccess, transaction_->Write(batch->ToApi()));
+
+  string_view value;
+  for (const std::string& key : keys) {
+    ASSERT_EQ(Status::kSuccess, transaction_->Get(
+        space_.get(), string_view(key.data(), key.size()), &value));
+    EXPECT_EQ(string_view(key.data(), key.size()), value);
+  }
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "old", &value));
+  EXPECT_EQ("second update", value);
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space2.get(), "old", &value));
+  EXPECT_EQ("space2 value", value);
+  EXPECT_EQ(Status::kNotFound,
+            transaction_->Get(space_.get(), "deleted", &value));
+  EXPECT_EQ(Status::kNotFound,
+            transaction_->Get(space2.get(), "key000000", &value));
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+
+  // Applying the same batch again overwrites the keys with the same values.
+  ASSERT_EQ(Status::kSuccess, transaction_->Write(batch->ToApi()));
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(
+      space_.get(), "key000500", &value));
+  EXPECT_EQ("key000500", value);
+}
+
+TEST_F(TransactionImplTest, WriteBatchEntryTooLarge) {
+  SpaceImpl* raw_space;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      nullptr, "space2", &raw_space));
+  UniquePtr<Space> space2(raw_space->ToApi());
+
+  // The spaces are applied in root page order, so the oversized key is placed
+  // in both the first and the last applied space.
+  UniquePtr<WriteBatchImpl> batch(WriteBatchImpl::Create());
+  std::string large_key(5000, 'k');
+  batch->Put(space_.get(), "key", "value");
+  batch->Put(space2.get(), "key", "value");
+  batch->Put(space2.get(),
+             string_view(large_key.data(), large_key.size()), "value");
+  EXPECT_EQ(Status::kEntryTooLarge, transaction_->Write(batch->ToApi()));
+
+  UniquePtr<WriteBatchImpl> batch2(WriteBatchImpl::Create());
+  batch2->Put(space_.get(),
+              string_view(large_key.data(), large_key.size()), "value");
+  batch2->Put(space2.get(), "key", "value");
+  EXPECT_EQ(Status::kEntryTooLarge, transaction_->Write(batch2->ToApi()));
+
+  // The oversized entries are detected before any tree is modified.
+  string_view value;
+  EXPECT_EQ(Status::kNotFound,
+            transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ(Status::kNotFound,
+            transaction_->Get(space2.get(), "key", &value));
+
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_EQ(Status::kAlreadyClosed, transaction_->Write(batch->ToApi()));
+}
+
+TEST_F(TransactionImplTest, LargeValues) {
+  // The value is much larger than the page pool.
+  std::string large_value = LargeValue(1 << 20);
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", ToStringView(large_value)));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+  PagePool* page_pool = store_->page_pool();
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "large", &value));
+  EXPECT_EQ(ToStringView(large_value), value);
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  {
+    // Large values are copied into the handle, so no page stays pinned.
+    ValueHandle handle;
+    ASSERT_EQ(Status::kSuccess,
+              transaction_->Get(space_.get(), "large", &handle));
+    EXPECT_EQ(0U, page_pool->pinned_pages());
+    ValueHandle moved_handle(std::move(handle));
+    EXPECT_TRUE(handle.IsEmpty());
+    EXPECT_EQ(ToStringView(large_value), moved_handle.value());
+  }
+
+  string_view keys[] = {"large", "key", "missing"};
+  ValueHandle values[3];
+  Status statuses[3];
+  ASSERT_EQ(Status::kSuccess, transaction_->MultiGet(
+      space_.get(), 3, keys, values, statuses));
+  EXPECT_EQ(Status::kSuccess, statuses[0]);
+  EXPECT_EQ(ToStringView(large_value), values[0].value());
+  EXPECT_EQ(Status::kSuccess, statuses[1]);
+  EXPECT_EQ("value", values[1].value());
+  EXPECT_EQ(Status::kNotFound, statuses[2]);
+  for (ValueHandle& handle : values)
+    handle.Release();
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  // Overwriting a large value with a small value and the other way around.
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", "small"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "key", ToStringView(large_value)));
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "large", &value));
+  EXPECT_EQ("small", value);
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ(ToStringView(large_value), value);
+}
+
+TEST_F(TransactionImplTest, LargeValuesSurviveCommit) {
+  std::string large_value = LargeValue(100000);
+  UniquePtr<WriteBatchImpl> batch(WriteBatchImpl::Create());
+  batch->Put(space_.get(), "large", ToStringView(large_value));
+  batch->Put(space_.get(), "key", "value");
+  ASSERT_EQ(Status::kSuccess, transaction_->Write(batch->ToApi()));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "large", &value));
+  EXPECT_EQ(ToStringView(large_value), value);
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ("value", value);
+}
+
+TEST_F(TransactionImplTest, LargeValuePagesAreFreed) {
+  std::string large_value = LargeValue(20000);
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", ToStringView(large_value)));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "deleted", ToStringView(large_value)));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_EQ(FreePageList::kInvalidPageId,
+            store_->header()->free_list_head_page);
+  size_t page_count = store_->header()->page_count;
+
+  // Overwriting and deleting the values frees their overflow pages.
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "large", &value));
+  EXPECT_EQ(ToStringView(large_value), value);
+  ASSERT_EQ(Status::kSuccess,
+            transaction_->Put(space_.get(), "large", "small"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Delete(space_.get(), "deleted"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_NE(FreePageList::kInvalidPageId,
+            store_->header()->free_list_head_page);
+  EXPECT_EQ(page_count, store_->header()->page_count);
+
+  // New tree nodes reuse the freed pages, so the data file does not grow.
+  transaction_.reset(store_->CreateTransaction());
+  for (int i = 0; i < 4; ++i) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "space%d", i);
+    SpaceImpl* raw_space;
+    ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+        nullptr, name, &raw_space));
+    raw_space->Release();
+  }
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "large", &value));
+  EXPECT_EQ("small", value);
+  EXPECT_EQ(Status::kNotFound,
+            transaction_->Get(space_.get(), "deleted", &value));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_EQ(page_count, store_->header()->page_count);
+}
+
+TEST_F(TransactionImplTest, DirectIo) {
+  // The pool and store created by SetUp() are replaced by a direct I/O pool
+  // that is small enough to evict the large value's pages.
+  space_.reset();
+  transaction_.reset();
+  store_.reset();
+  PoolOptions options;
+  options.page_shift = 12;
+  options.page_pool_size = 16;
+  options.page_pool_direct_io = true;
+  pool_.reset(PoolImpl::Create(options));
+  EXPECT_TRUE(pool_->page_pool()->uses_direct_io());
+  EXPECT_TRUE(pool_->page_pool()->uses_slabs());
+
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+  transaction_.reset(store_->CreateTransaction());
+  // The store file already lists the space created by SetUp().
+  SpaceImpl* raw_space;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      nullptr, "direct_io_space", &raw_space));
+  space_.reset(raw_space->ToApi());
+
+  std::string large_value = LargeValue(100000);
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", ToStringView(large_value)));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  // Reopening the store empties the page pool, so all the pages are read back
+  // from the data file.
+  transaction_.reset();
+  store_.reset();
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "large", &value));
+  EXPECT_EQ(ToStringView(large_value), value);
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ("value", value);
+}
+
+TEST_F(TransactionImplTest, CatalogsSurviveReopening) {
+  SpaceImpl* raw_space;
+  EXPECT_EQ(Status::kAlreadyExists, transaction_->CreateSpace(
+      nullptr, "space", &raw_space));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+
+  CatalogImpl* raw_catalog;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateCatalog(
+      nullptr, "catalog", &raw_catalog));
+  UniquePtr<CatalogImpl> catalog(raw_catalog);
+  EXPECT_EQ(Status::kAlreadyExists, transaction_->CreateCatalog(
+      nullptr, "catalog", &raw_catalog));
+  // Names are scoped to their catalogs.
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      catalog.get(), "space", &raw_space));
+  UniquePtr<Space> nested_space(raw_space->ToApi());
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      nested_space.get(), "key", "nested"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  size_t root_page_id = SpaceImpl::FromApi(space_.get())->root_page_id();
+  size_t nested_root_page_id =
+      SpaceImpl::FromApi(nested_space.get())->root_page_id();
+  catalog.reset();
+  nested_space.reset();
+  space_.reset();
+  transaction_.reset();
+  store_.reset();
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+
+  CatalogImpl* root_catalog = store_->RootCatalog();
+  ASSERT_EQ(Status::kSuccess, root_catalog->OpenSpace("space", &raw_space));
+  space_.reset(raw_space->ToApi());
+  EXPECT_EQ(root_page_id, raw_space->root_page_id());
+  EXPECT_EQ(Status::kNotFound, root_catalog->OpenSpace("missing", &raw_space));
+  EXPECT_EQ(Status::kNotFound, root_catalog->OpenSpace("catalog", &raw_space));
+  EXPECT_EQ(Status::kNotFound, root_catalog->OpenCatalog("space",
+                                                         &raw_catalog));
+
+  ASSERT_EQ(Status::kSuccess, root_catalog->OpenCatalog(
+      "catalog", &raw_catalog));
+  catalog.reset(raw_catalog);
+  ASSERT_EQ(Status::kSuccess, catalog->OpenSpace("space", &raw_space));
+  nested_space.reset(raw_space->ToApi());
+  EXPECT_EQ(nested_root_page_id, raw_space->root_page_id());
+
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ("value", value);
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(
+      nested_space.get(), "key", &value));
+  EXPECT_EQ("nested", value);
+}
+
+TEST_F(TransactionImplTest, FreeListSurvivesReopening) {
+  std::string large_value = LargeValue(20000);
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", ToStringView(large_value)));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  transaction_.reset(store_->CreateTransaction());
+  ASSERT_EQ(Status::kSuccess, transaction_->Delete(space_.get(), "large"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  size_t free_list_head_page = store_->header()->free_list_head_page;
+  size_t page_count = store_->header()->page_count;
+  EXPECT_NE(FreePageList::kInvalidPageId, free_list_head_page);
+
+  transaction_.reset();
+  store_.reset();
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+  EXPECT_EQ(free_list_head_page, store_->header()->free_list_head_page);
+  EXPECT_EQ(page_count, store_->header()->page_count);
+}
+
+TEST_F(TransactionImplTest, RollbackReturnsAllocatedPages) {
+  CatalogImpl* raw_catalog;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateCatalog(
+      nullptr, "catalog", &raw_catalog));
+  UniquePtr<CatalogImpl> catalog(raw_catalog);
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  size_t page_count = store_->header()->page_count;
+
+  transaction_.reset(store_->CreateTransaction());
+  SpaceImpl* raw_space;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      nullptr, "rolled_back", &raw_space));
+  UniquePtr<Space> rolled_back_space(raw_space->ToApi());
+  EXPECT_LT(page_count, store_->header()->page_count);
+  ASSERT_EQ(Status::kSuccess, transaction_->Rollback());
+  EXPECT_EQ(page_count, store_->header()->page_count);
+  EXPECT_EQ(FreePageList::kInvalidPageId,
+            store_->header()->free_list_head_page);
+
+  // Pages that are not at the end of the file go on the free list.
+  transaction_.reset(store_->CreateTransaction());
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      nullptr, "rolled_back", &raw_space));
+  rolled_back_space.reset(raw_space->ToApi());
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  ASSERT_EQ(Status::kSuccess, transaction->CreateSpace(
+      catalog.get(), "committed", &raw_space));
+  UniquePtr<Space> committed_space(raw_space->ToApi());
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+  ASSERT_EQ(Status::kSuccess, transaction_->Rollback());
+  EXPECT_NE(FreePageList::kInvalidPageId,
+            store_->header()->free_list_head_page);
+  size_t free_list_head_page = store_->header()->free_list_head_page;
+  page_count = store_->header()->page_count;
+
+  transaction.reset();
+  rolled_back_space.reset();
+  committed_space.reset();
+  catalog.reset();
+  space_.reset();
+  transaction_.reset();
+  store_.reset();
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+  EXPECT_EQ(free_list_head_page, store_->header()->free_list_head_page);
+  EXPECT_EQ(page_count, store_->header()->page_count);
+
+  CatalogImpl* root_catalog = store_->RootCatalog();
+  EXPECT_EQ(Status::kNotFound, root_catalog->OpenSpace(
+      "rolled_back", &raw_space));
+  ASSERT_EQ(Status::kSuccess, root_catalog->OpenCatalog(
+      "catalog", &raw_catalog));
+  catalog.reset(raw_catalog);
+  ASSERT_EQ(Status::kSuccess, catalog->OpenSpace("committed", &raw_space));
+  committed_space.reset(raw_space->ToApi());
+}
+
+TEST_F(TransactionImplTest, ConcurrentAllocations) {
+  CatalogImpl* raw_catalog;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateCatalog(
+      nullptr, "catalog1", &raw_catalog));
+  UniquePtr<CatalogImpl> catalog1(raw_catalog);
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateCatalog(
+      nullptr, "catalog2", &raw_catalog));
+  UniquePtr<CatalogImpl> catalog2(raw_catalog);
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  // Each transaction allocates pages while the other one is open.
+  transaction_.reset(store_->CreateTransaction());
+  UniquePtr<TransactionImpl> transaction(store_->CreateTransaction());
+  SpaceImpl* raw_space;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateSpace(
+      catalog1.get(), "space", &raw_space));
+  UniquePtr<Space> space1(raw_space->ToApi());
+  ASSERT_EQ(Status::kSuccess, transaction->CreateSpace(
+      catalog2.get(), "space", &raw_space));
+  UniquePtr<Space> space2(raw_space->ToApi());
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space1.get(), "key", "1"));
+  ASSERT_EQ(Status::kSuccess, transaction->Put(space2.get(), "key", "2"));
+  ASSERT_EQ(Status::kSuccess, transaction->Commit());
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  size_t page_count = store_->header()->page_count;
+
+  transaction.reset();
+  space1.reset();
+  space2.reset();
+  catalog1.reset();
+  catalog2.reset();
+  space_.reset();
+  transaction_.reset();
+  store_.reset();
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+  EXPECT_EQ(page_count, store_->header()->page_count);
+
+  CatalogImpl* root_catalog = store_->RootCatalog();
+  ASSERT_EQ(Status::kSuccess, root_catalog->OpenCatalog(
+      "catalog1", &raw_catalog));
+  catalog1.reset(raw_catalog);
+  ASSERT_EQ(Status::kSuccess, root_catalog->OpenCatalog(
+      "catalog2", &raw_catalog));
+  catalog2.reset(raw_catalog);
+  ASSERT_EQ(Status::kSuccess, catalog1->OpenSpace("space", &raw_space));
+  space1.reset(raw_space->ToApi());
+  ASSERT_EQ(Status::kSuccess, catalog2->OpenSpace("space", &raw_space));
+  space2.reset(raw_space->ToApi());
+  EXPECT_NE(SpaceImpl::FromApi(space1.get())->root_page_id(),
+            SpaceImpl::FromApi(space2.get())->root_page_id());
+
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space1.get(), "key", &value));
+  EXPECT_EQ("1", value);
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space2.get(), "key", &value));
+  EXPECT_EQ("2", value);
+}
+
+TEST_F(TransactionImplTest, MemoryMapped) {
+  std::string large_value = LargeValue(100000);
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", ToStringView(large_value)));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  transaction_.reset();
+  store_.reset();
+  StoreOptions options;
+  options.memory_mapped = true;
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, options, &raw_store));
+  store_.reset(raw_store);
+  EXPECT_TRUE(store_->is_mapped());
+  PagePool* page_pool = store_->page_pool();
+  size_t allocated_pages = page_pool->allocated_pages();
+  size_t unused_pages = page_pool->unused_pages();
+
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "large", &value));
+  EXPECT_EQ(ToStringView(large_value), value);
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ("value", value);
+  string_view keys[] = {"key", "missing"};
+  ValueHandle values[2];
+  Status statuses[2];
+  ASSERT_EQ(Status::kSuccess, transaction_->MultiGet(
+      space_.get(), 2, keys, values, statuses));
+  EXPECT_EQ(Status::kSuccess, statuses[0]);
+  EXPECT_EQ("value", values[0].value());
+  EXPECT_EQ(Status::kNotFound, statuses[1]);
+  for (ValueHandle& handle : values)
+    handle.Release();
+
+  // The store's pages are read from the mapping, not from the page pool.
+  EXPECT_EQ(allocated_pages, page_pool->allocated_pages());
+  EXPECT_EQ(unused_pages, page_pool->unused_pages());
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+
+  EXPECT_EQ(Status::kReadOnly, transaction_->Put(space_.get(), "key", "v2"));
+  EXPECT_EQ(Status::kReadOnly, transaction_->Delete(space_.get(), "key"));
+  UniquePtr<WriteBatchImpl> batch(WriteBatchImpl::Create());
+  batch->Put(space_.get(), "key", "v2");
+  EXPECT_EQ(Status::kReadOnly, transaction_->Write(batch->ToApi()));
+  SpaceImpl* raw_space;
+  EXPECT_EQ(Status::kReadOnly, transaction_->CreateSpace(
+      nullptr, "space2", &raw_space));
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ("value", value);
+  EXPECT_EQ(Status::kSuccess, transaction_->Commit());
+}
+
+#if defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+
+TEST_F(TransactionImplTest, MemoryMappedStoresExcludeWriters) {
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+
+  // A store cannot be mapped while it is open for writing.
+  StoreOptions options;
+  options.memory_mapped = true;
+  StoreImpl* raw_store;
+  EXPECT_EQ(Status::kAlreadyLocked, pool_->OpenStore(
+      kStoreFileName, options, &raw_store));
+
+  transaction_.reset();
+  store_.reset();
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, options, &raw_store));
+  UniquePtr<StoreImpl> mapped_store(raw_store);
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, options, &raw_store));
+  UniquePtr<StoreImpl> mapped_store2(raw_store);
+  EXPECT_EQ(Status::kAlreadyLocked, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+
+  mapped_store.reset();
+  mapped_store2.reset();
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, StoreOptions(), &raw_store));
+  store_.reset(raw_store);
+}
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+
+#if defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+TEST_F(TransactionImplTest, MemoryMappedReadOnlyFile) {
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  transaction_.reset();
+  store_.reset();
+  ASSERT_EQ(0, ::chmod(kStoreFileName.c_str(), 0444));
+
+  StoreOptions options;
+  options.memory_mapped = true;
+  StoreImpl* raw_store;
+  ASSERT_EQ(Status::kSuccess, pool_->OpenStore(
+      kStoreFileName, options, &raw_store));
+  store_.reset(raw_store);
+  transaction_.reset(store_->CreateTransaction());
+  string_view value;
+  ASSERT_EQ(Status::kSuccess, transaction_->Get(space_.get(), "key", &value));
+  EXPECT_EQ("value", value);
+  EXPECT_EQ(Status::kSuccess, transaction_->Commit());
+}
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+TEST_F(TransactionImplTest, MemoryMappedStoreMustExist) {
+  transaction_.reset();
+  store_.reset();
+
+  StoreOptions options;
+  options.memory_mapped = true;
+  StoreImpl* raw_store;
+  EXPECT_NE(Status::kSuccess, pool_->OpenStore(
+      "test_transaction_missing.berry", options, &raw_store));
+}
+
+TEST_F(TransactionImplTest, ValueReaderStreamsLargeValue) {
+  std::string large_value = LargeValue(1 << 20);
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(
+      space_.get(), "large", ToStringView(large_value)));
+
+  ValueReaderImpl* raw_reader;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateValueReader(
+      space_.get(), "large", &raw_reader));
+  UniquePtr<ValueReaderImpl> reader(raw_reader);
+  EXPECT_EQ(large_value.size(), reader->size());
+
+  PagePool* page_pool = store_->page_pool();
+  std::string read_value;
+  size_t chunk_count = 0;
+  while (true) {
+    string_view chunk;
+    Status status = reader->Next(&chunk);
+    if (status == Status::kNotFound)
+      break;
+    ASSERT_EQ(Status::kSuccess, status);
+    read_value.append(chunk.data(), chunk.size());
+    ++chunk_count;
+
+    // Only the page holding the current chunk is pinned.
+    EXPECT_EQ(1U, page_pool->pinned_pages());
+  }
+  EXPECT_EQ(large_value, read_value);
+  EXPECT_LT(page_pool->page_capacity(), chunk_count);
+  EXPECT_EQ(0U, page_pool->pinned_pages());
+  string_view chunk;
+  EXPECT_EQ(Status::kNotFound, reader->Next(&chunk));
+}
+
+TEST_F(TransactionImplTest, ValueReaderSmallValue) {
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "key", "value"));
+  ASSERT_EQ(Status::kSuccess, transaction_->Put(space_.get(), "empty", ""));
+
+  ValueReaderImpl* raw_reader;
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateValueReader(
+      space_.get(), "key", &raw_reader));
+  UniquePtr<ValueReaderImpl> reader(raw_reader);
+  EXPECT_EQ(5U, reader->size());
+  string_view chunk;
+  ASSERT_EQ(Status::kSuccess, reader->Next(&chunk));
+  EXPECT_EQ("value", chunk);
+  EXPECT_EQ(Status::kNotFound, reader->Next(&chunk));
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+
+  ASSERT_EQ(Status::kSuccess, transaction_->CreateValueReader(
+      space_.get(), "empty", &raw_reader));
+  reader.reset(raw_reader);
+  EXPECT_EQ(0U, reader->size());
+  EXPECT_EQ(Status::kNotFound, reader->Next(&chunk));
+  reader.reset();
+
+  EXPECT_EQ(Status::kNotFound, transaction_->CreateValueReader(
+      space_.get(), "missing", &raw_reader));
+  EXPECT_EQ(0U, store_->page_pool()->pinned_pages());
+  ASSERT_EQ(Status::kSuccess, transaction_->Commit());
+  EXPECT_EQ(Status::kAlreadyClosed, transaction_->CreateValueReader(
+      space_.get(), "key", &raw_reader));
+}
+
+}  // namespace berrydb
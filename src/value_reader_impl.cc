@@ -0,0 +1,94 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./value_reader_impl.h"
+
+#include "berrydb/status.h"
+#include "./format/btree_page_format.h"
+#include "./format/overflow_page_format.h"
+#include "./page.h"
+#include "./page_pool.h"
+#include "./store_impl.h"
+#include "./transaction_impl.h"
+
+namespace berrydb {
+
+static_assert(std::is_standard_layout<ValueReaderImpl>::value,
+    "ValueReaderImpl must be a standard layout type so its public API can be "
+    "exposed cheaply");
+
+namespace {
+
+/** The reference to a chain that holds an empty value. */
+constexpr char kEmptyChainReference[OverflowPageFormat::kReferenceSize] = {};
+
+/** The reference that a reader passes to its chain. */
+string_view ChainReference(Page* leaf, size_t slot) noexcept {
+  if (BTreePageFormat::IsOverflowValue(leaf->data(), slot))
+    return BTreePageFormat::Value(leaf->data(), slot);
+  return string_view(kEmptyChainReference, sizeof(kEmptyChainReference));
+}
+
+}  // namespace
+
+ValueReaderImpl* ValueReaderImpl::Create(TransactionImpl* transaction,
+                                         Page* leaf, size_t slot) {
+  void* heap_block = Allocate(sizeof(ValueReaderImpl));
+  ValueReaderImpl* reader = new (heap_block) ValueReaderImpl(
+      transaction, leaf, slot);
+  DCHECK_EQ(heap_block, static_cast<void*>(reader));
+  return reader;
+}
+
+ValueReaderImpl::ValueReaderImpl(TransactionImpl* transaction, Page* leaf,
+                                 size_t slot)
+    : api_(), transaction_(transaction),
+      page_pool_(transaction->store()->page_pool()),
+      is_overflow_(BTreePageFormat::IsOverflowValue(leaf->data(), slot)),
+      leaf_(leaf), leaf_value_(BTreePageFormat::Value(leaf->data(), slot)),
+      chain_(transaction, ChainReference(leaf, slot)),
+      size_(is_overflow_ ? static_cast<size_t>(chain_.value_size64()) :
+                           leaf_value_.size()) {
+  // The chain copied its reference, so the leaf is not needed anymore.
+  if (is_overflow_) {
+    page_pool_->UnpinStorePage(leaf_);
+    leaf_ = nullptr;
+    leaf_value_ = string_view();
+  }
+}
+
+ValueReaderImpl::~ValueReaderImpl() {
+  if (leaf_ != nullptr)
+    page_pool_->UnpinStorePage(leaf_);
+}
+
+void ValueReaderImpl::Release() {
+  this->~ValueReaderImpl();
+  void* heap_block = static_cast<void*>(this);
+  Deallocate(heap_block, sizeof(ValueReaderImpl));
+}
+
+Status ValueReaderImpl::Next(string_view* chunk) {
+  DCHECK(chunk != nullptr);
+
+  if (transaction_->IsClosed())
+    return Status::kAlreadyClosed;
+  if (is_overflow_)
+    return chain_.Next(chunk);
+
+  // Values stored in leaves are returned in one chunk, which references the
+  // leaf's data. The leaf is unpinned when the next chunk is requested.
+  if (leaf_ != nullptr && !leaf_value_.empty()) {
+    *chunk = leaf_value_;
+    leaf_value_ = string_view();
+    return Status::kSuccess;
+  }
+  if (leaf_ != nullptr) {
+    page_pool_->UnpinStorePage(leaf_);
+    leaf_ = nullptr;
+  }
+  return Status::kNotFound;
+}
+
+}  // namespace berrydb
@@ -0,0 +1,98 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_VALUE_READER_IMPL_H_
+#define BERRYDB_VALUE_READER_IMPL_H_
+
+#include "berrydb/platform.h"
+#include "berrydb/value_reader.h"
+#include "./overflow_chain.h"
+
+namespace berrydb {
+
+class Page;
+class PagePool;
+class TransactionImpl;
+
+/** Internal representation for the ValueReader class in the public API.
+ *
+ * Values stored in B+tree leaves are returned as a single chunk, and the reader
+ * keeps the leaf pinned until the chunk is consumed. Values stored in overflow
+ * pages are streamed by an OverflowChain, so the leaf is unpinned as soon as
+ * the chain's reference is copied.
+ */
+class ValueReaderImpl {
+ public:
+  /** Creates a ValueReaderImpl instance.
+   *
+   * This method consumes the caller's pin on the leaf.
+   *
+   * @param transaction the transaction used to read the value's pages
+   * @param leaf        the B+tree leaf holding the value's key
+   * @param slot        the key's slot in the leaf
+   */
+  static ValueReaderImpl* Create(TransactionImpl* transaction, Page* leaf,
+                                 size_t slot);
+
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline ValueReaderImpl* FromApi(ValueReader* api) noexcept {
+    ValueReaderImpl* impl = reinterpret_cast<ValueReaderImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline const ValueReaderImpl* FromApi(
+      const ValueReader* api) noexcept {
+    const ValueReaderImpl* impl = reinterpret_cast<const ValueReaderImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+
+  /** Computes the public API representation for this reader. */
+  inline ValueReader* ToApi() noexcept { return &api_; }
+
+  // See the public API documention for details.
+  inline size_t size() const noexcept { return size_; }
+  Status Next(string_view* chunk);
+  void Release();
+
+ private:
+  /** Use ValueReaderImpl::Create() to obtain ValueReaderImpl instances. */
+  ValueReaderImpl(TransactionImpl* transaction, Page* leaf, size_t slot);
+  /** Use Release() to destroy ValueReaderImpl instances. */
+  ~ValueReaderImpl();
+
+  // Readers cannot be copied or moved.
+  ValueReaderImpl(const ValueReaderImpl& other) = delete;
+  ValueReaderImpl(ValueReaderImpl&& other) = delete;
+  ValueReaderImpl& operator=(const ValueReaderImpl& other) = delete;
+  ValueReaderImpl& operator=(ValueReaderImpl&& other) = delete;
+
+  /* The public API version of this class. */
+  ValueReader api_;  // Must be the first class member.
+
+  /** The transaction used to read the value's pages. */
+  TransactionImpl* const transaction_;
+  /** The page pool that caches the value's pages. */
+  PagePool* const page_pool_;
+  /** True if the value is stored in overflow pages. */
+  const bool is_overflow_;
+
+  /** The leaf holding a value stored in the tree. nullptr once it is read.
+   *
+   * This is always nullptr for values stored in overflow pages. */
+  Page* leaf_;
+  /** The value stored in the leaf. */
+  string_view leaf_value_;
+  /** Streams the value stored in overflow pages.
+   *
+   * For values stored in leaves, this is an empty chain. */
+  OverflowChain chain_;
+  /** The size of the whole value. */
+  const size_t size_;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_VALUE_READER_IMPL_H_
@@ -0,0 +1,21 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "berrydb/vfs.h"
+
+#include "berrydb/platform.h"
+
+namespace berrydb {
+
+// TODO(pwnall): Put DefaultVfs() behind an #ifdef, so embedders can use the
+//               built-in VFS, but still supply their own default.
+Vfs* DefaultVfs() {
+#if defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+  return BuiltinPosixVfs();
+#else  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+  return BuiltinLibcVfs();
+#endif  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+}
+
+}  // namespace berrydb
@@ -0,0 +1,263 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./io_uring_block_io_queue.h"
+
+#if defined(BERRYDB_PLATFORM_HAVE_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include "../util/platform_allocator.h"
+
+namespace berrydb {
+
+IoUringBlockIoQueue* IoUringBlockIoQueue::Create(int fd, size_t queue_depth) {
+  void* heap_block = Allocate(sizeof(IoUringBlockIoQueue));
+  IoUringBlockIoQueue* queue = new (heap_block) IoUringBlockIoQueue(
+      fd, queue_depth);
+  DCHECK_EQ(heap_block, static_cast<void*>(queue));
+
+  if (!queue->Initialize()) {
+    queue->Release();
+    return nullptr;
+  }
+  return queue;
+}
+
+IoUringBlockIoQueue::IoUringBlockIoQueue(int fd, size_t queue_depth)
+    : fd_(fd), queue_depth_(queue_depth), slots_(queue_depth) {
+  DCHECK_GE(fd, 0);
+  DCHECK_GT(queue_depth, 0U);
+
+  free_slots_.reserve(queue_depth);
+  for (size_t i = queue_depth; i > 0; --i)
+    free_slots_.push_back(static_cast<uint32_t>(i - 1));
+}
+
+IoUringBlockIoQueue::~IoUringBlockIoQueue() {
+  // The kernel may still write into the buffers of operations in progress, so
+  // they must complete before the ring is torn down. Operations that were not
+  // handed to the kernel are dropped with the ring.
+  // Reap() may queue the rest of short transfers, which are also dropped.
+  if (cqes_ != nullptr) {
+    BlockIoCompletion discarded[16];
+    while (pending_count_ > unsubmitted_count_) {
+      size_t count = Reap(discarded, 16);
+      pending_count_ -= count;
+      if (count == 0 && Enter(0, 1) < 0 && errno != EINTR)
+        break;
+    }
+  }
+
+  if (sqes_ != nullptr)
+    ::munmap(sqes_, sqes_size_);
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_)
+    ::munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_ != nullptr)
+    ::munmap(sq_ring_, sq_ring_size_);
+  if (ring_fd_ >= 0)
+    ::close(ring_fd_);
+}
+
+void IoUringBlockIoQueue::Release() {
+  void* heap_block = reinterpret_cast<void*>(this);
+  this->~IoUringBlockIoQueue();
+  Deallocate(heap_block, sizeof(IoUringBlockIoQueue));
+}
+
+bool IoUringBlockIoQueue::Initialize() {
+  if (queue_depth_ > std::numeric_limits<uint32_t>::max())
+    return false;
+
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ring_fd_ = static_cast<int>(::syscall(
+      __NR_io_uring_setup, static_cast<uint32_t>(queue_depth_), &params));
+  if (ring_fd_ < 0)
+    return false;
+
+  // IORING_OP_READ and IORING_OP_WRITE shipped in the same kernel release
+  // (5.6) as this feature flag.
+  if ((params.features & IORING_FEAT_RW_CUR_POS) == 0)
+    return false;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mapping)
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+  void* mapping = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring_fd_,
+                         IORING_OFF_SQ_RING);
+  if (mapping == MAP_FAILED)
+    return false;
+  sq_ring_ = mapping;
+
+  if (single_mapping) {
+    cq_ring_ = sq_ring_;
+  } else {
+    mapping = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (mapping == MAP_FAILED)
+      return false;
+    cq_ring_ = mapping;
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  mapping = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (mapping == MAP_FAILED)
+    return false;
+  sqes_ = static_cast<io_uring_sqe*>(mapping);
+
+  uint8_t* sq_ring = static_cast<uint8_t*>(sq_ring_);
+  sq_tail_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.array);
+  uint8_t* cq_ring = static_cast<uint8_t*>(cq_ring_);
+  cq_head_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+  return true;
+}
+
+Status IoUringBlockIoQueue::SubmitRead(
+    size_t offset, size_t byte_count, uint8_t* buffer, void* tag) {
+  return Submit(IORING_OP_READ, buffer, offset, byte_count, tag);
+}
+
+Status IoUringBlockIoQueue::SubmitWrite(
+    uint8_t* buffer, size_t offset, size_t byte_count, void* tag) {
+  return Submit(IORING_OP_WRITE, buffer, offset, byte_count, tag);
+}
+
+Status IoUringBlockIoQueue::Submit(uint8_t opcode, uint8_t* buffer,
+                                   size_t offset, size_t byte_count,
+                                   void* tag) {
+  if (pending_count_ >= queue_depth_)
+    return Status::kInvalidArgument;
+  // TODO(pwnall): Split larger operations into multiple queue entries.
+  if (byte_count > std::numeric_limits<uint32_t>::max())
+    return Status::kInvalidArgument;
+
+  uint32_t slot = free_slots_.back();
+  free_slots_.pop_back();
+  slots_[slot] = {tag, buffer, offset, static_cast<uint32_t>(byte_count),
+                  opcode};
+  QueueSlot(slot);
+  ++pending_count_;
+  return Status::kSuccess;
+}
+
+void IoUringBlockIoQueue::QueueSlot(uint32_t slot) {
+  const Slot& operation = slots_[slot];
+
+  // Only this thread writes the submission ring's tail. The ring has room for
+  // all the queue's operations, and each operation has at most one entry.
+  uint32_t tail = *sq_tail_;
+  uint32_t index = tail & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(io_uring_sqe));
+  sqe->opcode = operation.opcode;
+  sqe->fd = fd_;
+  sqe->off = operation.offset;
+  sqe->addr = reinterpret_cast<uintptr_t>(operation.buffer);
+  sqe->len = operation.byte_count;
+  sqe->user_data = slot;
+  sq_array_[index] = index;
+  // The kernel must see the entry's contents before it sees the new tail.
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  ++unsubmitted_count_;
+}
+
+Status IoUringBlockIoQueue::Poll(
+    size_t min_count, size_t max_count, BlockIoCompletion* completions,
+    size_t* completion_count) {
+  DCHECK_LE(min_count, max_count);
+  DCHECK_LE(min_count, pending_count_);
+
+  Status status = Status::kSuccess;
+  size_t count = Reap(completions, max_count);
+  while (unsubmitted_count_ > 0 || count < min_count) {
+    // A single system call submits the batch and waits for completions.
+    uint32_t wait_count = static_cast<uint32_t>(
+        (count < min_count) ? min_count - count : 0);
+    int result = Enter(unsubmitted_count_, wait_count);
+    if (result < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      status = Status::kIoError;
+      break;
+    }
+    unsubmitted_count_ -= static_cast<uint32_t>(result);
+    count += Reap(completions + count, max_count - count);
+  }
+
+  pending_count_ -= count;
+  *completion_count = count;
+  return status;
+}
+
+size_t IoUringBlockIoQueue::Reap(BlockIoCompletion* completions,
+                                 size_t max_count) {
+  // Only this thread writes the completion ring's head.
+  uint32_t head = *cq_head_;
+  // The entries' contents must be read after the new tail.
+  uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+  size_t count = 0;
+  while (head != tail && count < max_count) {
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+    int result = cqe.res;
+    ++head;
+
+    Slot& operation = slots_[slot];
+    if (result == -EINTR || result == -EAGAIN) {
+      QueueSlot(slot);
+      continue;
+    }
+    // Reading past the end of the file is an error, like in the POSIX VFS.
+    if (result > 0 && static_cast<uint32_t>(result) < operation.byte_count) {
+      uint32_t transfer_count = static_cast<uint32_t>(result);
+      operation.buffer += transfer_count;
+      operation.offset += transfer_count;
+      operation.byte_count -= transfer_count;
+      QueueSlot(slot);
+      continue;
+    }
+
+    completions[count].tag = operation.tag;
+    completions[count].status =
+        (result >= 0 &&
+         static_cast<uint32_t>(result) == operation.byte_count) ?
+        Status::kSuccess : Status::kIoError;
+    free_slots_.push_back(slot);
+    ++count;
+  }
+
+  // The kernel may reuse the entries once it sees the new head.
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  return count;
+}
+
+int IoUringBlockIoQueue::Enter(uint32_t submit_count, uint32_t wait_count) {
+  return static_cast<int>(::syscall(
+      __NR_io_uring_enter, ring_fd_, submit_count, wait_count,
+      (wait_count > 0) ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+}
+
+}  // namespace berrydb
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_IO_URING)
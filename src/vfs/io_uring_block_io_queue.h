@@ -0,0 +1,132 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_VFS_IO_URING_BLOCK_IO_QUEUE_H_
+#define BERRYDB_VFS_IO_URING_BLOCK_IO_QUEUE_H_
+
+#include "berrydb/platform.h"
+
+#if defined(BERRYDB_PLATFORM_HAVE_IO_URING)
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "berrydb/status.h"
+#include "berrydb/vfs.h"
+
+namespace berrydb {
+
+/** BlockIoQueue backed by a Linux io_uring instance.
+ *
+ * Submitted operations are written to the submission ring right away, and are
+ * handed to the kernel in a batch, by the io_uring_enter() call that Poll()
+ * also uses to wait for completions. The rings are sized so that they can hold
+ * all the queue's operations, so submissions never wait for ring space.
+ *
+ * Short transfers are completed by resubmitting the rest of the operation, like
+ * the pread() / pwrite() loops used by the thread pool backend. Reads that hit
+ * the end of the file fail.
+ *
+ * The queue talks to the kernel via raw system calls, so it does not depend on
+ * liburing.
+ */
+class IoUringBlockIoQueue : public BlockIoQueue {
+ public:
+  /** Creates a queue that issues I/O to a file descriptor.
+   *
+   * @param  fd          the file that the queue's operations go to; must stay
+   *                     open while the queue exists
+   * @param  queue_depth the maximum number of operations that can be queued or
+   *                     in progress at a time
+   * @return             nullptr if the kernel does not support io_uring, or
+   *                     does not allow this process to use it
+   */
+  static IoUringBlockIoQueue* Create(int fd, size_t queue_depth);
+
+  // BlockIoQueue.
+  Status SubmitRead(
+      size_t offset, size_t byte_count, uint8_t* buffer, void* tag) override;
+  Status SubmitWrite(
+      uint8_t* buffer, size_t offset, size_t byte_count, void* tag) override;
+  Status Poll(size_t min_count, size_t max_count,
+              BlockIoCompletion* completions,
+              size_t* completion_count) override;
+  void Release() override;
+
+ private:
+  /** Bookkeeping for an operation that the kernel may be working on.
+   *
+   * The buffer, offset and byte count describe the part of the operation that
+   * has not been transferred yet. */
+  struct Slot {
+    void* tag;
+    uint8_t* buffer;
+    size_t offset;
+    uint32_t byte_count;
+    uint8_t opcode;
+  };
+
+  IoUringBlockIoQueue(int fd, size_t queue_depth);
+  ~IoUringBlockIoQueue() override;
+
+  /** Sets up the io_uring instance. Returns false on failure. */
+  bool Initialize();
+
+  /** Adds an operation to the submission ring. */
+  Status Submit(uint8_t opcode, uint8_t* buffer, size_t offset,
+                size_t byte_count, void* tag);
+
+  /** Writes a submission queue entry for the operation in a slot. */
+  void QueueSlot(uint32_t slot);
+
+  /** Collects the completions available in the completion ring.
+   *
+   * Operations that were interrupted or only transferred part of their data
+   * are queued again, and do not produce completions.
+   *
+   * @return the number of completions written to the array */
+  size_t Reap(BlockIoCompletion* completions, size_t max_count);
+
+  /** Wraps the io_uring_enter() system call. */
+  int Enter(uint32_t submit_count, uint32_t wait_count);
+
+  const int fd_;
+  const size_t queue_depth_;
+  int ring_fd_ = -1;
+
+  /** Operations submitted and not yet returned by Poll(). */
+  size_t pending_count_ = 0;
+  /** Operations in the submission ring that the kernel has not consumed. */
+  uint32_t unsubmitted_count_ = 0;
+
+  /** Indexed by the user_data in submission / completion queue entries. */
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> free_slots_;
+
+  // The ring mappings. The rings share one mapping on newer kernels.
+  void* sq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  void* cq_ring_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  // Pointers into the ring mappings.
+  uint32_t* sq_tail_ = nullptr;
+  uint32_t sq_mask_ = 0;
+  uint32_t* sq_array_ = nullptr;
+  uint32_t* cq_head_ = nullptr;
+  uint32_t* cq_tail_ = nullptr;
+  uint32_t cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+}  // namespace berrydb
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_IO_URING)
+
+#endif  // BERRYDB_VFS_IO_URING_BLOCK_IO_QUEUE_H_
@@ -8,11 +8,13 @@
 
 #include "berrydb/vfs.h"
 
-// TODO(pwnall): This is not as efficient as having separate POSIX and Windows
-//               implementations. Write the separate implementations in the
-//               nearby future.
+// This VFS only relies on the C standard library, so it works everywhere. The
+// POSIX VFS in posix_vfs.cc is faster, and is preferred where it's available.
+//
+// TODO(pwnall): Write a Windows implementation.
 
 #include <cstdio>
+#include <mutex>
 
 #include "berrydb/platform.h"
 #include "berrydb/status.h"
@@ -24,8 +26,9 @@ namespace {
 
 std::FILE* OpenLibcFile(
     const std::string& file_path, bool create_if_missing,
-    bool error_if_exists, size_t* file_size) {
+    bool error_if_exists, bool read_only, size_t* file_size) {
   DCHECK(!error_if_exists || create_if_missing);
+  DCHECK(!read_only || !create_if_missing);
 
   const char* cpath = file_path.c_str();
 
@@ -50,7 +53,7 @@ std::FILE* OpenLibcFile(
         std::fclose(fp);
     }
 
-    fp = std::fopen(cpath, "rb+");
+    fp = std::fopen(cpath, read_only ? "rb" : "rb+");
   }
 
   if (fp != nullptr) {
@@ -101,6 +104,33 @@ Status WriteLibcFile(
   return Status::kSuccess;
 }
 
+// The vectored functions below seek once, and then transfer the buffers in
+// order, because fread() and fwrite() advance the file position.
+
+Status ReadLibcFileV(std::FILE* fp, size_t offset, const BlockIoBuffer* buffers,
+                     size_t buffer_count) {
+  if (std::fseek(fp, static_cast<long>(offset), SEEK_SET) != 0)
+    return Status::kIoError;
+
+  for (size_t i = 0; i < buffer_count; ++i) {
+    if (std::fread(buffers[i].data, buffers[i].byte_count, 1, fp) != 1)
+      return Status::kIoError;
+  }
+  return Status::kSuccess;
+}
+
+Status WriteLibcFileV(std::FILE* fp, const BlockIoBuffer* buffers,
+                      size_t buffer_count, size_t offset) {
+  if (std::fseek(fp, static_cast<long>(offset), SEEK_SET) != 0)
+    return Status::kIoError;
+
+  for (size_t i = 0; i < buffer_count; ++i) {
+    if (std::fwrite(buffers[i].data, buffers[i].byte_count, 1, fp) != 1)
+      return Status::kIoError;
+  }
+  return Status::kSuccess;
+}
+
 Status SyncLibcFile(std::FILE* fp) {
   // HACK(pwnall): fflush() does not have the guarantees we require, but is
   //               the closest that the C/C++ standard has to offer.
@@ -133,6 +163,7 @@ class LibcBlockAccessFile : public BlockAccessFile {
     DCHECK_EQ(byte_count & (block_size_ - 1), 0U);
 #endif  // DCHECK_IS_ON()
 
+    std::lock_guard<std::mutex> lock(mutex_);
     return ReadLibcFile(fp_, offset, byte_count, buffer);
   }
 
@@ -142,10 +173,38 @@ class LibcBlockAccessFile : public BlockAccessFile {
     DCHECK_EQ(byte_count & (block_size_ - 1), 0U);
 #endif  // DCHECK_IS_ON()
 
+    std::lock_guard<std::mutex> lock(mutex_);
     return WriteLibcFile(fp_, buffer, offset, byte_count);
   }
 
-  Status Sync() override { return SyncLibcFile(fp_); }
+  Status ReadV(size_t offset, const BlockIoBuffer* buffers,
+               size_t buffer_count) override {
+#if DCHECK_IS_ON()
+    DCHECK_EQ(offset & (block_size_ - 1), 0U);
+    for (size_t i = 0; i < buffer_count; ++i)
+      DCHECK_EQ(buffers[i].byte_count & (block_size_ - 1), 0U);
+#endif  // DCHECK_IS_ON()
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ReadLibcFileV(fp_, offset, buffers, buffer_count);
+  }
+
+  Status WriteV(const BlockIoBuffer* buffers, size_t buffer_count,
+                size_t offset) override {
+#if DCHECK_IS_ON()
+    DCHECK_EQ(offset & (block_size_ - 1), 0U);
+    for (size_t i = 0; i < buffer_count; ++i)
+      DCHECK_EQ(buffers[i].byte_count & (block_size_ - 1), 0U);
+#endif  // DCHECK_IS_ON()
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return WriteLibcFileV(fp_, buffers, buffer_count, offset);
+  }
+
+  Status Sync() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return SyncLibcFile(fp_);
+  }
 
   Status Lock() override {
     // TODO(pwnall): This should use fcntl(F_SETLK) on POSIX and LockFile() on
@@ -154,6 +213,11 @@ class LibcBlockAccessFile : public BlockAccessFile {
     return Status::kSuccess;
   }
 
+  Status LockShared() override {
+    // TODO(pwnall): See Lock().
+    return Status::kSuccess;
+  }
+
   Status Close() override {
     void* heap_block = reinterpret_cast<void*>(this);
     this->~LibcBlockAccessFile();
@@ -169,6 +233,11 @@ class LibcBlockAccessFile : public BlockAccessFile {
  private:
   std::FILE* fp_;
 
+  /** Serializes I/O, because fseek() and fread() share the file position.
+   *
+   * Page pools read and write a store's data file from multiple threads. */
+  std::mutex mutex_;
+
 #if DCHECK_IS_ON()
   size_t block_size_;
 #endif  // DCHECK_IS_ON()
@@ -218,7 +287,7 @@ class LibcVfs : public Vfs {
       bool error_if_exists, RandomAccessFile** result,
       size_t* file_size) override {
     FILE* fp = OpenLibcFile(
-        file_path, create_if_missing, error_if_exists, file_size);
+        file_path, create_if_missing, error_if_exists, false, file_size);
     if (fp == nullptr)
       return Status::kIoError;
 
@@ -230,10 +299,28 @@ class LibcVfs : public Vfs {
   }
   Status OpenForBlockAccess(
       const std::string& file_path, size_t block_shift,
-      bool create_if_missing, bool error_if_exists,
+      bool create_if_missing, bool error_if_exists, bool direct_io,
       BlockAccessFile** result, size_t* file_size) override {
+    // stdio has no direct I/O support. LibcBlockAccessFile disables stdio's
+    // buffering, which is the closest substitute.
+    UNUSED(direct_io);
+
     FILE* fp = OpenLibcFile(
-        file_path, create_if_missing, error_if_exists, file_size);
+        file_path, create_if_missing, error_if_exists, false, file_size);
+    if (fp == nullptr)
+      return Status::kIoError;
+
+    void* heap_block = Allocate(sizeof(LibcBlockAccessFile));
+    LibcBlockAccessFile* file = new (heap_block) LibcBlockAccessFile(
+        fp, block_shift);
+    DCHECK_EQ(heap_block, reinterpret_cast<void*>(file));
+    *result = file;
+    return Status::kSuccess;
+  }
+  Status OpenForBlockReads(
+      const std::string& file_path, size_t block_shift,
+      BlockAccessFile** result, size_t* file_size) override {
+    FILE* fp = OpenLibcFile(file_path, false, false, true, file_size);
     if (fp == nullptr)
       return Status::kIoError;
 
@@ -253,11 +340,9 @@ class LibcVfs : public Vfs {
   }
 };
 
-// TODO(pwnall): Put DefaultVfs() behind an #ifdef, so embedders can use the
-//               built-in VFS, but still supply their own default.
-Vfs* DefaultVfs() {
+Vfs* BuiltinLibcVfs() {
   // TODO(pwnall): Check whether this is threadsafe.
-  static Vfs* vfs = new (Allocate(sizeof(Vfs))) LibcVfs();
+  static Vfs* vfs = new (Allocate(sizeof(LibcVfs))) LibcVfs();
 
   return vfs;
 }
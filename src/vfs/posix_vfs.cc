@@ -0,0 +1,584 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Use 64-bit file offsets on 32-bit platforms. This must precede all #includes.
+#if !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif  // !defined(_FILE_OFFSET_BITS)
+
+// glibc only defines O_DIRECT if _GNU_SOURCE is defined.
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif  // !defined(_GNU_SOURCE)
+
+#include "berrydb/vfs.h"
+
+#include "berrydb/platform.h"
+
+#if defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+#include <fcntl.h>
+#if defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+#include <sys/file.h>
+#endif  // defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if defined(BERRYDB_PLATFORM_HAVE_PREADV)
+#include <sys/uio.h>
+#endif  // defined(BERRYDB_PLATFORM_HAVE_PREADV)
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <limits>
+
+#include "berrydb/status.h"
+#include "../thread_pool_block_io_queue.h"
+#include "../util/platform_allocator.h"
+#include "./io_uring_block_io_queue.h"
+
+namespace berrydb {
+
+namespace {
+
+/** Direct I/O is only attempted for blocks at least this large.
+ *
+ * Direct I/O must be aligned to the storage device's logical block size, which
+ * is at most 4 KB on common hardware. */
+constexpr size_t kMinDirectIoBlockShift = 12;
+
+/** Upper bound for the worker threads used by a thread pool I/O queue. */
+constexpr size_t kMaxIoQueueThreads = 16;
+
+#if defined(BERRYDB_PLATFORM_HAVE_PREADV)
+/** Upper bound for the buffers passed to one preadv() or pwritev() call.
+ *
+ * Longer buffer arrays are transferred using multiple system calls. */
+#if defined(IOV_MAX) && IOV_MAX < 64
+constexpr size_t kMaxIoVecs = IOV_MAX;
+#else  // defined(IOV_MAX) && IOV_MAX < 64
+constexpr size_t kMaxIoVecs = 64;
+#endif  // defined(IOV_MAX) && IOV_MAX < 64
+#endif  // defined(BERRYDB_PLATFORM_HAVE_PREADV)
+
+/** open() that retries when interrupted by signals. */
+int OpenRetryingOnEintr(const char* path, int flags) {
+  int fd;
+  do {
+    fd = ::open(path, flags, 0644);
+  } while (fd == -1 && errno == EINTR);
+  return fd;
+}
+
+/** Returns -1 on failure, like open(). */
+int OpenPosixFile(
+    const std::string& file_path, bool create_if_missing,
+    bool error_if_exists, bool direct_io, bool read_only, size_t* file_size) {
+  DCHECK(!error_if_exists || create_if_missing);
+  DCHECK(!read_only || !create_if_missing);
+
+  int flags = read_only ? O_RDONLY : O_RDWR;
+#if defined(O_CLOEXEC)
+  flags |= O_CLOEXEC;
+#endif  // defined(O_CLOEXEC)
+  if (create_if_missing)
+    flags |= O_CREAT;
+  if (error_if_exists)
+    flags |= O_EXCL;
+
+  const char* path = file_path.c_str();
+  int fd = -1;
+#if defined(O_DIRECT)
+  if (direct_io) {
+    fd = OpenRetryingOnEintr(path, flags | O_DIRECT);
+
+    // Filesystems that don't support direct I/O fail with EINVAL. Some of them
+    // create the file before failing, so O_EXCL is dropped when retrying. The
+    // file did not exist before the first attempt, because that would have
+    // failed with EEXIST.
+    if (fd == -1 && errno == EINVAL)
+      fd = OpenRetryingOnEintr(path, flags & ~O_EXCL);
+  } else {
+    fd = OpenRetryingOnEintr(path, flags);
+  }
+#else  // defined(O_DIRECT)
+  fd = OpenRetryingOnEintr(path, flags);
+#if defined(F_NOCACHE)
+  // OSX has no O_DIRECT, but can turn off caching on an open file. This is a
+  // hint, so failures are ignored.
+  if (fd != -1 && direct_io)
+    ::fcntl(fd, F_NOCACHE, 1);
+#endif  // defined(F_NOCACHE)
+#endif  // defined(O_DIRECT)
+  if (fd == -1)
+    return -1;
+
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  *file_size = static_cast<size_t>(file_stat.st_size);
+  return fd;
+}
+
+/** True if the byte range can be addressed by off_t on this platform. */
+inline bool IsValidPosixRange(size_t offset, size_t byte_count) {
+  constexpr size_t kMaxOffset =
+      static_cast<size_t>(std::numeric_limits<off_t>::max());
+  return offset <= kMaxOffset && byte_count <= kMaxOffset - offset;
+}
+
+// pread() and pwrite() do not use or change the file position, so the
+// functions below can be called concurrently on the same file descriptor.
+
+Status ReadPosixFile(
+    int fd, size_t offset, size_t byte_count, uint8_t* buffer) {
+  if (!IsValidPosixRange(offset, byte_count))
+    return Status::kIoError;
+
+  while (byte_count > 0) {
+    ssize_t result = ::pread(
+        fd, buffer, byte_count, static_cast<off_t>(offset));
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      return Status::kIoError;
+    }
+    // Reading past the end of the file is an error, like in the libc VFS.
+    if (result == 0)
+      return Status::kIoError;
+
+    size_t read_count = static_cast<size_t>(result);
+    buffer += read_count;
+    offset += read_count;
+    byte_count -= read_count;
+  }
+  return Status::kSuccess;
+}
+
+Status WritePosixFile(
+    int fd, const uint8_t* buffer, size_t offset, size_t byte_count) {
+  if (!IsValidPosixRange(offset, byte_count))
+    return Status::kIoError;
+
+  while (byte_count > 0) {
+    ssize_t result = ::pwrite(
+        fd, buffer, byte_count, static_cast<off_t>(offset));
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      return Status::kIoError;
+    }
+
+    size_t write_count = static_cast<size_t>(result);
+    buffer += write_count;
+    offset += write_count;
+    byte_count -= write_count;
+  }
+  return Status::kSuccess;
+}
+
+#if defined(BERRYDB_PLATFORM_HAVE_PREADV)
+
+/** Implements vectored reads and writes on top of preadv() and pwritev(). */
+Status TransferPosixFileV(
+    int fd, bool is_write, const BlockIoBuffer* buffers, size_t buffer_count,
+    size_t offset) {
+  size_t byte_count = 0;
+  for (size_t i = 0; i < buffer_count; ++i)
+    byte_count += buffers[i].byte_count;
+  if (!IsValidPosixRange(offset, byte_count))
+    return Status::kIoError;
+
+  // iovecs[iovec_start, iovec_end) have not been (fully) transferred yet.
+  iovec iovecs[kMaxIoVecs];
+  size_t iovec_start = 0;
+  size_t iovec_end = 0;
+  while (true) {
+    if (iovec_start == iovec_end) {
+      if (buffer_count == 0)
+        break;
+      iovec_start = 0;
+      iovec_end = std::min(buffer_count, kMaxIoVecs);
+      for (size_t i = 0; i < iovec_end; ++i) {
+        iovecs[i].iov_base = buffers[i].data;
+        iovecs[i].iov_len = buffers[i].byte_count;
+      }
+      buffers += iovec_end;
+      buffer_count -= iovec_end;
+    }
+
+    int iovec_count = static_cast<int>(iovec_end - iovec_start);
+    ssize_t result = is_write ?
+        ::pwritev(fd, iovecs + iovec_start, iovec_count,
+                  static_cast<off_t>(offset)) :
+        ::preadv(fd, iovecs + iovec_start, iovec_count,
+                 static_cast<off_t>(offset));
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      return Status::kIoError;
+    }
+    // Reading past the end of the file is an error, like in ReadPosixFile().
+    if (result == 0 && !is_write)
+      return Status::kIoError;
+
+    // Short transfers may stop in the middle of a buffer.
+    size_t transfer_count = static_cast<size_t>(result);
+    offset += transfer_count;
+    while (iovec_start < iovec_end &&
+           iovecs[iovec_start].iov_len <= transfer_count) {
+      transfer_count -= iovecs[iovec_start].iov_len;
+      ++iovec_start;
+    }
+    if (transfer_count > 0) {
+      iovecs[iovec_start].iov_base =
+          static_cast<uint8_t*>(iovecs[iovec_start].iov_base) + transfer_count;
+      iovecs[iovec_start].iov_len -= transfer_count;
+    }
+  }
+  return Status::kSuccess;
+}
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_PREADV)
+
+/** Translates a VFS mapping hint into a posix_madvise() argument. */
+int PosixMappingAdvice(MappingAdvice advice) {
+  switch (advice) {
+    case MappingAdvice::kNormal:
+      return POSIX_MADV_NORMAL;
+    case MappingAdvice::kRandom:
+      return POSIX_MADV_RANDOM;
+    case MappingAdvice::kSequential:
+      return POSIX_MADV_SEQUENTIAL;
+    case MappingAdvice::kWillNeed:
+      return POSIX_MADV_WILLNEED;
+  }
+
+  DCHECK(false);
+  return POSIX_MADV_NORMAL;
+}
+
+#if defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+
+/** Acquires a whole-file lock without waiting for it.
+ *
+ * flock() locks belong to open file descriptions, unlike fcntl() locks, which
+ * belong to processes. So, a file's lock is not downgraded or dropped when the
+ * same process opens and closes the file again, and opening a store twice in a
+ * process is detected. */
+Status LockPosixFile(int fd, bool shared) {
+  int operation = (shared ? LOCK_SH : LOCK_EX) | LOCK_NB;
+  while (::flock(fd, operation) != 0) {
+    if (errno == EINTR)
+      continue;
+    return (errno == EWOULDBLOCK) ? Status::kAlreadyLocked : Status::kIoError;
+  }
+  return Status::kSuccess;
+}
+
+#else  // defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+
+Status LockPosixFile(int fd, bool shared) {
+  // TODO(pwnall): Use fcntl(F_SETLK) where flock() is not available. Chromium's
+  //               File::Lock() implementation is a good source of inspiration.
+  UNUSED(fd);
+  UNUSED(shared);
+  return Status::kSuccess;
+}
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+
+Status SyncPosixFile(int fd) {
+  int result;
+  do {
+#if defined(BERRYDB_PLATFORM_HAVE_FDATASYNC)
+    // The data and the file size are flushed. Metadata that is not needed to
+    // read the file back, such as the modification time, is not.
+    result = ::fdatasync(fd);
+#else  // defined(BERRYDB_PLATFORM_HAVE_FDATASYNC)
+    // TODO(pwnall): Use fcntl(F_FULLFSYNC) on OSX, where fsync() does not
+    //               flush the drive's write cache.
+    result = ::fsync(fd);
+#endif  // defined(BERRYDB_PLATFORM_HAVE_FDATASYNC)
+  } while (result != 0 && errno == EINTR);
+  return (result == 0) ? Status::kSuccess : Status::kIoError;
+}
+
+}  // anonymous namespace
+
+class PosixBlockAccessFile : public BlockAccessFile {
+ public:
+  PosixBlockAccessFile(int fd, size_t block_shift, bool direct_io)
+      : fd_(fd)
+#if DCHECK_IS_ON()
+      , block_size_(static_cast<size_t>(1) << block_shift),
+      direct_io_(direct_io)
+#endif  // DCHECK_IS_ON()
+      {
+    DCHECK_GE(fd, 0);
+
+    UNUSED(block_shift);
+    UNUSED(direct_io);
+  }
+
+  Status Read(size_t offset, size_t byte_count, uint8_t* buffer) override {
+#if DCHECK_IS_ON()
+    DCHECK_EQ(offset & (block_size_ - 1), 0U);
+    DCHECK_EQ(byte_count & (block_size_ - 1), 0U);
+    if (direct_io_)
+      DCHECK_EQ(reinterpret_cast<uintptr_t>(buffer) & (block_size_ - 1), 0U);
+#endif  // DCHECK_IS_ON()
+
+    return ReadPosixFile(fd_, offset, byte_count, buffer);
+  }
+
+  Status Write(uint8_t* buffer, size_t offset, size_t byte_count) override {
+#if DCHECK_IS_ON()
+    DCHECK_EQ(offset & (block_size_ - 1), 0U);
+    DCHECK_EQ(byte_count & (block_size_ - 1), 0U);
+    if (direct_io_)
+      DCHECK_EQ(reinterpret_cast<uintptr_t>(buffer) & (block_size_ - 1), 0U);
+#endif  // DCHECK_IS_ON()
+
+    return WritePosixFile(fd_, buffer, offset, byte_count);
+  }
+
+#if defined(BERRYDB_PLATFORM_HAVE_PREADV)
+  Status ReadV(size_t offset, const BlockIoBuffer* buffers,
+               size_t buffer_count) override {
+#if DCHECK_IS_ON()
+    DCheckVectoredAccess(offset, buffers, buffer_count);
+#endif  // DCHECK_IS_ON()
+
+    return TransferPosixFileV(fd_, false, buffers, buffer_count, offset);
+  }
+
+  Status WriteV(const BlockIoBuffer* buffers, size_t buffer_count,
+                size_t offset) override {
+#if DCHECK_IS_ON()
+    DCheckVectoredAccess(offset, buffers, buffer_count);
+#endif  // DCHECK_IS_ON()
+
+    return TransferPosixFileV(fd_, true, buffers, buffer_count, offset);
+  }
+#endif  // defined(BERRYDB_PLATFORM_HAVE_PREADV)
+
+  Status Sync() override { return SyncPosixFile(fd_); }
+
+  Status Lock() override { return LockPosixFile(fd_, false); }
+
+  Status LockShared() override { return LockPosixFile(fd_, true); }
+
+  Status CreateIoQueue(size_t queue_depth, BlockIoQueue** result) override {
+    DCHECK_GT(queue_depth, 0U);
+
+#if defined(BERRYDB_PLATFORM_HAVE_IO_URING)
+    // io_uring may be missing from the kernel, or blocked by a sandbox.
+    BlockIoQueue* queue = IoUringBlockIoQueue::Create(fd_, queue_depth);
+    if (queue != nullptr) {
+      *result = queue;
+      return Status::kSuccess;
+    }
+#endif  // defined(BERRYDB_PLATFORM_HAVE_IO_URING)
+
+    // pread() and pwrite() can be issued concurrently, so each worker thread
+    // can have an operation in flight.
+    *result = ThreadPoolBlockIoQueue::Create(
+        this, queue_depth, std::min(queue_depth, kMaxIoQueueThreads));
+    return Status::kSuccess;
+  }
+
+  Status MapForReading(size_t byte_count, uint8_t** result) override {
+    DCHECK(mapping_ == nullptr);
+    DCHECK_GT(byte_count, 0U);
+#if DCHECK_IS_ON()
+    DCHECK_EQ(byte_count & (block_size_ - 1), 0U);
+#endif  // DCHECK_IS_ON()
+
+    // Mappings of files opened with O_DIRECT use the OS page cache, like any
+    // other mapping.
+    void* mapping = ::mmap(nullptr, byte_count, PROT_READ, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED)
+      return Status::kIoError;
+
+    mapping_ = static_cast<uint8_t*>(mapping);
+    mapping_size_ = byte_count;
+    *result = mapping_;
+    return Status::kSuccess;
+  }
+
+  void AdviseMapping(size_t offset, size_t byte_count,
+                     MappingAdvice advice) override {
+    DCHECK(mapping_ != nullptr);
+    DCHECK_LE(offset, mapping_size_);
+    DCHECK_LE(byte_count, mapping_size_ - offset);
+
+    // posix_madvise() requires an address aligned to the OS page size, which
+    // may be larger than the block size.
+    static const size_t os_page_size =
+        static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t aligned_offset = offset & ~(os_page_size - 1);
+    ::posix_madvise(mapping_ + aligned_offset,
+                    byte_count + (offset - aligned_offset),
+                    PosixMappingAdvice(advice));
+  }
+
+  Status Close() override {
+    void* heap_block = reinterpret_cast<void*>(this);
+    this->~PosixBlockAccessFile();
+    Deallocate(heap_block, sizeof(PosixBlockAccessFile));
+    return Status::kSuccess;
+  }
+
+ protected:
+  ~PosixBlockAccessFile() {
+    if (mapping_ != nullptr)
+      ::munmap(mapping_, mapping_size_);
+    ::close(fd_);
+  }
+
+ private:
+#if DCHECK_IS_ON()
+  /** Checks the alignment requirements of ReadV() and WriteV(). */
+  void DCheckVectoredAccess(size_t offset, const BlockIoBuffer* buffers,
+                            size_t buffer_count) {
+    DCHECK_EQ(offset & (block_size_ - 1), 0U);
+    for (size_t i = 0; i < buffer_count; ++i) {
+      DCHECK_EQ(buffers[i].byte_count & (block_size_ - 1), 0U);
+      if (direct_io_) {
+        DCHECK_EQ(reinterpret_cast<uintptr_t>(buffers[i].data) &
+                  (block_size_ - 1), 0U);
+      }
+    }
+  }
+#endif  // DCHECK_IS_ON()
+
+  int fd_;
+
+  /** The file's memory mapping, if MapForReading() was called. */
+  uint8_t* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+
+#if DCHECK_IS_ON()
+  size_t block_size_;
+  /** True if the caller promised to only use block-aligned buffers. */
+  bool direct_io_;
+#endif  // DCHECK_IS_ON()
+};
+
+class PosixRandomAccessFile : public RandomAccessFile {
+ public:
+  PosixRandomAccessFile(int fd) : fd_(fd) {
+    DCHECK_GE(fd, 0);
+  }
+
+  Status Read(size_t offset, size_t byte_count, uint8_t* buffer) override {
+    return ReadPosixFile(fd_, offset, byte_count, buffer);
+  }
+
+  Status Write(
+      const uint8_t* buffer, size_t offset, size_t byte_count) override {
+    return WritePosixFile(fd_, buffer, offset, byte_count);
+  }
+
+  // Writes are not buffered in user space, so there is nothing to flush.
+  Status Flush() override { return Status::kSuccess; }
+
+  Status Sync() override { return SyncPosixFile(fd_); }
+
+  Status Close() override {
+    void* heap_block = reinterpret_cast<void*>(this);
+    this->~PosixRandomAccessFile();
+    Deallocate(heap_block, sizeof(PosixRandomAccessFile));
+    return Status::kSuccess;
+  }
+
+ protected:
+  ~PosixRandomAccessFile() {
+    ::close(fd_);
+  }
+
+ private:
+  int fd_;
+};
+
+class PosixVfs : public Vfs {
+ public:
+  Status OpenForRandomAccess(
+      const std::string& file_path, bool create_if_missing,
+      bool error_if_exists, RandomAccessFile** result,
+      size_t* file_size) override {
+    int fd = OpenPosixFile(
+        file_path, create_if_missing, error_if_exists, false, false,
+        file_size);
+    if (fd == -1)
+      return Status::kIoError;
+
+    void* heap_block = Allocate(sizeof(PosixRandomAccessFile));
+    PosixRandomAccessFile* file = new (heap_block) PosixRandomAccessFile(fd);
+    DCHECK_EQ(heap_block, reinterpret_cast<void*>(file));
+    *result = file;
+    return Status::kSuccess;
+  }
+  Status OpenForBlockAccess(
+      const std::string& file_path, size_t block_shift,
+      bool create_if_missing, bool error_if_exists, bool direct_io,
+      BlockAccessFile** result, size_t* file_size) override {
+    bool use_direct_io = direct_io && block_shift >= kMinDirectIoBlockShift;
+    int fd = OpenPosixFile(file_path, create_if_missing, error_if_exists,
+                           use_direct_io, false, file_size);
+    if (fd == -1)
+      return Status::kIoError;
+
+    void* heap_block = Allocate(sizeof(PosixBlockAccessFile));
+    PosixBlockAccessFile* file = new (heap_block) PosixBlockAccessFile(
+        fd, block_shift, direct_io);
+    DCHECK_EQ(heap_block, reinterpret_cast<void*>(file));
+    *result = file;
+    return Status::kSuccess;
+  }
+  Status OpenForBlockReads(
+      const std::string& file_path, size_t block_shift,
+      BlockAccessFile** result, size_t* file_size) override {
+    int fd = OpenPosixFile(file_path, false, false, false, true, file_size);
+    if (fd == -1)
+      return Status::kIoError;
+
+    void* heap_block = Allocate(sizeof(PosixBlockAccessFile));
+    PosixBlockAccessFile* file = new (heap_block) PosixBlockAccessFile(
+        fd, block_shift, false);
+    DCHECK_EQ(heap_block, reinterpret_cast<void*>(file));
+    *result = file;
+    return Status::kSuccess;
+  }
+
+  Status RemoveFile(const std::string& file_path) override {
+    if (::unlink(file_path.c_str()) != 0)
+      return Status::kIoError;
+
+    return Status::kSuccess;
+  }
+};
+
+Vfs* BuiltinPosixVfs() {
+  static Vfs* vfs = new (Allocate(sizeof(PosixVfs))) PosixVfs();
+
+  return vfs;
+}
+
+}  // namespace berrydb
+
+#else  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+namespace berrydb {
+
+Vfs* BuiltinPosixVfs() { return nullptr; }
+
+}  // namespace berrydb
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
@@ -0,0 +1,295 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "berrydb/vfs.h"
+
+#include "berrydb/platform.h"
+
+#if defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+#include <sys/stat.h>
+#endif  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "berrydb/status.h"
+#include "../test/file_deleter.h"
+
+namespace berrydb {
+
+#if defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+class PosixVfsTest : public ::testing::Test {
+ protected:
+  PosixVfsTest() : vfs_(BuiltinPosixVfs()), file_deleter_(kFileName) { }
+
+  /** Fills a block with a pattern that depends on the block number. */
+  void FillBlock(size_t block_number, uint8_t* buffer) {
+    std::mt19937 rnd(static_cast<uint32_t>(block_number));
+    for (size_t i = 0; i < kBlockSize; ++i)
+      buffer[i] = static_cast<uint8_t>(rnd());
+  }
+
+  const std::string kFileName = "test_posix_vfs.berry";
+  constexpr static size_t kBlockShift = 12;
+  constexpr static size_t kBlockSize = 1 << kBlockShift;
+  Vfs* vfs_;
+  FileDeleter file_deleter_;
+};
+
+constexpr size_t PosixVfsTest::kBlockShift;
+constexpr size_t PosixVfsTest::kBlockSize;
+
+TEST_F(PosixVfsTest, IsDefault) {
+  ASSERT_NE(nullptr, vfs_);
+  EXPECT_EQ(vfs_, DefaultVfs());
+  EXPECT_NE(vfs_, BuiltinLibcVfs());
+}
+
+TEST_F(PosixVfsTest, ReadPastEndOfFile) {
+  uint8_t buffer[kBlockSize];
+  FillBlock(0, buffer);
+
+  RandomAccessFile* file;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForRandomAccess(
+      kFileName, true, true, &file, &file_size));
+  ASSERT_EQ(Status::kSuccess, file->Write(buffer, 0, kBlockSize));
+
+  EXPECT_EQ(Status::kSuccess, file->Read(1, kBlockSize - 1, buffer));
+  EXPECT_EQ(Status::kIoError, file->Read(1, kBlockSize, buffer));
+  EXPECT_EQ(Status::kIoError, file->Read(kBlockSize, 1, buffer));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
+#if defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+
+TEST_F(PosixVfsTest, BlockAccessFileLocks) {
+  BlockAccessFile* files[3];
+  size_t file_size;
+  for (BlockAccessFile*& file : files) {
+    ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+        kFileName, kBlockShift, true, false, false, &file, &file_size));
+  }
+
+  // Shared locks coexist with each other, but not with an exclusive lock.
+  ASSERT_EQ(Status::kSuccess, files[0]->LockShared());
+  ASSERT_EQ(Status::kSuccess, files[1]->LockShared());
+  EXPECT_EQ(Status::kAlreadyLocked, files[2]->Lock());
+
+  // Closing a file releases its lock.
+  EXPECT_EQ(Status::kSuccess, files[0]->Close());
+  EXPECT_EQ(Status::kSuccess, files[1]->Close());
+  ASSERT_EQ(Status::kSuccess, files[2]->Lock());
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, false, false, &files[0], &file_size));
+  EXPECT_EQ(Status::kAlreadyLocked, files[0]->LockShared());
+  EXPECT_EQ(Status::kAlreadyLocked, files[0]->Lock());
+
+  EXPECT_EQ(Status::kSuccess, files[0]->Close());
+  EXPECT_EQ(Status::kSuccess, files[2]->Close());
+}
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+
+TEST_F(PosixVfsTest, ConcurrentBlockAccess) {
+  constexpr size_t kThreadCount = 4;
+  constexpr size_t kBlocksPerThread = 64;
+
+  BlockAccessFile* file;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, true, false, &file, &file_size));
+
+  // Each thread writes and reads back its own interleaved set of blocks. With
+  // a shared file position, the threads would clobber each other's offsets.
+  std::vector<std::thread> threads;
+  std::vector<size_t> error_counts(kThreadCount, 0);
+  for (size_t t = 0; t < kThreadCount; ++t) {
+    threads.emplace_back([this, file, t, &error_counts]() {
+      uint8_t buffer[kBlockSize], read_buffer[kBlockSize];
+      for (size_t i = 0; i < kBlocksPerThread; ++i) {
+        size_t block_number = i * kThreadCount + t;
+        FillBlock(block_number, buffer);
+        if (file->Write(buffer, block_number << kBlockShift, kBlockSize) !=
+            Status::kSuccess) {
+          ++error_counts[t];
+        }
+      }
+      for (size_t i = 0; i < kBlocksPerThread; ++i) {
+        size_t block_number = i * kThreadCount + t;
+        FillBlock(block_number, buffer);
+        if (file->Read(block_number << kBlockShift, kBlockSize,
+                       read_buffer) != Status::kSuccess ||
+            std::memcmp(buffer, read_buffer, kBlockSize) != 0) {
+          ++error_counts[t];
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+  for (size_t t = 0; t < kThreadCount; ++t)
+    EXPECT_EQ(0U, error_counts[t]) << "thread " << t;
+  EXPECT_EQ(Status::kSuccess, file->Sync());
+  EXPECT_EQ(Status::kSuccess, file->Close());
+
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, false, false, false, &file, &file_size));
+  EXPECT_EQ((kThreadCount * kBlocksPerThread) << kBlockShift, file_size);
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
+TEST_F(PosixVfsTest, LibcVfsCompatibility) {
+  uint8_t buffer[2][kBlockSize], read_buffer[kBlockSize];
+  FillBlock(0, buffer[0]);
+  FillBlock(1, buffer[1]);
+  Vfs* libc_vfs = BuiltinLibcVfs();
+
+  BlockAccessFile* file;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, true, false, &file, &file_size));
+  EXPECT_EQ(Status::kSuccess, file->Write(buffer[0], 0, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+
+  ASSERT_EQ(Status::kSuccess, libc_vfs->OpenForBlockAccess(
+      kFileName, kBlockShift, false, false, false, &file, &file_size));
+  EXPECT_EQ(kBlockSize, file_size);
+  EXPECT_EQ(Status::kSuccess, file->Read(0, kBlockSize, read_buffer));
+  EXPECT_EQ(0, std::memcmp(buffer[0], read_buffer, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Write(buffer[1], kBlockSize, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, false, false, false, &file, &file_size));
+  EXPECT_EQ(2 * kBlockSize, file_size);
+  EXPECT_EQ(Status::kSuccess, file->Read(kBlockSize, kBlockSize, read_buffer));
+  EXPECT_EQ(0, std::memcmp(buffer[1], read_buffer, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
+TEST_F(PosixVfsTest, VectoredIoManyBuffers) {
+  // More buffers than a single preadv() / pwritev() call takes.
+  constexpr size_t kBufferCount = 100;
+  std::vector<uint8_t> data(kBufferCount * kBlockSize);
+  std::vector<uint8_t> read_data(kBufferCount * kBlockSize);
+  for (size_t i = 0; i < kBufferCount; ++i)
+    FillBlock(i, data.data() + i * kBlockSize);
+
+  // The buffers are handed out in reverse order, so adjacent blocks in the
+  // file are not adjacent in memory.
+  std::vector<BlockIoBuffer> buffers, read_buffers;
+  for (size_t i = kBufferCount; i > 0; --i) {
+    buffers.push_back({data.data() + (i - 1) * kBlockSize, kBlockSize});
+    read_buffers.push_back(
+        {read_data.data() + (i - 1) * kBlockSize, kBlockSize});
+  }
+
+  // The libc VFS implements vectored I/O by looping over the buffers.
+  for (Vfs* vfs : {vfs_, BuiltinLibcVfs()}) {
+    BlockAccessFile* file;
+    size_t file_size;
+    ASSERT_EQ(Status::kSuccess, vfs->OpenForBlockAccess(
+        kFileName, kBlockShift, true, false, false, &file, &file_size));
+    EXPECT_EQ(Status::kSuccess, file->WriteV(
+        buffers.data(), kBufferCount, kBlockSize));
+
+    uint8_t read_buffer[kBlockSize];
+    EXPECT_EQ(Status::kSuccess, file->Read(
+        kBufferCount * kBlockSize, kBlockSize, read_buffer));
+    EXPECT_EQ(0, std::memcmp(data.data(), read_buffer, kBlockSize));
+
+    std::fill(read_data.begin(), read_data.end(), 0);
+    EXPECT_EQ(Status::kSuccess, file->ReadV(
+        kBlockSize, read_buffers.data(), kBufferCount));
+    EXPECT_TRUE(data == read_data);
+    EXPECT_EQ(Status::kSuccess, file->Close());
+    EXPECT_EQ(Status::kSuccess, vfs->RemoveFile(kFileName));
+  }
+}
+
+TEST_F(PosixVfsTest, MapForReading) {
+  constexpr size_t kBlockCount = 4;
+  std::vector<uint8_t> data(kBlockCount * kBlockSize);
+  for (size_t i = 0; i < kBlockCount; ++i)
+    FillBlock(i, data.data() + i * kBlockSize);
+
+  BlockAccessFile* file;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, false, false, &file, &file_size));
+  ASSERT_EQ(Status::kSuccess, file->Write(
+      data.data(), 0, kBlockCount * kBlockSize));
+
+  uint8_t* mapping;
+  ASSERT_EQ(Status::kSuccess, file->MapForReading(
+      kBlockCount * kBlockSize, &mapping));
+  EXPECT_EQ(0, std::memcmp(data.data(), mapping, kBlockCount * kBlockSize));
+
+  // Hints do not change the mapping's content.
+  file->AdviseMapping(0, kBlockCount * kBlockSize, MappingAdvice::kRandom);
+  file->AdviseMapping(kBlockSize, 2 * kBlockSize, MappingAdvice::kWillNeed);
+  file->AdviseMapping(2 * kBlockSize, kBlockSize, MappingAdvice::kSequential);
+  file->AdviseMapping(0, kBlockCount * kBlockSize, MappingAdvice::kNormal);
+  EXPECT_EQ(0, std::memcmp(data.data(), mapping, kBlockCount * kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
+TEST_F(PosixVfsTest, MapReadOnlyFile) {
+  uint8_t buffer[kBlockSize];
+  FillBlock(0, buffer);
+
+  BlockAccessFile* file;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockAccess(
+      kFileName, kBlockShift, true, false, false, &file, &file_size));
+  ASSERT_EQ(Status::kSuccess, file->Write(buffer, 0, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+  ASSERT_EQ(0, ::chmod(kFileName.c_str(), 0444));
+
+  ASSERT_EQ(Status::kSuccess, vfs_->OpenForBlockReads(
+      kFileName, kBlockShift, &file, &file_size));
+  EXPECT_EQ(kBlockSize, file_size);
+  uint8_t* mapping;
+  ASSERT_EQ(Status::kSuccess, file->MapForReading(kBlockSize, &mapping));
+  EXPECT_EQ(0, std::memcmp(buffer, mapping, kBlockSize));
+#if defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+  EXPECT_EQ(Status::kSuccess, file->LockShared());
+#endif  // defined(BERRYDB_PLATFORM_HAVE_FLOCK)
+  EXPECT_EQ(Status::kIoError, file->Write(buffer, 0, kBlockSize));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
+TEST_F(PosixVfsTest, LibcVfsCannotMap) {
+  uint8_t buffer[kBlockSize];
+  FillBlock(0, buffer);
+
+  BlockAccessFile* file;
+  size_t file_size;
+  ASSERT_EQ(Status::kSuccess, BuiltinLibcVfs()->OpenForBlockAccess(
+      kFileName, kBlockShift, true, false, false, &file, &file_size));
+  ASSERT_EQ(Status::kSuccess, file->Write(buffer, 0, kBlockSize));
+
+  uint8_t* mapping;
+  EXPECT_EQ(Status::kIoError, file->MapForReading(kBlockSize, &mapping));
+  EXPECT_EQ(Status::kSuccess, file->Close());
+}
+
+#else  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+TEST(PosixVfsTest, Unavailable) {
+  EXPECT_EQ(nullptr, BuiltinPosixVfs());
+  EXPECT_EQ(BuiltinLibcVfs(), DefaultVfs());
+}
+
+#endif  // defined(BERRYDB_PLATFORM_HAVE_POSIX_FILES)
+
+}  // namespace berrydb
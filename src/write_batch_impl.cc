@@ -0,0 +1,110 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./write_batch_impl.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace berrydb {
+
+static_assert(std::is_standard_layout<WriteBatchImpl>::value,
+    "WriteBatchImpl must be a standard layout type so its public API can be "
+    "exposed cheaply");
+
+constexpr size_t WriteBatchImpl::kMinArenaCapacity;
+
+WriteBatchImpl* WriteBatchImpl::Create() {
+  void* heap_block = Allocate(sizeof(WriteBatchImpl));
+  WriteBatchImpl* batch = new (heap_block) WriteBatchImpl();
+  DCHECK_EQ(heap_block, static_cast<void*>(batch));
+  return batch;
+}
+
+WriteBatchImpl::WriteBatchImpl() noexcept : api_() { }
+
+WriteBatchImpl::~WriteBatchImpl() {
+  if (arena_ != nullptr)
+    Deallocate(arena_, arena_capacity_);
+}
+
+void WriteBatchImpl::Release() {
+  this->~WriteBatchImpl();
+  void* heap_block = static_cast<void*>(this);
+  Deallocate(heap_block, sizeof(WriteBatchImpl));
+}
+
+void WriteBatchImpl::Put(Space* space, string_view key, string_view value) {
+  AppendRecord(space, key, value, false);
+}
+
+void WriteBatchImpl::Delete(Space* space, string_view key) {
+  AppendRecord(space, key, string_view(), true);
+}
+
+void WriteBatchImpl::Clear() noexcept {
+  arena_size_ = 0;
+  mutation_count_ = 0;
+}
+
+void WriteBatchImpl::ListMutations(Mutation* mutations) const noexcept {
+  DCHECK(mutations != nullptr || mutation_count_ == 0);
+
+  size_t offset = 0;
+  for (size_t i = 0; i < mutation_count_; ++i) {
+    RecordHeader header;
+    std::memcpy(&header, arena_ + offset, sizeof(header));
+    offset += sizeof(header);
+
+    Mutation& mutation = mutations[i];
+    mutation.space = header.space;
+    mutation.key = string_view(reinterpret_cast<char*>(arena_ + offset),
+                               header.key_size);
+    offset += header.key_size;
+    mutation.value = string_view(reinterpret_cast<char*>(arena_ + offset),
+                                 header.value_size);
+    offset += header.value_size;
+    mutation.is_delete = header.is_delete;
+  }
+  DCHECK_EQ(arena_size_, offset);
+}
+
+void WriteBatchImpl::AppendRecord(Space* space, string_view key,
+                                  string_view value, bool is_delete) {
+  DCHECK(space != nullptr);
+
+  size_t record_size = sizeof(RecordHeader) + key.size() + value.size();
+  if (arena_size_ + record_size > arena_capacity_) {
+    size_t new_capacity = std::max(arena_capacity_ * 2, kMinArenaCapacity);
+    while (new_capacity < arena_size_ + record_size)
+      new_capacity *= 2;
+
+    uint8_t* new_arena = reinterpret_cast<uint8_t*>(Allocate(new_capacity));
+    if (arena_ != nullptr) {
+      std::memcpy(new_arena, arena_, arena_size_);
+      Deallocate(arena_, arena_capacity_);
+    }
+    arena_ = new_arena;
+    arena_capacity_ = new_capacity;
+  }
+
+  RecordHeader header;
+  header.space = space;
+  header.key_size = key.size();
+  header.value_size = value.size();
+  header.is_delete = is_delete;
+  uint8_t* record = arena_ + arena_size_;
+  std::memcpy(record, &header, sizeof(header));
+  record += sizeof(header);
+  if (key.size() != 0)
+    std::memcpy(record, key.data(), key.size());
+  record += key.size();
+  if (value.size() != 0)
+    std::memcpy(record, value.data(), value.size());
+
+  arena_size_ += record_size;
+  ++mutation_count_;
+}
+
+}  // namespace berrydb
@@ -0,0 +1,108 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BERRYDB_WRITE_BATCH_IMPL_H_
+#define BERRYDB_WRITE_BATCH_IMPL_H_
+
+#include "berrydb/platform.h"
+#include "berrydb/write_batch.h"
+
+namespace berrydb {
+
+/** Internal representation for the WriteBatch class in the public API.
+ *
+ * The mutations are stored back to back in a single arena buffer. Each mutation
+ * is a fixed-size header, followed by the key's bytes and by the value's bytes.
+ * The arena grows geometrically, so recording a mutation usually boils down to
+ * a few memcpy calls.
+ */
+class WriteBatchImpl {
+ public:
+  /** A mutation recorded in a batch.
+   *
+   * The key and value point into the batch's arena, so they remain valid until
+   * the batch is modified. */
+  struct Mutation {
+    Space* space;
+    string_view key;
+    /** Empty for deletions. */
+    string_view value;
+    bool is_delete;
+  };
+
+  /** Create a WriteBatchImpl instance. */
+  static WriteBatchImpl* Create();
+
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline WriteBatchImpl* FromApi(WriteBatch* api) noexcept {
+    WriteBatchImpl* impl = reinterpret_cast<WriteBatchImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+  /** Computes the internal representation for a pointer from the public API. */
+  static inline const WriteBatchImpl* FromApi(const WriteBatch* api) noexcept {
+    const WriteBatchImpl* impl = reinterpret_cast<const WriteBatchImpl*>(api);
+    DCHECK_EQ(api, &impl->api_);
+    return impl;
+  }
+
+  /** Computes the public API representation for this batch. */
+  inline WriteBatch* ToApi() noexcept { return &api_; }
+
+  // See the public API documention for details.
+  void Put(Space* space, string_view key, string_view value);
+  void Delete(Space* space, string_view key);
+  void Clear() noexcept;
+  inline size_t size() const noexcept { return mutation_count_; }
+  void Release();
+
+  /** Lists the batch's mutations, in the order in which they were recorded.
+   *
+   * @param mutations receives size() mutations
+   */
+  void ListMutations(Mutation* mutations) const noexcept;
+
+ private:
+  /** Precedes each mutation's key and value in the arena. */
+  struct RecordHeader {
+    Space* space;
+    size_t key_size;
+    size_t value_size;
+    bool is_delete;
+  };
+
+  /** The arena's size when the first mutation is recorded. */
+  static constexpr size_t kMinArenaCapacity = 4096;
+
+  /** Use WriteBatchImpl::Create() to obtain WriteBatchImpl instances. */
+  WriteBatchImpl() noexcept;
+  /** Use Release() to destroy WriteBatchImpl instances. */
+  ~WriteBatchImpl();
+
+  // Batches cannot be copied or moved.
+  WriteBatchImpl(const WriteBatchImpl& other) = delete;
+  WriteBatchImpl(WriteBatchImpl&& other) = delete;
+  WriteBatchImpl& operator=(const WriteBatchImpl& other) = delete;
+  WriteBatchImpl& operator=(WriteBatchImpl&& other) = delete;
+
+  /** Appends a mutation to the arena. */
+  void AppendRecord(Space* space, string_view key, string_view value,
+                    bool is_delete);
+
+  /* The public API version of this class. */
+  WriteBatch api_;  // Must be the first class member.
+
+  /** Holds the batch's mutations. nullptr until the first mutation. */
+  uint8_t* arena_ = nullptr;
+  /** The number of bytes allocated for the arena. */
+  size_t arena_capacity_ = 0;
+  /** The number of arena bytes used by mutations. */
+  size_t arena_size_ = 0;
+  /** The number of mutations recorded in the arena. */
+  size_t mutation_count_ = 0;
+};
+
+}  // namespace berrydb
+
+#endif  // BERRYDB_WRITE_BATCH_IMPL_H_
@@ -0,0 +1,87 @@
+// Copyright 2017 The BerryDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "./write_batch_impl.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "./util/unique_ptr.h"
+
+namespace berrydb {
+
+namespace {
+
+// The batch never dereferences the spaces, so any address works.
+Space* FakeSpace(uintptr_t address) {
+  return reinterpret_cast<Space*>(address);
+}
+
+}  // namespace
+
+TEST(WriteBatchImplTest, ListMutations) {
+  UniquePtr<WriteBatchImpl> batch(WriteBatchImpl::Create());
+  EXPECT_EQ(0U, batch->size());
+
+  batch->Put(FakeSpace(8), "key", "value");
+  batch->Delete(FakeSpace(16), "deleted");
+  batch->Put(FakeSpace(8), "", "");
+  ASSERT_EQ(3U, batch->size());
+
+  WriteBatchImpl::Mutation mutations[3];
+  batch->ListMutations(mutations);
+  EXPECT_EQ(FakeSpace(8), mutations[0].space);
+  EXPECT_EQ("key", mutations[0].key);
+  EXPECT_EQ("value", mutations[0].value);
+  EXPECT_FALSE(mutations[0].is_delete);
+  EXPECT_EQ(FakeSpace(16), mutations[1].space);
+  EXPECT_EQ("deleted", mutations[1].key);
+  EXPECT_EQ("", mutations[1].value);
+  EXPECT_TRUE(mutations[1].is_delete);
+  EXPECT_EQ(FakeSpace(8), mutations[2].space);
+  EXPECT_EQ("", mutations[2].key);
+  EXPECT_EQ("", mutations[2].value);
+  EXPECT_FALSE(mutations[2].is_delete);
+}
+
+TEST(WriteBatchImplTest, CopiesLargeMutations) {
+  UniquePtr<WriteBatchImpl> batch(WriteBatchImpl::Create());
+
+  // The mutations outgrow the initial arena many times.
+  std::vector<std::string> values;
+  for (size_t i = 0; i < 100; ++i) {
+    std::string key = "key" + std::to_string(i);
+    values.push_back(std::string(i * 100, static_cast<char>('a' + i % 26)));
+    batch->Put(FakeSpace(8), string_view(key.data(), key.size()),
+               string_view(values[i].data(), values[i].size()));
+  }
+  ASSERT_EQ(100U, batch->size());
+
+  std::vector<WriteBatchImpl::Mutation> mutations(batch->size());
+  batch->ListMutations(mutations.data());
+  for (size_t i = 0; i < 100; ++i) {
+    std::string key = "key" + std::to_string(i);
+    EXPECT_EQ(string_view(key.data(), key.size()), mutations[i].key);
+    EXPECT_EQ(string_view(values[i].data(), values[i].size()),
+              mutations[i].value);
+  }
+}
+
+TEST(WriteBatchImplTest, Clear) {
+  UniquePtr<WriteBatchImpl> batch(WriteBatchImpl::Create());
+  batch->Put(FakeSpace(8), "key", "value");
+  batch->Clear();
+  EXPECT_EQ(0U, batch->size());
+
+  batch->Delete(FakeSpace(8), "other");
+  ASSERT_EQ(1U, batch->size());
+  WriteBatchImpl::Mutation mutation;
+  batch->ListMutations(&mutation);
+  EXPECT_EQ("other", mutation.key);
+  EXPECT_TRUE(mutation.is_delete);
+}
+
+}  // namespace berrydb